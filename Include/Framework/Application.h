@@ -1,6 +1,7 @@
 ﻿#pragma once
 
 #include <stdint.h>
+#include <string>
 #include <Windows.h>
 #include <d3d12.h>
 #include <dxgi1_6.h>
@@ -27,6 +28,7 @@ public:
 	void Terminate();
 
 	ID3D12Device9* GetD3D12Device9() { return m_d3d12Device.Get(); }
+	const std::string& GetAdapterName() const { return m_adapterName; }
 
 	virtual void OnInitialize(const ApplicationDesc& applicationDesc) = 0;
 	virtual void OnUpdate() = 0;
@@ -34,6 +36,10 @@ public:
 
 	static Application* GetMainApplication() { return s_instance; }
 
+	// Framework::Run returns after the frame in which the application requested to quit.
+	void RequestQuit() { m_isQuitRequested = true; }
+	bool IsQuitRequested() const { return m_isQuitRequested; }
+
 	HWND GetHWND();
 
 protected:
@@ -43,6 +49,8 @@ protected:
 	Microsoft::WRL::ComPtr<ID3D12CommandQueue> m_commandQueue = nullptr;
 	Microsoft::WRL::ComPtr<ID3D12QueryHeap> m_queryHeap = nullptr;
 	Microsoft::WRL::ComPtr<IDXGISwapChain3> m_swapChain = nullptr;
+	std::string m_adapterName;
+	bool m_isQuitRequested = false;
 	
 };
 }
\ No newline at end of file
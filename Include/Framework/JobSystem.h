@@ -0,0 +1,140 @@
+﻿#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace LearningWorkGraph
+{
+class TaskGroup;
+
+// Work-stealing job system. Every worker owns a Chase-Lev deque: it pushes and pops its own jobs at the bottom
+// while idle workers steal the oldest ones from the top. Threads that are no workers, like the main thread,
+// submit through a shared queue, and help executing jobs while they wait for a TaskGroup.
+// Has no graphics API dependency.
+class JobSystem
+{
+public:
+	// numWorkers threads besides the threads that submit, hardware_concurrency - 1 for the shared instance.
+	explicit JobSystem(uint32_t numWorkers);
+	~JobSystem();
+	JobSystem(const JobSystem&) = delete;
+	JobSystem& operator=(const JobSystem&) = delete;
+
+	static JobSystem& Get();
+
+	// Workers and the submitting thread.
+	uint32_t GetNumThreads() const { return static_cast<uint32_t>(m_workers.size()) + 1; }
+	// Runs one pending job on the calling thread. Returns false if none was found.
+	bool ExecuteOne();
+
+private:
+	friend class TaskGroup;
+
+	struct Job
+	{
+		std::function<void()> m_function;
+		TaskGroup* m_group = nullptr;
+	};
+
+	// Chase and Lev, "Dynamic Circular Work-Stealing Deque", with the memory orders of Lê et al.,
+	// "Correct and Efficient Work-Stealing for Weak Memory Models". Fixed capacity, a full deque runs the job inline.
+	class WorkStealingDeque
+	{
+	public:
+		bool Push(Job* job);
+		Job* Pop();
+		Job* Steal();
+
+	private:
+		static constexpr int64_t k_capacity = 1 << 12;
+		alignas(64) std::atomic<int64_t> m_top = 0;
+		alignas(64) std::atomic<int64_t> m_bottom = 0;
+		std::unique_ptr<std::atomic<Job*>[]> m_jobs = std::make_unique<std::atomic<Job*>[]>(k_capacity);
+	};
+
+	void Submit(Job* job);
+	Job* FindJob(uint32_t firstVictim);
+	void Execute(Job* job);
+	void RunWorker(uint32_t workerIndex);
+
+	std::vector<std::unique_ptr<WorkStealingDeque>> m_deques;
+	std::vector<std::thread> m_workers;
+	std::mutex m_sharedMutex;
+	std::deque<Job*> m_sharedJobs;
+	std::atomic<uint32_t> m_numSharedJobs = 0;
+	// Bumped on every submission, idle workers wait on it.
+	std::atomic<uint32_t> m_epoch = 0;
+	std::atomic<uint32_t> m_numSleeping = 0;
+	std::atomic<bool> m_isStopping = false;
+};
+
+// Fork/join: Run forks a job, Wait joins all jobs of the group and executes pending jobs on the calling thread meanwhile.
+// Jobs may run groups of their own.
+class TaskGroup
+{
+public:
+	explicit TaskGroup(JobSystem& jobSystem = JobSystem::Get()) : m_jobSystem(jobSystem) {}
+	~TaskGroup() { Wait(); }
+	TaskGroup(const TaskGroup&) = delete;
+	TaskGroup& operator=(const TaskGroup&) = delete;
+
+	template<typename Function>
+	void Run(Function&& function)
+	{
+		m_numPending.fetch_add(1, std::memory_order_relaxed);
+		m_jobSystem.Submit(new JobSystem::Job{ std::forward<Function>(function), this });
+	}
+	void Wait();
+
+	JobSystem& GetJobSystem() const { return m_jobSystem; }
+
+private:
+	friend class JobSystem;
+
+	JobSystem& m_jobSystem;
+	std::atomic<uint32_t> m_numPending = 0;
+};
+
+template<typename Function>
+void ParallelForSplit(TaskGroup& group, size_t begin, size_t end, size_t grain, const Function& function)
+{
+	// Halves are forked until a range fits the grain, so idle workers steal the largest halves first.
+	while (end - begin > grain)
+	{
+		const auto middle = begin + (end - begin) / 2;
+		group.Run([&group, middle, end, grain, &function] { ParallelForSplit(group, middle, end, grain, function); });
+		end = middle;
+	}
+	function(begin, end);
+}
+
+// Calls function(begin, end) for ranges that cover [begin, end). The grain adapts to the number of threads,
+// about k_rangesPerThread ranges per thread so that stealing balances uneven ranges, and never goes below minGrain.
+template<typename Function>
+void ParallelFor(size_t begin, size_t end, size_t minGrain, const Function& function, JobSystem& jobSystem = JobSystem::Get())
+{
+	constexpr size_t k_rangesPerThread = 4;
+	if (end <= begin)
+	{
+		return;
+	}
+	const auto count = end - begin;
+	const auto grain = (std::max)((std::max<size_t>)(minGrain, 1), (count + jobSystem.GetNumThreads() * k_rangesPerThread - 1) / (jobSystem.GetNumThreads() * k_rangesPerThread));
+	if (count <= grain)
+	{
+		function(begin, end);
+		return;
+	}
+	auto group = TaskGroup(jobSystem);
+	ParallelForSplit(group, begin, end, grain, function);
+	group.Wait();
+}
+}
\ No newline at end of file
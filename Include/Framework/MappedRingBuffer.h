@@ -0,0 +1,38 @@
+﻿#pragma once
+
+#include <Framework/RingAllocator.h>
+
+#include <Windows.h>
+#include <d3d12.h>
+#include <wrl.h>
+
+namespace LearningWorkGraph
+{
+// Upload or readback buffer that stays mapped for its whole lifetime, sub-allocated with a LinearRingAllocator.
+class MappedRingBuffer
+{
+public:
+	struct Allocation
+	{
+		std::byte* m_cpuAddress = nullptr;
+		D3D12_GPU_VIRTUAL_ADDRESS m_gpuAddress = 0;
+		uint64_t m_offset = 0;
+		uint64_t m_size = 0;
+	};
+
+	~MappedRingBuffer();
+
+	void Initialize(ID3D12Device* device, D3D12_HEAP_TYPE heapType, uint64_t size, uint32_t maxFramesInFlight, const wchar_t* name);
+	// Aborts if the ring is full.
+	Allocation Allocate(uint64_t size, uint64_t alignment);
+	void FinishFrame(uint64_t fenceValue);
+	void Retire(uint64_t completedFenceValue) { m_allocator.Retire(completedFenceValue); }
+
+	ID3D12Resource* GetResource() const { return m_resource.Get(); }
+	uint64_t GetSize() const { return m_allocator.GetSize(); }
+
+private:
+	Microsoft::WRL::ComPtr<ID3D12Resource> m_resource = nullptr;
+	LinearRingAllocator m_allocator = {};
+};
+}
\ No newline at end of file
@@ -0,0 +1,55 @@
+﻿#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace LearningWorkGraph
+{
+// Linear allocator over a persistently mapped range, used as a ring. Allocations of a frame are tagged with the fence value
+// signaled after the frame and their memory is reused once that fence value has completed.
+// Has no graphics API dependency, the fence is just a monotonically increasing value.
+class LinearRingAllocator
+{
+public:
+	struct Allocation
+	{
+		std::byte* m_cpuAddress = nullptr;
+		uint64_t m_offset = 0;
+		uint64_t m_size = 0;
+
+		bool IsValid() const { return m_size > 0; }
+	};
+
+	// cpuAddress can be nullptr to only compute offsets. maxFramesInFlight bounds the number of unretired frames.
+	void Initialize(std::byte* cpuAddress, uint64_t size, uint32_t maxFramesInFlight);
+
+	// alignment must be a power of two. Returns an invalid allocation if the ring is full.
+	Allocation Allocate(uint64_t size, uint64_t alignment);
+	// Everything allocated since the previous call is in use until fenceValue completes. Returns false if too many frames are in flight.
+	bool FinishFrame(uint64_t fenceValue);
+	// Frees the frames whose fence value is <= completedFenceValue.
+	void Retire(uint64_t completedFenceValue);
+
+	uint64_t GetSize() const { return m_size; }
+	uint64_t GetUsedSize() const { return m_head - m_tail; }
+	uint32_t GetNumFramesInFlight() const { return m_numFrames; }
+
+private:
+	struct Frame
+	{
+		uint64_t m_fenceValue = 0;
+		uint64_t m_end = 0;
+	};
+
+	std::byte* m_cpuAddress = nullptr;
+	uint64_t m_size = 0;
+	// Positions grow monotonically, the offset is position % m_size.
+	uint64_t m_head = 0;
+	uint64_t m_tail = 0;
+	// Fixed capacity queue of unretired frames, allocated once in Initialize.
+	std::vector<Frame> m_frames;
+	uint32_t m_firstFrame = 0;
+	uint32_t m_numFrames = 0;
+};
+}
\ No newline at end of file
@@ -23,6 +23,7 @@ public:
 	~Shader();
 	bool CompileFromMemory(std::string_view source, std::string_view entryPoint, std::string_view target, const std::vector<ShaderDefine>* defines = nullptr);
 	bool CompileFromFile(std::string_view filePath, std::string_view entryPoint, std::string_view target, const std::vector<ShaderDefine>* defines = nullptr);
+	static bool ReadSourceFile(std::string_view filePath, std::string& source);
 //	void Map(const char* sourcePath);
 
 	const void* GetData() const { return m_compilerBufferData.get(); }
@@ -3,6 +3,8 @@
 
 #include <d3dx12/d3dx12.h>
 
+#include <cstdio>
+
 using Microsoft::WRL::ComPtr;
 namespace LearningWorkGraph
 {
@@ -64,6 +66,22 @@ void Application::Initialize(const ApplicationDesc& applicationDesc)
 			adapter->Release();
 		}
 		D3D12CreateDevice(hardwareAdapter.Get(), D3D_FEATURE_LEVEL_11_0, IID_PPV_ARGS(&m_d3d12Device));
+
+		DXGI_ADAPTER_DESC1 adapterDesc = {};
+		if (hardwareAdapter && SUCCEEDED(hardwareAdapter->GetDesc1(&adapterDesc)))
+		{
+			m_adapterName.resize(WideCharToMultiByte(CP_ACP, 0, adapterDesc.Description, -1, NULL, 0, NULL, NULL));
+			WideCharToMultiByte(CP_ACP, 0, adapterDesc.Description, -1, m_adapterName.data(), m_adapterName.size(), NULL, NULL);
+			m_adapterName.resize(strlen(m_adapterName.c_str()));
+		}
+	}
+
+	// Without a device the application runs on its CPU path.
+	if (!m_d3d12Device)
+	{
+		printf("No D3D12 device available.\n");
+		OnInitialize(applicationDesc);
+		return;
 	}
 
 	D3D12_COMMAND_QUEUE_DESC commandQueueDesc = {};
@@ -100,8 +118,6 @@ void Application::Initialize(const ApplicationDesc& applicationDesc)
 		swapChain.As(& m_swapChain);
 	}
 
-	LWG_CHECK_WITH_MESSAGE(m_d3d12Device, "Failed to initialize compiler.");
-
 	OnInitialize(applicationDesc);
 }
 
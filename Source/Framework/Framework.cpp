@@ -72,6 +72,10 @@ void Framework::Run()
 			{
 				application->OnUpdate();
 				application->OnRender();
+				if (application->IsQuitRequested())
+				{
+					PostQuitMessage(0);
+				}
 			}
 			// Process any messages in the queue.
 			if (PeekMessage(&msg, NULL, 0, 0, PM_REMOVE))
@@ -89,6 +93,10 @@ void Framework::Run()
 			{
 				application->OnUpdate();
 				application->OnRender();
+				if (application->IsQuitRequested())
+				{
+					break;
+				}
 			}
 		}
 	}
@@ -0,0 +1,234 @@
+﻿#include <Framework/JobSystem.h>
+
+namespace LearningWorkGraph
+{
+namespace
+{
+// Job system and deque of the calling thread if it is a worker.
+thread_local JobSystem* t_jobSystem = nullptr;
+thread_local uint32_t t_workerIndex = 0;
+
+// Attempts to find a job before an idle worker sleeps.
+constexpr uint32_t k_numSpins = 64;
+}
+
+bool JobSystem::WorkStealingDeque::Push(Job* job)
+{
+	const auto bottom = m_bottom.load(std::memory_order_relaxed);
+	const auto top = m_top.load(std::memory_order_acquire);
+	if (bottom - top >= k_capacity)
+	{
+		return false;
+	}
+	m_jobs[bottom & (k_capacity - 1)].store(job, std::memory_order_relaxed);
+	// Publishes the job to the thieves that acquire the bottom.
+	m_bottom.store(bottom + 1, std::memory_order_release);
+	return true;
+}
+
+JobSystem::Job* JobSystem::WorkStealingDeque::Pop()
+{
+	const auto bottom = m_bottom.load(std::memory_order_relaxed) - 1;
+	m_bottom.store(bottom, std::memory_order_relaxed);
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+	auto top = m_top.load(std::memory_order_relaxed);
+	if (top > bottom)
+	{
+		m_bottom.store(bottom + 1, std::memory_order_relaxed);
+		return nullptr;
+	}
+	auto* job = m_jobs[bottom & (k_capacity - 1)].load(std::memory_order_relaxed);
+	if (top == bottom)
+	{
+		// The last job, raced with the thieves.
+		if (!m_top.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+		{
+			job = nullptr;
+		}
+		m_bottom.store(bottom + 1, std::memory_order_relaxed);
+	}
+	return job;
+}
+
+JobSystem::Job* JobSystem::WorkStealingDeque::Steal()
+{
+	auto top = m_top.load(std::memory_order_acquire);
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+	const auto bottom = m_bottom.load(std::memory_order_acquire);
+	if (top >= bottom)
+	{
+		return nullptr;
+	}
+	auto* job = m_jobs[top & (k_capacity - 1)].load(std::memory_order_relaxed);
+	if (!m_top.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+	{
+		return nullptr;
+	}
+	return job;
+}
+
+JobSystem::JobSystem(uint32_t numWorkers)
+{
+	for (uint32_t i = 0; i < numWorkers; ++i)
+	{
+		m_deques.push_back(std::make_unique<WorkStealingDeque>());
+	}
+	// Started after all deques exist, a worker steals from any of them.
+	for (uint32_t i = 0; i < numWorkers; ++i)
+	{
+		m_workers.emplace_back([this, i] { RunWorker(i); });
+	}
+}
+
+JobSystem::~JobSystem()
+{
+	m_isStopping.store(true);
+	m_epoch.fetch_add(1);
+	m_epoch.notify_all();
+	for (auto& worker : m_workers)
+	{
+		worker.join();
+	}
+}
+
+JobSystem& JobSystem::Get()
+{
+	static auto jobSystem = JobSystem((std::max)(1u, std::thread::hardware_concurrency()) - 1);
+	return jobSystem;
+}
+
+bool JobSystem::ExecuteOne()
+{
+	auto* job = FindJob((t_jobSystem == this) ? t_workerIndex + 1 : 0);
+	if (job == nullptr)
+	{
+		return false;
+	}
+	Execute(job);
+	return true;
+}
+
+void JobSystem::Submit(Job* job)
+{
+	if (t_jobSystem == this)
+	{
+		// A full deque has plenty of jobs to steal already.
+		if (!m_deques[t_workerIndex]->Push(job))
+		{
+			Execute(job);
+			return;
+		}
+	}
+	else
+	{
+		auto lock = std::lock_guard(m_sharedMutex);
+		m_sharedJobs.push_back(job);
+		m_numSharedJobs.fetch_add(1, std::memory_order_release);
+	}
+
+	// A worker that counted itself as sleeping before this either sees the job or the new epoch.
+	m_epoch.fetch_add(1);
+	if (m_numSleeping.load() > 0)
+	{
+		m_epoch.notify_one();
+	}
+}
+
+JobSystem::Job* JobSystem::FindJob(uint32_t firstVictim)
+{
+	if (t_jobSystem == this)
+	{
+		if (auto* job = m_deques[t_workerIndex]->Pop())
+		{
+			return job;
+		}
+	}
+	if (m_numSharedJobs.load(std::memory_order_acquire) > 0)
+	{
+		auto lock = std::lock_guard(m_sharedMutex);
+		if (!m_sharedJobs.empty())
+		{
+			auto* job = m_sharedJobs.front();
+			m_sharedJobs.pop_front();
+			m_numSharedJobs.fetch_sub(1, std::memory_order_relaxed);
+			return job;
+		}
+	}
+	const auto numDeques = static_cast<uint32_t>(m_deques.size());
+	for (uint32_t i = 0; i < numDeques; ++i)
+	{
+		const auto victim = (firstVictim + i) % numDeques;
+		if (t_jobSystem == this && victim == t_workerIndex)
+		{
+			continue;
+		}
+		if (auto* job = m_deques[victim]->Steal())
+		{
+			return job;
+		}
+	}
+	return nullptr;
+}
+
+void JobSystem::Execute(Job* job)
+{
+	job->m_function();
+	auto* group = job->m_group;
+	// The group may be gone once its last job is counted, so the job is destroyed first.
+	delete job;
+	group->m_numPending.fetch_sub(1, std::memory_order_release);
+}
+
+void JobSystem::RunWorker(uint32_t workerIndex)
+{
+	t_jobSystem = this;
+	t_workerIndex = workerIndex;
+	auto numFailures = 0u;
+	while (true)
+	{
+		if (auto* job = FindJob(workerIndex + 1))
+		{
+			Execute(job);
+			numFailures = 0;
+			continue;
+		}
+		if (m_isStopping.load())
+		{
+			break;
+		}
+		if (++numFailures < k_numSpins)
+		{
+			std::this_thread::yield();
+			continue;
+		}
+
+		m_numSleeping.fetch_add(1);
+		const auto epoch = m_epoch.load();
+		if (auto* job = FindJob(workerIndex + 1))
+		{
+			m_numSleeping.fetch_sub(1);
+			Execute(job);
+			numFailures = 0;
+			continue;
+		}
+		if (!m_isStopping.load())
+		{
+			m_epoch.wait(epoch);
+		}
+		m_numSleeping.fetch_sub(1);
+		numFailures = 0;
+	}
+}
+
+void TaskGroup::Wait()
+{
+	// The waiting thread joins in instead of blocking, so nested groups on the workers cannot run out of threads.
+	while (m_numPending.load(std::memory_order_acquire) > 0)
+	{
+		if (!m_jobSystem.ExecuteOne())
+		{
+			std::this_thread::yield();
+		}
+	}
+}
+}
\ No newline at end of file
@@ -0,0 +1,50 @@
+﻿#include <Framework/MappedRingBuffer.h>
+#include <Framework/Framework.h>
+
+#include <d3dx12/d3dx12.h>
+
+namespace LearningWorkGraph
+{
+MappedRingBuffer::~MappedRingBuffer()
+{
+	if (m_resource)
+	{
+		m_resource->Unmap(0, NULL);
+	}
+}
+
+void MappedRingBuffer::Initialize(ID3D12Device* device, D3D12_HEAP_TYPE heapType, uint64_t size, uint32_t maxFramesInFlight, const wchar_t* name)
+{
+	LWG_CHECK(heapType == D3D12_HEAP_TYPE_UPLOAD || heapType == D3D12_HEAP_TYPE_READBACK);
+	if (m_resource)
+	{
+		m_resource->Unmap(0, NULL);
+		m_resource.Reset();
+	}
+
+	// Upload heaps must stay in GENERIC_READ and readback heaps in COPY_DEST.
+	const auto state = (heapType == D3D12_HEAP_TYPE_UPLOAD) ? D3D12_RESOURCE_STATE_GENERIC_READ : D3D12_RESOURCE_STATE_COPY_DEST;
+	auto heapProperties = CD3DX12_HEAP_PROPERTIES(heapType);
+	auto desc = CD3DX12_RESOURCE_DESC::Buffer(size);
+	LWG_CHECK_HRESULT(device->CreateCommittedResource(&heapProperties, D3D12_HEAP_FLAG_NONE, &desc, state, NULL, IID_PPV_ARGS(&m_resource)));
+	m_resource->SetName(name);
+
+	// Upload memory is never read by the CPU, readback memory may be read anywhere.
+	std::byte* cpuAddress = nullptr;
+	auto readRange = CD3DX12_RANGE(0, 0);
+	LWG_CHECK_HRESULT(m_resource->Map(0, (heapType == D3D12_HEAP_TYPE_UPLOAD) ? &readRange : NULL, (void**)&cpuAddress));
+	m_allocator.Initialize(cpuAddress, size, maxFramesInFlight);
+}
+
+MappedRingBuffer::Allocation MappedRingBuffer::Allocate(uint64_t size, uint64_t alignment)
+{
+	const auto allocation = m_allocator.Allocate(size, alignment);
+	LWG_CHECK_WITH_MESSAGE(allocation.IsValid(), "Ring buffer is full.");
+	return { allocation.m_cpuAddress, m_resource->GetGPUVirtualAddress() + allocation.m_offset, allocation.m_offset, allocation.m_size };
+}
+
+void MappedRingBuffer::FinishFrame(uint64_t fenceValue)
+{
+	LWG_CHECK_WITH_MESSAGE(m_allocator.FinishFrame(fenceValue), "Too many frames in flight.");
+}
+}
\ No newline at end of file
@@ -0,0 +1,70 @@
+﻿#include <Framework/RingAllocator.h>
+
+namespace LearningWorkGraph
+{
+void LinearRingAllocator::Initialize(std::byte* cpuAddress, uint64_t size, uint32_t maxFramesInFlight)
+{
+	m_cpuAddress = cpuAddress;
+	m_size = size;
+	m_head = 0;
+	m_tail = 0;
+	m_frames.assign(maxFramesInFlight, Frame());
+	m_firstFrame = 0;
+	m_numFrames = 0;
+}
+
+LinearRingAllocator::Allocation LinearRingAllocator::Allocate(uint64_t size, uint64_t alignment)
+{
+	if (size == 0 || size > m_size)
+	{
+		return {};
+	}
+
+	// An allocation never straddles the end of the range, the rest of the range is skipped instead.
+	const auto offset = m_head % m_size;
+	auto alignedOffset = (offset + alignment - 1) & ~(alignment - 1);
+	if (alignedOffset + size > m_size)
+	{
+		alignedOffset = m_size;
+	}
+	const auto padding = alignedOffset - offset;
+	if (alignedOffset == m_size)
+	{
+		alignedOffset = 0;
+	}
+	if (GetUsedSize() + padding + size > m_size)
+	{
+		return {};
+	}
+	m_head += padding + size;
+
+	auto allocation = Allocation();
+	allocation.m_cpuAddress = m_cpuAddress ? m_cpuAddress + alignedOffset : nullptr;
+	allocation.m_offset = alignedOffset;
+	allocation.m_size = size;
+	return allocation;
+}
+
+bool LinearRingAllocator::FinishFrame(uint64_t fenceValue)
+{
+	if (m_numFrames == m_frames.size())
+	{
+		return false;
+	}
+	auto& frame = m_frames[(m_firstFrame + m_numFrames) % m_frames.size()];
+	frame.m_fenceValue = fenceValue;
+	frame.m_end = m_head;
+	++m_numFrames;
+	return true;
+}
+
+void LinearRingAllocator::Retire(uint64_t completedFenceValue)
+{
+	while (m_numFrames > 0 && m_frames[m_firstFrame].m_fenceValue <= completedFenceValue)
+	{
+		m_tail = m_frames[m_firstFrame].m_end;
+		m_firstFrame = static_cast<uint32_t>((m_firstFrame + 1) % m_frames.size());
+		--m_numFrames;
+	}
+}
+}
\ No newline at end of file
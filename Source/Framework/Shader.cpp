@@ -144,6 +144,16 @@ bool Shader::CompileFromMemory(std::string_view source, std::string_view entryPo
 }
 
 bool Shader::CompileFromFile(std::string_view filePath, std::string_view entryPoint, std::string_view target, const std::vector<ShaderDefine>* defines)
+{
+	auto source = std::string();
+	if (!ReadSourceFile(filePath, source))
+	{
+		return false;
+	}
+	return CompileFromMemory(source, entryPoint, target, defines);
+}
+
+bool Shader::ReadSourceFile(std::string_view filePath, std::string& source)
 {
 	char fullFilePath[MAX_PATH];
 	GetFullPathNameA(filePath.data(), MAX_PATH, fullFilePath, NULL);
@@ -160,7 +170,10 @@ bool Shader::CompileFromFile(std::string_view filePath, std::string_view entryPo
 		memory.push_back((char)c);
 	}
 	std::fclose(file);
-	return CompileFromMemory(std::string(memory.begin(), memory.end()), entryPoint, target, defines);
+	// Drop the UTF-8 BOM so the source can be concatenated with generated code.
+	const size_t offset = (memory.size() >= 3 && memory[0] == '\xEF' && memory[1] == '\xBB' && memory[2] == '\xBF') ? 3 : 0;
+	source.assign(memory.begin() + offset, memory.end());
+	return true;
 }
 
 void Shader::Release()
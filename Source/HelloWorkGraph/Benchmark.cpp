@@ -0,0 +1,1327 @@
+﻿#include "Benchmark.h"
+#include "CooperativeSort.h"
+#include "CpuSort.h"
+#include "GroupBy.h"
+#include "HostMemory.h"
+#include "IncrementalSort.h"
+#include "KernelTuner.h"
+#include "NarrowKeys.h"
+#include "Primitives.h"
+#include "Sortedness.h"
+#include "SortRouter.h"
+#include "SortService.h"
+#include "SortingNetwork.h"
+#include "SortingNetworkSimd.h"
+#include "WorkGraphSortModel.h"
+#include "WorkGraphStats.h"
+
+#include <Framework/RingAllocator.h>
+
+#include <atomic>
+#include <bit>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <map>
+#include <mutex>
+#include <numeric>
+#include <random>
+#include <string>
+#include <thread>
+
+namespace LearningWorkGraph
+{
+namespace
+{
+constexpr uint32_t k_numIterations = 9;
+
+// Destination of the samples while a benchmark runs with results.
+struct BenchmarkRecorder
+{
+	std::vector<BenchmarkResult>* m_results = nullptr;
+	std::optional<BenchmarkResult> m_nextCase;
+} s_recorder;
+
+// Failed correctness checks since RunBenchmark started, any of them fails the command line.
+uint32_t s_numFailedChecks = 0;
+
+// Suffix of the line that reports the checked result.
+const char* CheckBenchmark(bool isPassed, const char* failure = " MISMATCH")
+{
+	if (isPassed)
+	{
+		return "";
+	}
+	++s_numFailedChecks;
+	return failure;
+}
+
+// Tune, Select, Save and Load with a synthetic timer in place of the device. The fastest variant is known, so the tuner
+// has to find it among the dispatchable candidates, and the table has to survive the round trip through a file.
+void BenchmarkKernelTuner()
+{
+	constexpr std::string_view k_device = "Synthetic";
+	// Fastest at 256 threads and 2 elements per thread, the other topologies pay a little more.
+	auto measure = [](const KernelVariant& variant, uint32_t numSortElements)
+	{
+		const auto threadsDistance = std::abs(static_cast<int>(std::bit_width(variant.m_threadsPerGroup)) - 9);
+		const auto elementsDistance = std::abs(static_cast<int>(std::bit_width(variant.m_elementsPerThread)) - 2);
+		return numSortElements * 1e-6 * (1.0 + 0.1 * threadsDistance + 0.1 * elementsDistance + 0.05 * static_cast<uint32_t>(variant.m_topology));
+	};
+	struct TuneCase
+	{
+		std::string_view m_pipelineMode;
+		uint32_t m_numSortElements;
+		KernelVariant m_expected;
+	};
+	// 2^27 keys need 2048 keys per group to stay within the dispatch limit.
+	constexpr TuneCase k_cases[] =
+	{
+		{ "Compute", 1u << 16, { 256, 2, KernelTopology::Launcher } },
+		{ "Compute", 1u << 27, { 1024, 2, KernelTopology::Launcher } },
+		{ "Work Graph", 1u << 16, { 256, 2, KernelTopology::Launcher } },
+		{ "Work Graph", 1u << 27, { 1024, 2, KernelTopology::Launcher } },
+	};
+
+	auto tuner = KernelTuner();
+	for (const auto& tuneCase : k_cases)
+	{
+		const auto candidates = KernelTuner::EnumerateVariants(tuneCase.m_pipelineMode == "Work Graph", tuneCase.m_numSortElements);
+		const auto isDispatchable = std::all_of(candidates.begin(), candidates.end(), [&](const KernelVariant& variant) { return variant.GetDispatchGrid(tuneCase.m_numSortElements) <= KernelVariant::k_maxDispatchGrid; });
+		const auto& best = tuner.Tune(k_device, tuneCase.m_pipelineMode, tuneCase.m_numSortElements, candidates, 3, measure);
+		printf
+		(
+			"%.*s, 2^%u keys: %zu candidates, %s%s\n",
+			static_cast<int>(tuneCase.m_pipelineMode.size()),
+			tuneCase.m_pipelineMode.data(),
+			std::bit_width(tuneCase.m_numSortElements) - 1,
+			candidates.size(),
+			best.ToString().c_str(),
+			CheckBenchmark(isDispatchable && best == tuneCase.m_expected)
+		);
+	}
+
+	// Every bucket between the tuned ones selects the closest winner that is dispatchable, past 2^27 keys there is none.
+	auto isSelected = true;
+	for (uint32_t bucket = 10; bucket <= 28; ++bucket)
+	{
+		const auto selected = tuner.Select(k_device, "Compute", 1u << bucket);
+		const auto* expected = (bucket <= 21) ? &k_cases[0].m_expected : (bucket <= 27) ? &k_cases[1].m_expected : nullptr;
+		isSelected &= expected ? (selected == *expected) : !selected;
+	}
+	SetBenchmarkCase("kernel tuner select", 19);
+	const auto selectTime = MeasureMilliseconds(k_numIterations, [] {}, [&]
+	{
+		for (uint32_t bucket = 10; bucket <= 28; ++bucket)
+		{
+			tuner.Select(k_device, "Work Graph", 1u << bucket);
+		}
+	});
+	printf("select: %.1fns per call%s\n", selectTime * 1e6 / 19, CheckBenchmark(isSelected));
+
+	// The table round trips, and corrupt or hand-edited lines are skipped instead of failing the load.
+	const auto path = (std::filesystem::temp_directory_path() / "KernelTunerBenchmark.txt").string();
+	auto isRoundTripped = tuner.Save(path);
+	{
+		auto file = std::ofstream(path, std::ios::app);
+		file << k_device << "\tCompute\tabc\tthreads=256,elements=2,topology=Launcher\t1.0\n";
+		file << k_device << "\tCompute\t20\tthreads=99999999999,elements=2,topology=Launcher\t1.0\n";
+		file << k_device << "\tCompute\t20\tthreads=256,elements=,topology=Launcher\t1.0\n";
+		file << k_device << "\tCompute\t20\tthreads=256,elements=2,topology=Unknown\t1.0\n";
+		file << k_device << "\tCompute\t20\tthreads=256,elements=2,topology=Launcher\t1.0ms\n";
+		file << "not a table line\n";
+	}
+	auto loaded = KernelTuner();
+	isRoundTripped &= loaded.Load(path);
+	for (const auto& tuneCase : k_cases)
+	{
+		for (uint32_t bucket = 10; bucket <= 28; ++bucket)
+		{
+			isRoundTripped &= (loaded.Select(k_device, tuneCase.m_pipelineMode, 1u << bucket) == tuner.Select(k_device, tuneCase.m_pipelineMode, 1u << bucket));
+		}
+	}
+	std::error_code error;
+	std::filesystem::remove(path, error);
+
+	auto isParsed = true;
+	for (const auto& variant : KernelTuner::EnumerateVariants(true, 1u << 10))
+	{
+		isParsed &= (KernelVariant::FromString(variant.ToString()) == variant);
+	}
+	for (const auto* text : { "threads=abc", "threads=-1", "threads=4294967296", "threads=256,elements=3", "threads=2048", "threads=256,topology=Unknown", "threads" })
+	{
+		isParsed &= !KernelVariant::FromString(text).has_value();
+	}
+	printf("table round trip%s\n", CheckBenchmark(isRoundTripped));
+	printf("variant strings%s\n", CheckBenchmark(isParsed));
+}
+
+template<SortingNetworkKind Kind, uint32_t N>
+void BenchmarkSortingNetwork(const char* kindName, const std::vector<uint32_t>& source, std::vector<uint32_t>& values)
+{
+	auto prepare = [&] { values = source; };
+	SetBenchmarkCase("sorting network " + std::string(kindName) + " " + std::to_string(N), values.size());
+	const auto time = MeasureMilliseconds(k_numIterations, prepare, [&] { SortBlocksWithNetwork<Kind, N>(values.data(), values.size()); });
+	auto isSorted = true;
+	for (size_t i = 0; i + N <= values.size() && isSorted; i += N)
+	{
+		isSorted = std::is_sorted(values.begin() + i, values.begin() + i + N);
+	}
+	printf("  %-13s %8.3fms %6.2fns/block (%zu comparators)%s\n", kindName, time, time * 1e6 / (values.size() / N), SortingNetwork<Kind, N>::k_comparators.size(), CheckBenchmark(isSorted));
+}
+
+// Sorts values.size() / N independent arrays, one per SIMD lane. Data is laid out as [element][array].
+template<uint32_t N>
+void BenchmarkSortingNetworkColumns(SimdLevel level, const std::vector<uint32_t>& source, std::vector<uint32_t>& values)
+{
+	const auto sort = GetSortNetworkColumns(level, N);
+	const auto numLanes = GetSimdLanes(level);
+	const auto name = std::string(GetSimdLevelName(level)) + " x" + std::to_string(numLanes);
+	if (sort == nullptr)
+	{
+		printf("  %-13s not supported\n", name.c_str());
+		return;
+	}
+	auto prepare = [&] { values = source; };
+	SetBenchmarkCase("sorting network " + name + " " + std::to_string(N), values.size());
+	const auto time = MeasureMilliseconds(k_numIterations, prepare, [&] { sort(values.data(), values.size()); });
+	// Every lane of a block is sorted down its column.
+	auto isSorted = true;
+	for (size_t i = 0; i + N * numLanes <= values.size() && isSorted; i += N * numLanes)
+	{
+		for (uint32_t element = 1; element < N; ++element)
+		{
+			for (uint32_t lane = 0; lane < numLanes; ++lane)
+			{
+				isSorted &= values[i + (element - 1) * numLanes + lane] <= values[i + element * numLanes + lane];
+			}
+		}
+	}
+	printf("  %-13s %8.3fms %6.2fns/block%s\n", name.c_str(), time, time * 1e6 / (values.size() / N), CheckBenchmark(isSorted));
+}
+
+template<uint32_t N>
+void BenchmarkSortingNetworkSize(const std::vector<uint32_t>& source)
+{
+	auto values = std::vector<uint32_t>(source.size());
+	printf("N = %u, %zu blocks\n", N, source.size() / N);
+	{
+		auto prepare = [&] { values = source; };
+		auto run = [&]
+		{
+			for (size_t i = 0; i + N <= values.size(); i += N)
+			{
+				std::sort(values.begin() + i, values.begin() + i + N);
+			}
+		};
+		SetBenchmarkCase("std::sort blocks of " + std::to_string(N), values.size());
+		const auto time = MeasureMilliseconds(k_numIterations, prepare, run);
+		printf("  %-13s %8.3fms %6.2fns/block\n", "std::sort", time, time * 1e6 / (values.size() / N));
+	}
+	BenchmarkSortingNetwork<SortingNetworkKind::Bitonic, N>("Bitonic", source, values);
+	BenchmarkSortingNetwork<SortingNetworkKind::OddEvenMerge, N>("OddEvenMerge", source, values);
+	BenchmarkSortingNetwork<SortingNetworkKind::GreenOddEvenMerge, N>("GreenOddEven", source, values);
+	for (const auto level : { SimdLevel::Sse41, SimdLevel::Avx2, SimdLevel::Avx512 })
+	{
+		BenchmarkSortingNetworkColumns<N>(level, source, values);
+	}
+}
+
+void BenchmarkSortingNetworks()
+{
+	printf("SIMD level of this CPU: %s\n", GetSimdLevelName(GetSupportedSimdLevel()));
+	auto source = std::vector<uint32_t>(1 << 22);
+	auto randomEngine = std::mt19937();
+	for (auto& value : source)
+	{
+		value = randomEngine();
+	}
+	BenchmarkSortingNetworkSize<4>(source);
+	BenchmarkSortingNetworkSize<8>(source);
+	BenchmarkSortingNetworkSize<16>(source);
+	BenchmarkSortingNetworkSize<32>(source);
+	BenchmarkSortingNetworkSize<64>(source);
+}
+
+// Keys in [base, base + range): the bitonic passes of the compute engine on 32-bit keys against the same passes on packed
+// words (BitonicSortPacked), which need the min/max pre-pass, pack and unpack on top.
+void BenchmarkNarrowKeys()
+{
+	constexpr size_t k_numKeys = 1 << 18;
+	constexpr uint32_t k_base = 1000000;
+	auto randomEngine = std::mt19937();
+	auto keys = std::vector<uint32_t>(k_numKeys);
+	auto values = std::vector<uint32_t>(k_numKeys);
+	auto words = std::vector<uint32_t>(k_numKeys);
+	for (uint32_t rangeBits : { 4u, 8u, 12u, 16u, 24u })
+	{
+		auto random = std::uniform_int_distribution<uint32_t>(k_base, k_base + (1u << rangeBits) - 1);
+		std::generate(keys.begin(), keys.end(), [&] { return random(randomEngine); });
+		auto expected = keys;
+		std::sort(expected.begin(), expected.end());
+
+		const auto distribution = "range 2^" + std::to_string(rangeBits);
+		SetBenchmarkCase("narrow keys bitonic 32-bit", k_numKeys, distribution);
+		const auto sortTime = MeasureMilliseconds(k_numIterations, [&] { values = keys; }, [&] { SortNarrowKeys(values.data(), values.size(), NarrowKeyPacking()); });
+		const auto isSorted = (values == expected);
+
+		auto packing = NarrowKeyPacking();
+		SetBenchmarkCase("narrow keys pre-pass", k_numKeys, distribution);
+		const auto prepassTime = MeasureMilliseconds(k_numIterations, [] {}, [&] { packing = ComputeNarrowKeyPacking(keys.data(), keys.size()); });
+		const auto numWords = keys.size() / packing.GetKeysPerWord();
+		SetBenchmarkCase("narrow keys pack", k_numKeys, distribution);
+		const auto packTime = MeasureMilliseconds(k_numIterations, [] {}, [&] { PackNarrowKeys(keys.data(), keys.size(), packing, words.data()); });
+		auto packed = std::vector<uint32_t>(words.begin(), words.begin() + numWords);
+		SetBenchmarkCase("narrow keys bitonic packed", k_numKeys, distribution);
+		const auto packedSortTime = MeasureMilliseconds(k_numIterations, [&] { std::copy(packed.begin(), packed.end(), words.begin()); }, [&] { SortNarrowKeys(words.data(), keys.size(), packing); });
+		SetBenchmarkCase("narrow keys unpack", k_numKeys, distribution);
+		const auto unpackTime = MeasureMilliseconds(k_numIterations, [] {}, [&] { UnpackNarrowKeys(words.data(), keys.size(), packing, values.data()); });
+
+		printf
+		(
+			"range = 2^%u, %u bits, %zu bytes, %zu units per pass (32-bit: %zu bytes, %zu units)%s\n",
+			rangeBits,
+			packing.m_bits,
+			numWords * sizeof(uint32_t),
+			keys.size() / 2 / packing.GetKeysPerWord(),
+			keys.size() * sizeof(uint32_t),
+			keys.size() / 2,
+			CheckBenchmark(isSorted && values == expected)
+		);
+		printf("  %-15s %8.3fms\n", "bitonic 32-bit", sortTime);
+		printf("  %-15s %8.3fms\n", "pre-pass", prepassTime);
+		printf("  %-15s %8.3fms\n", "pack", packTime);
+		printf("  %-15s %8.3fms\n", "bitonic packed", packedSortTime);
+		printf("  %-15s %8.3fms\n", "unpack", unpackTime);
+		printf("  %-15s %8.3fms\n", "total packed", prepassTime + packTime + packedSortTime + unpackTime);
+	}
+}
+
+// Pre-pass and the chosen strategy against a full sort for every input distribution.
+void BenchmarkSortedness()
+{
+	constexpr size_t k_numKeys = 1 << 22;
+	auto source = std::vector<uint32_t>(k_numKeys);
+	auto keys = std::vector<uint32_t>(k_numKeys);
+	for (uint32_t i = 0; i < static_cast<uint32_t>(KeyDistribution::Count); ++i)
+	{
+		const auto distribution = static_cast<KeyDistribution>(i);
+		auto randomEngine = std::mt19937();
+		GenerateSortKeys(randomEngine, UINT32_MAX, source.data(), source.size());
+		ApplyKeyDistribution(distribution, randomEngine, source.data(), source.size());
+
+		auto analysis = SortednessAnalysis();
+		SetBenchmarkCase("sortedness pre-pass", k_numKeys, GetKeyDistributionName(distribution));
+		const auto prepassTime = MeasureMilliseconds(k_numIterations, [] {}, [&] { analysis = AnalyzeSortedness(source.data(), source.size()); });
+		SetBenchmarkCase("sortedness strategy", k_numKeys, GetKeyDistributionName(distribution));
+		const auto strategyTime = MeasureMilliseconds(k_numIterations, [&] { keys = source; }, [&] { SortWithStrategy(analysis.m_strategy, keys.data(), keys.size()); });
+		const auto isSorted = std::is_sorted(keys.begin(), keys.end());
+		SetBenchmarkCase("reference sort", k_numKeys, GetKeyDistributionName(distribution));
+		const auto sortTime = MeasureMilliseconds(k_numIterations, [&] { keys = source; }, [&] { ReferenceSort(keys.data(), keys.size()); });
+
+		printf("%.*s: %zu runs, %s%s\n", static_cast<int>(GetKeyDistributionName(distribution).size()), GetKeyDistributionName(distribution).data(), analysis.GetNumRuns(), GetSortStrategyName(analysis.m_strategy).data(), CheckBenchmark(isSorted, " NOT SORTED"));
+		printf("  %-13s %8.3fms\n", "pre-pass", prepassTime);
+		printf("  %-13s %8.3fms\n", "strategy", strategyTime);
+		printf("  %-13s %8.3fms\n", "full sort", sortTime);
+	}
+}
+
+// Incremental sort of a delta of updates against a full sort of the updated keys, across delta ratios.
+void BenchmarkIncrementalSort()
+{
+	constexpr size_t k_numKeys = 1 << 22;
+	auto randomEngine = std::mt19937();
+	auto sorted = std::vector<uint32_t>(k_numKeys);
+	GenerateSortKeys(randomEngine, UINT32_MAX, sorted.data(), sorted.size());
+	ReferenceSort(sorted.data(), sorted.size());
+	auto keys = std::vector<uint32_t>();
+	auto output = std::vector<uint32_t>();
+	for (double ratio : { 0.001, 0.01, 0.05, 0.1, 0.25 })
+	{
+		const auto numUpdates = static_cast<size_t>(k_numKeys * ratio);
+		const auto stride = k_numKeys / numUpdates;
+		auto delta = SortDelta<uint32_t>();
+		auto updated = sorted;
+		for (size_t i = 0; i < numUpdates; ++i)
+		{
+			const auto index = i * stride + randomEngine() % stride;
+			const auto newKey = static_cast<uint32_t>(randomEngine());
+			delta.AddUpdate(sorted[index], newKey);
+			updated[index] = newKey;
+		}
+		auto unsortedDelta = delta;
+
+		const auto distribution = "delta " + std::to_string(numUpdates);
+		SetBenchmarkCase("incremental sort", k_numKeys, distribution);
+		const auto incrementalTime = MeasureMilliseconds(k_numIterations, [&] { delta = unsortedDelta; }, [&]
+		{
+			delta.Sort();
+			ApplySortDelta(sorted.data(), sorted.size(), delta, output);
+		});
+		SetBenchmarkCase("incremental full sort", k_numKeys, distribution);
+		const auto sortTime = MeasureMilliseconds(k_numIterations, [&] { keys = updated; }, [&] { ReferenceSort(keys.data(), keys.size()); });
+
+		printf("delta = %.1f%% (%zu updates)%s\n", ratio * 100.0, numUpdates, CheckBenchmark(output == keys));
+		printf("  %-13s %8.3fms\n", "incremental", incrementalTime);
+		printf("  %-13s %8.3fms\n", "full sort", sortTime);
+	}
+}
+
+// Allocations of random sizes and alignments from the ring allocator with a fake fence that completes frames late. Every
+// allocation has to be aligned and inside the range, and must not overlap one whose frame has not retired yet.
+void BenchmarkRingAllocator()
+{
+	constexpr uint64_t k_ringSize = 1 << 16;
+	constexpr uint32_t k_maxFramesInFlight = 3;
+	constexpr uint32_t k_numFrames = 1 << 14;
+	constexpr uint32_t k_maxAllocationsPerFrame = 8;
+	constexpr uint32_t k_maxAllocationSize = 4096;
+	auto memory = std::vector<std::byte>(k_ringSize);
+	auto allocator = LinearRingAllocator();
+	allocator.Initialize(memory.data(), memory.size(), k_maxFramesInFlight);
+
+	struct LiveAllocation
+	{
+		uint64_t m_fenceValue = 0;
+		uint64_t m_begin = 0;
+		uint64_t m_end = 0;
+	};
+	auto live = std::vector<LiveAllocation>();
+	auto randomEngine = std::mt19937();
+	uint64_t fenceValue = 0;
+	uint64_t completedFenceValue = 0;
+	uint64_t previousEnd = 0;
+	uint32_t numAllocations = 0;
+	uint32_t numFull = 0;
+	uint32_t numWraps = 0;
+	bool isAligned = true;
+	bool isInRange = true;
+	bool isDisjoint = true;
+	bool isFinished = true;
+	for (uint32_t frame = 0; frame < k_numFrames; ++frame)
+	{
+		const auto numAllocationsInFrame = randomEngine() % k_maxAllocationsPerFrame + 1;
+		for (uint32_t i = 0; i < numAllocationsInFrame; ++i)
+		{
+			const uint64_t size = randomEngine() % k_maxAllocationSize + 1;
+			const uint64_t alignment = uint64_t(1) << (randomEngine() % 9);
+			const auto allocation = allocator.Allocate(size, alignment);
+			if (!allocation.IsValid())
+			{
+				++numFull;
+				continue;
+			}
+			++numAllocations;
+			const auto end = allocation.m_offset + allocation.m_size;
+			isAligned &= allocation.m_offset % alignment == 0;
+			isInRange &= allocation.m_size == size && end <= k_ringSize && allocation.m_cpuAddress == memory.data() + allocation.m_offset;
+			for (const auto& other : live)
+			{
+				isDisjoint &= end <= other.m_begin || other.m_end <= allocation.m_offset;
+			}
+			numWraps += allocation.m_offset < previousEnd;
+			previousEnd = end;
+			live.push_back({ fenceValue + 1, allocation.m_offset, end });
+		}
+		isFinished &= allocator.FinishFrame(++fenceValue);
+
+		// The fence lags a random number of frames, the oldest frame is forced to complete when the limit is reached.
+		const uint64_t lag = randomEngine() % k_maxFramesInFlight;
+		completedFenceValue = std::max(completedFenceValue, fenceValue - std::min(lag, fenceValue));
+		allocator.Retire(completedFenceValue);
+		std::erase_if(live, [&](const LiveAllocation& allocation) { return allocation.m_fenceValue <= completedFenceValue; });
+	}
+
+	// One frame too many is rejected, and retiring everything empties the ring.
+	while (allocator.GetNumFramesInFlight() < k_maxFramesInFlight)
+	{
+		isFinished &= allocator.FinishFrame(++fenceValue);
+	}
+	const auto isLimited = !allocator.FinishFrame(fenceValue + 1);
+	allocator.Retire(fenceValue);
+	const auto isEmpty = allocator.GetUsedSize() == 0 && allocator.GetNumFramesInFlight() == 0;
+
+	const auto isPassed = isAligned && isInRange && isDisjoint && isFinished && isLimited && isEmpty && numWraps > 0;
+	printf("%u allocations over %u frames, %u wrap-arounds, %u full%s\n", numAllocations, k_numFrames, numWraps, numFull, CheckBenchmark(isPassed));
+
+	// Allocation cost with a fence that keeps up, without the checks.
+	auto sizes = std::vector<uint64_t>(1 << 20);
+	for (auto& size : sizes)
+	{
+		size = randomEngine() % k_maxAllocationSize + 1;
+	}
+	SetBenchmarkCase("ring allocator", sizes.size());
+	const auto time = MeasureMilliseconds(k_numIterations, [&] { allocator.Initialize(memory.data(), memory.size(), k_maxFramesInFlight); }, [&]
+	{
+		uint64_t value = 0;
+		for (size_t i = 0; i < sizes.size(); ++i)
+		{
+			allocator.Allocate(sizes[i], 256);
+			if (i % k_maxAllocationsPerFrame == k_maxAllocationsPerFrame - 1)
+			{
+				allocator.FinishFrame(++value);
+				allocator.Retire(value - std::min<uint64_t>(value, k_maxFramesInFlight - 1));
+			}
+		}
+	});
+	printf("  %-13s %8.1fns per allocation\n", "allocate", time * 1e6 / sizes.size());
+}
+
+// CPU fallback engine against the reference sort for a few key types and sizes.
+template<typename Key>
+void BenchmarkCpuSortKeyType()
+{
+	for (size_t numKeys : { size_t(1) << 12, size_t(1) << 16, size_t(1) << 20, size_t(1) << 23 })
+	{
+		auto randomEngine = std::mt19937();
+		auto source = std::vector<Key>(numKeys);
+		GenerateSortKeys(randomEngine, UINT32_MAX, source.data(), source.size());
+		auto keys = std::vector<Key>(numKeys);
+		auto scratch = std::vector<Key>(numKeys);
+
+		const auto keyName = std::string(SortKeyTraits<Key>::k_name);
+		SetBenchmarkCase("radix sort " + keyName, numKeys);
+		const auto radixTime = MeasureMilliseconds(k_numIterations, [&] { keys = source; }, [&] { ParallelRadixSort(keys.data(), keys.size(), scratch.data()); });
+		auto radixOutput = keys;
+		SetBenchmarkCase("reference sort " + keyName, numKeys);
+		const auto sortTime = MeasureMilliseconds(k_numIterations, [&] { keys = source; }, [&] { ReferenceSort(keys.data(), keys.size()); });
+
+		printf("%.*s, %zu keys%s\n", static_cast<int>(SortKeyTraits<Key>::k_name.size()), SortKeyTraits<Key>::k_name.data(), numKeys, CheckBenchmark(std::memcmp(radixOutput.data(), keys.data(), sizeof(Key) * numKeys) == 0));
+		printf("  %-13s %8.3fms %6.2fns/key\n", "std::sort", sortTime, sortTime * 1e6 / numKeys);
+		printf("  %-13s %8.3fms %6.2fns/key (%u threads)\n", "radix", radixTime, radixTime * 1e6 / numKeys, GetNumWorkerThreads());
+	}
+}
+
+void BenchmarkCpuSort()
+{
+	BenchmarkCpuSortKeyType<uint32_t>();
+	BenchmarkCpuSortKeyType<float>();
+	BenchmarkCpuSortKeyType<uint64_t>();
+}
+
+// Data generation, sort and validation passes over a std::vector and over host buffers with huge pages and NUMA placement.
+// The placements only differ on multi-socket hosts, and huge pages only where the system provides them.
+void BenchmarkHostMemory()
+{
+	constexpr size_t k_numKeys = size_t(1) << 24;
+	constexpr size_t k_minGrain = 1 << 16;
+	const auto& topology = NumaTopology::Get();
+	printf("%u NUMA nodes, %u worker threads, %zu keys\n", topology.GetNumNodes(), GetNumWorkerThreads(), k_numKeys);
+
+	struct Configuration
+	{
+		const char* m_name;
+		bool m_isHostBuffer;
+		HostMemoryOptions m_options;
+		bool m_isPinned;
+	};
+	constexpr Configuration k_configurations[] =
+	{
+		{ "std::vector", false, {}, false },
+		{ "Default", true, { false, HostPagePlacement::Default }, false },
+		{ "HugePages", true, { true, HostPagePlacement::Default }, false },
+		{ "FirstTouch", true, { true, HostPagePlacement::FirstTouch }, true },
+		{ "Interleave", true, { true, HostPagePlacement::Interleave }, true },
+	};
+	for (const auto& configuration : k_configurations)
+	{
+		SetWorkerPinning(configuration.m_isPinned);
+		auto vectorKeys = std::vector<uint32_t>();
+		auto vectorScratch = std::vector<uint32_t>();
+		auto bufferKeys = HostBuffer();
+		auto bufferScratch = HostBuffer();
+		const auto allocationBegin = std::chrono::high_resolution_clock::now();
+		if (configuration.m_isHostBuffer)
+		{
+			bufferKeys.Allocate(sizeof(uint32_t) * k_numKeys, configuration.m_options);
+			bufferScratch.Allocate(sizeof(uint32_t) * k_numKeys, configuration.m_options);
+		}
+		else
+		{
+			vectorKeys.resize(k_numKeys);
+			vectorScratch.resize(k_numKeys);
+		}
+		const auto allocationEnd = std::chrono::high_resolution_clock::now();
+		auto* keys = configuration.m_isHostBuffer ? reinterpret_cast<uint32_t*>(bufferKeys.GetData()) : vectorKeys.data();
+		auto* scratch = configuration.m_isHostBuffer ? reinterpret_cast<uint32_t*>(bufferScratch.GetData()) : vectorScratch.data();
+		if (keys == nullptr || scratch == nullptr)
+		{
+			printf("  %-12s allocation failed\n", configuration.m_name);
+			continue;
+		}
+
+		// Every range generates its own keys, so the keys do not depend on the number of workers.
+		auto generate = [&]
+		{
+			ParallelForRanges(k_numKeys, k_minGrain, [&](uint32_t, size_t begin, size_t end)
+			{
+				for (auto i = begin; i < end; ++i)
+				{
+					auto x = static_cast<uint64_t>(i) * 0x9E3779B97F4A7C15ull;
+					keys[i] = static_cast<uint32_t>((x ^ (x >> 29)) >> 32);
+				}
+			});
+		};
+		auto isSorted = std::atomic<bool>(true);
+		auto validate = [&]
+		{
+			ParallelForRanges(k_numKeys, k_minGrain, [&](uint32_t, size_t begin, size_t end)
+			{
+				// Each range also checks the key before it.
+				if (!std::is_sorted(keys + (begin > 0 ? begin - 1 : 0), keys + end))
+				{
+					isSorted = false;
+				}
+			});
+		};
+		const auto name = std::string(configuration.m_name);
+		SetBenchmarkCase("generate " + name, k_numKeys);
+		const auto generateTime = MeasureMilliseconds(k_numIterations, [] {}, generate);
+		SetBenchmarkCase("radix sort " + name, k_numKeys);
+		const auto sortTime = MeasureMilliseconds(k_numIterations, generate, [&] { ParallelRadixSort(keys, k_numKeys, scratch); });
+		SetBenchmarkCase("validate " + name, k_numKeys);
+		const auto validateTime = MeasureMilliseconds(k_numIterations, [] {}, validate);
+		printf
+		(
+			"  %-12s allocate %8.3fms, generate %8.3fms, sort %8.3fms, validate %8.3fms%s%s\n",
+			configuration.m_name,
+			std::chrono::duration<double, std::milli>(allocationEnd - allocationBegin).count(),
+			generateTime,
+			sortTime,
+			validateTime,
+			(configuration.m_isHostBuffer && configuration.m_options.m_useHugePages && !bufferKeys.HasHugePages()) ? " (no huge pages)" : "",
+			CheckBenchmark(isSorted)
+		);
+	}
+	SetWorkerPinning(false);
+}
+
+// Router calibrated from a few probes of synthetic engines: fixed submission cost plus per-key cost.
+void BenchmarkRouter()
+{
+	struct SyntheticEngine
+	{
+		std::string_view m_name;
+		double m_fixedTime;
+		double m_nanosecondsPerKeyLog;
+	};
+	// The GPU engines pay the submission, fence wait and readback, bitonic sort grows with n * log2(n)^2.
+	constexpr SyntheticEngine k_engines[] =
+	{
+		{ "CPU", 0.002, 1.5 },
+		{ "Compute", 0.150, 0.004 },
+		{ "Work Graph", 0.200, 0.003 },
+	};
+	auto getTime = [](const SyntheticEngine& engine, uint32_t numKeys, bool isCpu)
+	{
+		const auto log = std::log2(static_cast<double>(numKeys));
+		return engine.m_fixedTime + engine.m_nanosecondsPerKeyLog * 1e-6 * numKeys * (isCpu ? 1.0 : log * log);
+	};
+
+	auto router = SortRouter();
+	auto engineNames = std::vector<std::string_view>();
+	for (const auto& engine : k_engines)
+	{
+		engineNames.push_back(engine.m_name);
+		for (uint32_t numKeys : { 1u << 8, 1u << 12, 1u << 16, 1u << 20, 1u << 24 })
+		{
+			router.SetCost("synthetic", engine.m_name, numKeys, getTime(engine, numKeys, &engine == &k_engines[0]));
+		}
+	}
+
+	auto randomEngine = std::mt19937();
+	auto random = std::uniform_int_distribution<uint32_t>(1u << 6, 1u << 26);
+	auto numMisroutes = 0u;
+	constexpr uint32_t k_numRequests = 1 << 16;
+	auto requests = std::vector<uint32_t>(k_numRequests);
+	std::generate(requests.begin(), requests.end(), [&] { return random(randomEngine); });
+	auto routes = std::vector<size_t>(k_numRequests);
+	SetBenchmarkCase("router route", k_numRequests);
+	const auto routeTime = MeasureMilliseconds(k_numIterations, [] {}, [&]
+	{
+		for (uint32_t i = 0; i < k_numRequests; ++i)
+		{
+			routes[i] = router.Route("synthetic", engineNames, requests[i]).value_or(0);
+		}
+	});
+	for (uint32_t i = 0; i < k_numRequests; ++i)
+	{
+		const auto& engine = k_engines[routes[i]];
+		const auto predicted = router.Predict("synthetic", engine.m_name, requests[i]);
+		router.Record(engine.m_name, predicted, getTime(engine, requests[i], routes[i] == 0));
+
+		// The best engine by the synthetic truth.
+		auto best = size_t(0);
+		for (size_t j = 1; j < std::size(k_engines); ++j)
+		{
+			best = (getTime(k_engines[j], requests[i], false) < getTime(k_engines[best], requests[i], best == 0)) ? j : best;
+		}
+		numMisroutes += (getTime(engine, requests[i], routes[i] == 0) > getTime(k_engines[best], requests[i], best == 0) * 1.05) ? 1 : 0;
+	}
+
+	printf("%u requests, %u routed more than 5%% slower than the best engine, %.1fns per decision\n", k_numRequests, numMisroutes, routeTime * 1e6 / k_numRequests);
+	router.PrintMetrics();
+	for (uint32_t numKeys = 1 << 8; numKeys <= (1 << 24); numKeys <<= 4)
+	{
+		const auto route = router.Route("synthetic", engineNames, numKeys).value_or(0);
+		printf("  %10u keys -> %s\n", numKeys, k_engines[route].m_name.data());
+	}
+}
+
+// Split sort with a thread group standing in for the GPU: the ratio converges from 0.5 to the throughput balance.
+void BenchmarkSplitSort()
+{
+	constexpr size_t k_numKeys = 1 << 22;
+	auto randomEngine = std::mt19937();
+	auto source = std::vector<uint32_t>(k_numKeys);
+	GenerateSortKeys(randomEngine, UINT32_MAX, source.data(), source.size());
+	auto expected = source;
+	ReferenceSort(expected.data(), expected.size());
+	auto keys = std::vector<uint32_t>(k_numKeys);
+	auto scratch = std::vector<uint32_t>(k_numKeys);
+	auto output = std::vector<uint32_t>(k_numKeys);
+
+	SetBenchmarkCase("split sort host only", k_numKeys);
+	const auto hostTime = MeasureMilliseconds(k_numIterations, [&] { keys = source; }, [&] { ParallelRadixSort(keys.data(), keys.size(), scratch.data()); });
+	printf("  %-13s %8.3fms\n", "host only", hostTime);
+
+	for (uint32_t numDeviceThreads : { 1u, 4u })
+	{
+		auto device = ThreadGroupSortDevice<uint32_t>(numDeviceThreads);
+		auto balancer = SplitBalancer();
+		printf("device with %u threads\n", numDeviceThreads);
+		for (uint32_t frame = 0; frame < 6; ++frame)
+		{
+			keys = source;
+			auto result = SplitSortResult();
+			SetBenchmarkCase("split sort frame " + std::to_string(frame), k_numKeys, "device " + std::to_string(numDeviceThreads) + " threads");
+			const auto time = MeasureMilliseconds(1, [] {}, [&] { result = CooperativeSort(device, balancer, keys.data(), keys.size(), scratch.data(), output.data()); });
+			printf
+			(
+				"  frame %u: %5.1f%% device, device %8.3fms, host %8.3fms, merge %8.3fms, total %8.3fms%s\n",
+				frame,
+				100.0 * result.m_deviceCount / k_numKeys,
+				result.m_deviceTime,
+				result.m_hostTime,
+				result.m_mergeTime,
+				time,
+				CheckBenchmark(output == expected)
+			);
+		}
+	}
+}
+
+// Runs the record flow of the recursive topology in random orders and checks the output and the record counts.
+// The small merge grid limit makes the merge threads stride over ranges larger than the grid, like the clamped grid on the GPU.
+void BenchmarkWorkGraphModel()
+{
+	constexpr uint32_t k_mergeElementsPerThread = 8;
+	constexpr uint32_t k_numOrders = 4;
+	auto randomEngine = std::mt19937();
+	for (const auto& [numThreads, maxDispatchGrid] : { std::pair(64u, KernelVariant::k_maxDispatchGrid), std::pair(1024u, KernelVariant::k_maxDispatchGrid), std::pair(64u, 3u) })
+	{
+		for (uint32_t numKeys : { 1u << 6, 1u << 12, 1u << 16, 1u << 20 })
+		{
+			auto source = std::vector<uint32_t>(numKeys);
+			GenerateSortKeys(randomEngine, UINT32_MAX, source.data(), source.size());
+			auto expected = source;
+			ReferenceSort(expected.data(), expected.size());
+			auto keys = std::vector<uint32_t>(numKeys);
+			auto scratch = std::vector<uint32_t>(numKeys);
+
+			auto model = WorkGraphSortModel<uint32_t>(numThreads, k_mergeElementsPerThread, maxDispatchGrid);
+			const auto numLeaves = (std::max)(1u, numKeys / model.GetLeafSize());
+			auto expectedMergeGroups = 0u;
+			for (uint32_t count = model.GetLeafSize() * 2; count <= numKeys; count *= 2)
+			{
+				expectedMergeGroups += (numKeys / count) * model.GetMergeDispatchGrid(count);
+			}
+
+			auto statistics = WorkGraphSortStatistics();
+			auto isValid = true;
+			SetBenchmarkCase("work graph model threads " + std::to_string(numThreads) + " grid " + std::to_string(maxDispatchGrid), numKeys);
+			const auto time = MeasureMilliseconds(k_numOrders, [&] { keys = source; }, [&]
+			{
+				statistics = model.Run(keys.data(), numKeys, scratch.data(), static_cast<uint32_t>(randomEngine()));
+				isValid &= (keys == expected)
+					&& statistics.m_numLeafRecords == numLeaves
+					&& statistics.m_numMergeRecords == numLeaves - 1
+					&& statistics.m_numMergeGroups == expectedMergeGroups
+					&& statistics.m_numEarlyMerges == 0;
+			});
+			printf
+			(
+				"  threads %4u, grid %5u, %8u keys: %5u splits, %5u leaves, %5u merges, %6u merge groups %8.3fms%s\n",
+				numThreads,
+				maxDispatchGrid,
+				numKeys,
+				statistics.m_numSplitRecords,
+				statistics.m_numLeafRecords,
+				statistics.m_numMergeRecords,
+				statistics.m_numMergeGroups,
+				time,
+				CheckBenchmark(isValid)
+			);
+		}
+	}
+}
+
+// Per-node counters the instrumentation build is expected to report. The counters of the recursive topology are
+// taken from runs of WorkGraphSortModel where it counts them, so the report shows where the two disagree.
+void BenchmarkWorkGraphStats()
+{
+	constexpr uint32_t k_mergeElementsPerThread = 8;
+	constexpr uint32_t k_leafKeysPerThread = 2;
+	auto randomEngine = std::mt19937();
+	for (auto topology : { KernelTopology::Launcher, KernelTopology::LauncherMultiDispatchGrid, KernelTopology::Recursive })
+	{
+		for (uint32_t numKeys : { 1u << 6, 1u << 16, 1u << 20 })
+		{
+			const auto variant = KernelVariant{ 256, 2, topology };
+			const auto expected = PredictWorkGraphStats(variant, numKeys, 1, k_mergeElementsPerThread, k_leafKeysPerThread);
+			auto stats = expected;
+			if (topology == KernelTopology::Recursive)
+			{
+				auto keys = std::vector<uint32_t>(numKeys);
+				auto scratch = std::vector<uint32_t>(numKeys);
+				GenerateSortKeys(randomEngine, UINT32_MAX, keys.data(), keys.size());
+				auto model = WorkGraphSortModel<uint32_t>(variant.m_threadsPerGroup, k_mergeElementsPerThread);
+				const auto statistics = model.Run(keys.data(), numKeys, scratch.data(), static_cast<uint32_t>(randomEngine()));
+				stats[static_cast<size_t>(WorkGraphNode::Split)].m_recordsIn = statistics.m_numSplitRecords;
+				stats[static_cast<size_t>(WorkGraphNode::LeafSort)].m_recordsIn = statistics.m_numLeafRecords;
+				stats[static_cast<size_t>(WorkGraphNode::Merge)].m_recordsIn = statistics.m_numMergeRecords;
+				stats[static_cast<size_t>(WorkGraphNode::Merge)].m_groups = statistics.m_numMergeGroups;
+			}
+			printf("  %s, %u keys:\n", variant.ToString().c_str(), numKeys);
+			// The recursive counts come from the model, so a difference to the prediction fails the check.
+			CheckBenchmark(PrintWorkGraphStats(stats, expected));
+		}
+	}
+}
+
+// Throughput of the parallel primitives against their serial standard library versions.
+void BenchmarkPrimitives()
+{
+	constexpr size_t k_numValues = 1 << 24;
+	constexpr uint32_t k_shift = 8;
+	constexpr uint32_t k_mask = 0x3;
+	auto randomEngine = std::mt19937();
+	auto values = std::vector<uint32_t>(k_numValues);
+	GenerateSortKeys(randomEngine, UINT32_MAX, values.data(), values.size());
+	auto output = std::vector<uint32_t>(k_numValues);
+	auto expected = std::vector<uint32_t>(k_numValues);
+	const auto numBytes = static_cast<double>(k_numValues * sizeof(uint32_t));
+	auto print = [&](const char* name, double serialTime, double parallelTime, bool isValid)
+	{
+		printf("  %-10s serial %8.3fms %6.2fGB/s, parallel %8.3fms %6.2fGB/s%s\n", name, serialTime, numBytes / serialTime * 1e-6, parallelTime, numBytes / parallelTime * 1e-6, CheckBenchmark(isValid));
+	};
+	auto none = [] {};
+
+	{
+		auto expectedSum = 0u;
+		auto sum = 0u;
+		SetBenchmarkCase("reduce serial", k_numValues);
+		const auto serialTime = MeasureMilliseconds(k_numIterations, none, [&] { expectedSum = std::accumulate(values.begin(), values.end(), 0u); });
+		SetBenchmarkCase("reduce parallel", k_numValues);
+		const auto parallelTime = MeasureMilliseconds(k_numIterations, none, [&] { sum = ParallelReduce(values.data(), values.size()); });
+		print("reduce", serialTime, parallelTime, sum == expectedSum);
+	}
+	{
+		SetBenchmarkCase("scan serial", k_numValues);
+		const auto serialTime = MeasureMilliseconds(k_numIterations, none, [&] { std::exclusive_scan(values.begin(), values.end(), expected.begin(), 0u); });
+		SetBenchmarkCase("scan parallel", k_numValues);
+		const auto parallelTime = MeasureMilliseconds(k_numIterations, none, [&] { ParallelExclusiveScan(values.data(), values.size(), output.data()); });
+		print("scan", serialTime, parallelTime, output == expected);
+	}
+	{
+		auto expectedHistogram = std::array<uint32_t, k_histogramBuckets>();
+		auto histogram = std::array<uint32_t, k_histogramBuckets>();
+		auto serial = [&]
+		{
+			expectedHistogram.fill(0);
+			for (const auto value : values)
+			{
+				++expectedHistogram[(value >> k_shift) & (k_histogramBuckets - 1)];
+			}
+		};
+		SetBenchmarkCase("histogram serial", k_numValues);
+		const auto serialTime = MeasureMilliseconds(k_numIterations, none, serial);
+		SetBenchmarkCase("histogram parallel", k_numValues);
+		const auto parallelTime = MeasureMilliseconds(k_numIterations, none, [&] { histogram = ParallelHistogram(values.data(), values.size(), k_shift); });
+		print("histogram", serialTime, parallelTime, histogram == expectedHistogram);
+	}
+	{
+		auto expectedCount = size_t(0);
+		auto count = size_t(0);
+		auto matches = [](uint32_t value) { return (value & k_mask) == 0; };
+		SetBenchmarkCase("compact serial", k_numValues);
+		const auto serialTime = MeasureMilliseconds(k_numIterations, none, [&] { expectedCount = std::copy_if(values.begin(), values.end(), expected.begin(), matches) - expected.begin(); });
+		SetBenchmarkCase("compact parallel", k_numValues);
+		const auto parallelTime = MeasureMilliseconds(k_numIterations, none, [&] { count = ParallelCompact(values.data(), values.size(), k_mask, 0, output.data()); });
+		print("compact", serialTime, parallelTime, count == expectedCount && std::equal(output.begin(), output.begin() + count, expected.begin()));
+	}
+}
+
+// Sort-based group-by of (group, value) pairs packed in 64-bit keys against a std::map, and how much less the device
+// reads back with the group table than with the sorted keys.
+void BenchmarkGroupBy()
+{
+	constexpr size_t k_numKeys = 1 << 22;
+	auto randomEngine = std::mt19937();
+	auto none = [] {};
+	for (uint32_t cardinality : { 16u, 1u << 10, 1u << 16 })
+	{
+		auto source = std::vector<uint64_t>(k_numKeys);
+		for (auto& key : source)
+		{
+			key = (static_cast<uint64_t>(randomEngine() % cardinality) << 32) | (randomEngine() & 0xffff);
+		}
+		auto keys = std::vector<uint64_t>(k_numKeys);
+		auto scratch = std::vector<uint64_t>(k_numKeys);
+
+		const auto distribution = std::to_string(cardinality) + " groups";
+		auto expected = std::vector<GroupByRow>();
+		SetBenchmarkCase("group-by std::map", k_numKeys, distribution);
+		const auto mapTime = MeasureMilliseconds(k_numIterations, none, [&]
+		{
+			auto groups = std::map<uint32_t, GroupByRow>();
+			for (const auto key : source)
+			{
+				auto& row = groups.try_emplace(GetGroupByGroup(key), GroupByRow{ GetGroupByGroup(key), 0, 0 }).first->second;
+				++row.m_count;
+				row.m_sum += GetGroupByValue(key);
+			}
+			expected.clear();
+			for (const auto& group : groups)
+			{
+				expected.push_back(group.second);
+			}
+		});
+
+		auto rows = std::vector<GroupByRow>();
+		auto sortTime = 0.0;
+		SetBenchmarkCase("group-by sorted", k_numKeys, distribution);
+		const auto time = MeasureMilliseconds(k_numIterations, [&] { keys = source; }, [&]
+		{
+			const auto begin = std::chrono::high_resolution_clock::now();
+			ParallelRadixSort(keys.data(), keys.size(), scratch.data());
+			sortTime = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - begin).count();
+			rows = ParallelGroupBySorted(keys.data(), keys.size());
+		});
+		printf
+		(
+			"  %6u groups: map %8.3fms, sort + group-by %8.3fms (group-by %7.3fms), readback %8zu bytes, %7.1fx less%s\n",
+			cardinality,
+			mapTime,
+			time,
+			time - sortTime,
+			rows.size() * sizeof(GroupByRow),
+			static_cast<double>(k_numKeys * sizeof(uint64_t)) / (rows.size() * sizeof(GroupByRow)),
+			CheckBenchmark(rows == expected)
+		);
+	}
+}
+
+// Latency and throughput of the sort service over its batch window, with client threads that each submit jobs back to back
+// and a backend that pays a fixed latency per submission like a submit-and-wait cycle on a device.
+void BenchmarkSortService()
+{
+	constexpr uint32_t k_numClients = 8;
+	constexpr uint32_t k_numJobsPerClient = 64;
+	constexpr size_t k_numKeysPerJob = 1 << 12;
+	constexpr auto k_submissionLatency = std::chrono::microseconds(200);
+	auto randomEngine = std::mt19937();
+	auto source = std::vector<uint32_t>(k_numKeysPerJob * k_numClients * k_numJobsPerClient);
+	GenerateSortKeys(randomEngine, UINT32_MAX, source.data(), source.size());
+
+	// A negative window submits every job on its own, one at a time like on a single queue.
+	for (auto batchWindow : { -1, 0, 50, 200, 1000 })
+	{
+		auto keys = source;
+		auto latencies = std::vector<double>(k_numClients * k_numJobsPerClient);
+		auto backend = CpuSortBackend<uint32_t>(k_submissionLatency);
+		auto options = SortServiceOptions();
+		options.m_batchWindow = std::chrono::microseconds((std::max)(batchWindow, 0));
+
+		auto runClients = [&](auto&& sort)
+		{
+			auto clients = std::vector<std::thread>();
+			for (uint32_t client = 0; client < k_numClients; ++client)
+			{
+				clients.emplace_back([&, client]
+				{
+					for (uint32_t job = 0; job < k_numJobsPerClient; ++job)
+					{
+						const auto index = client * k_numJobsPerClient + job;
+						const auto submitTime = std::chrono::high_resolution_clock::now();
+						sort(keys.data() + index * k_numKeysPerJob);
+						latencies[index] = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - submitTime).count();
+					}
+				});
+			}
+			for (auto& client : clients)
+			{
+				client.join();
+			}
+		};
+
+		const auto begin = std::chrono::high_resolution_clock::now();
+		auto numBatches = 0u;
+		if (batchWindow < 0)
+		{
+			auto mutex = std::mutex();
+			runClients([&](uint32_t* jobKeys)
+			{
+				const auto lock = std::lock_guard(mutex);
+				backend.SortBatch({ { jobKeys, k_numKeysPerJob } });
+			});
+			numBatches = static_cast<uint32_t>(latencies.size());
+		}
+		else
+		{
+			auto service = SortService<uint32_t, CpuSortBackend<uint32_t>>(backend, options);
+			runClients([&](uint32_t* jobKeys) { service.Submit(jobKeys, k_numKeysPerJob).wait(); });
+			numBatches = service.GetNumBatches();
+		}
+		const auto time = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - begin).count();
+
+		auto isValid = true;
+		for (size_t job = 0; job < latencies.size(); ++job)
+		{
+			isValid &= std::is_sorted(keys.begin() + job * k_numKeysPerJob, keys.begin() + (job + 1) * k_numKeysPerJob);
+		}
+		std::sort(latencies.begin(), latencies.end());
+		printf
+		(
+			"  %-15s %5u batches, %5.1f jobs/batch, %8.0f jobs/s, latency mean %7.3fms p99 %7.3fms%s\n",
+			(batchWindow < 0) ? "unbatched:" : ("window " + std::to_string(batchWindow) + "us:").c_str(),
+			numBatches,
+			static_cast<double>(latencies.size()) / numBatches,
+			latencies.size() / time * 1e3,
+			std::accumulate(latencies.begin(), latencies.end(), 0.0) / latencies.size(),
+			latencies[latencies.size() * 99 / 100],
+			CheckBenchmark(isValid)
+		);
+	}
+}
+
+// The naive recursion, as the leaves of ForkJoinFibonacci.
+uint64_t SerialFibonacci(uint32_t n)
+{
+	return (n < 2) ? n : SerialFibonacci(n - 1) + SerialFibonacci(n - 2);
+}
+
+// Fork/join over a binary tree of task groups, the small subtrees run serially.
+uint64_t ForkJoinFibonacci(JobSystem& jobSystem, uint32_t n)
+{
+	constexpr uint32_t k_serialFibonacci = 20;
+	if (n < k_serialFibonacci)
+	{
+		return SerialFibonacci(n);
+	}
+	auto first = uint64_t(0);
+	auto group = TaskGroup(jobSystem);
+	group.Run([&] { first = ForkJoinFibonacci(jobSystem, n - 1); });
+	const auto second = ForkJoinFibonacci(jobSystem, n - 2);
+	group.Wait();
+	return first + second;
+}
+
+// Scaling of ParallelFor and fork/join over the number of threads, then stress tests with more workers than jobs:
+// nested task groups of random sizes and submission from several threads outside the job system at once.
+void BenchmarkJobSystem()
+{
+	constexpr size_t k_numValues = 1 << 24;
+	constexpr size_t k_minGrain = 1 << 12;
+	constexpr uint32_t k_fibonacci = 32;
+	constexpr uint64_t k_expectedFibonacci = 2178309;
+	auto randomEngine = std::mt19937();
+	auto values = std::vector<uint32_t>(k_numValues);
+	GenerateSortKeys(randomEngine, UINT32_MAX, values.data(), values.size());
+	const auto expectedSum = std::accumulate(values.begin(), values.end(), uint64_t(0));
+	auto none = [] {};
+
+	const auto maxThreads = (std::max)(1u, std::thread::hardware_concurrency());
+	auto baseTimes = std::pair(0.0, 0.0);
+	for (auto numThreads = 1u; ; numThreads = (std::min)(numThreads * 2, maxThreads))
+	{
+		auto jobSystem = JobSystem(numThreads - 1);
+		auto sum = uint64_t(0);
+		SetBenchmarkCase("parallel for " + std::to_string(numThreads) + " threads", k_numValues);
+		const auto forTime = MeasureMilliseconds(k_numIterations, none, [&]
+		{
+			auto sums = std::atomic<uint64_t>(0);
+			ParallelFor(0, k_numValues, k_minGrain, [&](size_t begin, size_t end)
+			{
+				sums.fetch_add(std::accumulate(values.begin() + begin, values.begin() + end, uint64_t(0)), std::memory_order_relaxed);
+			}, jobSystem);
+			sum = sums.load();
+		});
+		auto fibonacci = uint64_t(0);
+		SetBenchmarkCase("fork/join fibonacci " + std::to_string(numThreads) + " threads", k_fibonacci);
+		const auto forkJoinTime = MeasureMilliseconds(k_numIterations, none, [&] { fibonacci = ForkJoinFibonacci(jobSystem, k_fibonacci); });
+		if (numThreads == 1)
+		{
+			baseTimes = { forTime, forkJoinTime };
+		}
+		printf
+		(
+			"  %3u threads: parallel-for %8.3fms %5.2fx, fork/join %8.3fms %5.2fx%s\n",
+			numThreads,
+			forTime,
+			baseTimes.first / forTime,
+			forkJoinTime,
+			baseTimes.second / forkJoinTime,
+			CheckBenchmark(sum == expectedSum && fibonacci == k_expectedFibonacci)
+		);
+		if (numThreads == maxThreads)
+		{
+			break;
+		}
+	}
+
+	// Workers steal from each other even on a single core.
+	constexpr uint32_t k_numRounds = 256;
+	constexpr uint32_t k_maxTasks = 64;
+	auto jobSystem = JobSystem((std::max)(maxThreads, 4u) - 1);
+	{
+		auto numTasks = std::atomic<uint64_t>(0);
+		auto expectedTasks = uint64_t(0);
+		const auto begin = std::chrono::high_resolution_clock::now();
+		for (uint32_t round = 0; round < k_numRounds; ++round)
+		{
+			auto innerSizes = std::vector<uint32_t>(randomEngine() % k_maxTasks + 1);
+			for (auto& size : innerSizes)
+			{
+				size = randomEngine() % k_maxTasks;
+				expectedTasks += size + 1;
+			}
+			auto outer = TaskGroup(jobSystem);
+			for (const auto size : innerSizes)
+			{
+				outer.Run([&jobSystem, &numTasks, size]
+				{
+					auto inner = TaskGroup(jobSystem);
+					for (uint32_t i = 0; i < size; ++i)
+					{
+						inner.Run([&numTasks] { numTasks.fetch_add(1, std::memory_order_relaxed); });
+					}
+					numTasks.fetch_add(1, std::memory_order_relaxed);
+				});
+			}
+		}
+		const auto time = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - begin).count();
+		printf("  nested groups:       %8llu tasks %8.3fms%s\n", static_cast<unsigned long long>(numTasks.load()), time, CheckBenchmark(numTasks.load() == expectedTasks));
+	}
+	{
+		// Every index of every ParallelFor is visited once, whichever thread submitted it.
+		constexpr uint32_t k_numSubmitters = 4;
+		constexpr uint32_t k_numLoops = 256;
+		constexpr size_t k_loopSize = 1 << 12;
+		auto visits = std::vector<std::atomic<uint32_t>>(k_numSubmitters * k_loopSize);
+		const auto begin = std::chrono::high_resolution_clock::now();
+		auto submitters = std::vector<std::thread>();
+		for (uint32_t submitter = 0; submitter < k_numSubmitters; ++submitter)
+		{
+			submitters.emplace_back([&, submitter]
+			{
+				for (uint32_t loop = 0; loop < k_numLoops; ++loop)
+				{
+					ParallelFor(0, k_loopSize, 1, [&](size_t first, size_t last)
+					{
+						for (auto i = first; i < last; ++i)
+						{
+							visits[submitter * k_loopSize + i].fetch_add(1, std::memory_order_relaxed);
+						}
+					}, jobSystem);
+				}
+			});
+		}
+		for (auto& submitter : submitters)
+		{
+			submitter.join();
+		}
+		const auto time = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - begin).count();
+		const auto isValid = std::all_of(visits.begin(), visits.end(), [](const std::atomic<uint32_t>& count) { return count.load() == k_numLoops; });
+		printf("  external submitters: %u threads x %u loops %8.3fms%s\n", k_numSubmitters, k_numLoops, time, CheckBenchmark(isValid));
+	}
+}
+
+struct Benchmark
+{
+	std::string_view m_name;
+	void (*m_function)();
+};
+
+constexpr Benchmark k_benchmarks[] =
+{
+	{ "kernel-tuner", BenchmarkKernelTuner },
+	{ "sorting-network", BenchmarkSortingNetworks },
+	{ "narrow-keys", BenchmarkNarrowKeys },
+	{ "sortedness", BenchmarkSortedness },
+	{ "incremental", BenchmarkIncrementalSort },
+	{ "ring-allocator", BenchmarkRingAllocator },
+	{ "cpu-sort", BenchmarkCpuSort },
+	{ "host-memory", BenchmarkHostMemory },
+	{ "router", BenchmarkRouter },
+	{ "split-sort", BenchmarkSplitSort },
+	{ "work-graph-model", BenchmarkWorkGraphModel },
+	{ "work-graph-stats", BenchmarkWorkGraphStats },
+	{ "primitives", BenchmarkPrimitives },
+	{ "group-by", BenchmarkGroupBy },
+	{ "sort-service", BenchmarkSortService },
+	{ "job-system", BenchmarkJobSystem },
+};
+}
+
+std::optional<uint32_t> RunBenchmark(std::string_view name, std::vector<BenchmarkResult>* results)
+{
+	bool found = false;
+	s_numFailedChecks = 0;
+	for (const auto& benchmark : k_benchmarks)
+	{
+		if (name == "all" || name == benchmark.m_name)
+		{
+			printf("Benchmark: %.*s\n", static_cast<int>(benchmark.m_name.size()), benchmark.m_name.data());
+			s_recorder = { results, {} };
+			benchmark.m_function();
+			found = true;
+		}
+	}
+	s_recorder = {};
+	if (!found)
+	{
+		return std::nullopt;
+	}
+	if (s_numFailedChecks > 0)
+	{
+		printf("Benchmark: %u checks failed\n", s_numFailedChecks);
+	}
+	return s_numFailedChecks;
+}
+
+void SetBenchmarkCase(std::string_view algorithm, uint64_t size, std::string_view distribution)
+{
+	if (!s_recorder.m_results)
+	{
+		return;
+	}
+	auto result = BenchmarkResult();
+	result.m_algorithm = algorithm;
+	result.m_size = size;
+	result.m_distribution = distribution;
+	s_recorder.m_nextCase = std::move(result);
+}
+
+void RecordBenchmarkSamples(const std::vector<double>& samples)
+{
+	if (!s_recorder.m_results)
+	{
+		return;
+	}
+	// Every measurement names its case, a position in the benchmark would compare different cases once one is added.
+	if (!s_recorder.m_nextCase)
+	{
+		printf("Benchmark: samples without SetBenchmarkCase%s\n", CheckBenchmark(false, " NOT RECORDED"));
+		return;
+	}
+	auto result = std::move(*s_recorder.m_nextCase);
+	s_recorder.m_nextCase.reset();
+	result.m_device = "CPU (" + std::to_string(GetNumWorkerThreads()) + " threads)";
+	result.m_mode = "CPU";
+	result.m_samples = samples;
+	s_recorder.m_results->push_back(std::move(result));
+}
+
+std::optional<int> RunBenchmarkCommandLine(int argc, const char** argv)
+{
+	auto benchmarkName = std::optional<std::string_view>();
+	auto compareCommits = std::optional<std::string_view>();
+	auto resultsPath = std::string_view();
+	auto commit = std::string_view("local");
+	auto alpha = 0.01;
+	auto minSlowdown = 0.05;
+	for (int i = 1; i < argc; ++i)
+	{
+		const auto arg = std::string_view(argv[i]);
+		const auto separator = arg.find('=');
+		const auto key = arg.substr(0, separator);
+		const auto value = (separator != std::string_view::npos) ? arg.substr(separator + 1) : std::string_view();
+		if (key == "--benchmark")
+		{
+			benchmarkName = value;
+		}
+		else if (key == "--compare")
+		{
+			compareCommits = value;
+		}
+		else if (key == "--results")
+		{
+			resultsPath = value;
+		}
+		else if (key == "--commit")
+		{
+			commit = value;
+		}
+		else if (key == "--alpha")
+		{
+			alpha = atof(std::string(value).c_str());
+		}
+		else if (key == "--min-slowdown")
+		{
+			minSlowdown = atof(std::string(value).c_str());
+		}
+	}
+
+	if (benchmarkName)
+	{
+		auto results = std::vector<BenchmarkResult>();
+		const auto numFailedChecks = RunBenchmark(*benchmarkName, resultsPath.empty() ? nullptr : &results);
+		// Times of wrong results are not appended, so that they never become a baseline.
+		if (numFailedChecks.value_or(1) > 0)
+		{
+			return 1;
+		}
+		for (auto& result : results)
+		{
+			result.m_commit = commit;
+			if (!ResultsStore::Append(resultsPath, result))
+			{
+				printf("Results: cannot append to %.*s\n", static_cast<int>(resultsPath.size()), resultsPath.data());
+				return 1;
+			}
+		}
+		return 0;
+	}
+
+	if (compareCommits)
+	{
+		const auto comma = compareCommits->find(',');
+		auto store = ResultsStore();
+		if (comma == std::string_view::npos || !store.Load(resultsPath))
+		{
+			printf("Compare: needs --compare=<baseline commit>,<candidate commit> and --results=<file>\n");
+			return 1;
+		}
+		const auto baselineCommit = compareCommits->substr(0, comma);
+		const auto candidateCommit = compareCommits->substr(comma + 1);
+		const auto comparisons = store.Compare(baselineCommit, candidateCommit, alpha, minSlowdown);
+		const auto casesWithoutBaseline = store.FindCasesWithoutBaseline(baselineCommit, candidateCommit);
+		ResultsStore::PrintComparisons(comparisons);
+		ResultsStore::PrintCasesWithoutBaseline(casesWithoutBaseline);
+		const auto numRegressions = std::count_if(comparisons.begin(), comparisons.end(), [](const ResultsStore::Comparison& comparison) { return comparison.m_isRegression; });
+		printf("Compare: %zu cases, %zu regressions, %zu without baseline\n", comparisons.size(), static_cast<size_t>(numRegressions), casesWithoutBaseline.size());
+		// Nothing compared usually means a mistyped commit, which must not pass as "no regressions".
+		if (comparisons.empty())
+		{
+			printf("Compare: no case has results at both commits\n");
+			return 1;
+		}
+		return (numRegressions > 0 || !casesWithoutBaseline.empty()) ? 1 : 0;
+	}
+	return std::nullopt;
+}
+}
\ No newline at end of file
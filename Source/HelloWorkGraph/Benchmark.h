@@ -0,0 +1,44 @@
+﻿#pragma once
+
+#include "ResultsStore.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <optional>
+#include <string_view>
+#include <vector>
+
+namespace LearningWorkGraph
+{
+// Runs the CPU benchmark with the given name ("all" runs every benchmark). Returns the number of failed correctness checks,
+// nothing if the name is unknown. With results, the samples of every timed call are appended to it, without commit.
+std::optional<uint32_t> RunBenchmark(std::string_view name, std::vector<BenchmarkResult>* results = nullptr);
+
+// Names the next timed call of the running benchmark in the results. Calls without a name are numbered in their order in the benchmark.
+void SetBenchmarkCase(std::string_view algorithm, uint64_t size, std::string_view distribution = "random");
+void RecordBenchmarkSamples(const std::vector<double>& samples);
+
+// --benchmark=<name> appends the results to the file of --results, tagged with --commit, and returns 1 if a check failed.
+// --compare=<baseline commit>,<candidate commit> compares them there with --alpha and --min-slowdown and returns 1 on a regression.
+// Returns nothing without either, so that the application runs.
+std::optional<int> RunBenchmarkCommandLine(int argc, const char** argv);
+
+// Median time in milliseconds of run(), with prepare() executed untimed before every iteration.
+template<typename Prepare, typename Run>
+double MeasureMilliseconds(uint32_t numIterations, Prepare&& prepare, Run&& run)
+{
+	auto times = std::vector<double>(numIterations);
+	for (auto& time : times)
+	{
+		prepare();
+		const auto begin = std::chrono::high_resolution_clock::now();
+		run();
+		const auto end = std::chrono::high_resolution_clock::now();
+		time = std::chrono::duration<double, std::milli>(end - begin).count();
+	}
+	RecordBenchmarkSamples(times);
+	std::nth_element(times.begin(), times.begin() + times.size() / 2, times.end());
+	return times[times.size() / 2];
+}
+}
\ No newline at end of file
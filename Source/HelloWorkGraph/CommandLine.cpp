@@ -0,0 +1,15 @@
+﻿#include "CommandLine.h"
+#include "Benchmark.h"
+#include "FrameCapture.h"
+
+namespace LearningWorkGraph
+{
+std::optional<int> RunCpuCommandLine(int argc, const char** argv)
+{
+	if (const auto exitCode = RunBenchmarkCommandLine(argc, argv))
+	{
+		return exitCode;
+	}
+	return RunReplayCommandLine(argc, argv);
+}
+}
\ No newline at end of file
@@ -0,0 +1,10 @@
+﻿#pragma once
+
+#include <optional>
+
+namespace LearningWorkGraph
+{
+// The commands that run without creating a device: the CPU benchmarks, the comparison of their results and CPU replays
+// of frame captures. Returns their exit code, or nothing so that the application runs.
+std::optional<int> RunCpuCommandLine(int argc, const char** argv);
+}
\ No newline at end of file
@@ -0,0 +1,166 @@
+﻿#pragma once
+
+#include "CpuSort.h"
+#include "MergePath.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <thread>
+#include <vector>
+
+namespace LearningWorkGraph
+{
+// Splits a sort between a device and the host by their measured throughputs.
+class SplitBalancer
+{
+public:
+	// smoothing is the weight of the previous throughput when a new measurement comes in.
+	explicit SplitBalancer(double initialRatio = 0.5, double smoothing = 0.5) : m_ratio(initialRatio), m_smoothing(smoothing) {}
+
+	// Share of the keys the device sorts.
+	double GetRatio() const { return m_ratio; }
+	size_t GetDeviceCount(size_t count) const { return static_cast<size_t>(count * m_ratio + 0.5); }
+
+	// The candidate whose slower side is predicted to finish first, for devices that only take some sizes.
+	size_t SelectDeviceCount(size_t count, const std::vector<size_t>& candidates) const
+	{
+		auto best = candidates.front();
+		auto bestTime = -1.0;
+		for (const auto candidate : candidates)
+		{
+			// Without measurements yet, the candidate closest to the ratio.
+			const auto time = (m_deviceRate > 0.0 && m_hostRate > 0.0)
+				? (std::max)(candidate / m_deviceRate, (count - candidate) / m_hostRate)
+				: std::abs(static_cast<double>(candidate) - count * m_ratio);
+			if (bestTime < 0.0 || time < bestTime)
+			{
+				best = candidate;
+				bestTime = time;
+			}
+		}
+		return best;
+	}
+
+	// Times in milliseconds, each side measured from the submission to its own completion.
+	void Update(size_t deviceCount, double deviceTime, size_t hostCount, double hostTime)
+	{
+		auto smooth = [this](double& rate, double measured) { rate = (rate > 0.0) ? rate * m_smoothing + measured * (1.0 - m_smoothing) : measured; };
+		if (deviceCount > 0 && deviceTime > 0.0)
+		{
+			smooth(m_deviceRate, deviceCount / deviceTime);
+		}
+		if (hostCount > 0 && hostTime > 0.0)
+		{
+			smooth(m_hostRate, hostCount / hostTime);
+		}
+		if (m_deviceRate > 0.0 && m_hostRate > 0.0)
+		{
+			m_ratio = m_deviceRate / (m_deviceRate + m_hostRate);
+		}
+	}
+
+	// Keys per millisecond, 0 until measured.
+	double GetDeviceRate() const { return m_deviceRate; }
+	double GetHostRate() const { return m_hostRate; }
+
+private:
+	double m_ratio = 0.5;
+	double m_smoothing = 0.5;
+	double m_deviceRate = 0.0;
+	double m_hostRate = 0.0;
+};
+
+// Stand-in for the GPU on hosts without one: sorts asynchronously on its own group of threads,
+// chunks with ReferenceSort and then pairwise merges.
+template<typename Key>
+class ThreadGroupSortDevice
+{
+public:
+	explicit ThreadGroupSortDevice(uint32_t numThreads) : m_numThreads((std::max)(numThreads, 1u)) {}
+	~ThreadGroupSortDevice() { Wait(); }
+
+	void Submit(Key* keys, size_t count)
+	{
+		Wait();
+		m_submitTime = std::chrono::high_resolution_clock::now();
+		m_thread = std::thread([this, keys, count]
+		{
+			auto bounds = std::vector<size_t>(m_numThreads + 1);
+			for (uint32_t i = 0; i <= m_numThreads; ++i)
+			{
+				bounds[i] = count * i / m_numThreads;
+			}
+			auto threads = std::vector<std::thread>();
+			for (uint32_t i = 0; i < m_numThreads; ++i)
+			{
+				threads.emplace_back([&, i] { ReferenceSort(keys + bounds[i], bounds[i + 1] - bounds[i]); });
+			}
+			for (auto& thread : threads)
+			{
+				thread.join();
+			}
+			auto less = [](Key a, Key b) { return ToOrderedBits(a) < ToOrderedBits(b); };
+			for (uint32_t width = 1; width < m_numThreads; width *= 2)
+			{
+				for (uint32_t i = 0; i + width < m_numThreads; i += width * 2)
+				{
+					const auto end = bounds[(std::min)(i + width * 2, m_numThreads)];
+					std::inplace_merge(keys + bounds[i], keys + bounds[i + width], keys + end, less);
+				}
+			}
+			m_completeTime = std::chrono::high_resolution_clock::now();
+		});
+	}
+
+	// Returns the time in milliseconds from the submission to the completion on the device.
+	double Wait()
+	{
+		if (!m_thread.joinable())
+		{
+			return 0.0;
+		}
+		m_thread.join();
+		return std::chrono::duration<double, std::milli>(m_completeTime - m_submitTime).count();
+	}
+
+private:
+	uint32_t m_numThreads = 1;
+	std::thread m_thread;
+	std::chrono::high_resolution_clock::time_point m_submitTime = {};
+	std::chrono::high_resolution_clock::time_point m_completeTime = {};
+};
+
+struct SplitSortResult
+{
+	size_t m_deviceCount = 0;
+	double m_deviceTime = 0.0;
+	double m_hostTime = 0.0;
+	double m_mergeTime = 0.0;
+};
+
+// The device sorts the front of keys while the host sorts the rest with ParallelRadixSort, then both are merged into output.
+// keys and scratch are overwritten, the balancer learns from the measured times.
+template<typename Key, typename Device>
+SplitSortResult CooperativeSort(Device& device, SplitBalancer& balancer, Key* keys, size_t count, Key* scratch, Key* output)
+{
+	auto result = SplitSortResult();
+	result.m_deviceCount = balancer.GetDeviceCount(count);
+	const auto hostCount = count - result.m_deviceCount;
+
+	const auto begin = std::chrono::high_resolution_clock::now();
+	device.Submit(keys, result.m_deviceCount);
+	ParallelRadixSort(keys + result.m_deviceCount, hostCount, scratch);
+	const auto hostEnd = std::chrono::high_resolution_clock::now();
+	result.m_deviceTime = device.Wait();
+	result.m_hostTime = std::chrono::duration<double, std::milli>(hostEnd - begin).count();
+
+	const auto mergeBegin = std::chrono::high_resolution_clock::now();
+	ParallelMerge(keys, result.m_deviceCount, keys + result.m_deviceCount, hostCount, output, [](Key a, Key b) { return ToOrderedBits(a) < ToOrderedBits(b); });
+	const auto mergeEnd = std::chrono::high_resolution_clock::now();
+	result.m_mergeTime = std::chrono::duration<double, std::milli>(mergeEnd - mergeBegin).count();
+
+	balancer.Update(result.m_deviceCount, result.m_deviceTime, hostCount, result.m_hostTime);
+	return result;
+}
+}
\ No newline at end of file
@@ -0,0 +1,14 @@
+﻿#include "CommandLine.h"
+
+#include <cstdio>
+
+// Entry point of the build without a graphics API, which only runs the commands of RunCpuCommandLine.
+int main(int argc, const char** argv)
+{
+	if (const auto exitCode = LearningWorkGraph::RunCpuCommandLine(argc, argv))
+	{
+		return *exitCode;
+	}
+	printf("Usage: %s --benchmark=<name> | --compare=<baseline>,<candidate> | --replay=<capture> [--results=<file>] [--commit=<name>]\n", argc > 0 ? argv[0] : "HelloWorkGraphCpu");
+	return 1;
+}
\ No newline at end of file
@@ -0,0 +1,84 @@
+﻿#pragma once
+
+#include "Parallel.h"
+#include "SortKey.h"
+
+#include <array>
+#include <cstdint>
+#include <vector>
+
+namespace LearningWorkGraph
+{
+// Below this many keys the radix passes cost more than a comparison sort.
+constexpr size_t k_cpuSortComparisonThreshold = 1 << 12;
+
+// Parallel LSD radix sort on the order-preserving bits with 8-bit digits, same order as ReferenceSort.
+// Each worker histograms and scatters its own contiguous range, so the sort is stable.
+// Digits shared by every key are skipped. scratch must hold count keys.
+template<typename Key>
+void ParallelRadixSort(Key* keys, size_t count, Key* scratch)
+{
+	if (count <= k_cpuSortComparisonThreshold)
+	{
+		ReferenceSort(keys, count);
+		return;
+	}
+
+	constexpr size_t k_minGrain = 1 << 16;
+	constexpr uint32_t k_numBuckets = 256;
+	using Histogram = std::array<size_t, k_numBuckets>;
+	auto histograms = std::vector<Histogram>(GetNumWorkerThreads());
+
+	auto* source = keys;
+	auto* destination = scratch;
+	for (uint32_t shift = 0; shift < sizeof(Key) * 8; shift += 8)
+	{
+		auto getDigit = [shift](Key key) { return static_cast<uint32_t>(ToOrderedBits(key) >> shift) & (k_numBuckets - 1); };
+
+		const auto numRanges = ParallelForRanges(count, k_minGrain, [&](uint32_t rangeIndex, size_t begin, size_t end)
+		{
+			auto& histogram = histograms[rangeIndex];
+			histogram.fill(0);
+			for (size_t i = begin; i < end; ++i)
+			{
+				++histogram[getDigit(source[i])];
+			}
+		});
+
+		// Exclusive scan in bucket-major order gives every range its first output position per bucket.
+		auto offset = size_t(0);
+		auto isSkipped = false;
+		for (uint32_t bucket = 0; bucket < k_numBuckets; ++bucket)
+		{
+			auto bucketSize = size_t(0);
+			for (uint32_t range = 0; range < numRanges; ++range)
+			{
+				const auto rangeSize = histograms[range][bucket];
+				histograms[range][bucket] = offset + bucketSize;
+				bucketSize += rangeSize;
+			}
+			isSkipped |= (bucketSize == count);
+			offset += bucketSize;
+		}
+		if (isSkipped)
+		{
+			continue;
+		}
+
+		ParallelForRanges(count, k_minGrain, [&](uint32_t rangeIndex, size_t begin, size_t end)
+		{
+			auto& positions = histograms[rangeIndex];
+			for (size_t i = begin; i < end; ++i)
+			{
+				destination[positions[getDigit(source[i])]++] = source[i];
+			}
+		});
+		std::swap(source, destination);
+	}
+
+	if (source != keys)
+	{
+		ParallelForRanges(count, k_minGrain, [&](uint32_t, size_t begin, size_t end) { std::copy(source + begin, source + end, keys + begin); });
+	}
+}
+}
\ No newline at end of file
@@ -0,0 +1,714 @@
+﻿#include "FrameCapture.h"
+#include "CpuSort.h"
+#include "Parallel.h"
+#include "ResultsStore.h"
+#include "SortingNetwork.h"
+#include "WorkGraphSortModel.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <string>
+
+#if defined(_WIN32)
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace LearningWorkGraph
+{
+namespace
+{
+constexpr uint32_t k_magic = 0x4347574c; // "LWGC"
+constexpr uint32_t k_version = 1;
+// Sections start aligned, so the commands are read in place from the mapping.
+constexpr uint64_t k_sectionAlignment = 64;
+// Keys per job of the CPU passes.
+constexpr size_t k_passGrain = 1 << 14;
+// MERGE_ELEMENTS_PER_THREAD of the recursive work graph in Shader.shader.
+constexpr uint32_t k_mergeElementsPerThread = 8;
+
+enum class InputCodec : uint32_t
+{
+	Raw = 0,
+	BytePlanes,
+	DeltaBytePlanes,
+	Count
+};
+constexpr const char* k_codecNames[] = { "raw", "byte planes", "delta byte planes" };
+static_assert(std::size(k_codecNames) == static_cast<size_t>(InputCodec::Count));
+
+constexpr const char* k_modeNames[] = { "Compute", "Work Graph", "CPU" };
+static_assert(std::size(k_modeNames) == static_cast<size_t>(FrameCaptureMode::Count));
+
+constexpr const char* k_pipelineNames[] = { "CSMain", "SortingNetworkCSMain", "ReverseCSMain", "Work Graph" };
+static_assert(std::size(k_pipelineNames) == static_cast<size_t>(FrameCapturePipeline::Count));
+
+struct FrameCaptureSection
+{
+	uint64_t m_offset = 0;
+	uint64_t m_size = 0;
+};
+
+struct FrameCaptureHeader
+{
+	uint32_t m_magic = k_magic;
+	uint32_t m_version = k_version;
+	FrameCaptureInfo m_info = {};
+	InputCodec m_inputCodec = InputCodec::Raw;
+	uint32_t m_keySize = 0;
+	uint64_t m_inputSize = 0;
+	FrameCaptureSection m_input;
+	FrameCaptureSection m_constants;
+	FrameCaptureSection m_commands;
+};
+static_assert(std::is_trivially_copyable_v<FrameCaptureHeader>);
+
+uint64_t AlignOffset(uint64_t offset)
+{
+	return (offset + k_sectionAlignment - 1) / k_sectionAlignment * k_sectionAlignment;
+}
+
+// PackBits: a control byte c < 128 is followed by c + 1 literal bytes, otherwise the next byte repeats (c & 127) + 3 times.
+void EncodeRuns(const std::vector<uint8_t>& data, std::vector<std::byte>& output)
+{
+	constexpr size_t k_minRun = 3;
+	constexpr size_t k_maxRun = 127 + k_minRun;
+	constexpr size_t k_maxLiterals = 128;
+	auto getRun = [&](size_t i)
+	{
+		auto run = size_t(1);
+		while (i + run < data.size() && run < k_maxRun && data[i + run] == data[i])
+		{
+			++run;
+		}
+		return run;
+	};
+	for (size_t i = 0; i < data.size();)
+	{
+		const auto run = getRun(i);
+		if (run >= k_minRun)
+		{
+			output.push_back(std::byte(0x80 | (run - k_minRun)));
+			output.push_back(std::byte(data[i]));
+			i += run;
+			continue;
+		}
+		auto numLiterals = size_t(0);
+		while (i + numLiterals < data.size() && numLiterals < k_maxLiterals && getRun(i + numLiterals) < k_minRun)
+		{
+			++numLiterals;
+		}
+		output.push_back(std::byte(numLiterals - 1));
+		output.insert(output.end(), reinterpret_cast<const std::byte*>(data.data() + i), reinterpret_cast<const std::byte*>(data.data() + i + numLiterals));
+		i += numLiterals;
+	}
+}
+
+// Returns the end of the encoded data, or nullptr if it is corrupt.
+const std::byte* DecodeRuns(const std::byte* data, const std::byte* dataEnd, uint8_t* output, size_t size)
+{
+	for (size_t i = 0; i < size;)
+	{
+		if (data == dataEnd)
+		{
+			return nullptr;
+		}
+		const auto control = static_cast<uint8_t>(*data++);
+		const auto count = (control < 0x80) ? size_t(control) + 1 : size_t(control & 0x7f) + 3;
+		const auto numBytes = (control < 0x80) ? count : 1;
+		if (i + count > size || dataEnd - data < static_cast<ptrdiff_t>(numBytes))
+		{
+			return nullptr;
+		}
+		if (control < 0x80)
+		{
+			memcpy(output + i, data, count);
+		}
+		else
+		{
+			memset(output + i, static_cast<uint8_t>(*data), count);
+		}
+		data += numBytes;
+		i += count;
+	}
+	return data;
+}
+
+// Byte k of every key, for k = 0..keySize-1, each plane run-length encoded. With delta the keys are the differences of their raw bits.
+template<typename Bits>
+std::vector<std::byte> EncodeBytePlanes(const std::byte* input, size_t numKeys, bool isDelta)
+{
+	auto output = std::vector<std::byte>();
+	auto plane = std::vector<uint8_t>(numKeys);
+	for (size_t byte = 0; byte < sizeof(Bits); ++byte)
+	{
+		auto previous = Bits(0);
+		for (size_t i = 0; i < numKeys; ++i)
+		{
+			auto key = Bits(0);
+			memcpy(&key, input + i * sizeof(Bits), sizeof(Bits));
+			const auto value = isDelta ? static_cast<Bits>(key - previous) : key;
+			previous = key;
+			plane[i] = static_cast<uint8_t>(value >> (byte * 8));
+		}
+		EncodeRuns(plane, output);
+	}
+	return output;
+}
+
+template<typename Bits>
+bool DecodeBytePlanes(const std::byte* data, const std::byte* dataEnd, std::byte* output, size_t numKeys, bool isDelta)
+{
+	auto keys = std::vector<Bits>(numKeys);
+	auto plane = std::vector<uint8_t>(numKeys);
+	for (size_t byte = 0; byte < sizeof(Bits); ++byte)
+	{
+		data = DecodeRuns(data, dataEnd, plane.data(), numKeys);
+		if (data == nullptr)
+		{
+			return false;
+		}
+		for (size_t i = 0; i < numKeys; ++i)
+		{
+			keys[i] |= static_cast<Bits>(plane[i]) << (byte * 8);
+		}
+	}
+	if (isDelta)
+	{
+		for (size_t i = 1; i < numKeys; ++i)
+		{
+			keys[i] += keys[i - 1];
+		}
+	}
+	memcpy(output, keys.data(), numKeys * sizeof(Bits));
+	return true;
+}
+
+// One compare-exchange pass of BitonicSort in Shader.shader over the first numUnits units.
+template<typename Key>
+void ReplayBitonicPass(Key* keys, size_t numUnits, uint32_t inc, uint32_t dir)
+{
+	ParallelFor(0, numUnits, k_passGrain, [=](size_t begin, size_t end)
+	{
+		const size_t mask = inc - 1;
+		for (auto index = begin; index < end; ++index)
+		{
+			const auto i = index * 2 - (mask & index);
+			const auto a = ToOrderedBits(keys[i]);
+			const auto b = ToOrderedBits(keys[i + inc]);
+			const auto isAscending = ((dir & i) == 0);
+			if (isAscending ? !(a < b) : (a < b))
+			{
+				std::swap(keys[i], keys[i + inc]);
+			}
+		}
+	});
+}
+
+// All passes of LaunchWorkGraphNode and of the compute engine, in the same order.
+template<typename Key>
+void ReplayBitonicSort(Key* keys, uint32_t numSortElements)
+{
+	const auto log2n = static_cast<uint32_t>(std::bit_width(numSortElements)) - 1;
+	for (uint32_t i = 0; i < log2n; ++i)
+	{
+		for (uint32_t inc = 1u << i; inc > 0; inc /= 2)
+		{
+			ReplayBitonicPass(keys, numSortElements / 2, inc, 2u << i);
+		}
+	}
+}
+
+template<typename Key>
+void ReplayCommand(const FrameCaptureInfo& info, const FrameCaptureCommand& command, uint32_t numSortElements, uint32_t numValidElements, const std::vector<std::byte>& input, Key* keys, Key* scratch)
+{
+	const auto& variant = info.m_kernelVariant;
+	switch (command.m_type)
+	{
+	case FrameCaptureCommandType::CopyInput:
+		ParallelFor(0, input.size(), k_passGrain * sizeof(Key), [&](size_t begin, size_t end)
+		{
+			memcpy(reinterpret_cast<std::byte*>(keys) + begin, input.data() + begin, end - begin);
+		});
+		break;
+	case FrameCaptureCommandType::Dispatch:
+		if (command.m_pipeline == FrameCapturePipeline::BitonicSort)
+		{
+			// Threads past the sort units return, like IsOutOfSortRange.
+			const auto numThreads = static_cast<uint64_t>(command.m_groups) * variant.m_threadsPerGroup;
+			const auto numUnits = (std::min<uint64_t>)(numSortElements / 2, numThreads * variant.m_elementsPerThread);
+			ReplayBitonicPass(keys, numUnits, command.m_arguments[0], command.m_arguments[1]);
+		}
+		else if (command.m_pipeline == FrameCapturePipeline::SortingNetwork)
+		{
+			// The comparator table of SortingNetworkCSMain, which only exists for 32-bit unsigned keys.
+			if constexpr (std::is_same_v<Key, uint32_t>)
+			{
+				SortWithNetwork<SortingNetworkKind::GreenOddEvenMerge>(keys, info.m_numSortElements);
+			}
+		}
+		else if (command.m_pipeline == FrameCapturePipeline::Reverse)
+		{
+			const auto numThreads = (std::min<uint64_t>)(static_cast<uint64_t>(command.m_groups) * variant.m_threadsPerGroup, numValidElements / 2);
+			for (uint64_t i = 0; i < numThreads; ++i)
+			{
+				std::swap(keys[i], keys[numValidElements - 1 - i]);
+			}
+		}
+		break;
+	case FrameCaptureCommandType::DispatchGraph:
+		// The records of the recursive nodes run through the host model of the topology, with the same splits, leaves and merge paths.
+		if (variant.m_topology == KernelTopology::Recursive)
+		{
+			auto model = WorkGraphSortModel<Key>(variant.m_threadsPerGroup, k_mergeElementsPerThread);
+			model.Run(keys + command.m_arguments[0], command.m_arguments[1], scratch + command.m_arguments[0], 0);
+		}
+		else
+		{
+			ReplayBitonicSort(keys, numSortElements);
+		}
+		break;
+	case FrameCaptureCommandType::CpuSort:
+		if (static_cast<SortStrategy>(command.m_arguments[0]) == SortStrategy::FullSort)
+		{
+			ParallelRadixSort(keys, numValidElements, scratch);
+		}
+		else
+		{
+			SortWithStrategy(static_cast<SortStrategy>(command.m_arguments[0]), keys, numValidElements);
+		}
+		break;
+	default:
+		break;
+	}
+}
+
+// Commands are offsets and loop bounds of the replays, a capture only opens if all of them stay in the sort buffer.
+bool IsValidCommand(const FrameCaptureInfo& info, const FrameCaptureCommand& command)
+{
+	const auto numSortElements = info.m_numSortElements;
+	const auto& arguments = command.m_arguments;
+	if (command.m_pipeline >= FrameCapturePipeline::Count)
+	{
+		return false;
+	}
+	switch (command.m_type)
+	{
+	case FrameCaptureCommandType::CopyInput:
+	case FrameCaptureCommandType::UavBarrier:
+		return true;
+	case FrameCaptureCommandType::Dispatch:
+		switch (command.m_pipeline)
+		{
+		// BitonicSortThread compares key i with key i + inc, and dir is the size of the sequences being merged.
+		case FrameCapturePipeline::BitonicSort: return std::has_single_bit(arguments[0]) && arguments[0] <= numSortElements / 2 && std::has_single_bit(arguments[1]) && arguments[1] <= numSortElements;
+		case FrameCapturePipeline::SortingNetwork: return info.m_sortKeyType == SortKeyType::UInt32 && HasSortingNetwork(numSortElements);
+		case FrameCapturePipeline::Reverse: return true;
+		default: return false;
+		}
+	case FrameCaptureCommandType::DispatchGraph:
+		// The launchers take the dispatch grid, the recursive topology the begin and count of its root range.
+		return command.m_pipeline == FrameCapturePipeline::WorkGraph
+			&& (info.m_kernelVariant.m_topology != KernelTopology::Recursive || (std::has_single_bit(arguments[1]) && static_cast<uint64_t>(arguments[0]) + arguments[1] <= numSortElements));
+	case FrameCaptureCommandType::CpuSort:
+		return arguments[0] < static_cast<uint32_t>(SortStrategy::Count);
+	default:
+		return false;
+	}
+}
+}
+
+std::string_view GetFrameCapturePipelineName(FrameCapturePipeline pipeline)
+{
+	return k_pipelineNames[static_cast<uint32_t>(pipeline)];
+}
+
+uint64_t HashBytes(const void* data, size_t size, uint64_t hash)
+{
+	const auto* bytes = static_cast<const uint8_t*>(data);
+	for (size_t i = 0; i < size; ++i)
+	{
+		hash = (hash ^ bytes[i]) * 0x100000001b3ull;
+	}
+	return hash;
+}
+
+bool WriteFrameCapture(std::string_view filePath, const FrameCapture& capture)
+{
+	auto header = FrameCaptureHeader();
+	header.m_info = capture.m_info;
+	header.m_keySize = GetSortKeySize(capture.m_info.m_sortKeyType);
+	header.m_inputSize = capture.m_input.size();
+
+	// Random keys keep the high byte planes constant, sorted and nearly sorted keys the planes of their differences.
+	const auto numKeys = capture.m_input.size() / header.m_keySize;
+	auto input = std::vector<std::byte>(capture.m_input);
+	for (const auto codec : { InputCodec::BytePlanes, InputCodec::DeltaBytePlanes })
+	{
+		const auto isDelta = (codec == InputCodec::DeltaBytePlanes);
+		auto encoded = (header.m_keySize == sizeof(uint64_t))
+			? EncodeBytePlanes<uint64_t>(capture.m_input.data(), numKeys, isDelta)
+			: EncodeBytePlanes<uint32_t>(capture.m_input.data(), numKeys, isDelta);
+		if (encoded.size() < input.size())
+		{
+			input = std::move(encoded);
+			header.m_inputCodec = codec;
+		}
+	}
+
+	header.m_input = { AlignOffset(sizeof(header)), input.size() };
+	header.m_constants = { AlignOffset(header.m_input.m_offset + header.m_input.m_size), capture.m_constants.size() };
+	header.m_commands = { AlignOffset(header.m_constants.m_offset + header.m_constants.m_size), capture.m_commands.size() * sizeof(FrameCaptureCommand) };
+
+	auto file = std::ofstream(std::string(filePath), std::ios::binary);
+	if (!file)
+	{
+		return false;
+	}
+	auto write = [&](const FrameCaptureSection& section, const void* data)
+	{
+		const auto padding = std::vector<char>(section.m_offset - static_cast<uint64_t>(file.tellp()));
+		file.write(padding.data(), padding.size());
+		file.write(static_cast<const char*>(data), section.m_size);
+	};
+	file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+	write(header.m_input, input.data());
+	write(header.m_constants, capture.m_constants.data());
+	write(header.m_commands, capture.m_commands.data());
+	return file.good();
+}
+
+bool FrameCaptureFile::Open(std::string_view filePath)
+{
+	Close();
+	const auto path = std::string(filePath);
+#if defined(_WIN32)
+	// The view keeps the file mapped after the handles are closed.
+	auto file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+	if (file == INVALID_HANDLE_VALUE)
+	{
+		return false;
+	}
+	auto size = LARGE_INTEGER();
+	GetFileSizeEx(file, &size);
+	auto mapping = (size.QuadPart > 0) ? CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr) : nullptr;
+	auto* data = mapping ? MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0) : nullptr;
+	if (mapping)
+	{
+		CloseHandle(mapping);
+	}
+	CloseHandle(file);
+	if (data == nullptr)
+	{
+		return false;
+	}
+	m_data = static_cast<const std::byte*>(data);
+	m_size = static_cast<size_t>(size.QuadPart);
+#else
+	const auto file = open(path.c_str(), O_RDONLY);
+	if (file < 0)
+	{
+		return false;
+	}
+	struct stat status = {};
+	auto* data = (fstat(file, &status) == 0 && status.st_size > 0) ? mmap(nullptr, status.st_size, PROT_READ, MAP_PRIVATE, file, 0) : MAP_FAILED;
+	close(file);
+	if (data == MAP_FAILED)
+	{
+		return false;
+	}
+	m_data = static_cast<const std::byte*>(data);
+	m_size = static_cast<size_t>(status.st_size);
+#endif
+
+	const auto* header = reinterpret_cast<const FrameCaptureHeader*>(m_data);
+	const auto& info = header->m_info;
+	auto isInFile = [&](const FrameCaptureSection& section) { return section.m_offset <= m_size && section.m_size <= m_size - section.m_offset; };
+	const auto isValid = m_size >= sizeof(FrameCaptureHeader)
+		&& header->m_magic == k_magic
+		&& header->m_version == k_version
+		&& header->m_inputCodec < InputCodec::Count
+		&& info.m_mode < FrameCaptureMode::Count
+		&& info.m_sortKeyType < SortKeyType::Count
+		&& info.m_sortStrategy < SortStrategy::Count
+		&& (info.m_mode == FrameCaptureMode::Cpu || info.m_kernelVariant.IsValid())
+		&& std::has_single_bit(info.m_numSortElements)
+		&& info.m_numValidElements <= info.m_numSortElements
+		&& (header->m_keySize == sizeof(uint32_t) || header->m_keySize == sizeof(uint64_t))
+		&& header->m_keySize == GetSortKeySize(info.m_sortKeyType)
+		&& header->m_inputSize == static_cast<uint64_t>(info.m_numSortElements) * header->m_keySize
+		&& isInFile(header->m_input)
+		&& isInFile(header->m_constants)
+		&& isInFile(header->m_commands)
+		&& header->m_commands.m_offset % alignof(FrameCaptureCommand) == 0
+		&& header->m_commands.m_size % sizeof(FrameCaptureCommand) == 0;
+	if (!isValid)
+	{
+		Close();
+		return false;
+	}
+
+	// The sizes the shaders read from the constants bound the passes of the replay like the ones of the header.
+	if (const auto constants = GetConstants(); constants.size() >= 2 * sizeof(uint32_t))
+	{
+		auto numSortElements = uint32_t(0);
+		auto numValidElements = uint32_t(0);
+		memcpy(&numSortElements, constants.data(), sizeof(uint32_t));
+		memcpy(&numValidElements, constants.data() + sizeof(uint32_t), sizeof(uint32_t));
+		if (!std::has_single_bit(numSortElements) || numSortElements > info.m_numSortElements || numValidElements > numSortElements)
+		{
+			Close();
+			return false;
+		}
+	}
+	const auto commands = GetCommands();
+	if (!std::all_of(commands.begin(), commands.end(), [&](const FrameCaptureCommand& command) { return IsValidCommand(info, command); }))
+	{
+		Close();
+		return false;
+	}
+	return true;
+}
+
+void FrameCaptureFile::Close()
+{
+	if (m_data)
+	{
+#if defined(_WIN32)
+		UnmapViewOfFile(m_data);
+#else
+		munmap(const_cast<std::byte*>(m_data), m_size);
+#endif
+	}
+	m_data = nullptr;
+	m_size = 0;
+}
+
+const FrameCaptureInfo& FrameCaptureFile::GetInfo() const
+{
+	return reinterpret_cast<const FrameCaptureHeader*>(m_data)->m_info;
+}
+
+std::span<const std::byte> FrameCaptureFile::GetConstants() const
+{
+	const auto& section = reinterpret_cast<const FrameCaptureHeader*>(m_data)->m_constants;
+	return { m_data + section.m_offset, static_cast<size_t>(section.m_size) };
+}
+
+std::span<const FrameCaptureCommand> FrameCaptureFile::GetCommands() const
+{
+	const auto& section = reinterpret_cast<const FrameCaptureHeader*>(m_data)->m_commands;
+	return { reinterpret_cast<const FrameCaptureCommand*>(m_data + section.m_offset), static_cast<size_t>(section.m_size / sizeof(FrameCaptureCommand)) };
+}
+
+uint64_t FrameCaptureFile::GetInputSize() const
+{
+	return reinterpret_cast<const FrameCaptureHeader*>(m_data)->m_inputSize;
+}
+
+uint64_t FrameCaptureFile::GetCompressedInputSize() const
+{
+	return reinterpret_cast<const FrameCaptureHeader*>(m_data)->m_input.m_size;
+}
+
+bool FrameCaptureFile::DecodeInput(std::byte* output) const
+{
+	const auto* header = reinterpret_cast<const FrameCaptureHeader*>(m_data);
+	const auto* data = m_data + header->m_input.m_offset;
+	const auto* dataEnd = data + header->m_input.m_size;
+	const auto numKeys = static_cast<size_t>(header->m_inputSize / header->m_keySize);
+	const auto isDelta = (header->m_inputCodec == InputCodec::DeltaBytePlanes);
+	switch (header->m_inputCodec)
+	{
+	case InputCodec::Raw:
+		if (header->m_input.m_size != header->m_inputSize)
+		{
+			return false;
+		}
+		memcpy(output, data, header->m_inputSize);
+		return true;
+	default:
+		return (header->m_keySize == sizeof(uint64_t))
+			? DecodeBytePlanes<uint64_t>(data, dataEnd, output, numKeys, isDelta)
+			: DecodeBytePlanes<uint32_t>(data, dataEnd, output, numKeys, isDelta);
+	}
+}
+
+void FrameCaptureFile::Print() const
+{
+	const auto* header = reinterpret_cast<const FrameCaptureHeader*>(m_data);
+	const auto& info = header->m_info;
+	printf
+	(
+		"Frame Capture: %s, %s, %u keys (%u padded), strategy %s, frame %u on %.*s%s\n",
+		k_modeNames[static_cast<uint32_t>(info.m_mode) % static_cast<uint32_t>(FrameCaptureMode::Count)],
+		GetSortKeyName(info.m_sortKeyType).data(),
+		info.m_numValidElements,
+		info.m_numSortElements,
+		GetSortStrategyName(info.m_sortStrategy).data(),
+		info.m_frameIndex,
+		static_cast<int>(strnlen(info.m_device.data(), info.m_device.size())),
+		info.m_device.data(),
+		info.m_isValidationPassed ? "" : ", failed validation"
+	);
+	printf
+	(
+		"  input %llu bytes, %llu compressed (%s), constants %llu bytes, %zu commands\n",
+		static_cast<unsigned long long>(header->m_inputSize),
+		static_cast<unsigned long long>(header->m_input.m_size),
+		k_codecNames[static_cast<uint32_t>(header->m_inputCodec)],
+		static_cast<unsigned long long>(header->m_constants.m_size),
+		GetCommands().size()
+	);
+	if (info.m_mode != FrameCaptureMode::Cpu)
+	{
+		printf("  kernel variant %s\n", info.m_kernelVariant.ToString().c_str());
+	}
+	for (uint32_t pipeline = 0; pipeline < static_cast<uint32_t>(FrameCapturePipeline::Count); ++pipeline)
+	{
+		if (info.m_shaderHashes[pipeline] != 0)
+		{
+			printf("  %-20s %016llx\n", k_pipelineNames[pipeline], static_cast<unsigned long long>(info.m_shaderHashes[pipeline]));
+		}
+	}
+}
+
+std::vector<double> ReplayFrameCaptureOnCpu(const FrameCaptureFile& capture, uint32_t numIterations, bool& isOutputMatched)
+{
+	const auto& info = capture.GetInfo();
+	auto input = std::vector<std::byte>(capture.GetInputSize());
+	isOutputMatched = false;
+	if (!capture.DecodeInput(input.data()))
+	{
+		return {};
+	}
+
+	// The shaders read the sizes from the constants.
+	auto numSortElements = info.m_numSortElements;
+	auto numValidElements = info.m_numValidElements;
+	if (const auto constants = capture.GetConstants(); constants.size() >= 2 * sizeof(uint32_t))
+	{
+		memcpy(&numSortElements, constants.data(), sizeof(uint32_t));
+		memcpy(&numValidElements, constants.data() + sizeof(uint32_t), sizeof(uint32_t));
+	}
+	numSortElements = (std::min)(numSortElements, info.m_numSortElements);
+	numValidElements = (std::min)(numValidElements, numSortElements);
+
+	auto times = std::vector<double>();
+	VisitSortKeyType(info.m_sortKeyType, [&]<typename Key>(std::type_identity<Key>)
+	{
+		auto keys = std::vector<Key>(info.m_numSortElements);
+		auto scratch = std::vector<Key>(info.m_numSortElements);
+		for (uint32_t iteration = 0; iteration < numIterations; ++iteration)
+		{
+			const auto begin = std::chrono::high_resolution_clock::now();
+			for (const auto& command : capture.GetCommands())
+			{
+				ReplayCommand(info, command, numSortElements, numValidElements, input, keys.data(), scratch.data());
+			}
+			const auto end = std::chrono::high_resolution_clock::now();
+			times.push_back(std::chrono::duration<double, std::milli>(end - begin).count());
+		}
+		isOutputMatched = HashBytes(keys.data(), sizeof(Key) * info.m_numValidElements) == info.m_outputHash;
+	});
+	return times;
+}
+
+std::optional<int> RunReplayCommandLine(int argc, const char** argv)
+{
+	auto capturePath = std::optional<std::string_view>();
+	auto backend = std::string_view("cpu");
+	auto numIterations = k_defaultReplayIterations;
+	auto resultsPath = std::string_view();
+	auto commit = std::string_view("local");
+	for (int i = 1; i < argc; ++i)
+	{
+		const auto arg = std::string_view(argv[i]);
+		const auto separator = arg.find('=');
+		const auto key = arg.substr(0, separator);
+		const auto value = (separator != std::string_view::npos) ? arg.substr(separator + 1) : std::string_view();
+		if (key == "--replay")
+		{
+			capturePath = value;
+		}
+		else if (key == "--replay-backend")
+		{
+			backend = value;
+		}
+		else if (key == "--num-frames")
+		{
+			numIterations = (std::max)(1, atoi(std::string(value).c_str()));
+		}
+		else if (key == "--results")
+		{
+			resultsPath = value;
+		}
+		else if (key == "--commit")
+		{
+			commit = value;
+		}
+	}
+	if (!capturePath || backend == "gpu")
+	{
+		return std::nullopt;
+	}
+
+	auto capture = FrameCaptureFile();
+	if (!capture.Open(*capturePath))
+	{
+		printf("Replay: cannot open %.*s as a frame capture\n", static_cast<int>(capturePath->size()), capturePath->data());
+		return 1;
+	}
+	capture.Print();
+
+	auto isOutputMatched = false;
+	auto times = ReplayFrameCaptureOnCpu(capture, numIterations, isOutputMatched);
+	if (times.empty())
+	{
+		printf("Replay: the input of the capture is corrupt\n");
+		return 1;
+	}
+	auto sortedTimes = times;
+	std::sort(sortedTimes.begin(), sortedTimes.end());
+	printf
+	(
+		"Replay: CPU (%u threads), %u iterations, median %.3fms, min %.3fms, max %.3fms, Output: %s\n",
+		GetNumWorkerThreads(),
+		numIterations,
+		sortedTimes[sortedTimes.size() / 2],
+		sortedTimes.front(),
+		sortedTimes.back(),
+		isOutputMatched ? "Matched" : "Mismatched"
+	);
+
+	if (!resultsPath.empty())
+	{
+		const auto& info = capture.GetInfo();
+		auto result = BenchmarkResult();
+		result.m_commit = commit;
+		result.m_device = "CPU (" + std::to_string(GetNumWorkerThreads()) + " threads)";
+		result.m_mode = std::string("Replay ") + k_modeNames[static_cast<uint32_t>(info.m_mode) % static_cast<uint32_t>(FrameCaptureMode::Count)];
+		result.m_algorithm = std::string(GetSortStrategyName(info.m_sortStrategy)) + " " + std::string(GetSortKeyName(info.m_sortKeyType));
+		if (info.m_mode != FrameCaptureMode::Cpu)
+		{
+			result.m_algorithm += " " + info.m_kernelVariant.ToString();
+		}
+		result.m_distribution = "capture";
+		result.m_size = info.m_numValidElements;
+		result.m_samples = std::move(times);
+		if (!ResultsStore::Append(resultsPath, result))
+		{
+			printf("Results: cannot append to %.*s\n", static_cast<int>(resultsPath.size()), resultsPath.data());
+			return 1;
+		}
+	}
+	return isOutputMatched ? 0 : 1;
+}
+}
\ No newline at end of file
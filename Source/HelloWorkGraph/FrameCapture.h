@@ -0,0 +1,141 @@
+﻿#pragma once
+
+#include "KernelTuner.h"
+#include "SortKey.h"
+#include "Sortedness.h"
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <span>
+#include <string_view>
+#include <type_traits>
+#include <vector>
+
+namespace LearningWorkGraph
+{
+// Engine that executed the captured frame, the PipelineMode of the application.
+enum class FrameCaptureMode : uint32_t
+{
+	Compute = 0,
+	WorkGraph,
+	Cpu,
+	Count
+};
+
+// Pipelines of the sort frame, a capture identifies the variant of each by the hash of its compiled bytecode.
+enum class FrameCapturePipeline : uint32_t
+{
+	BitonicSort = 0,		// CSMain.
+	SortingNetwork,			// SortingNetworkCSMain.
+	Reverse,				// ReverseCSMain.
+	WorkGraph,				// The library of the work graph.
+	Count
+};
+
+std::string_view GetFrameCapturePipelineName(FrameCapturePipeline pipeline);
+
+// Iterations of a replay without --num-frames.
+constexpr uint32_t k_defaultReplayIterations = 10;
+
+enum class FrameCaptureCommandType : uint32_t
+{
+	CopyInput = 0,			// The input keys to the sort buffer.
+	Dispatch,				// m_groups thread groups of m_pipeline, with the pass constants inc and dir in m_arguments.
+	DispatchGraph,			// One record in m_arguments to the entry node of the work graph.
+	UavBarrier,				// Between two passes over the sort buffer.
+	CpuSort,				// The CPU engine sorts the valid keys with the SortStrategy in m_arguments[0].
+	Count
+};
+
+struct FrameCaptureCommand
+{
+	FrameCaptureCommandType m_type = FrameCaptureCommandType::CopyInput;
+	FrameCapturePipeline m_pipeline = FrameCapturePipeline::BitonicSort;
+	uint32_t m_groups = 0;
+	std::array<uint32_t, 4> m_arguments = {};
+
+	bool operator==(const FrameCaptureCommand&) const = default;
+};
+static_assert(sizeof(FrameCaptureCommand) == 7 * sizeof(uint32_t));
+
+// Everything about the frame besides the input, constants and commands. Stored as is, so the layout has no padding.
+struct FrameCaptureInfo
+{
+	std::array<uint64_t, static_cast<size_t>(FrameCapturePipeline::Count)> m_shaderHashes = {};
+	// Hash of the valid keys after the frame, the sorted input if the frame passed the validation.
+	uint64_t m_outputHash = 0;
+	std::array<char, 128> m_device = {};
+	FrameCaptureMode m_mode = FrameCaptureMode::Compute;
+	SortKeyType m_sortKeyType = SortKeyType::UInt32;
+	SortStrategy m_sortStrategy = SortStrategy::FullSort;
+	// Keys of the sort buffer, padded to a power of two, and the keys before the padding.
+	uint32_t m_numSortElements = 0;
+	uint32_t m_numValidElements = 0;
+	KernelVariant m_kernelVariant = {};
+	uint32_t m_isValidationPassed = 0;
+	// Frames the application rendered before this one, see --capture-frame.
+	uint32_t m_frameIndex = 0;
+};
+static_assert(std::is_trivially_copyable_v<FrameCaptureInfo>);
+static_assert(sizeof(FrameCaptureInfo) == 5 * sizeof(uint64_t) + 128 + 10 * sizeof(uint32_t));
+
+// One frame as recorded by the application with --capture.
+struct FrameCapture
+{
+	FrameCaptureInfo m_info = {};
+	// Keys of the sort buffer before the frame, padding included.
+	std::vector<std::byte> m_input;
+	// The ApplicationConstantBuffer of the frame, m_numSortElements then m_numValidElements. Empty for the CPU engine.
+	std::vector<std::byte> m_constants;
+	std::vector<FrameCaptureCommand> m_commands;
+};
+
+// 64-bit FNV-1a, chained through hash.
+uint64_t HashBytes(const void* data, size_t size, uint64_t hash = 0xcbf29ce484222325ull);
+
+// The input is stored as byte planes, or byte planes of the differences of neighbouring keys for mostly sorted inputs,
+// each run-length encoded, or raw if neither is smaller. Returns false if the file could not be written.
+bool WriteFrameCapture(std::string_view filePath, const FrameCapture& capture);
+
+// A capture mapped read-only, the constants and commands are used in place.
+class FrameCaptureFile
+{
+public:
+	FrameCaptureFile() = default;
+	~FrameCaptureFile() { Close(); }
+	FrameCaptureFile(const FrameCaptureFile&) = delete;
+	FrameCaptureFile& operator=(const FrameCaptureFile&) = delete;
+
+	// Returns false if the file is missing, of another version or truncated, or if a size or command is out of range.
+	bool Open(std::string_view filePath);
+	void Close();
+	bool IsOpen() const { return m_data != nullptr; }
+
+	const FrameCaptureInfo& GetInfo() const;
+	std::span<const std::byte> GetConstants() const;
+	std::span<const FrameCaptureCommand> GetCommands() const;
+	uint64_t GetInputSize() const;
+	uint64_t GetCompressedInputSize() const;
+	// output holds GetInputSize() bytes. Returns false if the compressed input is corrupt.
+	bool DecodeInput(std::byte* output) const;
+	// The frame, the compression of the input and the shader variants.
+	void Print() const;
+
+private:
+	const std::byte* m_data = nullptr;
+	size_t m_size = 0;
+};
+
+// Replays the commands of the capture on the CPU numIterations times, each from the decoded input, and returns the time of
+// every iteration in milliseconds. The passes run the comparators of the shaders in the same order, so the keys after every command
+// match the frame bit for bit; the recursive work graph runs its records through WorkGraphSortModel. isOutputMatched tells whether
+// the keys match the output of the captured frame.
+std::vector<double> ReplayFrameCaptureOnCpu(const FrameCaptureFile& capture, uint32_t numIterations, bool& isOutputMatched);
+
+// --replay=<capture> replays a capture of --capture on the CPU --num-frames times and appends the times to --results.
+// Returns 1 if the output does not match the captured frame.
+// Returns nothing without it, or with --replay-backend=gpu so that the application replays it on the device.
+std::optional<int> RunReplayCommandLine(int argc, const char** argv);
+}
\ No newline at end of file
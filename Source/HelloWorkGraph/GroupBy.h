@@ -0,0 +1,71 @@
+﻿#pragma once
+
+#include "Parallel.h"
+#include "Primitives.h"
+
+#include <cstdint>
+#include <vector>
+
+namespace LearningWorkGraph
+{
+// One group of a group-by, the same layout as the rows GroupByFinalizeCSMain in Shader/Primitives.shader writes.
+struct GroupByRow
+{
+	uint32_t m_group;
+	uint32_t m_count;
+	// Sum of the values of the group modulo 2^32.
+	uint32_t m_sum;
+
+	bool operator==(const GroupByRow&) const = default;
+};
+static_assert(sizeof(GroupByRow) == 12);
+
+// Group and value of a key, the same as LoadGroupByKey: a 32-bit key is its group with value 1,
+// a 64-bit key carries the group in the high word and the value in the low word, so sorting the keys sorts by group.
+inline uint32_t GetGroupByGroup(uint32_t key) { return key; }
+inline uint32_t GetGroupByValue(uint32_t) { return 1; }
+inline uint32_t GetGroupByGroup(uint64_t key) { return static_cast<uint32_t>(key >> 32); }
+inline uint32_t GetGroupByValue(uint64_t key) { return static_cast<uint32_t>(key); }
+
+// Appends the groups of count keys sorted by group to rows.
+template<typename Key>
+void GroupBySorted(const Key* keys, size_t count, std::vector<GroupByRow>& rows)
+{
+	for (size_t i = 0; i < count;)
+	{
+		auto row = GroupByRow{ GetGroupByGroup(keys[i]), 0, 0 };
+		for (; i < count && GetGroupByGroup(keys[i]) == row.m_group; ++i)
+		{
+			++row.m_count;
+			row.m_sum += GetGroupByValue(keys[i]);
+		}
+		rows.push_back(row);
+	}
+}
+
+// Same as GroupBySorted with one range per worker. A group that crosses a range boundary comes out of both ranges,
+// so the first row of a range is folded into the last row so far when their groups match.
+template<typename Key>
+std::vector<GroupByRow> ParallelGroupBySorted(const Key* keys, size_t count)
+{
+	auto rangeRows = std::vector<std::vector<GroupByRow>>(GetNumWorkerThreads());
+	const auto numRanges = ParallelForRanges(count, k_primitiveMinGrain, [&](uint32_t rangeIndex, size_t begin, size_t end)
+	{
+		GroupBySorted(keys + begin, end - begin, rangeRows[rangeIndex]);
+	});
+
+	auto rows = std::move(rangeRows[0]);
+	for (uint32_t range = 1; range < numRanges; ++range)
+	{
+		auto first = rangeRows[range].begin();
+		if (first != rangeRows[range].end() && !rows.empty() && rows.back().m_group == first->m_group)
+		{
+			rows.back().m_count += first->m_count;
+			rows.back().m_sum += first->m_sum;
+			++first;
+		}
+		rows.insert(rows.end(), first, rangeRows[range].end());
+	}
+	return rows;
+}
+}
\ No newline at end of file
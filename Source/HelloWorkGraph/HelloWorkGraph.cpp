@@ -22,9 +22,14 @@ THE SOFTWARE.
 
 // C++ STL
 #include <array>
+#include <atomic>
+#include <chrono>
 #include <random>
 #include <bit>
+#include <filesystem>
 #include <functional>
+#include <mutex>
+#include <numeric>
 
 #include <windows.h>
 #include <d3d12.h>
@@ -39,30 +44,117 @@ THE SOFTWARE.
 
 #include <Framework/Application.h>
 #include <Framework/Framework.h>
+#include <Framework/MappedRingBuffer.h>
 #include <Framework/Shader.h>
 
+#include "Benchmark.h"
+#include "CommandLine.h"
+#include "CooperativeSort.h"
+#include "CpuSort.h"
+#include "FrameCapture.h"
+#include "GroupBy.h"
+#include "HostMemory.h"
+#include "IncrementalSort.h"
+#include "KernelTuner.h"
+#include "MemoryBudget.h"
+#include "NarrowKeys.h"
+#include "Primitives.h"
+#include "ResultsStore.h"
+#include "SortingNetwork.h"
+#include "Sortedness.h"
+#include "SortRouter.h"
+#include "SortService.h"
+#include "SortKey.h"
+#include "WorkGraphStats.h"
+
 extern "C" { __declspec(dllexport) extern const UINT D3D12SDKVersion = 613; }
 extern "C" { __declspec(dllexport) extern const char* D3D12SDKPath = ".\\D3D12\\"; }
 
 using Microsoft::WRL::ComPtr;
 
-#define WORK_GRAPH_LAUNCHED_MULTI_DISPATCH_GRID 0
-
 class HelloWorkGraphApplication : public LearningWorkGraph::Application
 {
 private:
 	struct ApplicationConstantBuffer final
 	{
 		uint32_t m_numSortElements;
-		uint32_t m_dummy[63];
+		uint32_t m_numValidElements;
+		uint32_t m_dummy[62];
 	};
 	static_assert(sizeof(ApplicationConstantBuffer) == 256);
 	struct PassConstantBuffer final
 	{
 		uint32_t m_inc;
 		uint32_t m_dir;
+		uint32_t m_numDeletes;
+		uint32_t m_numInserts;
 	};
 	static_assert(sizeof(PassConstantBuffer) % 4 == 0);
+	enum class PipelineMode
+	{
+		Compute,
+		WorkGraph,
+		// Used without a D3D12 device.
+		Cpu,
+		Count
+	};
+	// Stored as FrameCaptureMode in frame captures.
+	static_assert(static_cast<uint32_t>(PipelineMode::WorkGraph) == static_cast<uint32_t>(LearningWorkGraph::FrameCaptureMode::WorkGraph));
+	static_assert(static_cast<uint32_t>(PipelineMode::Cpu) == static_cast<uint32_t>(LearningWorkGraph::FrameCaptureMode::Cpu));
+	// Primitives of Shader/Primitives.shader.
+	enum class PrimitiveKind
+	{
+		Reduce,
+		ReduceWorkGraph,
+		Scan,
+		Histogram,
+		Compact,
+		Count
+	};
+	// One job of a sort service batch in the batch buffers.
+	struct SortBatchJob final
+	{
+		uint64_t m_offset;
+		uint32_t m_numSortElements;
+		uint32_t m_numValidElements;
+	};
+	// SortService backend on the device, the batch is sorted by ExecuteSortBatch.
+	template<typename Key>
+	class D3D12SortBackend
+	{
+	public:
+		explicit D3D12SortBackend(HelloWorkGraphApplication& application) : m_application(application) {}
+
+		void SortBatch(const std::vector<LearningWorkGraph::SortBatchItem<Key>>& items)
+		{
+			// Each job is padded to a power of two at a raw buffer aligned offset.
+			auto jobs = std::vector<SortBatchJob>();
+			auto sortBufferSize = uint64_t(0);
+			for (const auto& item : items)
+			{
+				const auto numSortElements = std::bit_ceil(static_cast<uint32_t>(item.m_count));
+				jobs.push_back({ sortBufferSize, numSortElements, static_cast<uint32_t>(item.m_count) });
+				sortBufferSize += (sizeof(Key) * numSortElements + D3D12_RAW_UAV_SRV_BYTE_ALIGNMENT - 1) & ~static_cast<uint64_t>(D3D12_RAW_UAV_SRV_BYTE_ALIGNMENT - 1);
+			}
+
+			auto* keys = m_application.PrepareSortBatch(jobs, sortBufferSize);
+			for (size_t i = 0; i < items.size(); ++i)
+			{
+				auto* jobKeys = reinterpret_cast<Key*>(keys + jobs[i].m_offset);
+				std::copy(items[i].m_keys, items[i].m_keys + items[i].m_count, jobKeys);
+				std::fill(jobKeys + items[i].m_count, jobKeys + jobs[i].m_numSortElements, LearningWorkGraph::GetPaddingKey<Key>());
+			}
+			const auto* sortedKeys = m_application.ExecuteSortBatch(jobs, sortBufferSize);
+			for (size_t i = 0; i < items.size(); ++i)
+			{
+				const auto* jobKeys = reinterpret_cast<const Key*>(sortedKeys + jobs[i].m_offset);
+				std::copy(jobKeys, jobKeys + items[i].m_count, items[i].m_keys);
+			}
+		}
+
+	private:
+		HelloWorkGraphApplication& m_application;
+	};
 
 public:
 	virtual void OnInitialize(const LearningWorkGraph::ApplicationDesc& applicationDesc) override;
@@ -73,27 +165,90 @@ private:
 	void ProcessCommandLineArguments(uint32_t argc, const char** argvs);
 	ID3D12Resource* CreateBuffer(uint64_t Size, D3D12_RESOURCE_FLAGS ResourceFlags, D3D12_HEAP_TYPE HeapType);
 
-	bool EnsureWorkGraphsSupported();
+	bool IsWorkGraphsSupported();
+	void SelectPipelineMode();
 	D3D12_SET_PROGRAM_DESC PrepareWorkGraph();
 
 	void PreExecute();
 	void PostExecute();
-
+	void SubmitCommandList();
+	void WaitForCommandList();
+	void SubmitAndWaitForCommandList();
+	void ReleaseInitialBuffer();
+	LearningWorkGraph::MappedRingBuffer::Allocation RecordReadbackChunk(uint64_t chunkIndex);
+	void ConsumeSortedKeys(const std::byte* data, uint64_t offset, uint64_t size);
+
+	std::vector<std::byte> CreateInputKeys();
+	void CreateCpuSortBuffers(const std::vector<std::byte>& input);
 	void CreateBasePipeline();
 
 	void CreateComputePipeline();
 	void ExecuteComputeShader();
 
 	void CreateWorkGraphPipeline();
+	void CreateRecursiveSortBuffers();
 	void ExecuteWorkGraph();
+	void ReportNodeStats();
+
+	void ExecuteReverse();
+
+	void CreatePrimitivePipeline();
+	float ExecutePrimitive(PrimitiveKind primitive, uint32_t numElements);
+	void RunPrimitives();
+	void RecordGroupBy();
+	void ReadbackGroupBy(float gpuTime);
+
+	void CreateCpuPipeline();
+	void ExecuteCpuSort();
+
+	bool IsSplitFrame() const { return m_useSplitSort && !m_isTuning; }
+	bool IsGroupByFrame() const { return m_groupByCardinality > 0 && !m_isTuning; }
+	void RecordFrameTime();
+	void SelectSplit();
+	void SortSplitCpuShare();
+	void MergeSplitSort(float gpuTime, double gpuWaitTime);
+
+	void CalibrateRouter();
+	void RunSortService();
+	template<typename Key, typename Backend>
+	void MeasureSortService(Backend& backend);
+	void CreateSortBatchPipeline();
+	// Writes the constants of the jobs, returns where their keys go.
+	std::byte* PrepareSortBatch(const std::vector<SortBatchJob>& jobs, uint64_t sortBufferSize);
+	// Sorts the batch with one command list and one Signal, returns the sorted keys.
+	const std::byte* ExecuteSortBatch(const std::vector<SortBatchJob>& jobs, uint64_t sortBufferSize);
+	void RenderFrame();
+	void RenderRoutedFrame();
+	std::vector<PipelineMode> GetAvailablePipelineModes() const;
+	static std::string GetExecutableRelativePath(const char* fileName);
+
+	void UpdateIncrementalDelta();
+	void ExecuteIncrementalSort();
+	void ExecuteRunMerge();
+	bool IsIncrementalFrame() const { return m_useIncrementalSort && m_hasSortedState && !m_isTuning; }
+
+	const char* GetPipelineModeName() const;
+	std::string GetDeviceName() const;
+	void PrintFrameStatus(const char* timeName, float time);
+	uint64_t GetSortBufferSize() const { return static_cast<uint64_t>(m_sortKeySize) * m_numSortElements / m_narrowKeyPacking.GetKeysPerWord(); }
+	// Bytes of the keys sorted on the GPU this frame.
+	uint64_t GetActiveSortBufferSize() const { return static_cast<uint64_t>(m_sortKeySize) * m_numActiveSortElements / m_narrowKeyPacking.GetKeysPerWord(); }
+	uint32_t GetSortDispatchGrid() const { return m_kernelVariant.GetDispatchGrid(m_numActiveSortElements / m_narrowKeyPacking.GetKeysPerWord()); }
+	uint64_t GetReadbackChunkSize() const { return (m_memoryBudget > 0) ? (std::min)(GetSortBufferSize(), k_readbackChunkSize) : GetSortBufferSize(); }
+	std::vector<LearningWorkGraph::ShaderDefine> CreateShaderDefines();
+	void SelectKernelVariant();
+	void TuneKernels();
+
+	void OpenReplayCapture();
+	// shader is null if the pipeline is not created.
+	void SetShaderHash(LearningWorkGraph::FrameCapturePipeline pipeline, const LearningWorkGraph::Shader* shader);
+	void CaptureCommand(const LearningWorkGraph::FrameCaptureCommand& command);
+	void BeginFrameCapture();
+	void EndFrameCapture();
 
 private:
-	enum class PipelineMode
-	{
-		Compute,
-		WorkGraph,
-		Count
-	} m_pipelineMode = PipelineMode::Compute;
+	PipelineMode m_pipelineMode = PipelineMode::Compute;
+	bool m_isWorkGraphsSupported = false;
 	struct ConstantBufferRegisterID
 	{
 		enum
@@ -111,6 +266,9 @@ private:
 			PassConstants,
 			ShaderResourceView,
 			UnorderedAccessView,
+			ScratchUnorderedAccessView,
+			CounterUnorderedAccessView,
+			StatsUnorderedAccessView,
 			Count
 		};
 	};
@@ -121,19 +279,98 @@ private:
 
 	uint32_t m_numSortElementsUnsafe = 1 << 16;
 	uint32_t m_numSortElements = 0;
+	// Power of two prefix of the sort buffer sorted on the GPU, less than m_numSortElements only for split frames.
+	uint32_t m_numActiveSortElements = 0;
+	LearningWorkGraph::SortKeyType m_sortKeyType = LearningWorkGraph::SortKeyType::UInt32;
+	uint32_t m_sortKeySize = sizeof(uint32_t);
+	std::vector<std::byte> m_referenceOutput;
+	bool m_useNarrowKeys = false;
+	LearningWorkGraph::NarrowKeyPacking m_narrowKeyPacking = {};
+	LearningWorkGraph::KeyDistribution m_keyDistribution = LearningWorkGraph::KeyDistribution::Random;
+	bool m_useAdaptiveSort = false;
+	// Strategy executed on the GPU, see AnalyzeSortedness.
+	LearningWorkGraph::SortStrategy m_sortStrategy = LearningWorkGraph::SortStrategy::FullSort;
+	// Run merge on the GPU: the number of runs, the run starts and the number of keys, read by RunMergeCSMain.
+	uint32_t m_numRuns = 0;
+	ComPtr<ID3D12Resource> m_runStartsBuffer = nullptr;
+
+	// Incremental sort: after the first frame m_sortBuffer keeps the sorted keys and each frame merges in a delta of updates.
+	bool m_useIncrementalSort = false;
+	bool m_hasSortedState = false;
+	float m_incrementalDeltaRatio = 0.01f;
+	uint32_t m_numDeltaKeys = 0;
+	std::mt19937 m_deltaRandomEngine = std::mt19937(1);
+	D3D12_GPU_VIRTUAL_ADDRESS m_deltaAddress = 0;
+	ComPtr<ID3D12Resource> m_scratchBuffer = nullptr;
+	// Arrival counters of the recursive work graph topology, created with its pipeline.
+	ComPtr<ID3D12Resource> m_counterBuffer = nullptr;
+
+	// CPU engine: padded input keys, output and radix sort scratch.
+	// --huge-pages and --numa=first-touch|interleave choose their pages, --pin-workers pins the worker threads to match.
+	LearningWorkGraph::HostBuffer m_cpuInput;
+	LearningWorkGraph::HostBuffer m_cpuOutput;
+	LearningWorkGraph::HostBuffer m_cpuScratch;
+	LearningWorkGraph::HostMemoryOptions m_hostMemoryOptions = {};
+	bool m_pinWorkers = false;
+
+	// Cost-model routing of every frame to the engine predicted to be fastest, calibrated at startup.
+	bool m_useRouter = false;
+	LearningWorkGraph::SortRouter m_router = {};
+	std::string m_costTablePath = GetExecutableRelativePath("CostTable.txt");
+
+	// Sort service: client threads submit jobs of m_numSortElementsUnsafe keys through a SortService, m_numSortServiceJobs each.
+	// The batches are recorded into their own command list, so the service thread never touches the one of the frames.
+	uint32_t m_numSortServiceJobs = 0;
+	struct SortBatchPipeline
+	{
+		ComPtr<ID3D12CommandAllocator> m_commandAllocator = nullptr;
+		ComPtr<ID3D12GraphicsCommandList10> m_commandList = nullptr;
+		ComPtr<ID3D12Fence> m_fence = nullptr;
+		uint64_t m_fenceValue = 0;
+		// The constants of the jobs followed by their keys. Grown to the largest batch and kept mapped.
+		ComPtr<ID3D12Resource> m_uploadBuffer = nullptr;
+		ComPtr<ID3D12Resource> m_sortBuffer = nullptr;
+		ComPtr<ID3D12Resource> m_readbackBuffer = nullptr;
+		std::byte* m_uploadData = nullptr;
+		const std::byte* m_readbackData = nullptr;
+		uint64_t m_constantsSize = 0;
+		uint64_t m_sortBufferSize = 0;
+	} m_sortBatchPipeline = {};
+
+	// Split sort: the GPU sorts a power of two prefix while the CPU engine sorts the rest, then both are merged.
+	bool m_useSplitSort = false;
+	LearningWorkGraph::SplitBalancer m_splitBalancer = {};
+	double m_splitCpuTime = 0.0;
+	bool m_isValidationPassed = false;
 	ComPtr<ID3D12RootSignature> m_rootSignature = nullptr;
-	ComPtr<ID3D12Resource> m_gpuTimeCPUReadbackBuffer = nullptr;
-	ComPtr<ID3D12Resource> m_applicationConstantBuffer = nullptr;
 	ComPtr<ID3D12Resource> m_initialBuffer = nullptr;
 	ComPtr<ID3D12Resource> m_sortBuffer = nullptr;
-	ComPtr<ID3D12Resource> m_sortCPUReadbackBuffer = nullptr;
+
+	// Per-frame constants, node records and deltas, and the readback of timestamps and sorted keys.
+	// Both stay mapped and are sub-allocated every frame, the memory of a frame is reused once its fence value completed.
+	LearningWorkGraph::MappedRingBuffer m_uploadRing = {};
+	LearningWorkGraph::MappedRingBuffer m_readbackRing = {};
+	// Unpacked narrow keys of one readback chunk, allocated once.
+	std::vector<std::byte> m_unpackedOutput;
+
+	// Memory budget in bytes, 0 for no budget. With a budget the initial buffer is released after the first upload,
+	// the readback goes through chunks of k_readbackChunkSize and the backing memory is sized to fit.
+	uint64_t m_memoryBudget = 0;
+	LearningWorkGraph::MemoryTracker m_memoryTracker = {};
 
 	// Reset each frame.
 	uint32_t m_queryIndex = 0;
+	LearningWorkGraph::MappedRingBuffer::Allocation m_timestampReadback = {};
+	LearningWorkGraph::MappedRingBuffer::Allocation m_sortReadback = {};
 
 	struct ComputePipeline
 	{
 		ComPtr<ID3D12PipelineState> m_pipelineState = nullptr;
+		ComPtr<ID3D12PipelineState> m_sortingNetworkPipelineState = nullptr;
+		ComPtr<ID3D12PipelineState> m_reversePipelineState = nullptr;
+		ComPtr<ID3D12PipelineState> m_deltaRemovePipelineState = nullptr;
+		ComPtr<ID3D12PipelineState> m_mergePathPipelineState = nullptr;
+		ComPtr<ID3D12PipelineState> m_runMergePipelineState = nullptr;
 	} m_computePipeline = {};
 
 	struct WorkGraphPipeline
@@ -143,10 +380,90 @@ private:
 		ComPtr<ID3D12WorkGraphProperties> m_workGraphProperties = nullptr;
 		D3D12_WORK_GRAPH_MEMORY_REQUIREMENTS m_memoryRequirements = {};
 		ComPtr<ID3D12Resource> m_backingMemoryBuffer = nullptr;
+		uint64_t m_backingMemorySize = 0;
 	} m_workGraphPipeline = {};
 
+	// Per-node counters of the instrumentation build with --node-stats, compared with PredictWorkGraphStats every frame.
+	bool m_useNodeStats = false;
+	ComPtr<ID3D12Resource> m_nodeStatsBuffer = nullptr;
+	LearningWorkGraph::MappedRingBuffer::Allocation m_nodeStatsReadback = {};
+
+	// Parallel primitives, run once on the input keys as 32-bit words and validated against the CPU references with --primitives.
+	bool m_usePrimitives = false;
+	struct PrimitivePipeline
+	{
+		ComPtr<ID3D12PipelineState> m_clearPipelineState = nullptr;
+		ComPtr<ID3D12PipelineState> m_reducePipelineState = nullptr;
+		ComPtr<ID3D12PipelineState> m_scanPipelineState = nullptr;
+		ComPtr<ID3D12PipelineState> m_histogramPipelineState = nullptr;
+		ComPtr<ID3D12PipelineState> m_compactPipelineState = nullptr;
+		ComPtr<ID3D12PipelineState> m_groupByHeadsPipelineState = nullptr;
+		ComPtr<ID3D12PipelineState> m_groupByFinalizePipelineState = nullptr;
+		ComPtr<ID3D12StateObject> m_reduceStateObject = nullptr;
+		D3D12_PROGRAM_IDENTIFIER m_reduceProgramIdentifier = {};
+		ComPtr<ID3D12Resource> m_reduceBackingMemoryBuffer = nullptr;
+		uint64_t m_reduceBackingMemorySize = 0;
+		ComPtr<ID3D12Resource> m_outputBuffer = nullptr;
+		ComPtr<ID3D12Resource> m_scratchBuffer = nullptr;
+		ComPtr<ID3D12Resource> m_counterBuffer = nullptr;
+		// Timestamps, the total of the scan or compaction, then the output.
+		ComPtr<ID3D12Resource> m_readbackBuffer = nullptr;
+		// Look-back flags of a dispatch are tagged with its epoch, so scratch is never cleared.
+		uint32_t m_epoch = 0;
+	} m_primitivePipeline = {};
+
+	// Group-by of the sorted keys on the GPU every frame with --group-by=<number of groups>, see GroupBy.h.
+	// Only the table of groups is read back instead of the sorted keys.
+	uint32_t m_groupByCardinality = 0;
+	std::vector<LearningWorkGraph::GroupByRow> m_referenceGroups;
+
+	// With --num-frames the application quits after that many frames and appends their times to --results, tagged with --commit.
+	uint32_t m_numFrames = 0;
+	std::vector<double> m_frameTimes;
+	std::string m_resultsPath;
+	std::string m_commit = "local";
+
+	// Kernel variant the pipelines were compiled with.
+	LearningWorkGraph::KernelVariant m_kernelVariant = {};
+	std::vector<std::string> m_shaderDefineValues;
+	std::string m_kernelTablePath = "KernelTable.txt";
+	bool m_tuneKernels = false;
+	bool m_isTuning = false;
+	float m_lastGPUTime = 0.0f;
+
+	// --capture=<file> writes the frame --capture-frame to a frame capture, see FrameCapture.h.
+	// --replay=<file> with --replay-backend=gpu renders the captured frame and compares its shaders and commands with the capture.
+	std::string m_capturePath;
+	uint32_t m_captureFrameIndex = 0;
+	uint32_t m_numRenderedFrames = 0;
+	bool m_isCapturingFrame = false;
+	LearningWorkGraph::FrameCapture m_frameCapture = {};
+	std::string m_replayPath;
+	LearningWorkGraph::FrameCaptureFile m_replayCapture;
+	std::array<uint64_t, static_cast<size_t>(LearningWorkGraph::FrameCapturePipeline::Count)> m_shaderHashes = {};
+
 private:
 	static constexpr const wchar_t* k_programName = L"Hello World";
+	// Matches MERGE_ELEMENTS_PER_THREAD in Shader.shader.
+	static constexpr uint32_t k_mergeElementsPerThread = 8;
+	// Matches RECURSIVE_LEAF_SIZE in Shader.shader, in keys per thread.
+	static constexpr uint32_t k_recursiveLeafKeysPerThread = 2;
+	static constexpr uint64_t k_ringAlignment = D3D12_CONSTANT_BUFFER_DATA_PLACEMENT_ALIGNMENT;
+	static constexpr uint64_t k_readbackChunkSize = 1 << 20;
+	static constexpr uint32_t k_minSplitSortElements = 1 << 16;
+	// Keys generated with one random engine each, seeded with the block index so the keys do not depend on the number of threads.
+	static constexpr uint32_t k_generateBlockSize = 1 << 16;
+	// Keys compared per job of the validation.
+	static constexpr uint64_t k_validateGrain = 1 << 18;
+	// Match NUM_THREADS and ITEMS_PER_THREAD in Primitives.shader.
+	static constexpr uint32_t k_primitiveThreads = 256;
+	static constexpr uint32_t k_primitivePartitionSize = k_primitiveThreads * 4;
+	static constexpr uint32_t k_primitiveHistogramShift = 24;
+	static constexpr uint32_t k_primitiveCompactMask = 0x3;
+	// Thread groups of GroupByFinalizeCSMain, which strides over the groups.
+	static constexpr uint32_t k_groupByFinalizeGroups = 64;
+	static constexpr const wchar_t* k_reduceProgramName = L"Reduce";
+	static constexpr uint64_t AlignRingSize(uint64_t size) { return (size + k_ringAlignment - 1) & ~(k_ringAlignment - 1); }
 
 };
 
@@ -188,6 +505,119 @@ void HelloWorkGraphApplication::ProcessCommandLineArguments(uint32_t argc, const
 			{
 				m_pipelineMode = PipelineMode::WorkGraph;
 			}
+			else if (value == "Cpu")
+			{
+				m_pipelineMode = PipelineMode::Cpu;
+			}
+		}
+		else if (key == "--key-type")
+		{
+			LWG_CHECK_WITH_MESSAGE(LearningWorkGraph::FindSortKeyType(value, m_sortKeyType), "Unknown key type. Use uint32, int32, float, uint64, int64 or double.");
+		}
+		else if (key == "--distribution")
+		{
+			LWG_CHECK_WITH_MESSAGE(LearningWorkGraph::FindKeyDistribution(value, m_keyDistribution), "Unknown distribution. Use random, sorted, reversed, runs or nearly-sorted.");
+		}
+		else if (key == "--adaptive-sort")
+		{
+			m_useAdaptiveSort = true;
+		}
+		else if (key == "--incremental-sort")
+		{
+			m_useIncrementalSort = true;
+		}
+		else if (key == "--incremental-delta-ratio")
+		{
+			m_incrementalDeltaRatio = static_cast<float>(atof(value.c_str()));
+		}
+		else if (key == "--memory-budget")
+		{
+			// In MiB.
+			m_memoryBudget = static_cast<uint64_t>(atoll(value.c_str())) << 20;
+		}
+		else if (key == "--split-sort")
+		{
+			m_useSplitSort = true;
+		}
+		else if (key == "--route")
+		{
+			m_useRouter = true;
+		}
+		else if (key == "--cost-table")
+		{
+			m_costTablePath = value;
+		}
+		else if (key == "--sort-service")
+		{
+			m_numSortServiceJobs = static_cast<uint32_t>(atoi(value.c_str()));
+		}
+		else if (key == "--narrow-keys")
+		{
+			m_useNarrowKeys = true;
+		}
+		else if (key == "--primitives")
+		{
+			m_usePrimitives = true;
+		}
+		else if (key == "--huge-pages")
+		{
+			m_hostMemoryOptions.m_useHugePages = true;
+		}
+		else if (key == "--numa")
+		{
+			if (value == "first-touch")
+			{
+				m_hostMemoryOptions.m_placement = LearningWorkGraph::HostPagePlacement::FirstTouch;
+			}
+			else if (value == "interleave")
+			{
+				m_hostMemoryOptions.m_placement = LearningWorkGraph::HostPagePlacement::Interleave;
+			}
+		}
+		else if (key == "--pin-workers")
+		{
+			m_pinWorkers = true;
+		}
+		else if (key == "--node-stats")
+		{
+			m_useNodeStats = true;
+		}
+		else if (key == "--group-by")
+		{
+			m_groupByCardinality = static_cast<uint32_t>(atoi(value.c_str()));
+		}
+		else if (key == "--num-frames")
+		{
+			m_numFrames = static_cast<uint32_t>(atoi(value.c_str()));
+		}
+		else if (key == "--results")
+		{
+			m_resultsPath = value;
+		}
+		else if (key == "--commit")
+		{
+			m_commit = value;
+		}
+		else if (key == "--tune-kernels")
+		{
+			m_tuneKernels = true;
+		}
+		else if (key == "--kernel-table")
+		{
+			m_kernelTablePath = value;
+		}
+		else if (key == "--capture")
+		{
+			m_capturePath = value;
+		}
+		else if (key == "--capture-frame")
+		{
+			m_captureFrameIndex = static_cast<uint32_t>(atoi(value.c_str()));
+		}
+		else if (key == "--replay")
+		{
+			// Only with --replay-backend=gpu, the CPU backend replays before the application starts.
+			m_replayPath = value;
 		}
 	}
 }
@@ -195,27 +625,273 @@ void HelloWorkGraphApplication::ProcessCommandLineArguments(uint32_t argc, const
 void HelloWorkGraphApplication::OnInitialize(const LearningWorkGraph::ApplicationDesc& applicationDesc)
 {
 	ProcessCommandLineArguments(applicationDesc.m_argc, applicationDesc.m_argv);
-
-	if (!EnsureWorkGraphsSupported())
+	if (!m_replayPath.empty())
 	{
-		return;
+		OpenReplayCapture();
 	}
+	SelectPipelineMode();
+
+	// Pages touched first by a worker are only local to it while it stays on its node.
+	LearningWorkGraph::SetWorkerPinning(m_pinWorkers || m_hostMemoryOptions.m_placement == LearningWorkGraph::HostPagePlacement::FirstTouch);
 
 	m_numSortElements = std::bit_ceil(m_numSortElementsUnsafe);
+	m_numActiveSortElements = m_numSortElements;
+	m_sortKeySize = LearningWorkGraph::GetSortKeySize(m_sortKeyType);
+
+	// The split needs a GPU and enough keys for both sides, and sorts every frame fully from the initial keys.
+	if (m_useSplitSort && (m_pipelineMode == PipelineMode::Cpu || m_numSortElements < k_minSplitSortElements))
+	{
+		printf("Split Sort: needs a GPU and at least %u keys\n", k_minSplitSortElements);
+		m_useSplitSort = false;
+	}
+	if (m_useSplitSort)
+	{
+		m_useAdaptiveSort = false;
+		m_useIncrementalSort = false;
+		m_useNarrowKeys = false;
+		m_useRouter = false;
+		m_memoryBudget = 0;
+	}
+
+	// The group-by reads the groups from the sorted unsigned keys that the GPU leaves in the sort buffer every frame.
+	if (m_groupByCardinality > 0)
+	{
+		const auto isGroupByKeyType = (m_sortKeyType == LearningWorkGraph::SortKeyType::UInt32 || m_sortKeyType == LearningWorkGraph::SortKeyType::UInt64);
+		const auto maxGroupByKeys = static_cast<uint64_t>(D3D12_CS_DISPATCH_MAX_THREAD_GROUPS_PER_DIMENSION) * k_primitivePartitionSize;
+		if (!isGroupByKeyType || m_pipelineMode == PipelineMode::Cpu || m_useSplitSort || m_useIncrementalSort || m_useRouter || m_numSortElementsUnsafe > maxGroupByKeys)
+		{
+			printf("Group-By: needs a GPU, uint32 or uint64 keys, at most %llu keys and no split, incremental or routed sort\n", static_cast<unsigned long long>(maxGroupByKeys));
+			m_groupByCardinality = 0;
+		}
+		m_useNarrowKeys = false;
+	}
+
+	// The counters are only in the node shaders.
+	if (m_useNodeStats && m_pipelineMode != PipelineMode::WorkGraph)
+	{
+		printf("Node Stats: needs the work graph pipeline\n");
+		m_useNodeStats = false;
+	}
+
+	// The batches are sorted with full-width keys and without node counters.
+	if (m_numSortServiceJobs > 0 && (m_useNarrowKeys || m_useNodeStats))
+	{
+		printf("Sort Service: needs full-width keys without node stats\n");
+		m_useNarrowKeys = false;
+		m_useNodeStats = false;
+	}
+
+	// A capture holds one sort of its input, these frames also depend on earlier frames, the CPU share or the packing.
+	if (!m_capturePath.empty() && (m_useSplitSort || m_useIncrementalSort || m_useRouter || m_groupByCardinality > 0 || m_useNarrowKeys))
+	{
+		printf("Frame Capture: needs a frame without split, incremental, routed, group-by or narrow-key sort\n");
+		m_capturePath.clear();
+	}
+
+	if (m_pipelineMode == PipelineMode::Cpu)
+	{
+		CreateCpuPipeline();
+		if (m_numSortServiceJobs > 0)
+		{
+			RunSortService();
+		}
+		return;
+	}
 
 	CreateBasePipeline();
+	SelectKernelVariant();
 	CreateComputePipeline();
 	CreateWorkGraphPipeline();
+
+	if (m_usePrimitives || m_groupByCardinality > 0)
+	{
+		CreatePrimitivePipeline();
+	}
+	if (m_usePrimitives)
+	{
+		RunPrimitives();
+	}
+
+	if (m_useRouter)
+	{
+		CalibrateRouter();
+	}
+
+	if (m_numSortServiceJobs > 0)
+	{
+		RunSortService();
+	}
+}
+
+const char* HelloWorkGraphApplication::GetPipelineModeName() const
+{
+	switch (m_pipelineMode)
+	{
+	case PipelineMode::WorkGraph: return "Work Graph";
+	case PipelineMode::Cpu: return "CPU";
+	default: return "Compute";
+	}
+}
+
+std::string HelloWorkGraphApplication::GetDeviceName() const
+{
+	return (m_pipelineMode == PipelineMode::Cpu) ? "CPU (" + std::to_string(LearningWorkGraph::GetNumWorkerThreads()) + " threads)" : GetAdapterName();
+}
+
+void HelloWorkGraphApplication::PrintFrameStatus(const char* timeName, float time)
+{
+	char statusText[256] = {};
+	sprintf(statusText, "Pipeline Mode: %s, Key Type: %s, Strategy: %s, %s Time: %fms, Validation: %s\n", GetPipelineModeName(), LearningWorkGraph::GetSortKeyName(m_sortKeyType).data(), LearningWorkGraph::GetSortStrategyName(m_sortStrategy).data(), timeName, time, m_isValidationPassed ? "Passed" : "Failed");
+	printf(statusText);
+	SetConsoleTitleA(statusText);
+}
+
+std::vector<LearningWorkGraph::ShaderDefine> HelloWorkGraphApplication::CreateShaderDefines()
+{
+	// ShaderDefine only refers to the strings, so keep the values alive in the application.
+	m_shaderDefineValues =
+	{
+		std::to_string(m_kernelVariant.m_threadsPerGroup),
+		std::to_string(m_kernelVariant.m_elementsPerThread),
+		std::to_string(static_cast<uint32_t>(m_sortKeyType)),
+		std::to_string(m_narrowKeyPacking.m_bits),
+	};
+	auto shaderDefines = std::vector<LearningWorkGraph::ShaderDefine>();
+	shaderDefines.push_back({ "NUM_THREADS", m_shaderDefineValues[0] });
+	shaderDefines.push_back({ "ELEMENTS_PER_THREAD", m_shaderDefineValues[1] });
+	shaderDefines.push_back({ "KEY_TYPE", m_shaderDefineValues[2] });
+	if (m_kernelVariant.m_topology == LearningWorkGraph::KernelTopology::LauncherMultiDispatchGrid)
+	{
+		shaderDefines.push_back({ "WORK_GRAPH_LAUNCHED_MULTI_DISPATCH_GRID", "1" });
+	}
+	if (m_kernelVariant.m_topology == LearningWorkGraph::KernelTopology::Recursive)
+	{
+		shaderDefines.push_back({ "WORK_GRAPH_RECURSIVE", "1" });
+	}
+	if (m_useNodeStats)
+	{
+		shaderDefines.push_back({ "WORK_GRAPH_STATS", "1" });
+	}
+	if (m_narrowKeyPacking.IsPacked())
+	{
+		shaderDefines.push_back({ "PACKED_KEY_BITS", m_shaderDefineValues[3] });
+	}
+	return shaderDefines;
+}
+
+void HelloWorkGraphApplication::SelectKernelVariant()
+{
+	if (m_replayCapture.IsOpen())
+	{
+		m_kernelVariant = m_replayCapture.GetInfo().m_kernelVariant;
+		printf("Kernel Variant: %s (captured)\n", m_kernelVariant.ToString().c_str());
+		return;
+	}
+	if (m_tuneKernels)
+	{
+		TuneKernels();
+		return;
+	}
+
+	auto tuner = LearningWorkGraph::KernelTuner();
+	tuner.Load(m_kernelTablePath);
+	if (auto variant = tuner.Select(GetAdapterName(), GetPipelineModeName(), m_numSortElements))
+	{
+		m_kernelVariant = *variant;
+	}
+	// The recursive nodes sort full-width keys only.
+	if (m_kernelVariant.m_topology == LearningWorkGraph::KernelTopology::Recursive && m_narrowKeyPacking.IsPacked())
+	{
+		m_kernelVariant.m_topology = LearningWorkGraph::KernelTopology::Launcher;
+	}
+	// Past the dispatch limit without a tuned variant, the variant with the most keys per group.
+	if (!m_kernelVariant.IsDispatchable(m_numSortElements))
+	{
+		const auto candidates = LearningWorkGraph::KernelTuner::EnumerateVariants(false, m_numSortElements);
+		LWG_CHECK_WITH_MESSAGE(!candidates.empty(), "Too many keys to sort in one dispatch.");
+		m_kernelVariant = candidates.back();
+	}
+	printf("Kernel Variant: %s\n", m_kernelVariant.ToString().c_str());
+}
+
+void HelloWorkGraphApplication::TuneKernels()
+{
+	auto tuner = LearningWorkGraph::KernelTuner();
+	tuner.Load(m_kernelTablePath);
+
+	auto candidates = LearningWorkGraph::KernelTuner::EnumerateVariants(m_pipelineMode == PipelineMode::WorkGraph, m_numSortElements);
+	if (m_narrowKeyPacking.IsPacked())
+	{
+		std::erase_if(candidates, [](const LearningWorkGraph::KernelVariant& variant) { return variant.m_topology == LearningWorkGraph::KernelTopology::Recursive; });
+	}
+	LWG_CHECK_WITH_MESSAGE(!candidates.empty(), "Too many keys to sort in one dispatch.");
+	auto measure = [this](const LearningWorkGraph::KernelVariant& variant, uint32_t)
+	{
+		if (variant != m_kernelVariant || !m_computePipeline.m_pipelineState)
+		{
+			m_kernelVariant = variant;
+			CreateComputePipeline();
+			CreateWorkGraphPipeline();
+		}
+		RenderFrame();
+		return static_cast<double>(m_lastGPUTime);
+	};
+
+	m_isTuning = true;
+	m_kernelVariant = tuner.Tune(GetAdapterName(), GetPipelineModeName(), m_numSortElements, candidates, 8, measure);
+	m_isTuning = false;
+
+	LWG_CHECK_WITH_MESSAGE(tuner.Save(m_kernelTablePath), "Failed to save kernel table.");
+	printf("Kernel Variant: %s (tuned)\n", m_kernelVariant.ToString().c_str());
 }
 
-bool HelloWorkGraphApplication::EnsureWorkGraphsSupported()
+bool HelloWorkGraphApplication::IsWorkGraphsSupported()
 {
 	D3D12_FEATURE_DATA_D3D12_OPTIONS21 options = {};
-	m_d3d12Device->CheckFeatureSupport(D3D12_FEATURE_D3D12_OPTIONS21, &options, sizeof(options));
-	LWG_CHECK_WITH_MESSAGE(options.WorkGraphsTier != D3D12_WORK_GRAPHS_TIER_NOT_SUPPORTED, "Failed to ensure work graphs were supported. Check driver and graphics card.");
+	if (FAILED(m_d3d12Device->CheckFeatureSupport(D3D12_FEATURE_D3D12_OPTIONS21, &options, sizeof(options))))
+	{
+		return false;
+	}
 	return (options.WorkGraphsTier != D3D12_WORK_GRAPHS_TIER_NOT_SUPPORTED);
 }
 
+void HelloWorkGraphApplication::SelectPipelineMode()
+{
+	// Work graph falls back to compute, and everything falls back to the CPU engine without a device.
+	const auto requestedPipelineModeName = GetPipelineModeName();
+	if (!m_d3d12Device)
+	{
+		m_pipelineMode = PipelineMode::Cpu;
+	}
+	else
+	{
+		m_isWorkGraphsSupported = IsWorkGraphsSupported();
+		if (m_pipelineMode == PipelineMode::WorkGraph && !m_isWorkGraphsSupported)
+		{
+			m_pipelineMode = PipelineMode::Compute;
+		}
+	}
+
+	// GPU only options.
+	if (m_pipelineMode == PipelineMode::Cpu)
+	{
+		m_useIncrementalSort = false;
+		m_useNarrowKeys = false;
+		m_tuneKernels = false;
+		m_memoryBudget = 0;
+		m_useRouter = false;
+	}
+
+	if (strcmp(requestedPipelineModeName, GetPipelineModeName()) == 0)
+	{
+		printf("Engine: %s\n", GetPipelineModeName());
+	}
+	else
+	{
+		printf("Engine: %s (%s is not supported%s)\n", GetPipelineModeName(), requestedPipelineModeName, m_d3d12Device ? "" : ", no D3D12 device");
+	}
+}
+
 ID3D12Resource* HelloWorkGraphApplication::CreateBuffer(uint64_t size, D3D12_RESOURCE_FLAGS resourceFlags, D3D12_HEAP_TYPE heapType)
 {
 	ID3D12Resource* resource = nullptr;
@@ -233,76 +909,245 @@ D3D12_SET_PROGRAM_DESC HelloWorkGraphApplication::PrepareWorkGraph()
 	setProgramDesc.WorkGraph.Flags = D3D12_SET_WORK_GRAPH_FLAG_INITIALIZE;
 	if (m_workGraphPipeline.m_backingMemoryBuffer)
 	{
-		setProgramDesc.WorkGraph.BackingMemory = { m_workGraphPipeline.m_backingMemoryBuffer->GetGPUVirtualAddress(), m_workGraphPipeline.m_memoryRequirements.MaxSizeInBytes };
+		setProgramDesc.WorkGraph.BackingMemory = { m_workGraphPipeline.m_backingMemoryBuffer->GetGPUVirtualAddress(), m_workGraphPipeline.m_backingMemorySize };
 	}
 	return setProgramDesc;
 }
 
-void HelloWorkGraphApplication::CreateBasePipeline()
+std::vector<std::byte> HelloWorkGraphApplication::CreateInputKeys()
 {
-	// Create GPU time buffer.
+	auto randomEngine = std::mt19937();
+	auto input = std::vector<std::byte>(static_cast<size_t>(m_sortKeySize) * m_numSortElements);
+	LearningWorkGraph::VisitSortKeyType(m_sortKeyType, [&]<typename Key>(std::type_identity<Key>)
 	{
-		m_gpuTimeCPUReadbackBuffer = CreateBuffer
-		(
-			sizeof(uint64_t) * 2,
-			D3D12_RESOURCE_FLAG_NONE,
-			D3D12_HEAP_TYPE_READBACK
-		);
-	}
+		auto* keys = reinterpret_cast<Key*>(input.data());
+		if (m_replayCapture.IsOpen())
+		{
+			// The captured keys, padding included.
+			LWG_CHECK_WITH_MESSAGE(m_replayCapture.GetInputSize() == input.size() && m_replayCapture.DecodeInput(input.data()), "The input of the frame capture is corrupt.");
+		}
+		else
+		{
+			const auto numBlocks = (m_numSortElementsUnsafe + k_generateBlockSize - 1) / k_generateBlockSize;
+			LearningWorkGraph::ParallelFor(0, numBlocks, 1, [&](size_t beginBlock, size_t endBlock)
+			{
+				for (auto block = beginBlock; block < endBlock; ++block)
+				{
+					auto blockEngine = std::mt19937(static_cast<uint32_t>(block));
+					auto* blockKeys = keys + block * k_generateBlockSize;
+					const auto count = (std::min<size_t>)(k_generateBlockSize, m_numSortElementsUnsafe - block * k_generateBlockSize);
+					LearningWorkGraph::GenerateSortKeys(blockEngine, m_numSortElementsUnsafe, blockKeys, count);
+					// Few distinct groups for the group-by, a 64-bit key carries its group in the high word and a value in the low word.
+					if constexpr (std::is_same_v<Key, uint32_t> || std::is_same_v<Key, uint64_t>)
+					{
+						if (m_groupByCardinality > 0)
+						{
+							for (size_t i = 0; i < count; ++i)
+							{
+								const auto group = static_cast<uint64_t>(blockEngine() % m_groupByCardinality);
+								blockKeys[i] = static_cast<Key>((sizeof(Key) == sizeof(uint64_t)) ? (group << 32) | (blockEngine() & 0xffff) : group);
+							}
+						}
+					}
+				}
+			});
+			// The distributions reorder or repeat keys across the whole input, so they stay on one thread.
+			LearningWorkGraph::ApplyKeyDistribution(m_keyDistribution, randomEngine, keys, m_numSortElementsUnsafe);
+			std::fill(keys + m_numSortElementsUnsafe, keys + m_numSortElements, LearningWorkGraph::GetPaddingKey<Key>());
+		}
+
+		// The padding sorts last, so only the keys before it are analyzed.
+		if (m_useAdaptiveSort)
+		{
+			const auto begin = std::chrono::high_resolution_clock::now();
+			const auto analysis = LearningWorkGraph::AnalyzeSortedness(keys, m_numSortElementsUnsafe);
+			const auto end = std::chrono::high_resolution_clock::now();
+			m_sortStrategy = analysis.m_strategy;
+			printf
+			(
+				"Sortedness: %zu runs, %zu descents in %zu blocks, Decision: %s, Pre-pass Time: %fms\n",
+				analysis.GetNumRuns(),
+				analysis.m_numDescents,
+				analysis.m_blockDescents.size(),
+				LearningWorkGraph::GetSortStrategyName(m_sortStrategy).data(),
+				std::chrono::duration<double, std::milli>(end - begin).count()
+			);
+
+			// The replay has no pipeline of the run merge passes.
+			if (m_sortStrategy == LearningWorkGraph::SortStrategy::RunMerge && m_pipelineMode != PipelineMode::Cpu && !m_capturePath.empty())
+			{
+				printf("Frame Capture: needs a CPU frame for the run merge\n");
+				m_capturePath.clear();
+			}
+		}
+
+		// Expected output for validation.
+		m_referenceOutput.assign(input.data(), input.data() + sizeof(Key) * m_numSortElementsUnsafe);
+		LearningWorkGraph::ReferenceSort(reinterpret_cast<Key*>(m_referenceOutput.data()), m_numSortElementsUnsafe);
+		if constexpr (std::is_same_v<Key, uint32_t> || std::is_same_v<Key, uint64_t>)
+		{
+			if (m_groupByCardinality > 0)
+			{
+				m_referenceGroups = LearningWorkGraph::ParallelGroupBySorted(reinterpret_cast<const Key*>(m_referenceOutput.data()), m_numSortElementsUnsafe);
+			}
+		}
+	});
 
-	// Create application constant buffer.
+	// The captured frame may come later, so the keys are kept as they were generated.
+	if (!m_capturePath.empty())
 	{
-		m_applicationConstantBuffer = CreateBuffer
-		(
-			sizeof(ApplicationConstantBuffer),
-			D3D12_RESOURCE_FLAG_NONE,
-			D3D12_HEAP_TYPE_UPLOAD
-		);
-		ApplicationConstantBuffer* applicationConstantBuffer = nullptr;
-		auto range = CD3DX12_RANGE(0, sizeof(ApplicationConstantBuffer));
-		LWG_CHECK_HRESULT(m_applicationConstantBuffer->Map(0, &range, (void**)&applicationConstantBuffer));
-		applicationConstantBuffer->m_numSortElements = m_numSortElements;
-		memset(applicationConstantBuffer->m_dummy, 0, sizeof(applicationConstantBuffer->m_dummy));
-		m_applicationConstantBuffer->Unmap(0, NULL);
+		m_frameCapture.m_input = input;
 	}
+	return input;
+}
 
+void HelloWorkGraphApplication::CreateCpuPipeline()
+{
+	CreateCpuSortBuffers(CreateInputKeys());
+	printf("CPU Engine: %u worker threads\n", LearningWorkGraph::GetNumWorkerThreads());
+}
+
+void HelloWorkGraphApplication::CreateCpuSortBuffers(const std::vector<std::byte>& input)
+{
+	LWG_CHECK_WITH_MESSAGE(m_cpuInput.Allocate(input.size(), m_hostMemoryOptions), "Failed to allocate host memory.");
+	LWG_CHECK_WITH_MESSAGE(m_cpuOutput.Allocate(input.size(), m_hostMemoryOptions), "Failed to allocate host memory.");
+	LWG_CHECK_WITH_MESSAGE(m_cpuScratch.Allocate(input.size(), m_hostMemoryOptions), "Failed to allocate host memory.");
+	// In the ranges of the workers, so that first-touch pages stay with the worker that placed them.
+	LearningWorkGraph::ParallelForRanges(input.size(), 1 << 16, [&](uint32_t, size_t begin, size_t end)
+	{
+		std::copy(input.begin() + begin, input.begin() + end, m_cpuInput.GetData() + begin);
+	});
+	printf
+	(
+		"Host Memory: %s pages, %s placement, %u NUMA nodes%s\n",
+		m_cpuInput.HasHugePages() ? "huge" : "default",
+		LearningWorkGraph::GetHostPagePlacementName(m_hostMemoryOptions.m_placement).data(),
+		LearningWorkGraph::NumaTopology::Get().GetNumNodes(),
+		LearningWorkGraph::IsWorkerPinningEnabled() ? ", pinned workers" : ""
+	);
+}
+
+void HelloWorkGraphApplication::CreateBasePipeline()
+{
 	// Create inital buffer.
 	{
-		auto randomEngine = std::mt19937();
-		auto random = std::uniform_int_distribution<uint32_t>(0, m_numSortElementsUnsafe - 1);
+		const auto input = CreateInputKeys();
+		if (m_useRouter || m_useSplitSort)
+		{
+			CreateCpuSortBuffers(input);
+		}
+
+		// The range of the real keys decides the packed width, the padding is clamped to the largest packed value.
+		// Short arrays keep 32-bit keys for the sorting network path.
+		m_narrowKeyPacking = {};
+		if (m_useNarrowKeys && m_sortKeyType == LearningWorkGraph::SortKeyType::UInt32 && m_numSortElements > 64 && m_sortStrategy == LearningWorkGraph::SortStrategy::FullSort && !m_useIncrementalSort)
+		{
+			m_narrowKeyPacking = LearningWorkGraph::ComputeNarrowKeyPacking(reinterpret_cast<const uint32_t*>(input.data()), m_numSortElementsUnsafe);
+			printf("Narrow Keys: %u bits, minimum %u\n", m_narrowKeyPacking.m_bits, m_narrowKeyPacking.m_minimum);
+		}
+
 		m_initialBuffer = CreateBuffer
 		(
-			sizeof(uint32_t) * m_numSortElements,
+			GetSortBufferSize(),
 			D3D12_RESOURCE_FLAG_NONE,
 			D3D12_HEAP_TYPE_UPLOAD
 		);
-		uint32_t* buffer = nullptr;
-		auto range = CD3DX12_RANGE(0, sizeof(uint32_t) * m_numSortElements);
+		std::byte* buffer = nullptr;
+		auto range = CD3DX12_RANGE(0, GetSortBufferSize());
 		LWG_CHECK_HRESULT(m_initialBuffer->Map(0, &range, (void**)&buffer));
-		for (uint32_t i = 0; i < m_numSortElements; ++i)
+		if (m_narrowKeyPacking.IsPacked())
+		{
+			LearningWorkGraph::PackNarrowKeys(reinterpret_cast<const uint32_t*>(input.data()), m_numSortElements, m_narrowKeyPacking, reinterpret_cast<uint32_t*>(buffer));
+		}
+		else
 		{
-			buffer[i] = (i < m_numSortElementsUnsafe) ? random(randomEngine) : UINT32_MAX;
+			memcpy(buffer, input.data(), input.size());
 		}
 		m_initialBuffer->Unmap(0, NULL);
 		m_initialBuffer->SetName(L"initialInputBuffer");
+		m_memoryTracker.Allocate(LearningWorkGraph::MemoryCategory::InitialUpload, GetSortBufferSize());
+
+		// The padding sorts last, so it extends the last run.
+		if (m_sortStrategy == LearningWorkGraph::SortStrategy::RunMerge)
+		{
+			auto runStarts = std::vector<uint32_t>(1, 0);
+			LearningWorkGraph::VisitSortKeyType(m_sortKeyType, [&]<typename Key>(std::type_identity<Key>)
+			{
+				for (const auto runStart : LearningWorkGraph::FindRunStarts(reinterpret_cast<const Key*>(input.data()), m_numSortElementsUnsafe))
+				{
+					runStarts.push_back(static_cast<uint32_t>(runStart));
+				}
+			});
+			runStarts.back() = m_numSortElements;
+			m_numRuns = static_cast<uint32_t>(runStarts.size() - 2);
+			runStarts[0] = m_numRuns;
+
+			const auto runStartsSize = sizeof(uint32_t) * runStarts.size();
+			m_runStartsBuffer = CreateBuffer(runStartsSize, D3D12_RESOURCE_FLAG_NONE, D3D12_HEAP_TYPE_UPLOAD);
+			void* runStartsData = nullptr;
+			auto runStartsRange = CD3DX12_RANGE(0, runStartsSize);
+			LWG_CHECK_HRESULT(m_runStartsBuffer->Map(0, &runStartsRange, &runStartsData));
+			memcpy(runStartsData, runStarts.data(), runStartsSize);
+			m_runStartsBuffer->Unmap(0, NULL);
+			m_runStartsBuffer->SetName(L"runStartsBuffer");
+			printf("Run Merge: %u runs\n", m_numRuns);
+		}
 	}
 
 	// Create sort buffer.
 	{
 		m_sortBuffer = CreateBuffer
 		(
-			sizeof(uint32_t) * m_numSortElements,
+			GetSortBufferSize(),
 			D3D12_RESOURCE_FLAG_ALLOW_UNORDERED_ACCESS,
 			D3D12_HEAP_TYPE_DEFAULT
 		);
 		m_sortBuffer->SetName(L"sortedBuffer");
-		m_sortCPUReadbackBuffer = CreateBuffer
-		(
-			sizeof(uint32_t) * m_numSortElements,
-			D3D12_RESOURCE_FLAG_NONE,
-			D3D12_HEAP_TYPE_READBACK
-		);
-		m_sortCPUReadbackBuffer->SetName(L"sortedCPUReadbackBuffer");
+		m_memoryTracker.Allocate(LearningWorkGraph::MemoryCategory::SortBuffer, GetSortBufferSize());
+		if (m_narrowKeyPacking.IsPacked())
+		{
+			m_unpackedOutput.resize(GetReadbackChunkSize() * m_narrowKeyPacking.GetKeysPerWord());
+		}
+	}
+
+	// Create incremental sort buffers. Updates keep the number of keys, so the delta holds as many deletes as inserts.
+	if (m_useIncrementalSort)
+	{
+		m_numDeltaKeys = std::clamp(static_cast<uint32_t>(m_numSortElementsUnsafe * m_incrementalDeltaRatio), 1u, m_numSortElementsUnsafe);
+		m_scratchBuffer = CreateBuffer
+		(
+			GetSortBufferSize(),
+			D3D12_RESOURCE_FLAG_ALLOW_UNORDERED_ACCESS,
+			D3D12_HEAP_TYPE_DEFAULT
+		);
+		m_scratchBuffer->SetName(L"scratchBuffer");
+		m_memoryTracker.Allocate(LearningWorkGraph::MemoryCategory::ScratchBuffer, GetSortBufferSize());
+		printf("Incremental Sort: %u updates per frame\n", m_numDeltaKeys);
+	}
+
+	// The run merge passes alternate between the sort buffer and a scratch buffer.
+	if (m_sortStrategy == LearningWorkGraph::SortStrategy::RunMerge && !m_scratchBuffer)
+	{
+		m_scratchBuffer = CreateBuffer
+		(
+			GetSortBufferSize(),
+			D3D12_RESOURCE_FLAG_ALLOW_UNORDERED_ACCESS,
+			D3D12_HEAP_TYPE_DEFAULT
+		);
+		m_scratchBuffer->SetName(L"scratchBuffer");
+		m_memoryTracker.Allocate(LearningWorkGraph::MemoryCategory::ScratchBuffer, GetSortBufferSize());
+	}
+
+	// Create ring buffers with room for k_frameCount frames.
+	{
+		// The node stats are cleared from and read back to one more allocation each.
+		const auto nodeStatsSize = m_useNodeStats ? k_ringAlignment : 0;
+		const auto uploadFrameSize = k_ringAlignment * 2 + nodeStatsSize + AlignRingSize(static_cast<uint64_t>(m_sortKeySize) * m_numDeltaKeys * 2);
+		m_uploadRing.Initialize(m_d3d12Device.Get(), D3D12_HEAP_TYPE_UPLOAD, uploadFrameSize * k_frameCount, k_frameCount, L"uploadRingBuffer");
+		const auto readbackFrameSize = k_ringAlignment + nodeStatsSize + AlignRingSize(GetReadbackChunkSize());
+		m_readbackRing.Initialize(m_d3d12Device.Get(), D3D12_HEAP_TYPE_READBACK, readbackFrameSize * k_frameCount, k_frameCount, L"readbackRingBuffer");
+		m_memoryTracker.Allocate(LearningWorkGraph::MemoryCategory::UploadRing, m_uploadRing.GetSize());
+		m_memoryTracker.Allocate(LearningWorkGraph::MemoryCategory::ReadbackRing, m_readbackRing.GetSize());
 	}
 
 	// Create root signature.
@@ -312,6 +1157,9 @@ void HelloWorkGraphApplication::CreateBasePipeline()
 		rootParameter[RootParameterSlotID::PassConstants].InitAsConstants(sizeof(PassConstantBuffer) / sizeof(uint32_t), ConstantBufferRegisterID::Pass, 0);
 		rootParameter[RootParameterSlotID::ShaderResourceView].InitAsShaderResourceView(0, 0);
 		rootParameter[RootParameterSlotID::UnorderedAccessView].InitAsUnorderedAccessView(0, 0);
+		rootParameter[RootParameterSlotID::ScratchUnorderedAccessView].InitAsUnorderedAccessView(1, 0);
+		rootParameter[RootParameterSlotID::CounterUnorderedAccessView].InitAsUnorderedAccessView(2, 0);
+		rootParameter[RootParameterSlotID::StatsUnorderedAccessView].InitAsUnorderedAccessView(3, 0);
 		auto rootSignatureDesc = CD3DX12_ROOT_SIGNATURE_DESC(RootParameterSlotID::Count, rootParameter, 0, nullptr, D3D12_ROOT_SIGNATURE_FLAG_NONE);
 		ComPtr<ID3DBlob> serialized = nullptr;
 		LWG_CHECK_HRESULT(D3D12SerializeRootSignature(&rootSignatureDesc, D3D_ROOT_SIGNATURE_VERSION_1, &serialized, NULL));
@@ -326,9 +1174,10 @@ void HelloWorkGraphApplication::CreateBasePipeline()
 void HelloWorkGraphApplication::PreExecute()
 {
 	m_queryIndex = 0;
-	m_commandList->EndQuery(m_queryHeap.Get(), D3D12_QUERY_TYPE_TIMESTAMP, m_queryIndex++);
 
-	// Copy initial buffer to sorted buffer.
+	// Copy initial buffer to sorted buffer. Incremental frames keep the sorted keys of the previous frame,
+	// and with a memory budget the initial buffer is gone after the first copy, so the keys are sorted again in place.
+	if (!IsIncrementalFrame() && m_initialBuffer)
 	{
 		{
 			std::array<D3D12_RESOURCE_BARRIER, 2> barriers = {};
@@ -336,47 +1185,193 @@ void HelloWorkGraphApplication::PreExecute()
 			barriers[1] = CD3DX12_RESOURCE_BARRIER::Transition(m_sortBuffer.Get(), D3D12_RESOURCE_STATE_UNORDERED_ACCESS, D3D12_RESOURCE_STATE_COPY_DEST, 0);
 			m_commandList->ResourceBarrier(barriers.size(), barriers.data());
 		}
-		m_commandList->CopyBufferRegion(m_sortBuffer.Get(), 0, m_initialBuffer.Get(), 0, sizeof(uint32_t) * m_numSortElements);
+		m_commandList->CopyBufferRegion(m_sortBuffer.Get(), 0, m_initialBuffer.Get(), 0, GetActiveSortBufferSize());
+		CaptureCommand({ LearningWorkGraph::FrameCaptureCommandType::CopyInput });
 		{
 			std::array<D3D12_RESOURCE_BARRIER, 2> barriers = {};
 			barriers[0] = CD3DX12_RESOURCE_BARRIER::Transition(m_initialBuffer.Get(), D3D12_RESOURCE_STATE_COPY_SOURCE, D3D12_RESOURCE_STATE_COMMON, 0);
 			barriers[1] = CD3DX12_RESOURCE_BARRIER::Transition(m_sortBuffer.Get(), D3D12_RESOURCE_STATE_COPY_DEST, D3D12_RESOURCE_STATE_UNORDERED_ACCESS, 0);
 			m_commandList->ResourceBarrier(barriers.size(), barriers.data());
 		}
+		ReleaseInitialBuffer();
+	}
+	m_commandList->EndQuery(m_queryHeap.Get(), D3D12_QUERY_TYPE_TIMESTAMP, m_queryIndex++);
+
+	// Upload application constants.
+	const auto constants = m_uploadRing.Allocate(sizeof(ApplicationConstantBuffer), D3D12_CONSTANT_BUFFER_DATA_PLACEMENT_ALIGNMENT);
+	{
+		auto* applicationConstantBuffer = reinterpret_cast<ApplicationConstantBuffer*>(constants.m_cpuAddress);
+		applicationConstantBuffer->m_numSortElements = m_numActiveSortElements;
+		applicationConstantBuffer->m_numValidElements = m_numSortElementsUnsafe;
+		memset(applicationConstantBuffer->m_dummy, 0, sizeof(applicationConstantBuffer->m_dummy));
+		if (m_isCapturingFrame)
+		{
+			const auto* bytes = reinterpret_cast<const std::byte*>(applicationConstantBuffer);
+			m_frameCapture.m_constants.assign(bytes, bytes + sizeof(ApplicationConstantBuffer));
+		}
 	}
 
 	// Set root signature and parameters.
 	{
 		m_commandList->SetComputeRootSignature(m_rootSignature.Get());
-		m_commandList->SetComputeRootConstantBufferView(RootParameterSlotID::ApplicationConstantBufferView, m_applicationConstantBuffer->GetGPUVirtualAddress());
+		m_commandList->SetComputeRootConstantBufferView(RootParameterSlotID::ApplicationConstantBufferView, constants.m_gpuAddress);
 		m_commandList->SetComputeRootUnorderedAccessView(RootParameterSlotID::UnorderedAccessView, m_sortBuffer->GetGPUVirtualAddress());
+		if (IsIncrementalFrame())
+		{
+			m_commandList->SetComputeRootShaderResourceView(RootParameterSlotID::ShaderResourceView, m_deltaAddress);
+		}
+		else if (m_runStartsBuffer)
+		{
+			m_commandList->SetComputeRootShaderResourceView(RootParameterSlotID::ShaderResourceView, m_runStartsBuffer->GetGPUVirtualAddress());
+		}
+		if (m_scratchBuffer)
+		{
+			m_commandList->SetComputeRootUnorderedAccessView(RootParameterSlotID::ScratchUnorderedAccessView, m_scratchBuffer->GetGPUVirtualAddress());
+		}
+		if (m_counterBuffer)
+		{
+			m_commandList->SetComputeRootUnorderedAccessView(RootParameterSlotID::CounterUnorderedAccessView, m_counterBuffer->GetGPUVirtualAddress());
+		}
 	}
 }
 
 void HelloWorkGraphApplication::PostExecute()
 {
+	// The group-by is timed with the sort.
+	if (IsGroupByFrame())
+	{
+		RecordGroupBy();
+	}
+
 	m_commandList->EndQuery(m_queryHeap.Get(), D3D12_QUERY_TYPE_TIMESTAMP, m_queryIndex++);
-	m_commandList->ResolveQueryData(m_queryHeap.Get(), D3D12_QUERY_TYPE_TIMESTAMP, 0, 2, m_gpuTimeCPUReadbackBuffer.Get(), 0);
+	m_timestampReadback = m_readbackRing.Allocate(sizeof(uint64_t) * 2, sizeof(uint64_t));
+	m_commandList->ResolveQueryData(m_queryHeap.Get(), D3D12_QUERY_TYPE_TIMESTAMP, 0, 2, m_readbackRing.GetResource(), m_timestampReadback.m_offset);
 
 	// read results
+	if (IsGroupByFrame())
+	{
+		// Only the number of groups and the total sum, the table is copied once its size is known.
+		auto* scratchBuffer = m_primitivePipeline.m_scratchBuffer.Get();
+		auto barrier = CD3DX12_RESOURCE_BARRIER::Transition(scratchBuffer, D3D12_RESOURCE_STATE_UNORDERED_ACCESS, D3D12_RESOURCE_STATE_COPY_SOURCE, 0);
+		m_commandList->ResourceBarrier(1, &barrier);
+		m_commandList->CopyBufferRegion(m_primitivePipeline.m_readbackBuffer.Get(), sizeof(uint64_t) * 2, scratchBuffer, sizeof(uint32_t), sizeof(uint32_t) * 2);
+	}
+	else
 	{
 		auto barrier = CD3DX12_RESOURCE_BARRIER::Transition(m_sortBuffer.Get(), D3D12_RESOURCE_STATE_UNORDERED_ACCESS, D3D12_RESOURCE_STATE_COPY_SOURCE, 0);
 		m_commandList->ResourceBarrier(1, &barrier);
-		m_commandList->CopyResource(m_sortCPUReadbackBuffer.Get(), m_sortBuffer.Get());
+		if (IsSplitFrame())
+		{
+			// Only the GPU share is read back, it is merged with the CPU share.
+			m_sortReadback = m_readbackRing.Allocate(GetActiveSortBufferSize(), k_ringAlignment);
+			m_commandList->CopyBufferRegion(m_readbackRing.GetResource(), m_sortReadback.m_offset, m_sortBuffer.Get(), 0, GetActiveSortBufferSize());
+		}
+		else
+		{
+			m_sortReadback = RecordReadbackChunk(0);
+		}
 	}
 
-	// Close and execute the command list.
-	LWG_CHECK_HRESULT(m_commandList->Close());
-	ID3D12CommandList* commandLists[] = { m_commandList.Get() };
-	m_commandQueue->ExecuteCommandLists(1, commandLists);
+	SubmitCommandList();
+
+	// The CPU share is sorted while the GPU works.
+	if (IsSplitFrame())
+	{
+		SortSplitCpuShare();
+	}
 
 	if (m_swapChain)
 	{
 		m_swapChain->Present(1, 0);
 	}
 
+	const auto waitBegin = std::chrono::high_resolution_clock::now();
+	WaitForCommandList();
+	const auto waitEnd = std::chrono::high_resolution_clock::now();
+
+	uint64_t gpuTimeFrequency = 0;
+	m_commandQueue->GetTimestampFrequency(&gpuTimeFrequency);
+	const auto* queryResultPointer = reinterpret_cast<const uint64_t*>(m_timestampReadback.m_cpuAddress);
+	const auto gpuTime = (queryResultPointer[1] - queryResultPointer[0]) * 1000.0f / gpuTimeFrequency;
+	m_lastGPUTime = gpuTime;
+
+	if (m_nodeStatsReadback.m_cpuAddress)
+	{
+		ReportNodeStats();
+	}
+
+	if (IsGroupByFrame())
+	{
+		ReadbackGroupBy(gpuTime);
+		return;
+	}
+
+	if (IsSplitFrame())
+	{
+		MergeSplitSort(gpuTime, std::chrono::duration<double, std::milli>(waitEnd - waitBegin).count());
+		m_uploadRing.Retire(m_fenceValue);
+		m_readbackRing.Retire(m_fenceValue);
+		PrintFrameStatus("GPU", gpuTime);
+		return;
+	}
+
+	// Without a budget there is a single chunk. Otherwise the copy of the next chunk runs while the current one is validated.
+	m_isValidationPassed = true;
+	const auto numChunks = (GetSortBufferSize() + GetReadbackChunkSize() - 1) / GetReadbackChunkSize();
+	auto chunk = m_sortReadback;
+	auto chunkFenceValue = m_fenceValue;
+	for (uint64_t i = 0; i < numChunks; ++i)
+	{
+		const auto hasNextChunk = (i + 1 < numChunks);
+		auto nextChunk = LearningWorkGraph::MappedRingBuffer::Allocation();
+		if (hasNextChunk)
+		{
+			nextChunk = RecordReadbackChunk(i + 1);
+			SubmitCommandList();
+		}
+
+		ConsumeSortedKeys(chunk.m_cpuAddress, i * GetReadbackChunkSize(), chunk.m_size);
+
+		// Everything read from this submission, so its ring memory can be reused.
+		m_uploadRing.Retire(chunkFenceValue);
+		m_readbackRing.Retire(chunkFenceValue);
+
+		if (hasNextChunk)
+		{
+			WaitForCommandList();
+			chunk = nextChunk;
+			chunkFenceValue = m_fenceValue;
+		}
+	}
+
+	if (m_isTuning)
+	{
+		return;
+	}
+
+	// Without the initial copy the buffer is sorted from now on, reversing it again would unsort it.
+	if (!m_initialBuffer && (m_sortStrategy == LearningWorkGraph::SortStrategy::Reverse || m_sortStrategy == LearningWorkGraph::SortStrategy::RunMerge))
+	{
+		m_sortStrategy = LearningWorkGraph::SortStrategy::None;
+	}
+
+	PrintFrameStatus("GPU", gpuTime);
+}
+
+void HelloWorkGraphApplication::SubmitCommandList()
+{
+	// Close and execute the command list.
+	LWG_CHECK_HRESULT(m_commandList->Close());
+	ID3D12CommandList* commandLists[] = { m_commandList.Get() };
+	m_commandQueue->ExecuteCommandLists(1, commandLists);
+
 	LWG_CHECK_HRESULT(m_commandQueue->Signal(m_fence.Get(), ++m_fenceValue));
+	m_uploadRing.FinishFrame(m_fenceValue);
+	m_readbackRing.FinishFrame(m_fenceValue);
+}
 
+void HelloWorkGraphApplication::WaitForCommandList()
+{
 	HANDLE commandListFinished = CreateEventA(NULL, FALSE, FALSE, NULL);
 	LWG_CHECK(commandListFinished);
 
@@ -389,51 +1384,159 @@ void HelloWorkGraphApplication::PostExecute()
 		LWG_CHECK_HRESULT(m_commandAllocator->Reset());
 		LWG_CHECK_HRESULT(m_commandList->Reset(m_commandAllocator.Get(), nullptr));
 	}
+}
 
-	// Readback to CPU memory.
-	uint32_t* outputTemp = nullptr;
-	auto output = std::unique_ptr<uint32_t[]>(new uint32_t[m_numSortElements]);
-	auto range = CD3DX12_RANGE(0, sizeof(uint32_t) * m_numSortElements);
-	LWG_CHECK_HRESULT(m_sortCPUReadbackBuffer->Map(0, &range, (void**)&outputTemp));
-	memcpy(output.get(), outputTemp, sizeof(uint32_t) * m_numSortElements);
-	m_sortCPUReadbackBuffer->Unmap(0, NULL);
+void HelloWorkGraphApplication::SubmitAndWaitForCommandList()
+{
+	// Every submission takes a frame of the rings, which only hold k_frameCount of them until they are retired.
+	SubmitCommandList();
+	WaitForCommandList();
+	m_uploadRing.Retire(m_fenceValue);
+	m_readbackRing.Retire(m_fenceValue);
+}
 
-#if 1
-	for (uint32_t i = 0; i < m_numSortElementsUnsafe; ++i)
+void HelloWorkGraphApplication::ReleaseInitialBuffer()
+{
+	// Tuning sorts the initial keys once per measurement, so they are kept until the tuner is done.
+	if (m_memoryBudget == 0 || m_isTuning)
 	{
-		printf("%u : %u\n", i, output[i]);
+		return;
 	}
-#endif
 
+	// The copy runs on its own before the frame, so the initial buffer is not alive while the sort allocates its memory.
+	SubmitAndWaitForCommandList();
+
+	m_initialBuffer.Reset();
+	m_memoryTracker.Free(LearningWorkGraph::MemoryCategory::InitialUpload, GetSortBufferSize());
+	printf("Memory:\n");
+	m_memoryTracker.Print(m_memoryBudget);
+}
+
+LearningWorkGraph::MappedRingBuffer::Allocation HelloWorkGraphApplication::RecordReadbackChunk(uint64_t chunkIndex)
+{
+	// The sort buffer is promoted to COPY_SOURCE implicitly in the command lists after the first one.
+	const auto offset = chunkIndex * GetReadbackChunkSize();
+	const auto size = (std::min)(GetReadbackChunkSize(), GetSortBufferSize() - offset);
+	const auto allocation = m_readbackRing.Allocate(size, k_ringAlignment);
+	m_commandList->CopyBufferRegion(m_readbackRing.GetResource(), allocation.m_offset, m_sortBuffer.Get(), offset, size);
+	return allocation;
+}
+
+void HelloWorkGraphApplication::ConsumeSortedKeys(const std::byte* data, uint64_t offset, uint64_t size)
+{
+	const std::byte* output = data;
+	auto firstKey = offset / m_sortKeySize;
+	auto numKeys = size / m_sortKeySize;
+	if (m_narrowKeyPacking.IsPacked())
 	{
-		uint64_t gpuTimeFrequency = 0;
-		m_commandQueue->GetTimestampFrequency(&gpuTimeFrequency);
-		uint64_t* queryResultPointer = nullptr;
-		auto range = CD3DX12_RANGE(0, sizeof(uint64_t) * 2);
-		LWG_CHECK_HRESULT(m_gpuTimeCPUReadbackBuffer->Map(0, &range, (void**)&queryResultPointer));
-		const auto gpuTime = (queryResultPointer[1] - queryResultPointer[0]) * 1000.0f / gpuTimeFrequency;
-		m_gpuTimeCPUReadbackBuffer->Unmap(0, NULL);
-		char gpuTimeText[256] = {};
-		const char* pipelineModeText = m_pipelineMode == PipelineMode::Compute ? "Compute" : "Work Graph";
-		sprintf(gpuTimeText, "Pipeline Mode: %s, GPU Time: %fms\n", pipelineModeText, gpuTime);
-		printf(gpuTimeText);
-		SetConsoleTitleA(gpuTimeText);
+		firstKey *= m_narrowKeyPacking.GetKeysPerWord();
+		numKeys *= m_narrowKeyPacking.GetKeysPerWord();
+		LearningWorkGraph::UnpackNarrowKeys(reinterpret_cast<const uint32_t*>(data), numKeys, m_narrowKeyPacking, reinterpret_cast<uint32_t*>(m_unpackedOutput.data()));
+		output = m_unpackedOutput.data();
 	}
+
+	// The padding after m_numSortElementsUnsafe is not validated.
+	const auto numValidKeys = (firstKey < m_numSortElementsUnsafe) ? (std::min<uint64_t>)(numKeys, m_numSortElementsUnsafe - firstKey) : 0;
+	const auto* reference = m_referenceOutput.data() + firstKey * m_sortKeySize;
+	auto isMatched = std::atomic<bool>(true);
+	LearningWorkGraph::ParallelFor(0, numValidKeys, k_validateGrain, [&](size_t begin, size_t end)
+	{
+		if (memcmp(output + begin * m_sortKeySize, reference + begin * m_sortKeySize, (end - begin) * m_sortKeySize) != 0)
+		{
+			isMatched.store(false, std::memory_order_relaxed);
+		}
+	});
+	m_isValidationPassed &= isMatched.load();
+
+#if 1
+	LearningWorkGraph::VisitSortKeyType(m_sortKeyType, [&]<typename Key>(std::type_identity<Key>)
+	{
+		const auto* keys = reinterpret_cast<const Key*>(output);
+		// Measured frames are not slowed down by printing, the routed frames and their probes alike.
+		for (uint64_t i = 0; i < numValidKeys && !m_isTuning && !m_useRouter; ++i)
+		{
+			printf("%llu : %s\n", static_cast<unsigned long long>(firstKey + i), std::to_string(keys[i]).c_str());
+		}
+	});
+#endif
 }
 
 void HelloWorkGraphApplication::CreateComputePipeline()
 {
+	const auto shaderDefines = CreateShaderDefines();
 	auto computeShader = LearningWorkGraph::Shader();
-	LWG_CHECK(computeShader.CompileFromFile("Shader/Shader.shader", "CSMain", "cs_6_5"));
+	LWG_CHECK(computeShader.CompileFromFile("Shader/Shader.shader", "CSMain", "cs_6_5", &shaderDefines));
+	SetShaderHash(LearningWorkGraph::FrameCapturePipeline::BitonicSort, &computeShader);
 
 	D3D12_COMPUTE_PIPELINE_STATE_DESC computePipelineStateDesc = {};
 	computePipelineStateDesc.pRootSignature = m_rootSignature.Get();
 	computePipelineStateDesc.CS = CD3DX12_SHADER_BYTECODE(computeShader.GetData(), computeShader.GetSize());
 	LWG_CHECK_HRESULT(m_d3d12Device->CreateComputePipelineState(&computePipelineStateDesc, IID_PPV_ARGS(&m_computePipeline.m_pipelineState)));
+
+	m_computePipeline.m_reversePipelineState.Reset();
+	SetShaderHash(LearningWorkGraph::FrameCapturePipeline::Reverse, nullptr);
+	if (m_sortStrategy == LearningWorkGraph::SortStrategy::Reverse)
+	{
+		auto reverseShader = LearningWorkGraph::Shader();
+		LWG_CHECK(reverseShader.CompileFromFile("Shader/Shader.shader", "ReverseCSMain", "cs_6_5", &shaderDefines));
+		SetShaderHash(LearningWorkGraph::FrameCapturePipeline::Reverse, &reverseShader);
+		computePipelineStateDesc.CS = CD3DX12_SHADER_BYTECODE(reverseShader.GetData(), reverseShader.GetSize());
+		LWG_CHECK_HRESULT(m_d3d12Device->CreateComputePipelineState(&computePipelineStateDesc, IID_PPV_ARGS(&m_computePipeline.m_reversePipelineState)));
+	}
+
+	m_computePipeline.m_deltaRemovePipelineState.Reset();
+	m_computePipeline.m_mergePathPipelineState.Reset();
+	if (m_useIncrementalSort)
+	{
+		auto deltaRemoveShader = LearningWorkGraph::Shader();
+		LWG_CHECK(deltaRemoveShader.CompileFromFile("Shader/Shader.shader", "DeltaRemoveCSMain", "cs_6_5", &shaderDefines));
+		computePipelineStateDesc.CS = CD3DX12_SHADER_BYTECODE(deltaRemoveShader.GetData(), deltaRemoveShader.GetSize());
+		LWG_CHECK_HRESULT(m_d3d12Device->CreateComputePipelineState(&computePipelineStateDesc, IID_PPV_ARGS(&m_computePipeline.m_deltaRemovePipelineState)));
+
+		auto mergePathShader = LearningWorkGraph::Shader();
+		LWG_CHECK(mergePathShader.CompileFromFile("Shader/Shader.shader", "MergePathCSMain", "cs_6_5", &shaderDefines));
+		computePipelineStateDesc.CS = CD3DX12_SHADER_BYTECODE(mergePathShader.GetData(), mergePathShader.GetSize());
+		LWG_CHECK_HRESULT(m_d3d12Device->CreateComputePipelineState(&computePipelineStateDesc, IID_PPV_ARGS(&m_computePipeline.m_mergePathPipelineState)));
+	}
+
+	m_computePipeline.m_runMergePipelineState.Reset();
+	if (m_runStartsBuffer)
+	{
+		auto runMergeShader = LearningWorkGraph::Shader();
+		LWG_CHECK(runMergeShader.CompileFromFile("Shader/Shader.shader", "RunMergeCSMain", "cs_6_5", &shaderDefines));
+		computePipelineStateDesc.CS = CD3DX12_SHADER_BYTECODE(runMergeShader.GetData(), runMergeShader.GetSize());
+		LWG_CHECK_HRESULT(m_d3d12Device->CreateComputePipelineState(&computePipelineStateDesc, IID_PPV_ARGS(&m_computePipeline.m_runMergePipelineState)));
+	}
+
+	// Short arrays are sorted by one thread with an unrolled sorting network instead of log2(n)^2 dispatches.
+	m_computePipeline.m_sortingNetworkPipelineState.Reset();
+	SetShaderHash(LearningWorkGraph::FrameCapturePipeline::SortingNetwork, nullptr);
+	const auto sortingNetwork = LearningWorkGraph::GenerateSortingNetworkHLSL<LearningWorkGraph::SortingNetworkKind::GreenOddEvenMerge>(m_numSortElements, "SortingNetwork");
+	if (!sortingNetwork.empty() && m_sortKeyType == LearningWorkGraph::SortKeyType::UInt32)
+	{
+		auto source = std::string();
+		LWG_CHECK(LearningWorkGraph::Shader::ReadSourceFile("Shader/Shader.shader", source));
+		const auto sortingNetworkSize = std::to_string(m_numSortElements);
+		auto sortingNetworkDefines = shaderDefines;
+		sortingNetworkDefines.push_back({ "SORTING_NETWORK_SIZE", sortingNetworkSize });
+		auto sortingNetworkShader = LearningWorkGraph::Shader();
+		LWG_CHECK(sortingNetworkShader.CompileFromMemory(sortingNetwork + source, "SortingNetworkCSMain", "cs_6_5", &sortingNetworkDefines));
+		SetShaderHash(LearningWorkGraph::FrameCapturePipeline::SortingNetwork, &sortingNetworkShader);
+		computePipelineStateDesc.CS = CD3DX12_SHADER_BYTECODE(sortingNetworkShader.GetData(), sortingNetworkShader.GetSize());
+		LWG_CHECK_HRESULT(m_d3d12Device->CreateComputePipelineState(&computePipelineStateDesc, IID_PPV_ARGS(&m_computePipeline.m_sortingNetworkPipelineState)));
+	}
 }
 
 void HelloWorkGraphApplication::ExecuteComputeShader()
 {
+	if (m_computePipeline.m_sortingNetworkPipelineState)
+	{
+		m_commandList->SetPipelineState(m_computePipeline.m_sortingNetworkPipelineState.Get());
+		m_commandList->Dispatch(1, 1, 1);
+		CaptureCommand({ LearningWorkGraph::FrameCaptureCommandType::Dispatch, LearningWorkGraph::FrameCapturePipeline::SortingNetwork, 1 });
+		return;
+	}
+
 	m_commandList->SetPipelineState(m_computePipeline.m_pipelineState.Get());
 
 	const uint32_t log2n = static_cast<uint32_t>(std::log2f(m_numSortElements));
@@ -450,10 +1553,12 @@ void HelloWorkGraphApplication::ExecuteComputeShader()
 			{
 				auto barrier = CD3DX12_RESOURCE_BARRIER::UAV(m_sortBuffer.Get());
 				m_commandList->ResourceBarrier(1, &barrier);
+				CaptureCommand({ LearningWorkGraph::FrameCaptureCommandType::UavBarrier });
 			}
 			PassConstantBuffer passConstantBuffer = { inc, 2 << i };
 			m_commandList->SetComputeRoot32BitConstants(RootParameterSlotID::PassConstants, sizeof(PassConstantBuffer) / sizeof(uint32_t), &passConstantBuffer, 0);
-			m_commandList->Dispatch(max(1, m_numSortElements / 2 / 1024), 1, 1);
+			m_commandList->Dispatch(GetSortDispatchGrid(), 1, 1);
+			CaptureCommand({ LearningWorkGraph::FrameCaptureCommandType::Dispatch, LearningWorkGraph::FrameCapturePipeline::BitonicSort, GetSortDispatchGrid(), { passConstantBuffer.m_inc, passConstantBuffer.m_dir } });
 			inc /= 2;
 		}
 	}
@@ -461,15 +1566,28 @@ void HelloWorkGraphApplication::ExecuteComputeShader()
 
 void HelloWorkGraphApplication::CreateWorkGraphPipeline()
 {
-	auto shaderDefines = std::vector<LearningWorkGraph::ShaderDefine>();
-#if defined(WORK_GRAPH_LAUNCHED_MULTI_DISPATCH_GRID) && WORK_GRAPH_LAUNCHED_MULTI_DISPATCH_GRID
-	auto& shaderDefine = shaderDefines.emplace_back();
-	shaderDefine.m_key = "WORK_GRAPH_LAUNCHED_MULTI_DISPATCH_GRID";
-	shaderDefine.m_value = "1";
-#endif
+	if (!m_isWorkGraphsSupported)
+	{
+		return;
+	}
+
+	// Before the backing memory, so that a memory budget accounts for them.
+	if (m_kernelVariant.m_topology == LearningWorkGraph::KernelTopology::Recursive)
+	{
+		CreateRecursiveSortBuffers();
+	}
+	if (m_useNodeStats && !m_nodeStatsBuffer)
+	{
+		m_nodeStatsBuffer = CreateBuffer(sizeof(LearningWorkGraph::WorkGraphStats), D3D12_RESOURCE_FLAG_ALLOW_UNORDERED_ACCESS, D3D12_HEAP_TYPE_DEFAULT);
+		m_nodeStatsBuffer->SetName(L"nodeStatsBuffer");
+		m_memoryTracker.Allocate(LearningWorkGraph::MemoryCategory::ScratchBuffer, sizeof(LearningWorkGraph::WorkGraphStats));
+	}
+
+	const auto shaderDefines = CreateShaderDefines();
 
 	auto shader = LearningWorkGraph::Shader();
 	LWG_CHECK(shader.CompileFromFile("Shader/Shader.shader", "", "lib_6_8", &shaderDefines));
+	SetShaderHash(LearningWorkGraph::FrameCapturePipeline::WorkGraph, &shader);
 
 	auto desc = CD3DX12_STATE_OBJECT_DESC(D3D12_STATE_OBJECT_TYPE_EXECUTABLE);
 
@@ -493,45 +1611,1021 @@ void HelloWorkGraphApplication::CreateWorkGraphPipeline()
 	// GPU Ŏgp郁m.
 	auto index = m_workGraphPipeline.m_workGraphProperties->GetWorkGraphIndex(k_programName);
 	m_workGraphPipeline.m_workGraphProperties->GetWorkGraphMemoryRequirements(index, &m_workGraphPipeline.m_memoryRequirements);
-	if (m_workGraphPipeline.m_memoryRequirements.MaxSizeInBytes > 0)
+	m_workGraphPipeline.m_backingMemoryBuffer.Reset();
+	m_memoryTracker.Free(LearningWorkGraph::MemoryCategory::BackingMemory, m_workGraphPipeline.m_backingMemorySize);
+	m_workGraphPipeline.m_backingMemorySize = 0;
+	const auto& memoryRequirements = m_workGraphPipeline.m_memoryRequirements;
+	if (memoryRequirements.MaxSizeInBytes > 0)
 	{
-		m_workGraphPipeline.m_backingMemoryBuffer = CreateBuffer(m_workGraphPipeline.m_memoryRequirements.MaxSizeInBytes, D3D12_RESOURCE_FLAG_ALLOW_UNORDERED_ACCESS, D3D12_HEAP_TYPE_DEFAULT);
+		// With a budget, the backing memory gets what the other buffers leave, between the minimum and the maximum size.
+		auto backingMemorySize = memoryRequirements.MaxSizeInBytes;
+		if (m_memoryBudget > 0)
+		{
+			const auto used = m_memoryTracker.GetTotal();
+			backingMemorySize = LearningWorkGraph::SelectBackingMemorySize(memoryRequirements.MinSizeInBytes, memoryRequirements.MaxSizeInBytes, memoryRequirements.SizeGranularityInBytes, (m_memoryBudget > used) ? m_memoryBudget - used : 0);
+		}
+		m_workGraphPipeline.m_backingMemoryBuffer = CreateBuffer(backingMemorySize, D3D12_RESOURCE_FLAG_ALLOW_UNORDERED_ACCESS, D3D12_HEAP_TYPE_DEFAULT);
 		m_workGraphPipeline.m_backingMemoryBuffer->SetName(L"backingMemoryBuffer");
+		m_workGraphPipeline.m_backingMemorySize = backingMemorySize;
+		m_memoryTracker.Allocate(LearningWorkGraph::MemoryCategory::BackingMemory, backingMemorySize);
 	}
 }
 
+void HelloWorkGraphApplication::CreateRecursiveSortBuffers()
+{
+	// Ranges ping-pong between the sort buffer and the scratch buffer by their depth.
+	if (!m_scratchBuffer)
+	{
+		m_scratchBuffer = CreateBuffer
+		(
+			GetSortBufferSize(),
+			D3D12_RESOURCE_FLAG_ALLOW_UNORDERED_ACCESS,
+			D3D12_HEAP_TYPE_DEFAULT
+		);
+		m_scratchBuffer->SetName(L"scratchBuffer");
+		m_memoryTracker.Allocate(LearningWorkGraph::MemoryCategory::ScratchBuffer, GetSortBufferSize());
+	}
+
+	// Child and group arrival counters per tree node, see GetNumTreeNodes in Shader.shader.
+	// The counters start zeroed and the shaders reset them, so a larger leaf size reuses the buffer.
+	const auto leafSize = m_kernelVariant.m_threadsPerGroup * k_recursiveLeafKeysPerThread;
+	const auto numTreeNodes = static_cast<uint64_t>((std::max)(1u, m_numSortElements / leafSize)) * 2;
+	const auto counterBufferSize = numTreeNodes * 2 * sizeof(uint32_t);
+	if (m_counterBuffer && m_counterBuffer->GetDesc().Width >= counterBufferSize)
+	{
+		return;
+	}
+	if (m_counterBuffer)
+	{
+		m_memoryTracker.Free(LearningWorkGraph::MemoryCategory::ScratchBuffer, m_counterBuffer->GetDesc().Width);
+	}
+	m_counterBuffer = CreateBuffer
+	(
+		counterBufferSize,
+		D3D12_RESOURCE_FLAG_ALLOW_UNORDERED_ACCESS,
+		D3D12_HEAP_TYPE_DEFAULT
+	);
+	m_counterBuffer->SetName(L"counterBuffer");
+	m_memoryTracker.Allocate(LearningWorkGraph::MemoryCategory::ScratchBuffer, counterBufferSize);
+}
+
 void HelloWorkGraphApplication::ExecuteWorkGraph()
 {
 	D3D12_SET_PROGRAM_DESC setProgramDesc = PrepareWorkGraph();
 
-#if defined(WORK_GRAPH_LAUNCHED_MULTI_DISPATCH_GRID) && WORK_GRAPH_LAUNCHED_MULTI_DISPATCH_GRID
 	struct ApplicationRecord
 	{
 		uint32_t m_dispatchGrid;
-	} applicationRecord = { max(1, m_numSortElements / 2 / 1024) };
-#endif
+	};
+	const auto record = m_uploadRing.Allocate(sizeof(ApplicationRecord), alignof(ApplicationRecord));
+	auto* applicationRecord = reinterpret_cast<ApplicationRecord*>(record.m_cpuAddress);
+	applicationRecord->m_dispatchGrid = GetSortDispatchGrid();
+
+	// Matches SortRangeRecord in Shader.shader, the root range of the recursive topology.
+	struct SortRangeRecord
+	{
+		uint32_t m_begin;
+		uint32_t m_count;
+		uint32_t m_nodeIndex;
+	};
+	const auto rangeRecord = m_uploadRing.Allocate(sizeof(SortRangeRecord), alignof(SortRangeRecord));
+	auto* sortRangeRecord = reinterpret_cast<SortRangeRecord*>(rangeRecord.m_cpuAddress);
+	*sortRangeRecord = { 0, m_numActiveSortElements, 0 };
 
 	// dispatch work graph
 	D3D12_DISPATCH_GRAPH_DESC dispatchGraphDesc = {};
 	dispatchGraphDesc.Mode = D3D12_DISPATCH_MODE_NODE_CPU_INPUT;
 	dispatchGraphDesc.NodeCPUInput.EntrypointIndex = 0;
 	dispatchGraphDesc.NodeCPUInput.NumRecords = 1; // InputRecord ł NumRecords = 1 ɂȂ Dispatch Ȃ͗l.
-#if defined(WORK_GRAPH_LAUNCHED_MULTI_DISPATCH_GRID) && WORK_GRAPH_LAUNCHED_MULTI_DISPATCH_GRID
-	dispatchGraphDesc.NodeCPUInput.pRecords = &applicationRecord;
-	dispatchGraphDesc.NodeCPUInput.RecordStrideInBytes = sizeof(ApplicationRecord);
-#endif
+	// The record is captured from its values, the ring is write-combined memory and slow to read.
+	auto graphCommand = LearningWorkGraph::FrameCaptureCommand{ LearningWorkGraph::FrameCaptureCommandType::DispatchGraph, LearningWorkGraph::FrameCapturePipeline::WorkGraph };
+	if (m_kernelVariant.m_topology == LearningWorkGraph::KernelTopology::LauncherMultiDispatchGrid)
+	{
+		dispatchGraphDesc.NodeCPUInput.pRecords = applicationRecord;
+		dispatchGraphDesc.NodeCPUInput.RecordStrideInBytes = sizeof(ApplicationRecord);
+		graphCommand.m_arguments = { GetSortDispatchGrid() };
+	}
+	else if (m_kernelVariant.m_topology == LearningWorkGraph::KernelTopology::Recursive)
+	{
+		dispatchGraphDesc.NodeCPUInput.pRecords = sortRangeRecord;
+		dispatchGraphDesc.NodeCPUInput.RecordStrideInBytes = sizeof(SortRangeRecord);
+		graphCommand.m_arguments = { 0, m_numActiveSortElements, 0 };
+	}
+
+	// The counters only add up, so they start from zeros of the upload ring every frame.
+	const auto nodeStatsSize = static_cast<uint64_t>(sizeof(LearningWorkGraph::WorkGraphStats));
+	if (m_nodeStatsBuffer)
+	{
+		const auto zeros = m_uploadRing.Allocate(nodeStatsSize, sizeof(uint32_t));
+		memset(zeros.m_cpuAddress, 0, nodeStatsSize);
+		m_commandList->CopyBufferRegion(m_nodeStatsBuffer.Get(), 0, m_uploadRing.GetResource(), zeros.m_offset, nodeStatsSize);
+		auto barrier = CD3DX12_RESOURCE_BARRIER::Transition(m_nodeStatsBuffer.Get(), D3D12_RESOURCE_STATE_COPY_DEST, D3D12_RESOURCE_STATE_UNORDERED_ACCESS, 0);
+		m_commandList->ResourceBarrier(1, &barrier);
+		m_commandList->SetComputeRootUnorderedAccessView(RootParameterSlotID::StatsUnorderedAccessView, m_nodeStatsBuffer->GetGPUVirtualAddress());
+	}
 
 	m_commandList->SetProgram(&setProgramDesc);
 	m_commandList->DispatchGraph(&dispatchGraphDesc);
+	CaptureCommand(graphCommand);
+
+	// Kernel tuning times the instrumented graph too, but only frames are reported.
+	if (m_nodeStatsBuffer && !m_isTuning)
+	{
+		auto barrier = CD3DX12_RESOURCE_BARRIER::Transition(m_nodeStatsBuffer.Get(), D3D12_RESOURCE_STATE_UNORDERED_ACCESS, D3D12_RESOURCE_STATE_COPY_SOURCE, 0);
+		m_commandList->ResourceBarrier(1, &barrier);
+		m_nodeStatsReadback = m_readbackRing.Allocate(nodeStatsSize, sizeof(uint32_t));
+		m_commandList->CopyBufferRegion(m_readbackRing.GetResource(), m_nodeStatsReadback.m_offset, m_nodeStatsBuffer.Get(), 0, nodeStatsSize);
+	}
+}
+
+void HelloWorkGraphApplication::ReportNodeStats()
+{
+	auto stats = LearningWorkGraph::WorkGraphStats();
+	memcpy(stats.data(), m_nodeStatsReadback.m_cpuAddress, sizeof(stats));
+	m_nodeStatsReadback = {};
+
+	const auto expected = LearningWorkGraph::PredictWorkGraphStats(m_kernelVariant, m_numActiveSortElements, m_narrowKeyPacking.GetKeysPerWord(), k_mergeElementsPerThread, k_recursiveLeafKeysPerThread);
+	const auto& memoryRequirements = m_workGraphPipeline.m_memoryRequirements;
+	printf
+	(
+		"Node Stats: %s, backing memory %llu bytes (min %llu, max %llu)\n",
+		m_kernelVariant.ToString().c_str(),
+		static_cast<unsigned long long>(m_workGraphPipeline.m_backingMemorySize),
+		static_cast<unsigned long long>(memoryRequirements.MinSizeInBytes),
+		static_cast<unsigned long long>(memoryRequirements.MaxSizeInBytes)
+	);
+	LearningWorkGraph::PrintWorkGraphStats(stats, expected);
+}
+
+void HelloWorkGraphApplication::ExecuteReverse()
+{
+	// A single pass, so both pipeline modes use the compute shader.
+	m_commandList->SetPipelineState(m_computePipeline.m_reversePipelineState.Get());
+	const auto numThreads = (std::max)(1u, m_numSortElementsUnsafe / 2);
+	const auto numGroups = (numThreads + m_kernelVariant.m_threadsPerGroup - 1) / m_kernelVariant.m_threadsPerGroup;
+	m_commandList->Dispatch(numGroups, 1, 1);
+	CaptureCommand({ LearningWorkGraph::FrameCaptureCommandType::Dispatch, LearningWorkGraph::FrameCapturePipeline::Reverse, numGroups });
+}
+
+void HelloWorkGraphApplication::CreatePrimitivePipeline()
+{
+	const auto numElements = static_cast<uint32_t>(GetSortBufferSize() / sizeof(uint32_t));
+	const auto numPartitions = (numElements + k_primitivePartitionSize - 1) / k_primitivePartitionSize;
+
+	D3D12_COMPUTE_PIPELINE_STATE_DESC computePipelineStateDesc = {};
+	computePipelineStateDesc.pRootSignature = m_rootSignature.Get();
+	auto createPipelineState = [&](const char* entryPoint, ComPtr<ID3D12PipelineState>& pipelineState, const std::vector<LearningWorkGraph::ShaderDefine>* shaderDefines = nullptr)
+	{
+		auto shader = LearningWorkGraph::Shader();
+		LWG_CHECK(shader.CompileFromFile("Shader/Primitives.shader", entryPoint, "cs_6_5", shaderDefines));
+		computePipelineStateDesc.CS = CD3DX12_SHADER_BYTECODE(shader.GetData(), shader.GetSize());
+		LWG_CHECK_HRESULT(m_d3d12Device->CreateComputePipelineState(&computePipelineStateDesc, IID_PPV_ARGS(&pipelineState)));
+	};
+	createPipelineState("ClearCSMain", m_primitivePipeline.m_clearPipelineState);
+	createPipelineState("ReduceCSMain", m_primitivePipeline.m_reducePipelineState);
+	createPipelineState("ScanCSMain", m_primitivePipeline.m_scanPipelineState);
+	createPipelineState("HistogramCSMain", m_primitivePipeline.m_histogramPipelineState);
+	createPipelineState("CompactCSMain", m_primitivePipeline.m_compactPipelineState);
+	if (m_groupByCardinality > 0)
+	{
+		const auto shaderDefines = std::vector<LearningWorkGraph::ShaderDefine>{ { "GROUP_BY_KEY_WORDS", (m_sortKeySize == sizeof(uint64_t)) ? "2" : "1" } };
+		createPipelineState("GroupByHeadsCSMain", m_primitivePipeline.m_groupByHeadsPipelineState, &shaderDefines);
+		createPipelineState("GroupByFinalizeCSMain", m_primitivePipeline.m_groupByFinalizePipelineState, &shaderDefines);
+	}
+
+	// Work graph reduction tree.
+	if (m_isWorkGraphsSupported)
+	{
+		auto shader = LearningWorkGraph::Shader();
+		LWG_CHECK(shader.CompileFromFile("Shader/Primitives.shader", "", "lib_6_8"));
+		auto desc = CD3DX12_STATE_OBJECT_DESC(D3D12_STATE_OBJECT_TYPE_EXECUTABLE);
+		auto* globalRootSignatureDesc = desc.CreateSubobject<CD3DX12_GLOBAL_ROOT_SIGNATURE_SUBOBJECT>();
+		globalRootSignatureDesc->SetRootSignature(m_rootSignature.Get());
+		auto* libraryDesc = desc.CreateSubobject<CD3DX12_DXIL_LIBRARY_SUBOBJECT>();
+		auto libraryCode = CD3DX12_SHADER_BYTECODE(shader.GetData(), shader.GetSize());
+		libraryDesc->SetDXILLibrary(&libraryCode);
+		auto* workGraphDesc = desc.CreateSubobject<CD3DX12_WORK_GRAPH_SUBOBJECT>();
+		workGraphDesc->IncludeAllAvailableNodes();
+		workGraphDesc->SetProgramName(k_reduceProgramName);
+		LWG_CHECK_HRESULT(m_d3d12Device->CreateStateObject(desc, IID_PPV_ARGS(&m_primitivePipeline.m_reduceStateObject)));
+
+		ComPtr<ID3D12StateObjectProperties1> stateObjectProperties = nullptr;
+		ComPtr<ID3D12WorkGraphProperties> workGraphProperties = nullptr;
+		LWG_CHECK_HRESULT(m_primitivePipeline.m_reduceStateObject.As(&stateObjectProperties));
+		LWG_CHECK_HRESULT(m_primitivePipeline.m_reduceStateObject.As(&workGraphProperties));
+		m_primitivePipeline.m_reduceProgramIdentifier = stateObjectProperties->GetProgramIdentifier(k_reduceProgramName);
+		auto memoryRequirements = D3D12_WORK_GRAPH_MEMORY_REQUIREMENTS();
+		workGraphProperties->GetWorkGraphMemoryRequirements(workGraphProperties->GetWorkGraphIndex(k_reduceProgramName), &memoryRequirements);
+		if (memoryRequirements.MaxSizeInBytes > 0)
+		{
+			m_primitivePipeline.m_reduceBackingMemorySize = memoryRequirements.MaxSizeInBytes;
+			m_primitivePipeline.m_reduceBackingMemoryBuffer = CreateBuffer(memoryRequirements.MaxSizeInBytes, D3D12_RESOURCE_FLAG_ALLOW_UNORDERED_ACCESS, D3D12_HEAP_TYPE_DEFAULT);
+			m_primitivePipeline.m_reduceBackingMemoryBuffer->SetName(L"reduceBackingMemoryBuffer");
+		}
+	}
+
+	// Output of the scan and the compaction, the histogram or the groups. Scratch holds the look-back state, two levels of partial sums
+	// and the segment heads of the group-by, see Primitives.shader.
+	const auto numGroupByWords = (m_groupByCardinality > 0) ? static_cast<uint64_t>(m_numSortElementsUnsafe) * 3 : 0;
+	const auto outputSize = (std::max)({ static_cast<uint64_t>(numElements), static_cast<uint64_t>(LearningWorkGraph::k_histogramBuckets), numGroupByWords }) * sizeof(uint32_t);
+	m_primitivePipeline.m_outputBuffer = CreateBuffer(outputSize, D3D12_RESOURCE_FLAG_ALLOW_UNORDERED_ACCESS, D3D12_HEAP_TYPE_DEFAULT);
+	m_primitivePipeline.m_outputBuffer->SetName(L"primitiveOutputBuffer");
+	m_primitivePipeline.m_scratchBuffer = CreateBuffer((4 + static_cast<uint64_t>(numPartitions) * 7 + numGroupByWords) * sizeof(uint32_t), D3D12_RESOURCE_FLAG_ALLOW_UNORDERED_ACCESS, D3D12_HEAP_TYPE_DEFAULT);
+	m_primitivePipeline.m_scratchBuffer->SetName(L"primitiveScratchBuffer");
+	m_primitivePipeline.m_counterBuffer = CreateBuffer(k_ringAlignment, D3D12_RESOURCE_FLAG_ALLOW_UNORDERED_ACCESS, D3D12_HEAP_TYPE_DEFAULT);
+	m_primitivePipeline.m_counterBuffer->SetName(L"primitiveCounterBuffer");
+	m_primitivePipeline.m_readbackBuffer = CreateBuffer(k_ringAlignment + outputSize, D3D12_RESOURCE_FLAG_NONE, D3D12_HEAP_TYPE_READBACK);
+	m_primitivePipeline.m_readbackBuffer->SetName(L"primitiveReadbackBuffer");
+}
+
+float HelloWorkGraphApplication::ExecutePrimitive(PrimitiveKind primitive, uint32_t numElements)
+{
+	const auto numPartitions = (numElements + k_primitivePartitionSize - 1) / k_primitivePartitionSize;
+	auto* outputBuffer = m_primitivePipeline.m_outputBuffer.Get();
+	auto* scratchBuffer = m_primitivePipeline.m_scratchBuffer.Get();
+
+	m_commandList->EndQuery(m_queryHeap.Get(), D3D12_QUERY_TYPE_TIMESTAMP, 0);
+	m_commandList->SetComputeRootSignature(m_rootSignature.Get());
+	m_commandList->SetComputeRootShaderResourceView(RootParameterSlotID::ShaderResourceView, m_initialBuffer->GetGPUVirtualAddress());
+	m_commandList->SetComputeRootUnorderedAccessView(RootParameterSlotID::UnorderedAccessView, outputBuffer->GetGPUVirtualAddress());
+	m_commandList->SetComputeRootUnorderedAccessView(RootParameterSlotID::ScratchUnorderedAccessView, scratchBuffer->GetGPUVirtualAddress());
+	m_commandList->SetComputeRootUnorderedAccessView(RootParameterSlotID::CounterUnorderedAccessView, m_primitivePipeline.m_counterBuffer->GetGPUVirtualAddress());
+
+	// Matches PrimitiveConstantBuffer in Primitives.shader.
+	uint32_t constants[4] = { numElements, 0, 0, 0 };
+	static_assert(sizeof(constants) == sizeof(PassConstantBuffer));
+	auto setConstants = [&] { m_commandList->SetComputeRoot32BitConstants(RootParameterSlotID::PassConstants, 4, constants, 0); };
+	auto outputSize = static_cast<uint64_t>(numElements) * sizeof(uint32_t);
+	switch (primitive)
+	{
+	case PrimitiveKind::Reduce:
+		setConstants();
+		m_commandList->SetPipelineState(m_primitivePipeline.m_reducePipelineState.Get());
+		m_commandList->Dispatch(numPartitions, 1, 1);
+		outputSize = sizeof(uint32_t);
+		break;
+	case PrimitiveKind::ReduceWorkGraph:
+	{
+		setConstants();
+		D3D12_SET_PROGRAM_DESC setProgramDesc = {};
+		setProgramDesc.Type = D3D12_PROGRAM_TYPE_WORK_GRAPH;
+		setProgramDesc.WorkGraph.ProgramIdentifier = m_primitivePipeline.m_reduceProgramIdentifier;
+		setProgramDesc.WorkGraph.Flags = D3D12_SET_WORK_GRAPH_FLAG_INITIALIZE;
+		if (m_primitivePipeline.m_reduceBackingMemoryBuffer)
+		{
+			setProgramDesc.WorkGraph.BackingMemory = { m_primitivePipeline.m_reduceBackingMemoryBuffer->GetGPUVirtualAddress(), m_primitivePipeline.m_reduceBackingMemorySize };
+		}
+		// Matches ReduceRecord in Primitives.shader.
+		struct ReduceRecord
+		{
+			uint32_t m_dispatchGrid;
+			uint32_t m_numElements;
+			uint32_t m_level;
+		};
+		auto record = ReduceRecord{ numPartitions, numElements, 0 };
+		D3D12_DISPATCH_GRAPH_DESC dispatchGraphDesc = {};
+		dispatchGraphDesc.Mode = D3D12_DISPATCH_MODE_NODE_CPU_INPUT;
+		dispatchGraphDesc.NodeCPUInput.EntrypointIndex = 0;
+		dispatchGraphDesc.NodeCPUInput.NumRecords = 1;
+		dispatchGraphDesc.NodeCPUInput.pRecords = &record;
+		dispatchGraphDesc.NodeCPUInput.RecordStrideInBytes = sizeof(ReduceRecord);
+		m_commandList->SetProgram(&setProgramDesc);
+		m_commandList->DispatchGraph(&dispatchGraphDesc);
+		outputSize = sizeof(uint32_t);
+		break;
+	}
+	case PrimitiveKind::Scan:
+		constants[1] = ++m_primitivePipeline.m_epoch;
+		setConstants();
+		m_commandList->SetPipelineState(m_primitivePipeline.m_scanPipelineState.Get());
+		m_commandList->Dispatch(numPartitions, 1, 1);
+		break;
+	case PrimitiveKind::Histogram:
+	{
+		constants[0] = LearningWorkGraph::k_histogramBuckets;
+		setConstants();
+		m_commandList->SetPipelineState(m_primitivePipeline.m_clearPipelineState.Get());
+		m_commandList->Dispatch(LearningWorkGraph::k_histogramBuckets / k_primitiveThreads + 1, 1, 1);
+		auto barrier = CD3DX12_RESOURCE_BARRIER::UAV(outputBuffer);
+		m_commandList->ResourceBarrier(1, &barrier);
+		constants[0] = numElements;
+		constants[2] = k_primitiveHistogramShift;
+		setConstants();
+		m_commandList->SetPipelineState(m_primitivePipeline.m_histogramPipelineState.Get());
+		m_commandList->Dispatch(numPartitions, 1, 1);
+		outputSize = LearningWorkGraph::k_histogramBuckets * sizeof(uint32_t);
+		break;
+	}
+	case PrimitiveKind::Compact:
+		constants[1] = ++m_primitivePipeline.m_epoch;
+		constants[2] = k_primitiveCompactMask;
+		setConstants();
+		m_commandList->SetPipelineState(m_primitivePipeline.m_compactPipelineState.Get());
+		m_commandList->Dispatch(numPartitions, 1, 1);
+		break;
+	default:
+		break;
+	}
+	m_commandList->EndQuery(m_queryHeap.Get(), D3D12_QUERY_TYPE_TIMESTAMP, 1);
+
+	// Readback: timestamps at 0, the total of the scan or compaction at 16 and the output at k_ringAlignment.
+	auto* readbackBuffer = m_primitivePipeline.m_readbackBuffer.Get();
+	m_commandList->ResolveQueryData(m_queryHeap.Get(), D3D12_QUERY_TYPE_TIMESTAMP, 0, 2, readbackBuffer, 0);
+	{
+		auto barrier = CD3DX12_RESOURCE_BARRIER::Transition(outputBuffer, D3D12_RESOURCE_STATE_UNORDERED_ACCESS, D3D12_RESOURCE_STATE_COPY_SOURCE, 0);
+		m_commandList->ResourceBarrier(1, &barrier);
+	}
+	m_commandList->CopyBufferRegion(readbackBuffer, k_ringAlignment, outputBuffer, 0, outputSize);
+	if (primitive == PrimitiveKind::Scan || primitive == PrimitiveKind::Compact)
+	{
+		auto barrier = CD3DX12_RESOURCE_BARRIER::Transition(scratchBuffer, D3D12_RESOURCE_STATE_UNORDERED_ACCESS, D3D12_RESOURCE_STATE_COPY_SOURCE, 0);
+		m_commandList->ResourceBarrier(1, &barrier);
+		m_commandList->CopyBufferRegion(readbackBuffer, sizeof(uint64_t) * 2, scratchBuffer, sizeof(uint32_t), sizeof(uint32_t));
+	}
+	SubmitAndWaitForCommandList();
+
+	uint64_t gpuTimeFrequency = 0;
+	m_commandQueue->GetTimestampFrequency(&gpuTimeFrequency);
+	const uint64_t* timestamps = nullptr;
+	auto range = CD3DX12_RANGE(0, sizeof(uint64_t) * 2);
+	LWG_CHECK_HRESULT(readbackBuffer->Map(0, &range, (void**)&timestamps));
+	const auto gpuTime = (timestamps[1] - timestamps[0]) * 1000.0f / gpuTimeFrequency;
+	auto writtenRange = CD3DX12_RANGE(0, 0);
+	readbackBuffer->Unmap(0, &writtenRange);
+	return gpuTime;
+}
+
+void HelloWorkGraphApplication::RunPrimitives()
+{
+	// The input keys as 32-bit words, whatever their type.
+	const auto numElements = static_cast<uint32_t>(GetSortBufferSize() / sizeof(uint32_t));
+	const auto numPartitions = (numElements + k_primitivePartitionSize - 1) / k_primitivePartitionSize;
+	if (numPartitions > D3D12_CS_DISPATCH_MAX_THREAD_GROUPS_PER_DIMENSION)
+	{
+		printf("Primitives: at most %u words\n", D3D12_CS_DISPATCH_MAX_THREAD_GROUPS_PER_DIMENSION * k_primitivePartitionSize);
+		return;
+	}
+	auto values = std::vector<uint32_t>(numElements);
+	{
+		const uint32_t* initial = nullptr;
+		auto range = CD3DX12_RANGE(0, GetSortBufferSize());
+		LWG_CHECK_HRESULT(m_initialBuffer->Map(0, &range, (void**)&initial));
+		std::copy(initial, initial + numElements, values.begin());
+		auto writtenRange = CD3DX12_RANGE(0, 0);
+		m_initialBuffer->Unmap(0, &writtenRange);
+	}
+
+	auto expected = std::vector<uint32_t>(numElements);
+	constexpr const char* k_primitiveNames[] = { "Reduce", "Reduce (Work Graph)", "Scan", "Histogram", "Compact" };
+	static_assert(std::size(k_primitiveNames) == static_cast<size_t>(PrimitiveKind::Count));
+	for (uint32_t i = 0; i < static_cast<uint32_t>(PrimitiveKind::Count); ++i)
+	{
+		const auto primitive = static_cast<PrimitiveKind>(i);
+		if (primitive == PrimitiveKind::ReduceWorkGraph && !m_primitivePipeline.m_reduceStateObject)
+		{
+			continue;
+		}
+		const auto gpuTime = ExecutePrimitive(primitive, numElements);
+
+		// CPU reference.
+		auto numExpected = size_t(1);
+		auto expectedTotal = std::optional<uint32_t>();
+		const auto cpuBegin = std::chrono::high_resolution_clock::now();
+		switch (primitive)
+		{
+		case PrimitiveKind::Reduce:
+		case PrimitiveKind::ReduceWorkGraph:
+			expected[0] = LearningWorkGraph::ParallelReduce(values.data(), numElements);
+			break;
+		case PrimitiveKind::Scan:
+			expectedTotal = LearningWorkGraph::ParallelExclusiveScan(values.data(), numElements, expected.data());
+			numExpected = numElements;
+			break;
+		case PrimitiveKind::Histogram:
+		{
+			const auto histogram = LearningWorkGraph::ParallelHistogram(values.data(), numElements, k_primitiveHistogramShift);
+			std::copy(histogram.begin(), histogram.end(), expected.begin());
+			numExpected = histogram.size();
+			break;
+		}
+		case PrimitiveKind::Compact:
+			numExpected = LearningWorkGraph::ParallelCompact(values.data(), numElements, k_primitiveCompactMask, 0, expected.data());
+			expectedTotal = static_cast<uint32_t>(numExpected);
+			break;
+		default:
+			break;
+		}
+		const auto cpuEnd = std::chrono::high_resolution_clock::now();
+
+		const std::byte* readback = nullptr;
+		auto range = CD3DX12_RANGE(0, k_ringAlignment + numExpected * sizeof(uint32_t));
+		LWG_CHECK_HRESULT(m_primitivePipeline.m_readbackBuffer->Map(0, &range, (void**)&readback));
+		const auto* total = reinterpret_cast<const uint32_t*>(readback + sizeof(uint64_t) * 2);
+		const auto* output = reinterpret_cast<const uint32_t*>(readback + k_ringAlignment);
+		const auto isValid = (!expectedTotal || *total == *expectedTotal) && std::equal(expected.begin(), expected.begin() + numExpected, output);
+		auto writtenRange = CD3DX12_RANGE(0, 0);
+		m_primitivePipeline.m_readbackBuffer->Unmap(0, &writtenRange);
+
+		printf
+		(
+			"Primitive: %s, GPU Time: %fms, CPU Time: %fms, Validation: %s\n",
+			k_primitiveNames[i],
+			gpuTime,
+			std::chrono::duration<double, std::milli>(cpuEnd - cpuBegin).count(),
+			isValid ? "Passed" : "Failed"
+		);
+	}
+}
+
+void HelloWorkGraphApplication::RecordGroupBy()
+{
+	const auto numPartitions = (m_numSortElementsUnsafe + k_primitivePartitionSize - 1) / k_primitivePartitionSize;
+	auto* scratchBuffer = m_primitivePipeline.m_scratchBuffer.Get();
+	{
+		auto barrier = CD3DX12_RESOURCE_BARRIER::Transition(m_sortBuffer.Get(), D3D12_RESOURCE_STATE_UNORDERED_ACCESS, D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE, 0);
+		m_commandList->ResourceBarrier(1, &barrier);
+	}
+	m_commandList->SetComputeRootShaderResourceView(RootParameterSlotID::ShaderResourceView, m_sortBuffer->GetGPUVirtualAddress());
+	m_commandList->SetComputeRootUnorderedAccessView(RootParameterSlotID::UnorderedAccessView, m_primitivePipeline.m_outputBuffer->GetGPUVirtualAddress());
+	m_commandList->SetComputeRootUnorderedAccessView(RootParameterSlotID::ScratchUnorderedAccessView, scratchBuffer->GetGPUVirtualAddress());
+
+	// Matches PrimitiveConstantBuffer in Primitives.shader. The padding after m_numSortElementsUnsafe is not grouped.
+	uint32_t constants[4] = { m_numSortElementsUnsafe, ++m_primitivePipeline.m_epoch, 0, 0 };
+	m_commandList->SetComputeRoot32BitConstants(RootParameterSlotID::PassConstants, 4, constants, 0);
+	m_commandList->SetPipelineState(m_primitivePipeline.m_groupByHeadsPipelineState.Get());
+	m_commandList->Dispatch(numPartitions, 1, 1);
+	{
+		auto barrier = CD3DX12_RESOURCE_BARRIER::UAV(scratchBuffer);
+		m_commandList->ResourceBarrier(1, &barrier);
+	}
+	constants[2] = k_groupByFinalizeGroups;
+	m_commandList->SetComputeRoot32BitConstants(RootParameterSlotID::PassConstants, 4, constants, 0);
+	m_commandList->SetPipelineState(m_primitivePipeline.m_groupByFinalizePipelineState.Get());
+	m_commandList->Dispatch(k_groupByFinalizeGroups, 1, 1);
+	{
+		auto barrier = CD3DX12_RESOURCE_BARRIER::Transition(m_sortBuffer.Get(), D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE, D3D12_RESOURCE_STATE_UNORDERED_ACCESS, 0);
+		m_commandList->ResourceBarrier(1, &barrier);
+	}
+}
+
+void HelloWorkGraphApplication::ReadbackGroupBy(float gpuTime)
+{
+	auto* readbackBuffer = m_primitivePipeline.m_readbackBuffer.Get();
+	auto totals = std::array<uint32_t, 2>();
+	{
+		const std::byte* readback = nullptr;
+		auto range = CD3DX12_RANGE(sizeof(uint64_t) * 2, sizeof(uint64_t) * 2 + sizeof(totals));
+		LWG_CHECK_HRESULT(readbackBuffer->Map(0, &range, (void**)&readback));
+		memcpy(totals.data(), readback + sizeof(uint64_t) * 2, sizeof(totals));
+		auto writtenRange = CD3DX12_RANGE(0, 0);
+		readbackBuffer->Unmap(0, &writtenRange);
+	}
+	m_uploadRing.Retire(m_fenceValue);
+	m_readbackRing.Retire(m_fenceValue);
+
+	// The second copy reads exactly the rows of the groups.
+	const auto numGroups = (std::min)(totals[0], m_numSortElementsUnsafe);
+	const auto tableSize = static_cast<uint64_t>(numGroups) * sizeof(LearningWorkGraph::GroupByRow);
+	if (tableSize > 0)
+	{
+		auto* outputBuffer = m_primitivePipeline.m_outputBuffer.Get();
+		auto barrier = CD3DX12_RESOURCE_BARRIER::Transition(outputBuffer, D3D12_RESOURCE_STATE_UNORDERED_ACCESS, D3D12_RESOURCE_STATE_COPY_SOURCE, 0);
+		m_commandList->ResourceBarrier(1, &barrier);
+		m_commandList->CopyBufferRegion(readbackBuffer, k_ringAlignment, outputBuffer, 0, tableSize);
+		SubmitAndWaitForCommandList();
+	}
+
+	const std::byte* readback = nullptr;
+	auto range = CD3DX12_RANGE(k_ringAlignment, k_ringAlignment + tableSize);
+	LWG_CHECK_HRESULT(readbackBuffer->Map(0, &range, (void**)&readback));
+	const auto* groups = reinterpret_cast<const LearningWorkGraph::GroupByRow*>(readback + k_ringAlignment);
+	m_isValidationPassed = (numGroups == m_referenceGroups.size()) && std::equal(m_referenceGroups.begin(), m_referenceGroups.end(), groups);
+	auto writtenRange = CD3DX12_RANGE(0, 0);
+	readbackBuffer->Unmap(0, &writtenRange);
+
+	printf
+	(
+		"Group-By: %u groups, Readback: %llu bytes instead of %llu bytes of sorted keys\n",
+		numGroups,
+		static_cast<unsigned long long>(tableSize + sizeof(totals)),
+		static_cast<unsigned long long>(static_cast<uint64_t>(m_sortKeySize) * m_numSortElementsUnsafe)
+	);
+	PrintFrameStatus("GPU", gpuTime);
+}
+
+void HelloWorkGraphApplication::ExecuteCpuSort()
+{
+	LearningWorkGraph::ParallelForRanges(m_cpuInput.GetSize(), 1 << 16, [&](uint32_t, size_t begin, size_t end)
+	{
+		std::copy(m_cpuInput.GetData() + begin, m_cpuInput.GetData() + end, m_cpuOutput.GetData() + begin);
+	});
+	CaptureCommand({ LearningWorkGraph::FrameCaptureCommandType::CopyInput });
+
+	// The padding already sorts last, so only the keys before it are sorted.
+	const auto begin = std::chrono::high_resolution_clock::now();
+	LearningWorkGraph::VisitSortKeyType(m_sortKeyType, [&]<typename Key>(std::type_identity<Key>)
+	{
+		auto* keys = reinterpret_cast<Key*>(m_cpuOutput.GetData());
+		const auto sortStrategy = m_isTuning ? LearningWorkGraph::SortStrategy::FullSort : m_sortStrategy;
+		if (sortStrategy == LearningWorkGraph::SortStrategy::FullSort)
+		{
+			LearningWorkGraph::ParallelRadixSort(keys, m_numSortElementsUnsafe, reinterpret_cast<Key*>(m_cpuScratch.GetData()));
+		}
+		else
+		{
+			LearningWorkGraph::SortWithStrategy(sortStrategy, keys, m_numSortElementsUnsafe);
+		}
+	});
+	const auto end = std::chrono::high_resolution_clock::now();
+	const auto cpuTime = std::chrono::duration<float, std::milli>(end - begin).count();
+	CaptureCommand({ LearningWorkGraph::FrameCaptureCommandType::CpuSort, LearningWorkGraph::FrameCapturePipeline::BitonicSort, 0, { static_cast<uint32_t>(m_sortStrategy) } });
+
+	m_isValidationPassed = true;
+	ConsumeSortedKeys(m_cpuOutput.GetData(), 0, m_cpuOutput.GetSize());
+	m_lastGPUTime = cpuTime;
+	if (!m_isTuning)
+	{
+		PrintFrameStatus("CPU", cpuTime);
+	}
+}
+
+std::string HelloWorkGraphApplication::GetExecutableRelativePath(const char* fileName)
+{
+	// Tables kept between runs live next to the executable, whatever the working directory is.
+	char modulePath[MAX_PATH] = {};
+	const auto length = GetModuleFileNameA(nullptr, modulePath, MAX_PATH);
+	if (length == 0 || length == MAX_PATH)
+	{
+		return fileName;
+	}
+	return (std::filesystem::path(modulePath).parent_path() / fileName).string();
+}
+
+std::vector<HelloWorkGraphApplication::PipelineMode> HelloWorkGraphApplication::GetAvailablePipelineModes() const
+{
+	auto pipelineModes = std::vector<PipelineMode>{ PipelineMode::Cpu };
+	if (m_d3d12Device)
+	{
+		pipelineModes.push_back(PipelineMode::Compute);
+	}
+	if (m_isWorkGraphsSupported)
+	{
+		pipelineModes.push_back(PipelineMode::WorkGraph);
+	}
+	return pipelineModes;
+}
+
+void HelloWorkGraphApplication::SelectSplit()
+{
+	// Bitonic sort pads to a power of two, so only power of two GPU shares are worth their cost.
+	auto candidates = std::vector<size_t>();
+	for (uint32_t count = k_minSplitSortElements / 2; count <= m_numSortElements / 2; count *= 2)
+	{
+		candidates.push_back(count);
+	}
+	m_numActiveSortElements = static_cast<uint32_t>(m_splitBalancer.SelectDeviceCount(m_numSortElementsUnsafe, candidates));
+}
+
+void HelloWorkGraphApplication::SortSplitCpuShare()
+{
+	// The GPU share never reaches the padding, the CPU share ends before it.
+	const auto begin = std::chrono::high_resolution_clock::now();
+	LearningWorkGraph::VisitSortKeyType(m_sortKeyType, [&]<typename Key>(std::type_identity<Key>)
+	{
+		const auto* input = reinterpret_cast<const Key*>(m_cpuInput.GetData());
+		auto* keys = reinterpret_cast<Key*>(m_cpuOutput.GetData());
+		std::copy(input + m_numActiveSortElements, input + m_numSortElementsUnsafe, keys + m_numActiveSortElements);
+		LearningWorkGraph::ParallelRadixSort(keys + m_numActiveSortElements, m_numSortElementsUnsafe - m_numActiveSortElements, reinterpret_cast<Key*>(m_cpuScratch.GetData()));
+	});
+	const auto end = std::chrono::high_resolution_clock::now();
+	m_splitCpuTime = std::chrono::duration<double, std::milli>(end - begin).count();
+}
+
+void HelloWorkGraphApplication::MergeSplitSort(float gpuTime, double gpuWaitTime)
+{
+	// If the CPU had to wait, the GPU finished after the CPU share. Otherwise only the GPU timestamps tell when.
+	const auto gpuShareTime = (gpuWaitTime > 0.01) ? m_splitCpuTime + gpuWaitTime : static_cast<double>(gpuTime);
+	const auto numCpuKeys = m_numSortElementsUnsafe - m_numActiveSortElements;
+
+	const auto begin = std::chrono::high_resolution_clock::now();
+	LearningWorkGraph::VisitSortKeyType(m_sortKeyType, [&]<typename Key>(std::type_identity<Key>)
+	{
+		const auto* gpuKeys = reinterpret_cast<const Key*>(m_sortReadback.m_cpuAddress);
+		const auto* cpuKeys = reinterpret_cast<const Key*>(m_cpuOutput.GetData()) + m_numActiveSortElements;
+		auto* output = reinterpret_cast<Key*>(m_cpuScratch.GetData());
+		LearningWorkGraph::ParallelMerge(gpuKeys, m_numActiveSortElements, cpuKeys, numCpuKeys, output, [](Key a, Key b) { return LearningWorkGraph::ToOrderedBits(a) < LearningWorkGraph::ToOrderedBits(b); });
+	});
+	const auto end = std::chrono::high_resolution_clock::now();
+
+	m_isValidationPassed = true;
+	ConsumeSortedKeys(m_cpuScratch.GetData(), 0, static_cast<uint64_t>(m_sortKeySize) * m_numSortElementsUnsafe);
+	m_splitBalancer.Update(m_numActiveSortElements, gpuShareTime, numCpuKeys, m_splitCpuTime);
+	printf
+	(
+		"Split Sort: GPU %u keys in %fms, CPU %u keys in %fms, Merge: %fms, Next GPU Ratio: %.3f\n",
+		m_numActiveSortElements,
+		gpuShareTime,
+		numCpuKeys,
+		m_splitCpuTime,
+		std::chrono::duration<double, std::milli>(end - begin).count(),
+		m_splitBalancer.GetRatio()
+	);
+}
+
+void HelloWorkGraphApplication::CalibrateRouter()
+{
+	// Incremental frames depend on the previous frame of the same engine.
+	if (m_useIncrementalSort)
+	{
+		printf("Route: disabled with incremental sort\n");
+		m_useRouter = false;
+		return;
+	}
+
+	// Probes measure the wall time of whole frames at the current size, the table keeps the other sizes of earlier runs.
+	// They render the same frames as the routed ones, so that the predictions compare with the measured times.
+	constexpr uint32_t k_numProbes = 5;
+	m_router.Load(m_costTablePath);
+	const auto pipelineMode = m_pipelineMode;
+	for (const auto probedPipelineMode : GetAvailablePipelineModes())
+	{
+		m_pipelineMode = probedPipelineMode;
+		const auto time = LearningWorkGraph::MeasureMilliseconds(k_numProbes, [] {}, [this] { RenderFrame(); });
+		m_router.SetCost(GetAdapterName(), GetPipelineModeName(), m_numSortElementsUnsafe, time);
+		printf("Route: %s probe %fms\n", GetPipelineModeName(), time);
+	}
+	m_pipelineMode = pipelineMode;
+	LWG_CHECK_WITH_MESSAGE(m_router.Save(m_costTablePath), "Failed to save cost table.");
+}
+
+void HelloWorkGraphApplication::RunSortService()
+{
+	LearningWorkGraph::VisitSortKeyType(m_sortKeyType, [&]<typename Key>(std::type_identity<Key>)
+	{
+		if (m_pipelineMode == PipelineMode::Cpu)
+		{
+			auto backend = LearningWorkGraph::CpuSortBackend<Key>();
+			MeasureSortService<Key>(backend);
+		}
+		else
+		{
+			CreateSortBatchPipeline();
+			auto backend = D3D12SortBackend<Key>(*this);
+			MeasureSortService<Key>(backend);
+		}
+	});
+	RequestQuit();
+}
+
+// Latency and throughput over the batch window like BenchmarkSortService, with the engine of the pipeline mode as the backend.
+template<typename Key, typename Backend>
+void HelloWorkGraphApplication::MeasureSortService(Backend& backend)
+{
+	constexpr uint32_t k_numClients = 8;
+	const auto numKeysPerJob = static_cast<size_t>(m_numSortElementsUnsafe);
+	const auto numJobs = static_cast<size_t>(k_numClients) * m_numSortServiceJobs;
+	const auto* reference = reinterpret_cast<const Key*>(m_referenceOutput.data());
+	printf("Sort Service: %s, %u clients, %u jobs of %zu keys each\n", GetPipelineModeName(), k_numClients, m_numSortServiceJobs, numKeysPerJob);
+
+	// Every job sorts its own shuffle of the input keys.
+	auto source = std::vector<Key>(numKeysPerJob * numJobs);
+	auto randomEngine = std::mt19937();
+	for (size_t job = 0; job < numJobs; ++job)
+	{
+		auto* jobKeys = source.data() + job * numKeysPerJob;
+		std::copy(reference, reference + numKeysPerJob, jobKeys);
+		std::shuffle(jobKeys, jobKeys + numKeysPerJob, randomEngine);
+	}
+
+	// A negative window submits every job on its own, one submission and fence wait each.
+	m_isValidationPassed = true;
+	for (auto batchWindow : { -1, 0, 50, 200, 1000 })
+	{
+		auto keys = source;
+		auto latencies = std::vector<double>(numJobs);
+		auto options = LearningWorkGraph::SortServiceOptions();
+		options.m_batchWindow = std::chrono::microseconds((std::max)(batchWindow, 0));
+
+		auto runClients = [&](auto&& sort)
+		{
+			auto clients = std::vector<std::thread>();
+			for (uint32_t client = 0; client < k_numClients; ++client)
+			{
+				clients.emplace_back([&, client]
+				{
+					for (uint32_t job = 0; job < m_numSortServiceJobs; ++job)
+					{
+						const auto index = client * m_numSortServiceJobs + job;
+						const auto submitTime = std::chrono::high_resolution_clock::now();
+						sort(keys.data() + index * numKeysPerJob);
+						latencies[index] = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - submitTime).count();
+					}
+				});
+			}
+			for (auto& client : clients)
+			{
+				client.join();
+			}
+		};
+
+		const auto begin = std::chrono::high_resolution_clock::now();
+		auto numBatches = 0u;
+		if (batchWindow < 0)
+		{
+			auto mutex = std::mutex();
+			runClients([&](Key* jobKeys)
+			{
+				const auto lock = std::lock_guard(mutex);
+				backend.SortBatch({ { jobKeys, numKeysPerJob } });
+			});
+			numBatches = static_cast<uint32_t>(numJobs);
+		}
+		else
+		{
+			auto service = LearningWorkGraph::SortService<Key, Backend>(backend, options);
+			runClients([&](Key* jobKeys) { service.Submit(jobKeys, numKeysPerJob).wait(); });
+			numBatches = service.GetNumBatches();
+		}
+		const auto time = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - begin).count();
+
+		auto isValid = true;
+		for (size_t job = 0; job < numJobs; ++job)
+		{
+			isValid &= (memcmp(keys.data() + job * numKeysPerJob, reference, sizeof(Key) * numKeysPerJob) == 0);
+		}
+		m_isValidationPassed &= isValid;
+		std::sort(latencies.begin(), latencies.end());
+		printf
+		(
+			"  %-15s %5u batches, %5.1f jobs/batch, %8.0f jobs/s, latency mean %7.3fms p99 %7.3fms, Validation: %s\n",
+			(batchWindow < 0) ? "unbatched:" : ("window " + std::to_string(batchWindow) + "us:").c_str(),
+			numBatches,
+			static_cast<double>(numJobs) / numBatches,
+			numJobs / time * 1e3,
+			std::accumulate(latencies.begin(), latencies.end(), 0.0) / numJobs,
+			latencies[numJobs * 99 / 100],
+			isValid ? "Passed" : "Failed"
+		);
+	}
+}
+
+void HelloWorkGraphApplication::CreateSortBatchPipeline()
+{
+	auto& batch = m_sortBatchPipeline;
+	LWG_CHECK_HRESULT(m_d3d12Device->CreateCommandAllocator(D3D12_COMMAND_LIST_TYPE_DIRECT, IID_PPV_ARGS(&batch.m_commandAllocator)));
+	LWG_CHECK_HRESULT(m_d3d12Device->CreateCommandList(0, D3D12_COMMAND_LIST_TYPE_DIRECT, batch.m_commandAllocator.Get(), nullptr, IID_PPV_ARGS(&batch.m_commandList)));
+	LWG_CHECK_HRESULT(m_d3d12Device->CreateFence(0, D3D12_FENCE_FLAG_NONE, IID_PPV_ARGS(&batch.m_fence)));
+}
+
+std::byte* HelloWorkGraphApplication::PrepareSortBatch(const std::vector<SortBatchJob>& jobs, uint64_t sortBufferSize)
+{
+	// Grown to powers of two, so that batches of similar sizes keep the buffers.
+	auto& batch = m_sortBatchPipeline;
+	const auto constantsSize = static_cast<uint64_t>(sizeof(ApplicationConstantBuffer)) * jobs.size();
+	if (constantsSize > batch.m_constantsSize || sortBufferSize > batch.m_sortBufferSize)
+	{
+		batch.m_constantsSize = std::bit_ceil((std::max)(constantsSize, batch.m_constantsSize));
+		batch.m_sortBufferSize = std::bit_ceil((std::max)(sortBufferSize, batch.m_sortBufferSize));
+		batch.m_uploadBuffer = CreateBuffer(batch.m_constantsSize + batch.m_sortBufferSize, D3D12_RESOURCE_FLAG_NONE, D3D12_HEAP_TYPE_UPLOAD);
+		batch.m_uploadBuffer->SetName(L"sortBatchUploadBuffer");
+		batch.m_sortBuffer = CreateBuffer(batch.m_sortBufferSize, D3D12_RESOURCE_FLAG_ALLOW_UNORDERED_ACCESS, D3D12_HEAP_TYPE_DEFAULT);
+		batch.m_sortBuffer->SetName(L"sortBatchSortBuffer");
+		batch.m_readbackBuffer = CreateBuffer(batch.m_sortBufferSize, D3D12_RESOURCE_FLAG_NONE, D3D12_HEAP_TYPE_READBACK);
+		batch.m_readbackBuffer->SetName(L"sortBatchReadbackBuffer");
+
+		auto writeRange = CD3DX12_RANGE(0, 0);
+		LWG_CHECK_HRESULT(batch.m_uploadBuffer->Map(0, &writeRange, reinterpret_cast<void**>(&batch.m_uploadData)));
+		void* readbackData = nullptr;
+		LWG_CHECK_HRESULT(batch.m_readbackBuffer->Map(0, nullptr, &readbackData));
+		batch.m_readbackData = static_cast<const std::byte*>(readbackData);
+	}
+
+	auto* constants = reinterpret_cast<ApplicationConstantBuffer*>(batch.m_uploadData);
+	for (size_t i = 0; i < jobs.size(); ++i)
+	{
+		constants[i].m_numSortElements = jobs[i].m_numSortElements;
+		constants[i].m_numValidElements = jobs[i].m_numValidElements;
+		memset(constants[i].m_dummy, 0, sizeof(constants[i].m_dummy));
+	}
+	return batch.m_uploadData + batch.m_constantsSize;
+}
+
+const std::byte* HelloWorkGraphApplication::ExecuteSortBatch(const std::vector<SortBatchJob>& jobs, uint64_t sortBufferSize)
+{
+	auto& batch = m_sortBatchPipeline;
+	auto* commandList = batch.m_commandList.Get();
+	{
+		auto barrier = CD3DX12_RESOURCE_BARRIER::Transition(batch.m_sortBuffer.Get(), D3D12_RESOURCE_STATE_COMMON, D3D12_RESOURCE_STATE_COPY_DEST, 0);
+		commandList->ResourceBarrier(1, &barrier);
+	}
+	commandList->CopyBufferRegion(batch.m_sortBuffer.Get(), 0, batch.m_uploadBuffer.Get(), batch.m_constantsSize, sortBufferSize);
+	{
+		auto barrier = CD3DX12_RESOURCE_BARRIER::Transition(batch.m_sortBuffer.Get(), D3D12_RESOURCE_STATE_COPY_DEST, D3D12_RESOURCE_STATE_UNORDERED_ACCESS, 0);
+		commandList->ResourceBarrier(1, &barrier);
+	}
+
+	// Every job binds its constants and its range of the sort buffer.
+	commandList->SetComputeRootSignature(m_rootSignature.Get());
+	auto bindJob = [&](size_t i)
+	{
+		commandList->SetComputeRootConstantBufferView(RootParameterSlotID::ApplicationConstantBufferView, batch.m_uploadBuffer->GetGPUVirtualAddress() + sizeof(ApplicationConstantBuffer) * i);
+		commandList->SetComputeRootUnorderedAccessView(RootParameterSlotID::UnorderedAccessView, batch.m_sortBuffer->GetGPUVirtualAddress() + jobs[i].m_offset);
+	};
+
+	// The launcher graphs sort a job per graph dispatch. The recursive graph counts arrivals for one array, so it sorts with the passes.
+	if (m_pipelineMode == PipelineMode::WorkGraph && m_kernelVariant.m_topology != LearningWorkGraph::KernelTopology::Recursive)
+	{
+		const auto setProgramDesc = PrepareWorkGraph();
+		for (size_t i = 0; i < jobs.size(); ++i)
+		{
+			// The graphs share the backing memory.
+			if (i > 0)
+			{
+				auto barrier = CD3DX12_RESOURCE_BARRIER::UAV(nullptr);
+				commandList->ResourceBarrier(1, &barrier);
+			}
+			bindJob(i);
+			const auto dispatchGrid = m_kernelVariant.GetDispatchGrid(jobs[i].m_numSortElements);
+			D3D12_DISPATCH_GRAPH_DESC dispatchGraphDesc = {};
+			dispatchGraphDesc.Mode = D3D12_DISPATCH_MODE_NODE_CPU_INPUT;
+			dispatchGraphDesc.NodeCPUInput.EntrypointIndex = 0;
+			dispatchGraphDesc.NodeCPUInput.NumRecords = 1;
+			if (m_kernelVariant.m_topology == LearningWorkGraph::KernelTopology::LauncherMultiDispatchGrid)
+			{
+				dispatchGraphDesc.NodeCPUInput.pRecords = &dispatchGrid;
+				dispatchGraphDesc.NodeCPUInput.RecordStrideInBytes = sizeof(dispatchGrid);
+			}
+			commandList->SetProgram(&setProgramDesc);
+			commandList->DispatchGraph(&dispatchGraphDesc);
+		}
+	}
+	else
+	{
+		// The jobs go through the bitonic steps together, one UAV barrier per step covers all of them.
+		auto maxNumSortElements = 1u;
+		for (const auto& job : jobs)
+		{
+			maxNumSortElements = (std::max)(maxNumSortElements, job.m_numSortElements);
+		}
+		commandList->SetPipelineState(m_computePipeline.m_pipelineState.Get());
+		const auto log2n = static_cast<uint32_t>(std::bit_width(maxNumSortElements)) - 1;
+		for (uint32_t i = 0; i < log2n; ++i)
+		{
+			for (uint32_t j = 0; j < i + 1; ++j)
+			{
+				if (i > 0 || j > 0)
+				{
+					auto barrier = CD3DX12_RESOURCE_BARRIER::UAV(batch.m_sortBuffer.Get());
+					commandList->ResourceBarrier(1, &barrier);
+				}
+				PassConstantBuffer passConstantBuffer = { 1u << (i - j), 2u << i };
+				commandList->SetComputeRoot32BitConstants(RootParameterSlotID::PassConstants, sizeof(PassConstantBuffer) / sizeof(uint32_t), &passConstantBuffer, 0);
+				for (size_t k = 0; k < jobs.size(); ++k)
+				{
+					// Shorter jobs are sorted after fewer steps.
+					if ((2u << i) <= jobs[k].m_numSortElements)
+					{
+						bindJob(k);
+						commandList->Dispatch(m_kernelVariant.GetDispatchGrid(jobs[k].m_numSortElements), 1, 1);
+					}
+				}
+			}
+		}
+	}
+
+	{
+		auto barrier = CD3DX12_RESOURCE_BARRIER::Transition(batch.m_sortBuffer.Get(), D3D12_RESOURCE_STATE_UNORDERED_ACCESS, D3D12_RESOURCE_STATE_COPY_SOURCE, 0);
+		commandList->ResourceBarrier(1, &barrier);
+	}
+	commandList->CopyBufferRegion(batch.m_readbackBuffer.Get(), 0, batch.m_sortBuffer.Get(), 0, sortBufferSize);
+	{
+		auto barrier = CD3DX12_RESOURCE_BARRIER::Transition(batch.m_sortBuffer.Get(), D3D12_RESOURCE_STATE_COPY_SOURCE, D3D12_RESOURCE_STATE_COMMON, 0);
+		commandList->ResourceBarrier(1, &barrier);
+	}
+
+	// One Signal for the whole batch.
+	LWG_CHECK_HRESULT(commandList->Close());
+	ID3D12CommandList* commandLists[] = { commandList };
+	m_commandQueue->ExecuteCommandLists(1, commandLists);
+	LWG_CHECK_HRESULT(m_commandQueue->Signal(batch.m_fence.Get(), ++batch.m_fenceValue));
+
+	HANDLE batchFinished = CreateEventA(NULL, FALSE, FALSE, NULL);
+	LWG_CHECK(batchFinished);
+	batch.m_fence->SetEventOnCompletion(batch.m_fenceValue, batchFinished);
+	WaitForSingleObject(batchFinished, INFINITE);
+	LWG_CHECK(CloseHandle(batchFinished));
+	LWG_CHECK_HRESULT(batch.m_commandAllocator->Reset());
+	LWG_CHECK_HRESULT(commandList->Reset(batch.m_commandAllocator.Get(), nullptr));
+	return batch.m_readbackData;
+}
+
+void HelloWorkGraphApplication::RenderRoutedFrame()
+{
+	const auto pipelineModes = GetAvailablePipelineModes();
+	auto pipelineModeNames = std::vector<std::string_view>();
+	for (const auto pipelineMode : pipelineModes)
+	{
+		m_pipelineMode = pipelineMode;
+		pipelineModeNames.push_back(GetPipelineModeName());
+	}
+	const auto route = m_router.Route(GetAdapterName(), pipelineModeNames, m_numSortElementsUnsafe);
+	m_pipelineMode = pipelineModes[route.value_or(0)];
+	const auto predictedTime = m_router.Predict(GetAdapterName(), GetPipelineModeName(), m_numSortElementsUnsafe);
+
+	const auto begin = std::chrono::high_resolution_clock::now();
+	RenderFrame();
+	const auto end = std::chrono::high_resolution_clock::now();
+	const auto measuredTime = std::chrono::duration<double, std::milli>(end - begin).count();
+
+	m_router.Record(GetPipelineModeName(), predictedTime, measuredTime);
+	m_router.PrintMetrics();
+	printf("Route: %s, Predicted: %fms, Measured: %fms\n", GetPipelineModeName(), predictedTime, measuredTime);
+}
+
+void HelloWorkGraphApplication::UpdateIncrementalDelta()
+{
+	LearningWorkGraph::VisitSortKeyType(m_sortKeyType, [&]<typename Key>(std::type_identity<Key>)
+	{
+		// One random key per stride is replaced, so the deletes are distinct occurrences of keys in the sorted buffer.
+		const auto* keys = reinterpret_cast<const Key*>(m_referenceOutput.data());
+		const auto stride = m_numSortElementsUnsafe / m_numDeltaKeys;
+		auto random = std::uniform_int_distribution<uint32_t>(0, stride - 1);
+		auto newKeys = std::vector<Key>(m_numDeltaKeys);
+		LearningWorkGraph::GenerateSortKeys(m_deltaRandomEngine, m_numSortElementsUnsafe, newKeys.data(), newKeys.size());
+		auto delta = LearningWorkGraph::SortDelta<Key>();
+		for (uint32_t i = 0; i < m_numDeltaKeys; ++i)
+		{
+			delta.AddUpdate(keys[i * stride + random(m_deltaRandomEngine)], newKeys[i]);
+		}
+		delta.Sort();
+
+		const auto allocation = m_uploadRing.Allocate(sizeof(Key) * m_numDeltaKeys * 2, k_ringAlignment);
+		auto* buffer = reinterpret_cast<Key*>(allocation.m_cpuAddress);
+		std::copy(delta.m_deletes.begin(), delta.m_deletes.end(), buffer);
+		std::copy(delta.m_inserts.begin(), delta.m_inserts.end(), buffer + m_numDeltaKeys);
+		m_deltaAddress = allocation.m_gpuAddress;
+
+		// Expected output for validation.
+		auto updated = std::vector<Key>();
+		LearningWorkGraph::ApplySortDelta(keys, m_numSortElementsUnsafe, delta, updated);
+		memcpy(m_referenceOutput.data(), updated.data(), m_referenceOutput.size());
+	});
+}
+
+void HelloWorkGraphApplication::ExecuteIncrementalSort()
+{
+	// Two passes, so both pipeline modes use the compute shaders.
+	PassConstantBuffer passConstantBuffer = { 0, 0, m_numDeltaKeys, m_numDeltaKeys };
+	m_commandList->SetComputeRoot32BitConstants(RootParameterSlotID::PassConstants, sizeof(PassConstantBuffer) / sizeof(uint32_t), &passConstantBuffer, 0);
+
+	m_commandList->SetPipelineState(m_computePipeline.m_deltaRemovePipelineState.Get());
+	m_commandList->Dispatch((m_numSortElements + m_kernelVariant.m_threadsPerGroup - 1) / m_kernelVariant.m_threadsPerGroup, 1, 1);
+
+	auto barrier = CD3DX12_RESOURCE_BARRIER::UAV(nullptr);
+	m_commandList->ResourceBarrier(1, &barrier);
+
+	const auto numMergeThreads = (m_numSortElements + k_mergeElementsPerThread - 1) / k_mergeElementsPerThread;
+	m_commandList->SetPipelineState(m_computePipeline.m_mergePathPipelineState.Get());
+	m_commandList->Dispatch((numMergeThreads + m_kernelVariant.m_threadsPerGroup - 1) / m_kernelVariant.m_threadsPerGroup, 1, 1);
+}
+
+void HelloWorkGraphApplication::ExecuteRunMerge()
+{
+	// Each pass halves the runs, an odd number of passes ends in the scratch buffer and copies back with one more.
+	const auto numMergeThreads = (m_numSortElements + k_mergeElementsPerThread - 1) / k_mergeElementsPerThread;
+	m_commandList->SetPipelineState(m_computePipeline.m_runMergePipelineState.Get());
+	auto isInScratch = false;
+	for (uint32_t runsPerInput = 1; runsPerInput < m_numRuns || isInScratch; runsPerInput *= 2)
+	{
+		if (runsPerInput > 1)
+		{
+			auto barrier = CD3DX12_RESOURCE_BARRIER::UAV(nullptr);
+			m_commandList->ResourceBarrier(1, &barrier);
+		}
+		PassConstantBuffer passConstantBuffer = { runsPerInput, isInScratch ? 1u : 0u, 0, 0 };
+		m_commandList->SetComputeRoot32BitConstants(RootParameterSlotID::PassConstants, sizeof(PassConstantBuffer) / sizeof(uint32_t), &passConstantBuffer, 0);
+		m_commandList->Dispatch((numMergeThreads + m_kernelVariant.m_threadsPerGroup - 1) / m_kernelVariant.m_threadsPerGroup, 1, 1);
+		isInScratch = !isInScratch;
+	}
 }
 
 void HelloWorkGraphApplication::OnUpdate()
 {
+	if (IsIncrementalFrame())
+	{
+		UpdateIncrementalDelta();
+	}
+
+	if (m_pipelineMode == PipelineMode::Cpu)
+	{
+		return;
+	}
+
 	if (GetKeyState(VK_F1) & 0x8000)
 	{
 		m_pipelineMode = PipelineMode::Compute;
 	}
-	else if (GetKeyState(VK_F2) & 0x8000)
+	else if ((GetKeyState(VK_F2) & 0x8000) && m_isWorkGraphsSupported)
 	{
 		m_pipelineMode = PipelineMode::WorkGraph;
 	}
@@ -539,22 +2633,215 @@ void HelloWorkGraphApplication::OnUpdate()
 
 void HelloWorkGraphApplication::OnRender()
 {
+	if (m_useRouter)
+	{
+		RenderRoutedFrame();
+	}
+	else
+	{
+		RenderFrame();
+	}
+	RecordFrameTime();
+}
+
+void HelloWorkGraphApplication::RecordFrameTime()
+{
+	if (m_numFrames == 0)
+	{
+		return;
+	}
+	m_frameTimes.push_back(m_lastGPUTime);
+	if (m_frameTimes.size() < m_numFrames)
+	{
+		return;
+	}
+
+	if (!m_resultsPath.empty())
+	{
+		auto result = LearningWorkGraph::BenchmarkResult();
+		result.m_commit = m_commit;
+		result.m_device = GetDeviceName();
+		result.m_mode = m_useRouter ? "Routed" : GetPipelineModeName();
+		// Replays are compared with the CPU replays of --replay-backend=cpu.
+		if (m_replayCapture.IsOpen())
+		{
+			result.m_mode = "Replay " + result.m_mode;
+		}
+		result.m_algorithm = std::string(LearningWorkGraph::GetSortStrategyName(m_sortStrategy)) + " " + std::string(LearningWorkGraph::GetSortKeyName(m_sortKeyType));
+		if (m_pipelineMode != PipelineMode::Cpu)
+		{
+			result.m_algorithm += " " + m_kernelVariant.ToString();
+		}
+		result.m_distribution = m_replayCapture.IsOpen() ? "capture" : LearningWorkGraph::GetKeyDistributionName(m_keyDistribution);
+		result.m_size = m_numSortElementsUnsafe;
+		result.m_samples = m_frameTimes;
+		LWG_CHECK_WITH_MESSAGE(LearningWorkGraph::ResultsStore::Append(m_resultsPath, result), "Cannot append to the results file.");
+		printf("Results: %u frames appended to %s\n", m_numFrames, m_resultsPath.c_str());
+	}
+	RequestQuit();
+}
+
+void HelloWorkGraphApplication::RenderFrame()
+{
+	BeginFrameCapture();
+	if (m_pipelineMode == PipelineMode::Cpu)
+	{
+		ExecuteCpuSort();
+		EndFrameCapture();
+		return;
+	}
+
+	// Kernel tuning sorts the whole buffer on the GPU.
+	if (IsSplitFrame())
+	{
+		SelectSplit();
+	}
+	else
+	{
+		m_numActiveSortElements = m_numSortElements;
+	}
+
 	PreExecute();
 
-	if (m_pipelineMode == PipelineMode::Compute)
+	// Kernel tuning always measures the full sort.
+	const auto sortStrategy = m_isTuning ? LearningWorkGraph::SortStrategy::FullSort : m_sortStrategy;
+	if (IsIncrementalFrame())
+	{
+		ExecuteIncrementalSort();
+	}
+	else if (sortStrategy == LearningWorkGraph::SortStrategy::Reverse)
 	{
-		ExecuteComputeShader();
+		ExecuteReverse();
 	}
-	else if (m_pipelineMode == PipelineMode::WorkGraph)
+	else if (sortStrategy == LearningWorkGraph::SortStrategy::RunMerge)
 	{
-		ExecuteWorkGraph();
+		ExecuteRunMerge();
+	}
+	else if (sortStrategy == LearningWorkGraph::SortStrategy::FullSort)
+	{
+		if (m_pipelineMode == PipelineMode::Compute)
+		{
+			ExecuteComputeShader();
+		}
+		else if (m_pipelineMode == PipelineMode::WorkGraph)
+		{
+			ExecuteWorkGraph();
+		}
 	}
 
 	PostExecute();
+	EndFrameCapture();
+
+	m_hasSortedState = m_useIncrementalSort && !m_isTuning;
+}
+
+void HelloWorkGraphApplication::OpenReplayCapture()
+{
+	LWG_CHECK_WITH_MESSAGE(m_replayCapture.Open(m_replayPath), "Cannot open the frame capture.");
+	m_replayCapture.Print();
+
+	// The capture decides what the frame depends on, the options that change the frame are off.
+	const auto& info = m_replayCapture.GetInfo();
+	m_pipelineMode = static_cast<PipelineMode>(info.m_mode);
+	m_sortKeyType = info.m_sortKeyType;
+	m_sortStrategy = info.m_sortStrategy;
+	m_numSortElementsUnsafe = info.m_numValidElements;
+	m_useAdaptiveSort = false;
+	m_useIncrementalSort = false;
+	m_useSplitSort = false;
+	m_useRouter = false;
+	m_useNarrowKeys = false;
+	m_groupByCardinality = 0;
+	m_tuneKernels = false;
+	m_capturePath.clear();
+	if (m_numFrames == 0)
+	{
+		m_numFrames = LearningWorkGraph::k_defaultReplayIterations;
+	}
+}
+
+void HelloWorkGraphApplication::SetShaderHash(LearningWorkGraph::FrameCapturePipeline pipeline, const LearningWorkGraph::Shader* shader)
+{
+	m_shaderHashes[static_cast<size_t>(pipeline)] = shader ? LearningWorkGraph::HashBytes(shader->GetData(), shader->GetSize()) : 0;
+}
+
+void HelloWorkGraphApplication::CaptureCommand(const LearningWorkGraph::FrameCaptureCommand& command)
+{
+	if (m_isCapturingFrame)
+	{
+		m_frameCapture.m_commands.push_back(command);
+	}
+}
+
+void HelloWorkGraphApplication::BeginFrameCapture()
+{
+	// Frames of the kernel tuning are not counted.
+	if (m_isTuning)
+	{
+		return;
+	}
+	const auto frameIndex = m_numRenderedFrames++;
+	// A replay records its first frame to compare it with the capture.
+	m_isCapturingFrame = (!m_capturePath.empty() && frameIndex == m_captureFrameIndex) || (m_replayCapture.IsOpen() && frameIndex == 0);
+	if (m_isCapturingFrame)
+	{
+		m_frameCapture.m_info.m_frameIndex = frameIndex;
+		m_frameCapture.m_constants.clear();
+		m_frameCapture.m_commands.clear();
+	}
+}
+
+void HelloWorkGraphApplication::EndFrameCapture()
+{
+	if (!m_isCapturingFrame)
+	{
+		return;
+	}
+	m_isCapturingFrame = false;
+
+	if (m_replayCapture.IsOpen())
+	{
+		// Shaders differ after a change of the shader source or the compiler, the commands after a change of the application.
+		const auto& info = m_replayCapture.GetInfo();
+		for (size_t pipeline = 0; pipeline < m_shaderHashes.size(); ++pipeline)
+		{
+			if (m_shaderHashes[pipeline] != info.m_shaderHashes[pipeline])
+			{
+				printf("Replay: %s differs from the capture\n", LearningWorkGraph::GetFrameCapturePipelineName(static_cast<LearningWorkGraph::FrameCapturePipeline>(pipeline)).data());
+			}
+		}
+		const auto isCommandsMatched = std::ranges::equal(m_replayCapture.GetCommands(), m_frameCapture.m_commands);
+		printf("Replay: %zu commands, Commands: %s, Validation: %s\n", m_frameCapture.m_commands.size(), isCommandsMatched ? "Matched" : "Mismatched", m_isValidationPassed ? "Passed" : "Failed");
+		return;
+	}
+
+	auto& info = m_frameCapture.m_info;
+	info.m_shaderHashes = m_shaderHashes;
+	info.m_outputHash = LearningWorkGraph::HashBytes(m_referenceOutput.data(), m_referenceOutput.size());
+	info.m_device = {};
+	GetDeviceName().copy(info.m_device.data(), info.m_device.size() - 1);
+	info.m_mode = static_cast<LearningWorkGraph::FrameCaptureMode>(m_pipelineMode);
+	info.m_sortKeyType = m_sortKeyType;
+	info.m_sortStrategy = m_sortStrategy;
+	info.m_numSortElements = m_numSortElements;
+	info.m_numValidElements = m_numSortElementsUnsafe;
+	info.m_kernelVariant = m_kernelVariant;
+	info.m_isValidationPassed = m_isValidationPassed ? 1 : 0;
+	LWG_CHECK_WITH_MESSAGE(LearningWorkGraph::WriteFrameCapture(m_capturePath, m_frameCapture), "Cannot write the frame capture.");
+	printf("Frame Capture: frame %u written to %s\n", info.m_frameIndex, m_capturePath.c_str());
+
+	// Only one frame is captured, the kept input is released.
+	m_frameCapture = {};
+	m_capturePath.clear();
 }
 
 int main(int argc, const char** argv)
 {
+	if (const auto exitCode = LearningWorkGraph::RunCpuCommandLine(argc, argv))
+	{
+		return *exitCode;
+	}
+
 	LearningWorkGraph::FrameworkDesc frameworkDesc = {};
 	frameworkDesc.m_useWindow = false;
 
@@ -0,0 +1,204 @@
+﻿#include "HostMemory.h"
+#include "Parallel.h"
+
+#include <algorithm>
+#include <utility>
+
+#if defined(_WIN32)
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+namespace LearningWorkGraph
+{
+namespace
+{
+constexpr const char* k_placementNames[] = { "Default", "FirstTouch", "Interleave" };
+static_assert(std::size(k_placementNames) == static_cast<size_t>(HostPagePlacement::Count));
+
+// Huge page size of x64 on both systems.
+constexpr size_t k_hugePageSize = 2 << 20;
+// Interleaving granularity where pages can only be placed per commit, and the stride of the first touch.
+constexpr size_t k_pageSize = 4 << 10;
+
+size_t AlignSize(size_t size, size_t alignment)
+{
+	return (size + alignment - 1) / alignment * alignment;
+}
+
+// Writes one byte per page from the worker whose range of ParallelForRanges covers the page, pinned to its CPU.
+void TouchPages(std::byte* data, size_t size)
+{
+	ParallelForRanges(size / k_pageSize, 1, [&](uint32_t rangeIndex, size_t begin, size_t end)
+	{
+		auto affinity = ScopedWorkerAffinity(rangeIndex, true);
+		for (auto page = begin; page < end; ++page)
+		{
+			data[page * k_pageSize] = std::byte(0);
+		}
+	});
+}
+
+#if defined(_WIN32)
+std::byte* MapPages(size_t size, const HostMemoryOptions& options, size_t& mappedSize, bool& hasHugePages)
+{
+	// Large pages need SeLockMemoryPrivilege and are committed at once, so they are placed on the node of the calling thread.
+	if (options.m_useHugePages && GetLargePageMinimum() > 0)
+	{
+		mappedSize = AlignSize(size, GetLargePageMinimum());
+		if (auto* data = VirtualAlloc(nullptr, mappedSize, MEM_RESERVE | MEM_COMMIT | MEM_LARGE_PAGES, PAGE_READWRITE))
+		{
+			hasHugePages = true;
+			return static_cast<std::byte*>(data);
+		}
+	}
+
+	mappedSize = AlignSize(size, k_hugePageSize);
+	const auto numNodes = NumaTopology::Get().GetNumNodes();
+	if (options.m_placement != HostPagePlacement::Interleave || numNodes == 1)
+	{
+		return static_cast<std::byte*>(VirtualAlloc(nullptr, mappedSize, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE));
+	}
+
+	// Commits k_hugePageSize chunks with a preferred node each.
+	auto* data = static_cast<std::byte*>(VirtualAlloc(nullptr, mappedSize, MEM_RESERVE, PAGE_READWRITE));
+	if (data == nullptr)
+	{
+		return nullptr;
+	}
+	const auto& nodes = NumaTopology::Get().m_nodeNumbers;
+	for (size_t offset = 0; offset < mappedSize; offset += k_hugePageSize)
+	{
+		if (!VirtualAllocExNuma(GetCurrentProcess(), data + offset, k_hugePageSize, MEM_COMMIT, PAGE_READWRITE, nodes[offset / k_hugePageSize % numNodes]))
+		{
+			VirtualFree(data, 0, MEM_RELEASE);
+			return nullptr;
+		}
+	}
+	return data;
+}
+
+void UnmapPages(std::byte* data, size_t)
+{
+	VirtualFree(data, 0, MEM_RELEASE);
+}
+#else
+// From linux/mempolicy.h, without depending on libnuma.
+constexpr int k_mpolInterleave = 3;
+
+std::byte* MapPages(size_t size, const HostMemoryOptions& options, size_t& mappedSize, bool& hasHugePages)
+{
+	mappedSize = AlignSize(size, k_hugePageSize);
+	if (options.m_useHugePages)
+	{
+		// Explicit huge pages only exist if the administrator reserved them.
+		auto* data = mmap(nullptr, mappedSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+		if (data != MAP_FAILED)
+		{
+			hasHugePages = true;
+			return static_cast<std::byte*>(data);
+		}
+	}
+
+	// Aligned to the huge page size, so transparent huge pages can back the whole buffer.
+	auto* reserved = mmap(nullptr, mappedSize + k_hugePageSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (reserved == MAP_FAILED)
+	{
+		return nullptr;
+	}
+	auto* begin = static_cast<std::byte*>(reserved);
+	auto* data = reinterpret_cast<std::byte*>(AlignSize(reinterpret_cast<uintptr_t>(begin), k_hugePageSize));
+	if (data > begin)
+	{
+		munmap(begin, data - begin);
+	}
+	munmap(data + mappedSize, begin + mappedSize + k_hugePageSize - data - mappedSize);
+	if (options.m_useHugePages)
+	{
+		hasHugePages = madvise(data, mappedSize, MADV_HUGEPAGE) == 0;
+	}
+
+	const auto numNodes = NumaTopology::Get().GetNumNodes();
+	if (options.m_placement == HostPagePlacement::Interleave && numNodes > 1)
+	{
+		// The nodes that have CPUs, the policy applies to the pages on their first touch.
+		unsigned long nodeMask = 0;
+		for (const auto node : NumaTopology::Get().m_nodeNumbers)
+		{
+			nodeMask |= (node < 64) ? 1ul << node : 0;
+		}
+		syscall(SYS_mbind, data, mappedSize, k_mpolInterleave, &nodeMask, 65ul, 0u);
+	}
+	return data;
+}
+
+void UnmapPages(std::byte* data, size_t mappedSize)
+{
+	munmap(data, mappedSize);
+}
+#endif
+}
+
+std::string_view GetHostPagePlacementName(HostPagePlacement placement)
+{
+	return k_placementNames[static_cast<uint32_t>(placement)];
+}
+
+HostBuffer::HostBuffer(HostBuffer&& other) noexcept
+	: m_data(std::exchange(other.m_data, nullptr))
+	, m_size(std::exchange(other.m_size, 0))
+	, m_mappedSize(std::exchange(other.m_mappedSize, 0))
+	, m_hasHugePages(std::exchange(other.m_hasHugePages, false))
+{
+}
+
+HostBuffer& HostBuffer::operator=(HostBuffer&& other) noexcept
+{
+	if (this != &other)
+	{
+		Release();
+		m_data = std::exchange(other.m_data, nullptr);
+		m_size = std::exchange(other.m_size, 0);
+		m_mappedSize = std::exchange(other.m_mappedSize, 0);
+		m_hasHugePages = std::exchange(other.m_hasHugePages, false);
+	}
+	return *this;
+}
+
+bool HostBuffer::Allocate(size_t size, const HostMemoryOptions& options)
+{
+	Release();
+	if (size == 0)
+	{
+		return true;
+	}
+	m_data = MapPages(size, options, m_mappedSize, m_hasHugePages);
+	if (m_data == nullptr)
+	{
+		m_mappedSize = 0;
+		m_hasHugePages = false;
+		return false;
+	}
+	m_size = size;
+	if (options.m_placement == HostPagePlacement::FirstTouch)
+	{
+		TouchPages(m_data, m_mappedSize);
+	}
+	return true;
+}
+
+void HostBuffer::Release()
+{
+	if (m_data)
+	{
+		UnmapPages(m_data, m_mappedSize);
+	}
+	m_data = nullptr;
+	m_size = 0;
+	m_mappedSize = 0;
+	m_hasHugePages = false;
+}
+}
\ No newline at end of file
@@ -0,0 +1,55 @@
+﻿#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+
+namespace LearningWorkGraph
+{
+enum class HostPagePlacement : uint32_t
+{
+	Default = 0,		// Wherever the first thread to write a page runs, usually the thread that fills the buffer.
+	FirstTouch,			// Pages are touched by pinned workers in the ranges of ParallelForRanges, so each range is local to its worker.
+	Interleave,			// Pages round robin over the NUMA nodes, for buffers that every worker reads all of.
+	Count
+};
+
+std::string_view GetHostPagePlacementName(HostPagePlacement placement);
+
+struct HostMemoryOptions
+{
+	// Explicit huge pages if the system has them, transparent huge pages otherwise.
+	bool m_useHugePages = false;
+	HostPagePlacement m_placement = HostPagePlacement::Default;
+};
+
+// Page-aligned host buffer for the keys of CPU-side sort, validation and data generation passes, mapped directly from the OS
+// so that its page size and NUMA placement can be chosen. The contents are zero after Allocate.
+class HostBuffer
+{
+public:
+	HostBuffer() = default;
+	~HostBuffer() { Release(); }
+	HostBuffer(HostBuffer&& other) noexcept;
+	HostBuffer& operator=(HostBuffer&& other) noexcept;
+	HostBuffer(const HostBuffer&) = delete;
+	HostBuffer& operator=(const HostBuffer&) = delete;
+
+	// Returns false if the pages could not be mapped, the buffer is empty then.
+	bool Allocate(size_t size, const HostMemoryOptions& options);
+	void Release();
+
+	std::byte* GetData() { return m_data; }
+	const std::byte* GetData() const { return m_data; }
+	size_t GetSize() const { return m_size; }
+	bool IsEmpty() const { return m_size == 0; }
+	// Whether the pages are huge pages, or advised to become ones for transparent huge pages.
+	bool HasHugePages() const { return m_hasHugePages; }
+
+private:
+	std::byte* m_data = nullptr;
+	size_t m_size = 0;
+	size_t m_mappedSize = 0;
+	bool m_hasHugePages = false;
+};
+}
\ No newline at end of file
@@ -0,0 +1,74 @@
+﻿#pragma once
+
+#include "MergePath.h"
+#include "Parallel.h"
+#include "SortKey.h"
+
+#include <algorithm>
+#include <vector>
+
+namespace LearningWorkGraph
+{
+// Changes to an already sorted array. An update is a delete of the old key and an insert of the new one.
+template<typename Key>
+struct SortDelta
+{
+	// Every delete must match a key in the sorted array. The k-th delete of a key removes its k-th occurrence.
+	std::vector<Key> m_deletes;
+	std::vector<Key> m_inserts;
+
+	void AddUpdate(Key oldKey, Key newKey)
+	{
+		m_deletes.push_back(oldKey);
+		m_inserts.push_back(newKey);
+	}
+
+	// Only the delta is sorted, O(d log d).
+	void Sort()
+	{
+		ReferenceSort(m_deletes.data(), m_deletes.size());
+		ReferenceSort(m_inserts.data(), m_inserts.size());
+	}
+};
+
+// Removes the sorted deletes from the sorted keys into output (count - numDeletes keys).
+// Each worker finds how many deletes precede its range by binary search, like DeltaRemoveCSMain, then walks the range.
+template<typename Key>
+void RemoveSortedKeys(const Key* keys, size_t count, const Key* deletes, size_t numDeletes, Key* output)
+{
+	auto less = [](Key a, Key b) { return ToOrderedBits(a) < ToOrderedBits(b); };
+	ParallelForRanges(count, 1 << 16, [&](uint32_t, size_t begin, size_t end)
+	{
+		if (begin == end)
+		{
+			return;
+		}
+		const auto key = keys[begin];
+		const auto occurrence = static_cast<size_t>(keys + begin - std::lower_bound(keys, keys + begin, key, less));
+		const auto firstDelete = std::lower_bound(deletes, deletes + numDeletes, key, less);
+		const auto numKeyDeletes = static_cast<size_t>(std::upper_bound(firstDelete, deletes + numDeletes, key, less) - firstDelete);
+		auto deleteIndex = static_cast<size_t>(firstDelete - deletes) + (std::min)(occurrence, numKeyDeletes);
+		for (size_t i = begin; i < end; ++i)
+		{
+			if (deleteIndex < numDeletes && ToOrderedBits(deletes[deleteIndex]) == ToOrderedBits(keys[i]))
+			{
+				++deleteIndex;
+				continue;
+			}
+			output[i - deleteIndex] = keys[i];
+		}
+	});
+}
+
+// CPU implementation of the incremental sort: remove the deletes, then merge the inserts with a parallel merge path.
+// O(d log d + d log n + n) instead of O(n log n) for a full sort. delta must be sorted.
+template<typename Key>
+void ApplySortDelta(const Key* keys, size_t count, const SortDelta<Key>& delta, std::vector<Key>& output)
+{
+	auto less = [](Key a, Key b) { return ToOrderedBits(a) < ToOrderedBits(b); };
+	auto remaining = std::vector<Key>(count - delta.m_deletes.size());
+	RemoveSortedKeys(keys, count, delta.m_deletes.data(), delta.m_deletes.size(), remaining.data());
+	output.resize(remaining.size() + delta.m_inserts.size());
+	ParallelMerge(remaining.data(), remaining.size(), delta.m_inserts.data(), delta.m_inserts.size(), output.data(), less);
+}
+}
\ No newline at end of file
@@ -0,0 +1,225 @@
+﻿#include "KernelTuner.h"
+
+#include <algorithm>
+#include <bit>
+#include <charconv>
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+
+namespace LearningWorkGraph
+{
+static constexpr const char* k_topologyNames[] = { "Launcher", "LauncherMultiDispatchGrid", "Recursive" };
+static_assert(std::size(k_topologyNames) == static_cast<size_t>(KernelTopology::Count));
+
+// The whole text is the number, tables may be corrupt or edited by hand.
+template<typename T>
+static bool ParseNumber(std::string_view text, T& value)
+{
+	const auto* end = text.data() + text.size();
+	const auto result = std::from_chars(text.data(), end, value);
+	return result.ec == std::errc() && result.ptr == end;
+}
+
+bool KernelVariant::IsValid() const
+{
+	return std::has_single_bit(m_threadsPerGroup) && m_threadsPerGroup <= 1024
+		&& std::has_single_bit(m_elementsPerThread) && m_elementsPerThread <= 1024
+		&& m_topology < KernelTopology::Count;
+}
+
+uint32_t KernelVariant::GetDispatchGrid(uint32_t numSortElements) const
+{
+	return (std::max)(1u, numSortElements / 2 / (m_threadsPerGroup * m_elementsPerThread));
+}
+
+std::string KernelVariant::ToString() const
+{
+	char text[128] = {};
+	std::snprintf(text, sizeof(text), "threads=%u,elements=%u,topology=%s", m_threadsPerGroup, m_elementsPerThread, k_topologyNames[static_cast<uint32_t>(m_topology)]);
+	return text;
+}
+
+std::optional<KernelVariant> KernelVariant::FromString(std::string_view text)
+{
+	auto variant = KernelVariant();
+	auto stream = std::istringstream(std::string(text));
+	auto field = std::string();
+	while (std::getline(stream, field, ','))
+	{
+		const auto s = field.find_first_of('=');
+		if (s == std::string::npos)
+		{
+			return std::nullopt;
+		}
+		const auto key = field.substr(0, s);
+		const auto value = field.substr(s + 1);
+		if (key == "threads")
+		{
+			if (!ParseNumber(value, variant.m_threadsPerGroup))
+			{
+				return std::nullopt;
+			}
+		}
+		else if (key == "elements")
+		{
+			if (!ParseNumber(value, variant.m_elementsPerThread))
+			{
+				return std::nullopt;
+			}
+		}
+		else if (key == "topology")
+		{
+			const auto found = std::find(std::begin(k_topologyNames), std::end(k_topologyNames), value);
+			if (found == std::end(k_topologyNames))
+			{
+				return std::nullopt;
+			}
+			variant.m_topology = static_cast<KernelTopology>(found - std::begin(k_topologyNames));
+		}
+	}
+	if (!variant.IsValid())
+	{
+		return std::nullopt;
+	}
+	return variant;
+}
+
+std::vector<KernelVariant> KernelTuner::EnumerateVariants(bool includeTopologies, uint32_t numSortElements)
+{
+	auto variants = std::vector<KernelVariant>();
+	const uint32_t numTopologies = includeTopologies ? static_cast<uint32_t>(KernelTopology::Count) : 1;
+	for (uint32_t topology = 0; topology < numTopologies; ++topology)
+	{
+		for (uint32_t threadsPerGroup = 64; threadsPerGroup <= 1024; threadsPerGroup *= 2)
+		{
+			for (uint32_t elementsPerThread = 1; elementsPerThread <= 4; elementsPerThread *= 2)
+			{
+				// The recursive nodes sort two keys per thread in their leaves regardless of elementsPerThread.
+				if (static_cast<KernelTopology>(topology) == KernelTopology::Recursive && elementsPerThread > 1)
+				{
+					continue;
+				}
+				const auto variant = KernelVariant{ threadsPerGroup, elementsPerThread, static_cast<KernelTopology>(topology) };
+				if (variant.IsDispatchable(numSortElements))
+				{
+					variants.push_back(variant);
+				}
+			}
+		}
+	}
+	return variants;
+}
+
+uint32_t KernelTuner::GetSizeBucket(uint32_t numSortElements)
+{
+	return std::bit_width(std::bit_ceil(numSortElements)) - 1;
+}
+
+const KernelVariant& KernelTuner::Tune(std::string_view device, std::string_view pipelineMode, uint32_t numSortElements, const std::vector<KernelVariant>& candidates, uint32_t numIterations, const MeasureFunction& measure)
+{
+	auto best = KernelVariant();
+	auto bestTime = -1.0;
+	auto times = std::vector<double>(numIterations);
+	for (const auto& candidate : candidates)
+	{
+		for (auto& time : times)
+		{
+			time = measure(candidate, numSortElements);
+		}
+		// Median is robust against the odd slow frame.
+		std::nth_element(times.begin(), times.begin() + times.size() / 2, times.end());
+		const auto time = times[times.size() / 2];
+		printf("Tune: %s %.4fms\n", candidate.ToString().c_str(), time);
+		if (bestTime < 0.0 || time < bestTime)
+		{
+			best = candidate;
+			bestTime = time;
+		}
+	}
+
+	const auto sizeBucket = GetSizeBucket(numSortElements);
+	auto found = std::find_if(m_entries.begin(), m_entries.end(), [&](const Entry& entry)
+	{
+		return entry.m_device == device && entry.m_pipelineMode == pipelineMode && entry.m_sizeBucket == sizeBucket;
+	});
+	if (found == m_entries.end())
+	{
+		return m_entries.emplace_back(std::string(device), std::string(pipelineMode), sizeBucket, best, bestTime).m_variant;
+	}
+	found->m_variant = best;
+	found->m_time = bestTime;
+	return found->m_variant;
+}
+
+std::optional<KernelVariant> KernelTuner::Select(std::string_view device, std::string_view pipelineMode, uint32_t numSortElements) const
+{
+	// Exact bucket if tuned, otherwise the closest tuned bucket on the same device.
+	const auto sizeBucket = GetSizeBucket(numSortElements);
+	const Entry* best = nullptr;
+	uint32_t bestDistance = UINT32_MAX;
+	for (const auto& entry : m_entries)
+	{
+		if (entry.m_device != device || entry.m_pipelineMode != pipelineMode || !entry.m_variant.IsDispatchable(numSortElements))
+		{
+			continue;
+		}
+		const auto distance = (entry.m_sizeBucket > sizeBucket) ? entry.m_sizeBucket - sizeBucket : sizeBucket - entry.m_sizeBucket;
+		if (distance < bestDistance)
+		{
+			best = &entry;
+			bestDistance = distance;
+		}
+	}
+	return best ? std::optional<KernelVariant>(best->m_variant) : std::nullopt;
+}
+
+bool KernelTuner::Load(std::string_view filePath)
+{
+	auto file = std::ifstream(std::string(filePath));
+	if (!file)
+	{
+		return false;
+	}
+	m_entries.clear();
+	auto line = std::string();
+	while (std::getline(file, line))
+	{
+		// device \t pipeline mode \t size bucket \t variant \t time
+		auto columns = std::vector<std::string>();
+		auto stream = std::istringstream(line);
+		auto column = std::string();
+		while (std::getline(stream, column, '\t'))
+		{
+			columns.push_back(column);
+		}
+		if (columns.size() != 5)
+		{
+			continue;
+		}
+		auto variant = KernelVariant::FromString(columns[3]);
+		auto sizeBucket = 0u;
+		auto time = 0.0;
+		if (!variant || !ParseNumber(columns[2], sizeBucket) || !ParseNumber(columns[4], time))
+		{
+			continue;
+		}
+		m_entries.push_back({ columns[0], columns[1], sizeBucket, *variant, time });
+	}
+	return true;
+}
+
+bool KernelTuner::Save(std::string_view filePath) const
+{
+	auto file = std::ofstream(std::string(filePath), std::ios::trunc);
+	if (!file)
+	{
+		return false;
+	}
+	for (const auto& entry : m_entries)
+	{
+		file << entry.m_device << '\t' << entry.m_pipelineMode << '\t' << entry.m_sizeBucket << '\t' << entry.m_variant.ToString() << '\t' << entry.m_time << '\n';
+	}
+	return static_cast<bool>(file);
+}
+}
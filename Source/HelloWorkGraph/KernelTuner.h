@@ -0,0 +1,71 @@
+﻿#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace LearningWorkGraph
+{
+enum class KernelTopology : uint32_t
+{
+	Launcher = 0,					// One launcher thread emits a broadcasting record per pass.
+	LauncherMultiDispatchGrid,		// WORK_GRAPH_LAUNCHED_MULTI_DISPATCH_GRID.
+	Recursive,						// WORK_GRAPH_RECURSIVE, ranges split and merged by recursive nodes.
+	Count
+};
+
+// A compile-time configuration of the sort kernels, passed to the shaders as ShaderDefine.
+struct KernelVariant
+{
+	uint32_t m_threadsPerGroup = 1024;
+	uint32_t m_elementsPerThread = 1;
+	KernelTopology m_topology = KernelTopology::Launcher;
+
+	// D3D12_CS_DISPATCH_MAX_THREAD_GROUPS_PER_DIMENSION, and NodeMaxDispatchGrid of the sort nodes.
+	static constexpr uint32_t k_maxDispatchGrid = 65535;
+
+	// Powers of two up to 1024 threads and elements, and a known topology.
+	bool IsValid() const;
+	uint32_t GetDispatchGrid(uint32_t numSortElements) const;
+	// Whether a pass over numSortElements fits in one dispatch.
+	bool IsDispatchable(uint32_t numSortElements) const { return GetDispatchGrid(numSortElements) <= k_maxDispatchGrid; }
+	std::string ToString() const;
+	static std::optional<KernelVariant> FromString(std::string_view text);
+
+	bool operator==(const KernelVariant&) const = default;
+};
+
+// Searches kernel variants for the fastest one and keeps the winners per (device, pipeline mode, size bucket).
+class KernelTuner
+{
+public:
+	// Returns the time in milliseconds of one sort of numSortElements with the given variant.
+	using MeasureFunction = std::function<double(const KernelVariant& variant, uint32_t numSortElements)>;
+
+	// Only the variants that sort numSortElements within the dispatch limit.
+	static std::vector<KernelVariant> EnumerateVariants(bool includeTopologies, uint32_t numSortElements);
+	static uint32_t GetSizeBucket(uint32_t numSortElements);
+
+	const KernelVariant& Tune(std::string_view device, std::string_view pipelineMode, uint32_t numSortElements, const std::vector<KernelVariant>& candidates, uint32_t numIterations, const MeasureFunction& measure);
+	// Skips tuned variants that are not dispatchable at numSortElements.
+	std::optional<KernelVariant> Select(std::string_view device, std::string_view pipelineMode, uint32_t numSortElements) const;
+
+	// Lines that do not parse are skipped.
+	bool Load(std::string_view filePath);
+	bool Save(std::string_view filePath) const;
+
+private:
+	struct Entry
+	{
+		std::string m_device;
+		std::string m_pipelineMode;
+		uint32_t m_sizeBucket;
+		KernelVariant m_variant;
+		double m_time;
+	};
+	std::vector<Entry> m_entries;
+};
+}
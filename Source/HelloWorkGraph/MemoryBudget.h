@@ -0,0 +1,88 @@
+﻿#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <cstdio>
+#include <string_view>
+
+namespace LearningWorkGraph
+{
+enum class MemoryCategory : uint32_t
+{
+	InitialUpload = 0,
+	SortBuffer,
+	ScratchBuffer,
+	UploadRing,
+	ReadbackRing,
+	BackingMemory,
+	Count
+};
+
+inline std::string_view GetMemoryCategoryName(MemoryCategory category)
+{
+	constexpr std::string_view k_names[] = { "Initial Upload", "Sort Buffer", "Scratch Buffer", "Upload Ring", "Readback Ring", "Backing Memory" };
+	return k_names[static_cast<uint32_t>(category)];
+}
+
+// Current and peak bytes of GPU buffers per category.
+class MemoryTracker
+{
+public:
+	void Allocate(MemoryCategory category, uint64_t size)
+	{
+		auto& usage = m_usages[static_cast<uint32_t>(category)];
+		usage.m_current += size;
+		usage.m_peak = (std::max)(usage.m_peak, usage.m_current);
+		m_total += size;
+		m_peakTotal = (std::max)(m_peakTotal, m_total);
+	}
+
+	void Free(MemoryCategory category, uint64_t size)
+	{
+		m_usages[static_cast<uint32_t>(category)].m_current -= size;
+		m_total -= size;
+	}
+
+	uint64_t GetCurrent(MemoryCategory category) const { return m_usages[static_cast<uint32_t>(category)].m_current; }
+	uint64_t GetPeak(MemoryCategory category) const { return m_usages[static_cast<uint32_t>(category)].m_peak; }
+	uint64_t GetTotal() const { return m_total; }
+	uint64_t GetPeakTotal() const { return m_peakTotal; }
+
+	void Print(uint64_t budget) const
+	{
+		for (uint32_t i = 0; i < static_cast<uint32_t>(MemoryCategory::Count); ++i)
+		{
+			const auto name = GetMemoryCategoryName(static_cast<MemoryCategory>(i));
+			printf("  %-15.*s peak %12llu bytes, current %12llu bytes\n", static_cast<int>(name.size()), name.data(), static_cast<unsigned long long>(m_usages[i].m_peak), static_cast<unsigned long long>(m_usages[i].m_current));
+		}
+		printf("  %-15s peak %12llu bytes, budget %12llu bytes%s\n", "Total", static_cast<unsigned long long>(m_peakTotal), static_cast<unsigned long long>(budget), (budget > 0 && m_peakTotal > budget) ? " (exceeded)" : "");
+	}
+
+private:
+	struct Usage
+	{
+		uint64_t m_current = 0;
+		uint64_t m_peak = 0;
+	};
+	std::array<Usage, static_cast<size_t>(MemoryCategory::Count)> m_usages = {};
+	uint64_t m_total = 0;
+	uint64_t m_peakTotal = 0;
+};
+
+// Largest work graph backing memory size in [minSize, maxSize] that fits into available, in steps of granularity.
+// Returns minSize if even that does not fit, the graph cannot run with less.
+inline uint64_t SelectBackingMemorySize(uint64_t minSize, uint64_t maxSize, uint64_t granularity, uint64_t available)
+{
+	if (available <= minSize)
+	{
+		return minSize;
+	}
+	auto size = (std::min)(available, maxSize);
+	if (granularity > 0 && size < maxSize)
+	{
+		size = minSize + (size - minSize) / granularity * granularity;
+	}
+	return size;
+}
+}
\ No newline at end of file
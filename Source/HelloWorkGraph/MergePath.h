@@ -0,0 +1,43 @@
+﻿#pragma once
+
+#include "Parallel.h"
+
+#include <algorithm>
+#include <cstddef>
+
+namespace LearningWorkGraph
+{
+// Merge path: the number of elements taken from a for the first `diagonal` outputs of merging a and b.
+// Elements of a go first on ties, like std::merge. Matches MergePathSplit in Shader.shader.
+template<typename T, typename Less>
+size_t MergePathSplit(const T* a, size_t numA, const T* b, size_t numB, size_t diagonal, Less less)
+{
+	auto low = (diagonal > numB) ? diagonal - numB : 0;
+	auto high = (std::min)(diagonal, numA);
+	while (low < high)
+	{
+		const auto mid = (low + high) / 2;
+		if (!less(b[diagonal - 1 - mid], a[mid]))
+		{
+			low = mid + 1;
+		}
+		else
+		{
+			high = mid;
+		}
+	}
+	return low;
+}
+
+// Splits the output into one range per worker, finds each range's start on the merge path and merges the ranges independently.
+template<typename T, typename Less>
+void ParallelMerge(const T* a, size_t numA, const T* b, size_t numB, T* output, Less less)
+{
+	ParallelForRanges(numA + numB, 1 << 14, [&](uint32_t, size_t begin, size_t end)
+	{
+		const auto aBegin = MergePathSplit(a, numA, b, numB, begin, less);
+		const auto aEnd = MergePathSplit(a, numA, b, numB, end, less);
+		std::merge(a + aBegin, a + aEnd, b + (begin - aBegin), b + (end - aEnd), output + begin, less);
+	});
+}
+}
\ No newline at end of file
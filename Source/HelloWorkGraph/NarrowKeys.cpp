@@ -0,0 +1,148 @@
+﻿#include "NarrowKeys.h"
+#include "Parallel.h"
+
+#include <algorithm>
+#include <utility>
+#include <vector>
+
+namespace LearningWorkGraph
+{
+static constexpr size_t k_minGrain = 1 << 16;
+
+NarrowKeyPacking ComputeNarrowKeyPacking(const uint32_t* keys, size_t count)
+{
+	auto minimums = std::vector<uint32_t>(GetNumWorkerThreads(), UINT32_MAX);
+	auto maximums = std::vector<uint32_t>(GetNumWorkerThreads(), 0);
+	const auto numRanges = ParallelForRanges(count, k_minGrain, [&](uint32_t rangeIndex, size_t begin, size_t end)
+	{
+		uint32_t minimum = UINT32_MAX;
+		uint32_t maximum = 0;
+		for (size_t i = begin; i < end; ++i)
+		{
+			minimum = (std::min)(minimum, keys[i]);
+			maximum = (std::max)(maximum, keys[i]);
+		}
+		minimums[rangeIndex] = minimum;
+		maximums[rangeIndex] = maximum;
+	});
+
+	auto packing = NarrowKeyPacking();
+	if (count == 0)
+	{
+		return packing;
+	}
+	packing.m_minimum = *std::min_element(minimums.begin(), minimums.begin() + numRanges);
+	const auto range = *std::max_element(maximums.begin(), maximums.begin() + numRanges) - packing.m_minimum;
+	packing.m_bits = (range <= UINT8_MAX) ? 8 : (range <= UINT16_MAX) ? 16 : 32;
+	return packing;
+}
+
+void PackNarrowKeys(const uint32_t* keys, size_t count, const NarrowKeyPacking& packing, uint32_t* words)
+{
+	const auto keysPerWord = packing.GetKeysPerWord();
+	const auto mask = (packing.m_bits < 32) ? (1u << packing.m_bits) - 1 : UINT32_MAX;
+	ParallelForRanges(count / keysPerWord, k_minGrain, [&](uint32_t, size_t begin, size_t end)
+	{
+		for (size_t w = begin; w < end; ++w)
+		{
+			uint32_t word = 0;
+			for (uint32_t k = 0; k < keysPerWord; ++k)
+			{
+				const auto key = keys[w * keysPerWord + k];
+				const auto rebased = (key >= packing.m_minimum) ? (std::min)(key - packing.m_minimum, mask) : 0;
+				word |= rebased << (k * packing.m_bits);
+			}
+			words[w] = word;
+		}
+	});
+}
+
+void UnpackNarrowKeys(const uint32_t* words, size_t count, const NarrowKeyPacking& packing, uint32_t* keys)
+{
+	const auto keysPerWord = packing.GetKeysPerWord();
+	const auto mask = (packing.m_bits < 32) ? (1u << packing.m_bits) - 1 : UINT32_MAX;
+	ParallelForRanges(count / keysPerWord, k_minGrain, [&](uint32_t, size_t begin, size_t end)
+	{
+		for (size_t w = begin; w < end; ++w)
+		{
+			const auto word = words[w];
+			for (uint32_t k = 0; k < keysPerWord; ++k)
+			{
+				keys[w * keysPerWord + k] = ((word >> (k * packing.m_bits)) & mask) + packing.m_minimum;
+			}
+		}
+	});
+}
+
+namespace
+{
+template<uint32_t Bits>
+void BitonicSortPackedPass(uint32_t* words, size_t count, uint32_t inc, uint32_t dir)
+{
+	constexpr uint32_t k_keysPerWord = 32 / Bits;
+	constexpr uint32_t k_mask = (Bits < 32) ? (1u << (Bits % 32)) - 1 : UINT32_MAX;
+	ParallelForRanges(count / 2 / k_keysPerWord, k_minGrain, [=](uint32_t, size_t begin, size_t end)
+	{
+		const size_t mask = inc - 1;
+		for (size_t unit = begin; unit < end; ++unit)
+		{
+			// The comparators of one unit touch exactly two whole words, see BitonicSortPacked.
+			const auto firstIndex = unit * k_keysPerWord;
+			const auto first = firstIndex * 2 - (mask & firstIndex);
+			const auto word0 = first / k_keysPerWord;
+			const auto word1 = (inc >= k_keysPerWord) ? (first + inc) / k_keysPerWord : word0 + 1;
+
+			uint32_t keys[k_keysPerWord * 2];
+			for (uint32_t s = 0; s < k_keysPerWord; ++s)
+			{
+				keys[s] = (words[word0] >> (s * Bits)) & k_mask;
+				keys[k_keysPerWord + s] = (words[word1] >> (s * Bits)) & k_mask;
+			}
+			for (uint32_t k = 0; k < k_keysPerWord; ++k)
+			{
+				const auto index = firstIndex + k;
+				const auto i = index * 2 - (mask & index);
+				const auto x = (inc >= k_keysPerWord) ? k : static_cast<uint32_t>(i - first);
+				const auto y = (inc >= k_keysPerWord) ? k_keysPerWord + k : x + inc;
+				const auto isAscending = ((dir & i) == 0);
+				if (isAscending ? !(keys[x] < keys[y]) : (keys[x] < keys[y]))
+				{
+					std::swap(keys[x], keys[y]);
+				}
+			}
+			auto sortedA = 0u;
+			auto sortedB = 0u;
+			for (uint32_t t = 0; t < k_keysPerWord; ++t)
+			{
+				sortedA |= keys[t] << (t * Bits);
+				sortedB |= keys[k_keysPerWord + t] << (t * Bits);
+			}
+			words[word0] = sortedA;
+			words[word1] = sortedB;
+		}
+	});
+}
+}
+
+void BitonicSortNarrowKeysPass(uint32_t* words, size_t count, const NarrowKeyPacking& packing, uint32_t inc, uint32_t dir)
+{
+	switch (packing.m_bits)
+	{
+	case 8: BitonicSortPackedPass<8>(words, count, inc, dir); break;
+	case 16: BitonicSortPackedPass<16>(words, count, inc, dir); break;
+	default: BitonicSortPackedPass<32>(words, count, inc, dir); break;
+	}
+}
+
+void SortNarrowKeys(uint32_t* words, size_t count, const NarrowKeyPacking& packing)
+{
+	// Fewer, wider units per pass are what the packing buys on the GPU, the number of passes stays the same.
+	for (size_t size = 2; size <= count; size *= 2)
+	{
+		for (auto inc = static_cast<uint32_t>(size / 2); inc > 0; inc /= 2)
+		{
+			BitonicSortNarrowKeysPass(words, count, packing, inc, static_cast<uint32_t>(size));
+		}
+	}
+}
+}
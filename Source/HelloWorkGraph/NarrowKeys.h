@@ -0,0 +1,30 @@
+﻿#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace LearningWorkGraph
+{
+// Keys are stored as (key - m_minimum) in m_bits bits, 32 / m_bits keys per word, lowest key in the lowest bits.
+struct NarrowKeyPacking
+{
+	uint32_t m_minimum = 0;
+	uint32_t m_bits = 32;
+
+	uint32_t GetKeysPerWord() const { return 32 / m_bits; }
+	bool IsPacked() const { return m_bits < 32; }
+};
+
+// Min/max pre-pass. Picks 8 or 16 bits when (max - min) fits, otherwise leaves keys at 32 bits.
+NarrowKeyPacking ComputeNarrowKeyPacking(const uint32_t* keys, size_t count);
+
+// count must be a multiple of GetKeysPerWord(). Keys outside the range (padding) are clamped to the largest packed value.
+void PackNarrowKeys(const uint32_t* keys, size_t count, const NarrowKeyPacking& packing, uint32_t* words);
+void UnpackNarrowKeys(const uint32_t* words, size_t count, const NarrowKeyPacking& packing, uint32_t* keys);
+
+// One pass of BitonicSortPacked in Shader.shader over count keys, KEYS_PER_WORD consecutive comparators per unit. With 32 bits
+// (no packing) it is the pass of BitonicSort on one key per comparator.
+void BitonicSortNarrowKeysPass(uint32_t* words, size_t count, const NarrowKeyPacking& packing, uint32_t inc, uint32_t dir);
+// All passes of the compute engine in the same order. count must be a power of two and at least two words of keys.
+void SortNarrowKeys(uint32_t* words, size_t count, const NarrowKeyPacking& packing);
+}
\ No newline at end of file
@@ -0,0 +1,200 @@
+﻿#include "Parallel.h"
+
+#include <atomic>
+#include <cstring>
+
+#if defined(_WIN32)
+#include <windows.h>
+#else
+#include <fstream>
+#include <pthread.h>
+#include <sched.h>
+#include <sstream>
+#include <string>
+#endif
+
+namespace LearningWorkGraph
+{
+namespace
+{
+std::atomic<bool> g_isWorkerPinningEnabled = false;
+
+#if defined(_WIN32)
+static_assert(sizeof(GROUP_AFFINITY) <= sizeof(uint64_t) * 16);
+
+// CPUs are numbered group * 64 + bit, like GetWorkerCpu returns them.
+NumaTopology ReadNumaTopology()
+{
+	auto topology = NumaTopology();
+	ULONG highestNode = 0;
+	if (GetNumaHighestNodeNumber(&highestNode))
+	{
+		for (USHORT node = 0; node <= highestNode; ++node)
+		{
+			auto affinity = GROUP_AFFINITY();
+			if (!GetNumaNodeProcessorMaskEx(node, &affinity) || affinity.Mask == 0)
+			{
+				continue;
+			}
+			topology.m_nodeNumbers.push_back(node);
+			auto& cpus = topology.m_nodeCpus.emplace_back();
+			for (uint32_t bit = 0; bit < 64; ++bit)
+			{
+				if (affinity.Mask & (KAFFINITY(1) << bit))
+				{
+					cpus.push_back(affinity.Group * 64 + bit);
+				}
+			}
+		}
+	}
+	return topology;
+}
+#else
+static_assert(sizeof(cpu_set_t) <= sizeof(uint64_t) * 16);
+
+// "0-3,8-11" as in /sys/devices/system/node/online and node*/cpulist.
+std::vector<uint32_t> ParseIndexList(const std::string& text)
+{
+	auto cpus = std::vector<uint32_t>();
+	auto stream = std::istringstream(text);
+	auto item = std::string();
+	while (std::getline(stream, item, ','))
+	{
+		const auto dash = item.find('-');
+		const auto first = static_cast<uint32_t>(std::stoul(item.substr(0, dash)));
+		const auto last = (dash == std::string::npos) ? first : static_cast<uint32_t>(std::stoul(item.substr(dash + 1)));
+		for (auto cpu = first; cpu <= last; ++cpu)
+		{
+			cpus.push_back(cpu);
+		}
+	}
+	return cpus;
+}
+
+NumaTopology ReadNumaTopology()
+{
+	auto allowed = cpu_set_t();
+	CPU_ZERO(&allowed);
+	sched_getaffinity(0, sizeof(allowed), &allowed);
+
+	auto topology = NumaTopology();
+	auto online = std::ifstream("/sys/devices/system/node/online");
+	auto nodes = std::string();
+	if (!online || !std::getline(online, nodes) || nodes.empty())
+	{
+		return topology;
+	}
+	for (const auto node : ParseIndexList(nodes))
+	{
+		auto file = std::ifstream("/sys/devices/system/node/node" + std::to_string(node) + "/cpulist");
+		auto text = std::string();
+		if (!file || !std::getline(file, text))
+		{
+			continue;
+		}
+		auto cpus = text.empty() ? std::vector<uint32_t>() : ParseIndexList(text);
+		std::erase_if(cpus, [&](uint32_t cpu) { return cpu >= CPU_SETSIZE || !CPU_ISSET(cpu, &allowed); });
+		if (!cpus.empty())
+		{
+			topology.m_nodeCpus.push_back(std::move(cpus));
+			topology.m_nodeNumbers.push_back(node);
+		}
+	}
+	return topology;
+}
+#endif
+}
+
+const NumaTopology& NumaTopology::Get()
+{
+	static const auto topology = []
+	{
+		auto topology = ReadNumaTopology();
+		if (topology.m_nodeCpus.empty())
+		{
+			topology.m_nodeNumbers = { 0 };
+			auto& cpus = topology.m_nodeCpus.emplace_back(GetNumWorkerThreads());
+			for (uint32_t cpu = 0; cpu < cpus.size(); ++cpu)
+			{
+				cpus[cpu] = cpu;
+			}
+		}
+		return topology;
+	}();
+	return topology;
+}
+
+uint32_t NumaTopology::GetWorkerCpu(uint32_t workerIndex) const
+{
+	auto numCpus = size_t(0);
+	for (const auto& cpus : m_nodeCpus)
+	{
+		numCpus += cpus.size();
+	}
+	auto index = workerIndex % numCpus;
+	for (const auto& cpus : m_nodeCpus)
+	{
+		if (index < cpus.size())
+		{
+			return cpus[index];
+		}
+		index -= cpus.size();
+	}
+	return 0;
+}
+
+void SetWorkerPinning(bool isEnabled)
+{
+	g_isWorkerPinningEnabled.store(isEnabled, std::memory_order_relaxed);
+}
+
+bool IsWorkerPinningEnabled()
+{
+	return g_isWorkerPinningEnabled.load(std::memory_order_relaxed);
+}
+
+ScopedWorkerAffinity::ScopedWorkerAffinity(uint32_t workerIndex, bool isEnabled)
+{
+	if (!isEnabled)
+	{
+		return;
+	}
+	const auto cpu = NumaTopology::Get().GetWorkerCpu(workerIndex);
+#if defined(_WIN32)
+	auto affinity = GROUP_AFFINITY();
+	affinity.Group = static_cast<WORD>(cpu / 64);
+	affinity.Mask = KAFFINITY(1) << (cpu % 64);
+	auto previous = GROUP_AFFINITY();
+	m_isPinned = SetThreadGroupAffinity(GetCurrentThread(), &affinity, &previous) != 0;
+	memcpy(m_previousAffinity.data(), &previous, sizeof(previous));
+#else
+	auto previous = cpu_set_t();
+	if (pthread_getaffinity_np(pthread_self(), sizeof(previous), &previous) != 0)
+	{
+		return;
+	}
+	auto affinity = cpu_set_t();
+	CPU_ZERO(&affinity);
+	CPU_SET(cpu, &affinity);
+	m_isPinned = pthread_setaffinity_np(pthread_self(), sizeof(affinity), &affinity) == 0;
+	memcpy(m_previousAffinity.data(), &previous, sizeof(previous));
+#endif
+}
+
+ScopedWorkerAffinity::~ScopedWorkerAffinity()
+{
+	if (!m_isPinned)
+	{
+		return;
+	}
+#if defined(_WIN32)
+	auto previous = GROUP_AFFINITY();
+	memcpy(&previous, m_previousAffinity.data(), sizeof(previous));
+	SetThreadGroupAffinity(GetCurrentThread(), &previous, nullptr);
+#else
+	auto previous = cpu_set_t();
+	memcpy(&previous, m_previousAffinity.data(), sizeof(previous));
+	pthread_setaffinity_np(pthread_self(), sizeof(previous), &previous);
+#endif
+}
+}
\ No newline at end of file
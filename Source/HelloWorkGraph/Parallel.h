@@ -0,0 +1,78 @@
+﻿#pragma once
+
+#include <Framework/JobSystem.h>
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <vector>
+
+namespace LearningWorkGraph
+{
+// Workers of the shared job system and the calling thread.
+inline uint32_t GetNumWorkerThreads()
+{
+	return JobSystem::Get().GetNumThreads();
+}
+
+// NUMA nodes with the CPUs the process may run on, read once. A host without NUMA information is one node.
+struct NumaTopology
+{
+	std::vector<std::vector<uint32_t>> m_nodeCpus;
+	// Node numbers of the OS, in the order of m_nodeCpus.
+	std::vector<uint32_t> m_nodeNumbers;
+
+	static const NumaTopology& Get();
+	uint32_t GetNumNodes() const { return static_cast<uint32_t>(m_nodeCpus.size()); }
+	// CPU of a worker: the CPUs are numbered node by node, so the contiguous ranges of ParallelForRanges fill one node after the other.
+	uint32_t GetWorkerCpu(uint32_t workerIndex) const;
+};
+
+// With pinning enabled every range of ParallelForRanges runs on the CPU of its worker, see NumaTopology::GetWorkerCpu.
+void SetWorkerPinning(bool isEnabled);
+bool IsWorkerPinningEnabled();
+
+// Pins the current thread to the CPU of a worker and restores its previous affinity at the end of the scope.
+class ScopedWorkerAffinity
+{
+public:
+	explicit ScopedWorkerAffinity(uint32_t workerIndex, bool isEnabled = IsWorkerPinningEnabled());
+	~ScopedWorkerAffinity();
+	ScopedWorkerAffinity(const ScopedWorkerAffinity&) = delete;
+	ScopedWorkerAffinity& operator=(const ScopedWorkerAffinity&) = delete;
+
+private:
+	bool m_isPinned = false;
+	// The affinity mask of the thread before, the group affinity on Windows and the cpu_set_t on Linux.
+	std::array<uint64_t, 16> m_previousAffinity = {};
+};
+
+// Splits [0, count) into at most one contiguous range per worker thread, with at least minGrain items each,
+// and calls function(rangeIndex, begin, end) for every range. Returns the number of ranges.
+// Ranges 1.. are forked to the job system and range 0 runs on the calling thread, which joins in until all completed.
+template<typename Function>
+uint32_t ParallelForRanges(size_t count, size_t minGrain, Function&& function)
+{
+	const auto numRanges = static_cast<uint32_t>((std::max<size_t>)(1, (std::min<size_t>)(GetNumWorkerThreads(), count / (std::max<size_t>)(minGrain, 1))));
+	if (numRanges == 1)
+	{
+		function(0u, size_t(0), count);
+		return 1;
+	}
+	auto group = TaskGroup();
+	for (uint32_t i = 1; i < numRanges; ++i)
+	{
+		group.Run([&function, i, count, numRanges]
+		{
+			auto affinity = ScopedWorkerAffinity(i);
+			function(i, count * i / numRanges, count * (i + 1) / numRanges);
+		});
+	}
+	{
+		auto affinity = ScopedWorkerAffinity(0);
+		function(0u, size_t(0), count / numRanges);
+	}
+	group.Wait();
+	return numRanges;
+}
+}
\ No newline at end of file
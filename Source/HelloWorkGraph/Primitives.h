@@ -0,0 +1,212 @@
+﻿#pragma once
+
+#include "Parallel.h"
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cstdint>
+#include <vector>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#	include <immintrin.h>
+#endif
+
+namespace LearningWorkGraph
+{
+// CPU references of the primitives in Shader/Primitives.shader, on 32-bit values with the same wrap-around sums.
+// Each splits the values into one contiguous range per worker with ParallelForRanges and vectorizes the inner loop.
+constexpr size_t k_primitiveMinGrain = 1 << 16;
+constexpr uint32_t k_histogramBuckets = 256;
+
+// Serial kernels of one range.
+inline uint32_t SumValues(const uint32_t* values, size_t count)
+{
+	auto i = size_t(0);
+	auto sum = 0u;
+#if defined(__AVX2__)
+	auto sum8 = _mm256_setzero_si256();
+	for (; i + 8 <= count; i += 8)
+	{
+		sum8 = _mm256_add_epi32(sum8, _mm256_loadu_si256(reinterpret_cast<const __m256i*>(values + i)));
+	}
+	alignas(32) uint32_t lanes[8] = {};
+	_mm256_store_si256(reinterpret_cast<__m256i*>(lanes), sum8);
+	for (const auto lane : lanes)
+	{
+		sum += lane;
+	}
+#elif defined(__SSE2__) || defined(_M_X64)
+	auto sum4 = _mm_setzero_si128();
+	for (; i + 4 <= count; i += 4)
+	{
+		sum4 = _mm_add_epi32(sum4, _mm_loadu_si128(reinterpret_cast<const __m128i*>(values + i)));
+	}
+	alignas(16) uint32_t lanes[4] = {};
+	_mm_store_si128(reinterpret_cast<__m128i*>(lanes), sum4);
+	for (const auto lane : lanes)
+	{
+		sum += lane;
+	}
+#endif
+	for (; i < count; ++i)
+	{
+		sum += values[i];
+	}
+	return sum;
+}
+
+// Exclusive scan of count values starting at offset, returns offset plus the sum of the values.
+inline uint32_t ExclusiveScanValues(const uint32_t* values, size_t count, uint32_t offset, uint32_t* output)
+{
+	auto i = size_t(0);
+#if defined(__SSE2__) || defined(_M_X64)
+	// Inclusive scan in the register by two shifted adds, shifted by one lane for the exclusive result.
+	auto carry = _mm_set1_epi32(static_cast<int>(offset));
+	for (; i + 4 <= count; i += 4)
+	{
+		auto x = _mm_loadu_si128(reinterpret_cast<const __m128i*>(values + i));
+		x = _mm_add_epi32(x, _mm_slli_si128(x, 4));
+		x = _mm_add_epi32(x, _mm_slli_si128(x, 8));
+		const auto inclusive = _mm_add_epi32(x, carry);
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(output + i), _mm_or_si128(_mm_slli_si128(inclusive, 4), _mm_srli_si128(carry, 12)));
+		carry = _mm_shuffle_epi32(inclusive, _MM_SHUFFLE(3, 3, 3, 3));
+	}
+	offset = static_cast<uint32_t>(_mm_cvtsi128_si32(carry));
+#endif
+	for (; i < count; ++i)
+	{
+		const auto value = values[i];
+		output[i] = offset;
+		offset += value;
+	}
+	return offset;
+}
+
+inline size_t CountMatches(const uint32_t* values, size_t count, uint32_t mask, uint32_t match)
+{
+	auto i = size_t(0);
+	auto numMatches = size_t(0);
+#if defined(__AVX2__)
+	const auto mask8 = _mm256_set1_epi32(static_cast<int>(mask));
+	const auto match8 = _mm256_set1_epi32(static_cast<int>(match));
+	for (; i + 8 <= count; i += 8)
+	{
+		const auto x = _mm256_and_si256(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(values + i)), mask8);
+		numMatches += std::popcount(static_cast<uint32_t>(_mm256_movemask_ps(_mm256_castsi256_ps(_mm256_cmpeq_epi32(x, match8)))));
+	}
+#endif
+	for (; i < count; ++i)
+	{
+		numMatches += ((values[i] & mask) == match) ? 1 : 0;
+	}
+	return numMatches;
+}
+
+// Sum of the values modulo 2^32.
+inline uint32_t ParallelReduce(const uint32_t* values, size_t count)
+{
+	auto sums = std::vector<uint32_t>(GetNumWorkerThreads());
+	const auto numRanges = ParallelForRanges(count, k_primitiveMinGrain, [&](uint32_t rangeIndex, size_t begin, size_t end)
+	{
+		sums[rangeIndex] = SumValues(values + begin, end - begin);
+	});
+	return SumValues(sums.data(), numRanges);
+}
+
+// output[i] is the sum of values[0, i), output may be values. Returns the sum of all values.
+// Sums every range, scans the range sums on the calling thread, then scans every range from its offset.
+inline uint32_t ParallelExclusiveScan(const uint32_t* values, size_t count, uint32_t* output)
+{
+	auto offsets = std::vector<uint32_t>(GetNumWorkerThreads());
+	const auto numRanges = ParallelForRanges(count, k_primitiveMinGrain, [&](uint32_t rangeIndex, size_t begin, size_t end)
+	{
+		offsets[rangeIndex] = SumValues(values + begin, end - begin);
+	});
+	const auto total = ExclusiveScanValues(offsets.data(), numRanges, 0, offsets.data());
+	ParallelForRanges(count, k_primitiveMinGrain, [&](uint32_t rangeIndex, size_t begin, size_t end)
+	{
+		ExclusiveScanValues(values + begin, end - begin, offsets[rangeIndex], output + begin);
+	});
+	return total;
+}
+
+// Counts of the 8-bit digit (value >> shift) & 255.
+inline std::array<uint32_t, k_histogramBuckets> ParallelHistogram(const uint32_t* values, size_t count, uint32_t shift)
+{
+	// Four interleaved sub-histograms per range, so that runs of equal digits don't serialize on one counter.
+	using Histograms = std::array<std::array<uint32_t, k_histogramBuckets>, 4>;
+	auto rangeHistograms = std::vector<Histograms>(GetNumWorkerThreads());
+	const auto numRanges = ParallelForRanges(count, k_primitiveMinGrain, [&](uint32_t rangeIndex, size_t begin, size_t end)
+	{
+		auto& histograms = rangeHistograms[rangeIndex];
+		for (auto& histogram : histograms)
+		{
+			histogram.fill(0);
+		}
+		auto i = begin;
+		for (; i + 4 <= end; i += 4)
+		{
+			++histograms[0][(values[i + 0] >> shift) & (k_histogramBuckets - 1)];
+			++histograms[1][(values[i + 1] >> shift) & (k_histogramBuckets - 1)];
+			++histograms[2][(values[i + 2] >> shift) & (k_histogramBuckets - 1)];
+			++histograms[3][(values[i + 3] >> shift) & (k_histogramBuckets - 1)];
+		}
+		for (; i < end; ++i)
+		{
+			++histograms[0][(values[i] >> shift) & (k_histogramBuckets - 1)];
+		}
+	});
+
+	auto histogram = std::array<uint32_t, k_histogramBuckets>();
+	histogram.fill(0);
+	for (uint32_t range = 0; range < numRanges; ++range)
+	{
+		for (const auto& subHistogram : rangeHistograms[range])
+		{
+			for (uint32_t bucket = 0; bucket < k_histogramBuckets; ++bucket)
+			{
+				histogram[bucket] += subHistogram[bucket];
+			}
+		}
+	}
+	return histogram;
+}
+
+// Stream compaction: copies the values with (value & mask) == match to output in their order and returns their number.
+inline size_t ParallelCompact(const uint32_t* values, size_t count, uint32_t mask, uint32_t match, uint32_t* output)
+{
+	auto offsets = std::vector<size_t>(GetNumWorkerThreads());
+	const auto numRanges = ParallelForRanges(count, k_primitiveMinGrain, [&](uint32_t rangeIndex, size_t begin, size_t end)
+	{
+		offsets[rangeIndex] = CountMatches(values + begin, end - begin, mask, match);
+	});
+	auto total = size_t(0);
+	for (uint32_t range = 0; range < numRanges; ++range)
+	{
+		const auto numMatches = offsets[range];
+		offsets[range] = total;
+		total += numMatches;
+	}
+	ParallelForRanges(count, k_primitiveMinGrain, [&](uint32_t rangeIndex, size_t begin, size_t end)
+	{
+		// Branchless appends to a block on the stack, since the range after the last match belongs to the next range.
+		constexpr size_t k_blockSize = 256;
+		uint32_t block[k_blockSize];
+		auto* destination = output + offsets[rangeIndex];
+		for (auto blockBegin = begin; blockBegin < end; blockBegin += k_blockSize)
+		{
+			const auto blockEnd = (std::min)(blockBegin + k_blockSize, end);
+			auto numMatches = size_t(0);
+			for (auto i = blockBegin; i < blockEnd; ++i)
+			{
+				block[numMatches] = values[i];
+				numMatches += ((values[i] & mask) == match) ? 1 : 0;
+			}
+			std::copy(block, block + numMatches, destination);
+			destination += numMatches;
+		}
+	});
+	return total;
+}
+}
\ No newline at end of file
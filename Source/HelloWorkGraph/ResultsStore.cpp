@@ -0,0 +1,263 @@
+﻿#include "ResultsStore.h"
+
+#include <algorithm>
+#include <charconv>
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+
+namespace LearningWorkGraph
+{
+namespace
+{
+double GetMedian(std::vector<double> samples)
+{
+	if (samples.empty())
+	{
+		return 0.0;
+	}
+	std::nth_element(samples.begin(), samples.begin() + samples.size() / 2, samples.end());
+	return samples[samples.size() / 2];
+}
+
+// Tabs and line breaks would break the columns.
+std::string SanitizeColumn(std::string_view value)
+{
+	auto column = std::string(value);
+	std::replace_if(column.begin(), column.end(), [](char c) { return c == '\t' || c == '\n' || c == '\r'; }, ' ');
+	return column.empty() ? "-" : column;
+}
+
+template<typename T>
+bool ParseNumber(std::string_view text, T& value)
+{
+	const auto* end = text.data() + text.size();
+	const auto result = std::from_chars(text.data(), end, value);
+	return result.ec == std::errc() && result.ptr == end;
+}
+
+// commit \t device \t mode \t algorithm \t distribution \t size \t samples separated by commas
+bool ParseResult(const std::string& line, BenchmarkResult& result)
+{
+	auto columns = std::vector<std::string>();
+	auto stream = std::istringstream(line);
+	auto column = std::string();
+	while (std::getline(stream, column, '\t'))
+	{
+		columns.push_back(column);
+	}
+	if (columns.size() != 7 || !ParseNumber(columns[5], result.m_size))
+	{
+		return false;
+	}
+	result.m_commit = columns[0];
+	result.m_device = columns[1];
+	result.m_mode = columns[2];
+	result.m_algorithm = columns[3];
+	result.m_distribution = columns[4];
+	auto samples = std::istringstream(columns[6]);
+	while (std::getline(samples, column, ','))
+	{
+		auto sample = 0.0;
+		if (!ParseNumber(column, sample))
+		{
+			return false;
+		}
+		result.m_samples.push_back(sample);
+	}
+	return !result.m_samples.empty();
+}
+}
+
+bool BenchmarkResult::IsSameCase(const BenchmarkResult& other) const
+{
+	return m_device == other.m_device && m_mode == other.m_mode && m_algorithm == other.m_algorithm && m_distribution == other.m_distribution && m_size == other.m_size;
+}
+
+double MannWhitneyPValue(const std::vector<double>& a, const std::vector<double>& b)
+{
+	if (a.empty() || b.empty())
+	{
+		return 1.0;
+	}
+
+	// Ranks over both samples, ties get the mean of their ranks.
+	auto values = std::vector<std::pair<double, bool>>();
+	values.reserve(a.size() + b.size());
+	for (const auto value : a)
+	{
+		values.emplace_back(value, true);
+	}
+	for (const auto value : b)
+	{
+		values.emplace_back(value, false);
+	}
+	std::sort(values.begin(), values.end(), [](const auto& x, const auto& y) { return x.first < y.first; });
+
+	const auto n = static_cast<double>(values.size());
+	auto rankSumA = 0.0;
+	auto tieCorrection = 0.0;
+	for (size_t i = 0; i < values.size();)
+	{
+		auto j = i;
+		while (j < values.size() && values[j].first == values[i].first)
+		{
+			++j;
+		}
+		const auto rank = (i + 1 + j) * 0.5;
+		for (auto k = i; k < j; ++k)
+		{
+			rankSumA += values[k].second ? rank : 0.0;
+		}
+		const auto t = static_cast<double>(j - i);
+		tieCorrection += t * t * t - t;
+		i = j;
+	}
+
+	const auto na = static_cast<double>(a.size());
+	const auto nb = static_cast<double>(b.size());
+	const auto u = rankSumA - na * (na + 1.0) * 0.5;
+	const auto mean = na * nb * 0.5;
+	const auto variance = na * nb / 12.0 * ((n + 1.0) - tieCorrection / (n * (n - 1.0)));
+	if (variance <= 0.0)
+	{
+		return 1.0;
+	}
+	// Continuity correction towards the mean.
+	const auto z = (std::max)(std::abs(u - mean) - 0.5, 0.0) / std::sqrt(variance);
+	return std::erfc(z / std::sqrt(2.0));
+}
+
+bool ResultsStore::Load(std::string_view filePath)
+{
+	auto file = std::ifstream(std::string(filePath));
+	if (!file)
+	{
+		return false;
+	}
+	m_results.clear();
+	auto line = std::string();
+	auto lineNumber = size_t(0);
+	while (std::getline(file, line))
+	{
+		++lineNumber;
+		if (line.empty() || line.starts_with('#'))
+		{
+			continue;
+		}
+		// A line cut short by an interrupted run only loses that result.
+		auto result = BenchmarkResult();
+		if (!ParseResult(line, result))
+		{
+			printf("Results: skipped malformed line %zu of %.*s\n", lineNumber, static_cast<int>(filePath.size()), filePath.data());
+			continue;
+		}
+		m_results.push_back(std::move(result));
+	}
+	return true;
+}
+
+bool ResultsStore::Append(std::string_view filePath, const BenchmarkResult& result)
+{
+	auto file = std::ofstream(std::string(filePath), std::ios::app);
+	if (!file)
+	{
+		return false;
+	}
+	file << SanitizeColumn(result.m_commit) << '\t' << SanitizeColumn(result.m_device) << '\t' << SanitizeColumn(result.m_mode) << '\t'
+		<< SanitizeColumn(result.m_algorithm) << '\t' << SanitizeColumn(result.m_distribution) << '\t' << result.m_size << '\t';
+	for (size_t i = 0; i < result.m_samples.size(); ++i)
+	{
+		file << (i > 0 ? "," : "") << result.m_samples[i];
+	}
+	file << '\n';
+	return static_cast<bool>(file);
+}
+
+std::vector<ResultsStore::Comparison> ResultsStore::Compare(std::string_view baselineCommit, std::string_view candidateCommit, double alpha, double minSlowdown) const
+{
+	auto comparisons = std::vector<Comparison>();
+	for (auto candidate = m_results.rbegin(); candidate != m_results.rend(); ++candidate)
+	{
+		if (candidate->m_commit != candidateCommit)
+		{
+			continue;
+		}
+		// Only the last result of a case, the file is in the order of the runs.
+		auto isCompared = std::any_of(comparisons.begin(), comparisons.end(), [&](const Comparison& comparison) { return comparison.m_candidate->IsSameCase(*candidate); });
+		auto baseline = std::find_if(m_results.rbegin(), m_results.rend(), [&](const BenchmarkResult& result) { return result.m_commit == baselineCommit && result.IsSameCase(*candidate); });
+		if (isCompared || baseline == m_results.rend())
+		{
+			continue;
+		}
+
+		auto comparison = Comparison();
+		comparison.m_baseline = &*baseline;
+		comparison.m_candidate = &*candidate;
+		comparison.m_baselineMedian = GetMedian(baseline->m_samples);
+		comparison.m_candidateMedian = GetMedian(candidate->m_samples);
+		comparison.m_pValue = MannWhitneyPValue(baseline->m_samples, candidate->m_samples);
+		comparison.m_isRegression = comparison.m_pValue < alpha && comparison.m_candidateMedian > comparison.m_baselineMedian * (1.0 + minSlowdown);
+		comparisons.push_back(comparison);
+	}
+	std::reverse(comparisons.begin(), comparisons.end());
+	return comparisons;
+}
+
+std::vector<const BenchmarkResult*> ResultsStore::FindCasesWithoutBaseline(std::string_view baselineCommit, std::string_view candidateCommit) const
+{
+	auto cases = std::vector<const BenchmarkResult*>();
+	for (const auto& candidate : m_results)
+	{
+		if (candidate.m_commit != candidateCommit || std::any_of(cases.begin(), cases.end(), [&](const BenchmarkResult* result) { return result->IsSameCase(candidate); }))
+		{
+			continue;
+		}
+		const auto hasBaseline = std::any_of(m_results.begin(), m_results.end(), [&](const BenchmarkResult& result) { return result.m_commit == baselineCommit && result.IsSameCase(candidate); });
+		if (!hasBaseline)
+		{
+			cases.push_back(&candidate);
+		}
+	}
+	return cases;
+}
+
+void ResultsStore::PrintComparisons(const std::vector<Comparison>& comparisons)
+{
+	for (const auto& comparison : comparisons)
+	{
+		const auto& result = *comparison.m_candidate;
+		printf
+		(
+			"%s, %s, %s, %s, %llu: %fms -> %fms (%+.1f%%), p = %.4f%s\n",
+			result.m_device.c_str(),
+			result.m_mode.c_str(),
+			result.m_algorithm.c_str(),
+			result.m_distribution.c_str(),
+			static_cast<unsigned long long>(result.m_size),
+			comparison.m_baselineMedian,
+			comparison.m_candidateMedian,
+			(comparison.m_baselineMedian > 0.0) ? (comparison.m_candidateMedian / comparison.m_baselineMedian - 1.0) * 100.0 : 0.0,
+			comparison.m_pValue,
+			comparison.m_isRegression ? " REGRESSION" : ""
+		);
+	}
+}
+
+void ResultsStore::PrintCasesWithoutBaseline(const std::vector<const BenchmarkResult*>& cases)
+{
+	for (const auto* result : cases)
+	{
+		printf
+		(
+			"%s, %s, %s, %s, %llu: no baseline\n",
+			result->m_device.c_str(),
+			result->m_mode.c_str(),
+			result->m_algorithm.c_str(),
+			result->m_distribution.c_str(),
+			static_cast<unsigned long long>(result->m_size)
+		);
+	}
+}
+}
@@ -0,0 +1,58 @@
+﻿#pragma once
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace LearningWorkGraph
+{
+// Timed samples of one benchmark case on one device at one commit.
+struct BenchmarkResult
+{
+	std::string m_commit;
+	std::string m_device;
+	std::string m_mode;
+	std::string m_algorithm;
+	std::string m_distribution;
+	uint64_t m_size = 0;
+	// In milliseconds, one per iteration or frame.
+	std::vector<double> m_samples;
+
+	// Everything but the commit and the samples, the same case at two commits is compared.
+	bool IsSameCase(const BenchmarkResult& other) const;
+};
+
+// Two-sided Mann-Whitney U test of a and b, with the normal approximation and the tie correction. Returns the p-value.
+double MannWhitneyPValue(const std::vector<double>& a, const std::vector<double>& b);
+
+// Append-only text file of benchmark results, one line per result, so results of any commit stay comparable.
+class ResultsStore
+{
+public:
+	struct Comparison
+	{
+		const BenchmarkResult* m_baseline = nullptr;
+		const BenchmarkResult* m_candidate = nullptr;
+		double m_baselineMedian = 0.0;
+		double m_candidateMedian = 0.0;
+		double m_pValue = 1.0;
+		bool m_isRegression = false;
+	};
+
+	bool Load(std::string_view filePath);
+	static bool Append(std::string_view filePath, const BenchmarkResult& result);
+	const std::vector<BenchmarkResult>& GetResults() const { return m_results; }
+
+	// Compares the last result of every case at candidateCommit with the last result of that case at baselineCommit.
+	// A case regressed if the candidate median is slower by more than minSlowdown, relative, and the samples differ with p < alpha.
+	std::vector<Comparison> Compare(std::string_view baselineCommit, std::string_view candidateCommit, double alpha, double minSlowdown) const;
+	static void PrintComparisons(const std::vector<Comparison>& comparisons);
+	// Cases at candidateCommit without a result at baselineCommit, which Compare can't check.
+	std::vector<const BenchmarkResult*> FindCasesWithoutBaseline(std::string_view baselineCommit, std::string_view candidateCommit) const;
+	static void PrintCasesWithoutBaseline(const std::vector<const BenchmarkResult*>& cases);
+
+private:
+	std::vector<BenchmarkResult> m_results;
+};
+}
\ No newline at end of file
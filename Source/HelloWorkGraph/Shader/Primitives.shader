@@ -0,0 +1,511 @@
+﻿// Parallel primitives on 32-bit values: reduce, exclusive scan, histogram, stream compaction and group-by of sorted keys,
+// see Primitives.h and GroupBy.h for the CPU references.
+// They share the root signature of Shader.shader: t0 input, u0 output, u1 scratch, u2 counters and the pass constants in b1.
+// Sums wrap around at 2^32 like the CPU references.
+struct PrimitiveConstantBuffer
+{
+	uint numElements;
+	// Nonzero and different for every scan or compaction dispatch, so the look-back flags of previous dispatches are never taken as ready.
+	uint epoch;
+	// Histogram: shift of the digit. Compaction: mask. Group-by finalize: number of groups of the dispatch.
+	uint parameter0;
+	// Compaction: match.
+	uint parameter1;
+};
+ConstantBuffer<PrimitiveConstantBuffer> primitiveConstantBuffer : register(b1);
+
+ByteAddressBuffer input : register(t0);
+RWByteAddressBuffer output : register(u0);
+// [0] partition ticket and [1, 3) total of the look-back, then flag, aggregate and inclusive prefix per partition,
+// then two regions of partial sums of the reductions, see GetPartialSumAddress, then the segment heads of the group-by.
+globallycoherent RWByteAddressBuffer scratch : register(u1);
+// Arrival counters of the reductions, reset by the last arriving group.
+globallycoherent RWByteAddressBuffer counters : register(u2);
+
+#if !defined(NUM_THREADS)
+#	define NUM_THREADS 256
+#endif
+#if !defined(ITEMS_PER_THREAD)
+#	define ITEMS_PER_THREAD 4
+#endif
+#define PARTITION_SIZE (NUM_THREADS * ITEMS_PER_THREAD)
+#define HISTOGRAM_BUCKETS 256
+
+uint GetNumPartitions(uint numElements)
+{
+	return (numElements + PARTITION_SIZE - 1) / PARTITION_SIZE;
+}
+
+uint GetPartialSumAddress(uint region, uint index)
+{
+	const uint numPartitions = GetNumPartitions(primitiveConstantBuffer.numElements);
+	return (4 + numPartitions * 5 + region * numPartitions + index) * 4;
+}
+
+uint GetSegmentHeadAddress(uint segment)
+{
+	const uint numPartitions = GetNumPartitions(primitiveConstantBuffer.numElements);
+	return (4 + numPartitions * 7 + segment * 3) * 4;
+}
+
+uint LoadInput(uint index)
+{
+	return (index < primitiveConstantBuffer.numElements) ? input.Load(index * 4) : 0;
+}
+
+// Wave sums, for any wave size down to 4.
+groupshared uint waveTotals[NUM_THREADS / 4];
+groupshared uint groupTotal;
+
+uint GroupReduce(uint value, uint groupIndex)
+{
+	const uint waveSum = WaveActiveSum(value);
+	if (WaveIsFirstLane())
+	{
+		waveTotals[groupIndex / WaveGetLaneCount()] = waveSum;
+	}
+	GroupMemoryBarrierWithGroupSync();
+	if (groupIndex == 0)
+	{
+		uint sum = 0;
+		for (uint w = 0; w < NUM_THREADS / WaveGetLaneCount(); ++w)
+		{
+			sum += waveTotals[w];
+		}
+		groupTotal = sum;
+	}
+	GroupMemoryBarrierWithGroupSync();
+	return groupTotal;
+}
+
+// Scans two sums at once, the group-by counts segment heads and sums values together.
+groupshared uint2 waveScanTotals[NUM_THREADS / 4];
+groupshared uint2 groupScanTotal;
+
+// Returns the sum of value over the threads before groupIndex, the sum over the group goes to total.
+uint2 GroupExclusiveScan(uint2 value, uint groupIndex, out uint2 total)
+{
+	const uint2 wavePrefix = WavePrefixSum(value);
+	const uint waveIndex = groupIndex / WaveGetLaneCount();
+	if (WaveGetLaneIndex() == WaveGetLaneCount() - 1)
+	{
+		waveScanTotals[waveIndex] = wavePrefix + value;
+	}
+	GroupMemoryBarrierWithGroupSync();
+	if (groupIndex == 0)
+	{
+		uint2 sum = 0;
+		for (uint w = 0; w < NUM_THREADS / WaveGetLaneCount(); ++w)
+		{
+			const uint2 waveTotal = waveScanTotals[w];
+			waveScanTotals[w] = sum;
+			sum += waveTotal;
+		}
+		groupScanTotal = sum;
+	}
+	GroupMemoryBarrierWithGroupSync();
+	total = groupScanTotal;
+	return waveScanTotals[waveIndex] + wavePrefix;
+}
+
+// Sum of the ITEMS_PER_THREAD values of a thread, strided by the group so that the loads coalesce.
+uint LoadThreadSum(uint partitionIndex, uint groupIndex)
+{
+	uint sum = 0;
+	[unroll]
+	for (uint i = 0; i < ITEMS_PER_THREAD; ++i)
+	{
+		sum += LoadInput(partitionIndex * PARTITION_SIZE + i * NUM_THREADS + groupIndex);
+	}
+	return sum;
+}
+
+[numthreads(NUM_THREADS, 1, 1)]
+void ClearCSMain(uint dispatchThreadID : SV_DispatchThreadID)
+{
+	if (dispatchThreadID < primitiveConstantBuffer.numElements)
+	{
+		output.Store(dispatchThreadID * 4, 0);
+	}
+}
+
+// Reduction in one dispatch: every group stores its partial sum, and the last group to arrive sums the partial sums into output[0].
+groupshared uint isLastGroup;
+
+[numthreads(NUM_THREADS, 1, 1)]
+void ReduceCSMain(uint groupID : SV_GroupID, uint groupIndex : SV_GroupIndex)
+{
+	const uint numGroups = GetNumPartitions(primitiveConstantBuffer.numElements);
+	const uint groupSum = GroupReduce(LoadThreadSum(groupID, groupIndex), groupIndex);
+	if (groupIndex == 0)
+	{
+		scratch.Store(GetPartialSumAddress(0, groupID), groupSum);
+		DeviceMemoryBarrier();
+		uint finishedGroups = 0;
+		counters.InterlockedAdd(0, 1, finishedGroups);
+		isLastGroup = (finishedGroups + 1 == numGroups) ? 1 : 0;
+		if (isLastGroup)
+		{
+			counters.Store(0, 0);
+		}
+	}
+	GroupMemoryBarrierWithGroupSync();
+	if (!isLastGroup)
+	{
+		return;
+	}
+
+	uint sum = 0;
+	for (uint g = groupIndex; g < numGroups; g += NUM_THREADS)
+	{
+		sum += scratch.Load(GetPartialSumAddress(0, g));
+	}
+	sum = GroupReduce(sum, groupIndex);
+	if (groupIndex == 0)
+	{
+		output.Store(0, sum);
+	}
+}
+
+// Reduction tree as a work graph: every level reduces the partial sums of the previous one,
+// and the last group of a level launches the next level until one group is left.
+// The levels ping-pong between the two regions of partial sums, the first level reads input.
+#define REDUCE_MAX_DEPTH 8
+
+struct ReduceRecord
+{
+	uint dispatchGrid : SV_DispatchGrid;
+	uint numElements;
+	uint level;
+};
+
+uint LoadReduceLevel(uint level, uint index, uint numElements)
+{
+	if (index >= numElements)
+	{
+		return 0;
+	}
+	if (level == 0)
+	{
+		return input.Load(index * 4);
+	}
+	return scratch.Load(GetPartialSumAddress((level - 1) & 1, index));
+}
+
+[Shader("node")]
+[NodeLaunch("broadcasting")]
+[NodeIsProgramEntry]
+[NodeMaxDispatchGrid(65535, 1, 1)]
+[NumThreads(NUM_THREADS, 1, 1)]
+[NodeMaxRecursionDepth(REDUCE_MAX_DEPTH)]
+void ReduceNode
+(
+	uint groupID : SV_GroupID,
+	uint groupIndex : SV_GroupIndex,
+	DispatchNodeInputRecord<ReduceRecord> inputRecord,
+	[MaxRecords(1)] [NodeID("ReduceNode")] NodeOutput<ReduceRecord> nextLevelOutput
+)
+{
+	const ReduceRecord record = inputRecord.Get();
+	uint sum = 0;
+	[unroll]
+	for (uint i = 0; i < ITEMS_PER_THREAD; ++i)
+	{
+		sum += LoadReduceLevel(record.level, groupID * PARTITION_SIZE + i * NUM_THREADS + groupIndex, record.numElements);
+	}
+	sum = GroupReduce(sum, groupIndex);
+
+	if (groupIndex == 0)
+	{
+		isLastGroup = 0;
+		if (record.dispatchGrid == 1)
+		{
+			output.Store(0, sum);
+		}
+		else
+		{
+			scratch.Store(GetPartialSumAddress(record.level & 1, groupID), sum);
+			DeviceMemoryBarrier();
+			uint finishedGroups = 0;
+			counters.InterlockedAdd(record.level * 4, 1, finishedGroups);
+			if (finishedGroups + 1 == record.dispatchGrid)
+			{
+				counters.Store(record.level * 4, 0);
+				isLastGroup = 1;
+			}
+		}
+	}
+	Barrier(GROUP_SHARED_MEMORY, GROUP_SCOPE | GROUP_SYNC);
+
+	GroupNodeOutputRecords<ReduceRecord> nextLevel = nextLevelOutput.GetGroupNodeOutputRecords(isLastGroup);
+	if (isLastGroup)
+	{
+		nextLevel.Get().dispatchGrid = GetNumPartitions(record.dispatchGrid);
+		nextLevel.Get().numElements = record.dispatchGrid;
+		nextLevel.Get().level = record.level + 1;
+	}
+	nextLevel.OutputComplete();
+}
+
+// Decoupled look-back: every partition publishes its aggregate, then walks back over the previous partitions
+// until one with an inclusive prefix, and publishes its own inclusive prefix. Partitions are numbered in the order the groups
+// start, so the partitions a group waits on are always running.
+#define PARTITION_AGGREGATE 1
+#define PARTITION_PREFIX 2
+
+uint GetPartitionAddress(uint partitionIndex)
+{
+	return (4 + partitionIndex * 5) * 4;
+}
+
+void PublishPartition(uint partitionIndex, uint2 value, uint state)
+{
+	const uint address = GetPartitionAddress(partitionIndex);
+	scratch.Store2(address + ((state == PARTITION_PREFIX) ? 12 : 4), value);
+	DeviceMemoryBarrier();
+	scratch.Store(address, (primitiveConstantBuffer.epoch << 2) | state);
+}
+
+// Called by one thread of the group. Returns the sum over the partitions before partitionIndex.
+uint2 LookBack(uint partitionIndex, uint2 aggregate)
+{
+	PublishPartition(partitionIndex, aggregate, PARTITION_AGGREGATE);
+	uint2 exclusive = 0;
+	for (int p = int(partitionIndex) - 1; p >= 0;)
+	{
+		const uint address = GetPartitionAddress(p);
+		const uint flag = scratch.Load(address);
+		if ((flag >> 2) != primitiveConstantBuffer.epoch)
+		{
+			// Not published yet, spin.
+			continue;
+		}
+		DeviceMemoryBarrier();
+		if ((flag & 3) == PARTITION_PREFIX)
+		{
+			exclusive += scratch.Load2(address + 12);
+			break;
+		}
+		exclusive += scratch.Load2(address + 4);
+		--p;
+	}
+	PublishPartition(partitionIndex, exclusive + aggregate, PARTITION_PREFIX);
+	return exclusive;
+}
+
+groupshared uint partitionIndex;
+groupshared uint2 partitionExclusive;
+
+uint AcquirePartition(uint groupIndex)
+{
+	if (groupIndex == 0)
+	{
+		uint ticket = 0;
+		scratch.InterlockedAdd(0, 1, ticket);
+		partitionIndex = ticket;
+	}
+	GroupMemoryBarrierWithGroupSync();
+	return partitionIndex;
+}
+
+// Called by one thread of the last partition. Stores the total and resets the ticket for the next dispatch,
+// every group took its ticket before the last one was handed out.
+void FinishPartitions(uint partition, uint2 total)
+{
+	if (partition + 1 == GetNumPartitions(primitiveConstantBuffer.numElements))
+	{
+		scratch.Store2(4, total);
+		scratch.Store(0, 0);
+	}
+}
+
+// Exclusive scan in one pass. Every thread scans ITEMS_PER_THREAD consecutive values.
+[numthreads(NUM_THREADS, 1, 1)]
+void ScanCSMain(uint groupIndex : SV_GroupIndex)
+{
+	const uint partition = AcquirePartition(groupIndex);
+	const uint base = partition * PARTITION_SIZE + groupIndex * ITEMS_PER_THREAD;
+	uint values[ITEMS_PER_THREAD];
+	uint threadSum = 0;
+	[unroll]
+	for (uint i = 0; i < ITEMS_PER_THREAD; ++i)
+	{
+		values[i] = LoadInput(base + i);
+		threadSum += values[i];
+	}
+
+	uint2 aggregate = 0;
+	const uint threadPrefix = GroupExclusiveScan(uint2(threadSum, 0), groupIndex, aggregate).x;
+	if (groupIndex == 0)
+	{
+		partitionExclusive = LookBack(partition, aggregate);
+		FinishPartitions(partition, partitionExclusive + aggregate);
+	}
+	GroupMemoryBarrierWithGroupSync();
+
+	uint prefix = partitionExclusive.x + threadPrefix;
+	[unroll]
+	for (uint j = 0; j < ITEMS_PER_THREAD; ++j)
+	{
+		if (base + j < primitiveConstantBuffer.numElements)
+		{
+			output.Store((base + j) * 4, prefix);
+		}
+		prefix += values[j];
+	}
+}
+
+// Histogram of the 8-bit digit (value >> parameter0) & 255 into output, which ClearCSMain zeroes before.
+groupshared uint localHistogram[HISTOGRAM_BUCKETS];
+
+[numthreads(NUM_THREADS, 1, 1)]
+void HistogramCSMain(uint groupID : SV_GroupID, uint groupIndex : SV_GroupIndex)
+{
+	for (uint b = groupIndex; b < HISTOGRAM_BUCKETS; b += NUM_THREADS)
+	{
+		localHistogram[b] = 0;
+	}
+	GroupMemoryBarrierWithGroupSync();
+
+	[unroll]
+	for (uint i = 0; i < ITEMS_PER_THREAD; ++i)
+	{
+		const uint index = groupID * PARTITION_SIZE + i * NUM_THREADS + groupIndex;
+		if (index < primitiveConstantBuffer.numElements)
+		{
+			InterlockedAdd(localHistogram[(input.Load(index * 4) >> primitiveConstantBuffer.parameter0) & (HISTOGRAM_BUCKETS - 1)], 1);
+		}
+	}
+	GroupMemoryBarrierWithGroupSync();
+
+	for (uint bucket = groupIndex; bucket < HISTOGRAM_BUCKETS; bucket += NUM_THREADS)
+	{
+		if (localHistogram[bucket] > 0)
+		{
+			output.InterlockedAdd(bucket * 4, localHistogram[bucket]);
+		}
+	}
+}
+
+// Stream compaction: the values with (value & parameter0) == parameter1 in their order, their number goes to scratch[1].
+// Same look-back as ScanCSMain over the number of matches.
+bool IsMatch(uint value)
+{
+	return (value & primitiveConstantBuffer.parameter0) == primitiveConstantBuffer.parameter1;
+}
+
+[numthreads(NUM_THREADS, 1, 1)]
+void CompactCSMain(uint groupIndex : SV_GroupIndex)
+{
+	const uint partition = AcquirePartition(groupIndex);
+	const uint base = partition * PARTITION_SIZE + groupIndex * ITEMS_PER_THREAD;
+	uint values[ITEMS_PER_THREAD];
+	uint numMatches = 0;
+	[unroll]
+	for (uint i = 0; i < ITEMS_PER_THREAD; ++i)
+	{
+		values[i] = LoadInput(base + i);
+		numMatches += (base + i < primitiveConstantBuffer.numElements && IsMatch(values[i])) ? 1 : 0;
+	}
+
+	uint2 aggregate = 0;
+	const uint threadPrefix = GroupExclusiveScan(uint2(numMatches, 0), groupIndex, aggregate).x;
+	if (groupIndex == 0)
+	{
+		partitionExclusive = LookBack(partition, aggregate);
+		FinishPartitions(partition, partitionExclusive + aggregate);
+	}
+	GroupMemoryBarrierWithGroupSync();
+
+	uint destination = partitionExclusive.x + threadPrefix;
+	[unroll]
+	for (uint j = 0; j < ITEMS_PER_THREAD; ++j)
+	{
+		if (base + j < primitiveConstantBuffer.numElements && IsMatch(values[j]))
+		{
+			output.Store(destination * 4, values[j]);
+			++destination;
+		}
+	}
+}
+
+// Group-by over sorted keys: the keys of a group are adjacent after the sort, so a group starts at every key whose group differs
+// from the previous one. One look-back pass counts the heads and sums the values together, every head stores its row
+// {group, position, sum of the values before it}, then a second pass turns the rows into {group, count, sum} in output.
+// GROUP_BY_KEY_WORDS 1: the key is the group and the value is 1. 2: the high word is the group and the low word the value.
+#if !defined(GROUP_BY_KEY_WORDS)
+#	define GROUP_BY_KEY_WORDS 1
+#endif
+
+uint2 LoadGroupByKey(uint index)
+{
+#if GROUP_BY_KEY_WORDS == 2
+	const uint2 key = input.Load2(index * 8);
+	return uint2(key.y, key.x);
+#else
+	return uint2(input.Load(index * 4), 1);
+#endif
+}
+
+bool IsSegmentHead(uint index, uint group)
+{
+	return index == 0 || LoadGroupByKey(index - 1).x != group;
+}
+
+[numthreads(NUM_THREADS, 1, 1)]
+void GroupByHeadsCSMain(uint groupIndex : SV_GroupIndex)
+{
+	const uint partition = AcquirePartition(groupIndex);
+	const uint base = partition * PARTITION_SIZE + groupIndex * ITEMS_PER_THREAD;
+	uint2 keys[ITEMS_PER_THREAD];
+	uint2 threadSum = 0;
+	[unroll]
+	for (uint i = 0; i < ITEMS_PER_THREAD; ++i)
+	{
+		const bool isValid = base + i < primitiveConstantBuffer.numElements;
+		keys[i] = isValid ? LoadGroupByKey(base + i) : 0;
+		// The previous key of the thread is in registers, only the first one is loaded again.
+		const bool isHead = isValid && ((i == 0) ? IsSegmentHead(base, keys[0].x) : keys[i - 1].x != keys[i].x);
+		threadSum += uint2(isHead ? 1 : 0, isValid ? keys[i].y : 0);
+	}
+
+	uint2 aggregate = 0;
+	const uint2 threadPrefix = GroupExclusiveScan(threadSum, groupIndex, aggregate);
+	if (groupIndex == 0)
+	{
+		partitionExclusive = LookBack(partition, aggregate);
+		FinishPartitions(partition, partitionExclusive + aggregate);
+	}
+	GroupMemoryBarrierWithGroupSync();
+
+	// x is the number of heads before the key, which is the row of the key if it is a head.
+	uint2 prefix = partitionExclusive + threadPrefix;
+	[unroll]
+	for (uint j = 0; j < ITEMS_PER_THREAD; ++j)
+	{
+		const uint index = base + j;
+		if (index < primitiveConstantBuffer.numElements)
+		{
+			const bool isHead = (j == 0) ? IsSegmentHead(index, keys[0].x) : keys[j - 1].x != keys[j].x;
+			if (isHead)
+			{
+				scratch.Store3(GetSegmentHeadAddress(prefix.x), uint3(keys[j].x, index, prefix.y));
+				++prefix.x;
+			}
+			prefix.y += keys[j].y;
+		}
+	}
+}
+
+// Rows {group, count, sum} of the numUnique groups in scratch[1, 3) = {numUnique, total sum}, read back alone.
+[numthreads(NUM_THREADS, 1, 1)]
+void GroupByFinalizeCSMain(uint dispatchThreadID : SV_DispatchThreadID)
+{
+	const uint2 total = scratch.Load2(4);
+	for (uint row = dispatchThreadID; row < total.x; row += NUM_THREADS * primitiveConstantBuffer.parameter0)
+	{
+		const uint3 head = scratch.Load3(GetSegmentHeadAddress(row));
+		const uint2 next = (row + 1 < total.x) ? scratch.Load3(GetSegmentHeadAddress(row + 1)).yz : uint2(primitiveConstantBuffer.numElements, total.y);
+		output.Store3(row * 12, uint3(head.x, next.x - head.y, next.y - head.z));
+	}
+}
\ No newline at end of file
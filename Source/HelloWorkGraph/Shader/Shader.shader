@@ -1,13 +1,132 @@
 ﻿struct ApplicationConstantBuffer
 {
 	uint numSortElements;
-	uint3 dummy0;
+	uint numValidElements; // Keys before the padding.
+	uint2 dummy0;
 	uint4 dummy1[15];
 };
 ConstantBuffer<ApplicationConstantBuffer> applicationConstantBuffer : register(b0);
 
 globallycoherent  RWByteAddressBuffer output : register(u0);
 
+// Kernel variant, see KernelVariant.
+#if !defined(NUM_THREADS)
+#	define NUM_THREADS 1024
+#endif
+#if !defined(ELEMENTS_PER_THREAD)
+#	define ELEMENTS_PER_THREAD 1
+#endif
+
+// Key type, see SortKeyType.
+#define KEY_TYPE_UINT32 0
+#define KEY_TYPE_INT32 1
+#define KEY_TYPE_FLOAT 2
+#define KEY_TYPE_UINT64 3
+#define KEY_TYPE_INT64 4
+#define KEY_TYPE_DOUBLE 5
+#if !defined(KEY_TYPE)
+#	define KEY_TYPE KEY_TYPE_UINT32
+#endif
+
+// Keys are sorted as raw bits. The order-preserving transform is only applied for the comparison.
+#if KEY_TYPE >= KEY_TYPE_UINT64
+#	define KEY_SIZE 8
+typedef uint2 KeyBits; // x: low word, y: high word.
+
+#	define LOAD_KEY(buffer, index) buffer.Load2((index) * KEY_SIZE)
+#	define STORE_KEY(buffer, index, key) buffer.Store2((index) * KEY_SIZE, key)
+
+KeyBits LoadKey(uint index)
+{
+	return output.Load2(index * KEY_SIZE);
+}
+
+void StoreKey(uint index, KeyBits key)
+{
+	output.Store2(index * KEY_SIZE, key);
+}
+
+KeyBits ToOrdered(KeyBits bits)
+{
+#	if KEY_TYPE == KEY_TYPE_INT64
+	bits.y ^= 0x80000000;
+#	elif KEY_TYPE == KEY_TYPE_DOUBLE
+	if (bits.y >> 31)
+	{
+		bits = ~bits;
+	}
+	else
+	{
+		bits.y ^= 0x80000000;
+	}
+#	endif
+	return bits;
+}
+
+bool KeyLess(KeyBits a, KeyBits b)
+{
+	const KeyBits orderedA = ToOrdered(a);
+	const KeyBits orderedB = ToOrdered(b);
+	return (orderedA.y < orderedB.y) || (orderedA.y == orderedB.y && orderedA.x < orderedB.x);
+}
+#else
+#	define KEY_SIZE 4
+typedef uint KeyBits;
+
+#	define LOAD_KEY(buffer, index) buffer.Load((index) * KEY_SIZE)
+#	define STORE_KEY(buffer, index, key) buffer.Store((index) * KEY_SIZE, key)
+
+KeyBits LoadKey(uint index)
+{
+	return output.Load(index * KEY_SIZE);
+}
+
+void StoreKey(uint index, KeyBits key)
+{
+	output.Store(index * KEY_SIZE, key);
+}
+
+KeyBits ToOrdered(KeyBits bits)
+{
+#	if KEY_TYPE == KEY_TYPE_INT32
+	bits ^= 0x80000000;
+#	elif KEY_TYPE == KEY_TYPE_FLOAT
+	bits ^= (bits >> 31) ? 0xFFFFFFFF : 0x80000000;
+#	endif
+	return bits;
+}
+
+bool KeyLess(KeyBits a, KeyBits b)
+{
+	return ToOrdered(a) < ToOrdered(b);
+}
+#endif
+
+// Narrow keys, see NarrowKeyPacking. Keys are (key - minimum) in PACKED_KEY_BITS bits, lowest key in the lowest bits.
+#if defined(PACKED_KEY_BITS)
+#	define KEYS_PER_WORD (32 / PACKED_KEY_BITS)
+#	define PACKED_KEY_MASK ((1u << PACKED_KEY_BITS) - 1)
+
+uint ExtractKey(uint word, uint slot)
+{
+	return (word >> (slot * PACKED_KEY_BITS)) & PACKED_KEY_MASK;
+}
+
+uint InsertKey(uint word, uint slot, uint key)
+{
+	const uint shift = slot * PACKED_KEY_BITS;
+	return (word & ~(PACKED_KEY_MASK << shift)) | (key << shift);
+}
+#else
+#	define KEYS_PER_WORD 1
+#endif
+
+// One sort unit is one comparator, or KEYS_PER_WORD consecutive comparators for packed keys.
+uint GetNumSortUnits()
+{
+	return applicationConstantBuffer.numSortElements / 2 / KEYS_PER_WORD;
+}
+
 // https://www.bealto.com/gpu-sorting_parallel-bitonic-1.html	
 void BitonicSort(uint index, uint inc, uint dir)
 {
@@ -16,28 +135,172 @@ void BitonicSort(uint index, uint inc, uint dir)
 	const uint i = (index * 2) - low; // insert 0 at position INC
 
 	// Load
-	const uint a = output.Load(i * 4);
-	const uint b = output.Load((i + inc) * 4);
+	const KeyBits a = LoadKey(i);
+	const KeyBits b = LoadKey(i + inc);
 
 	// Sort & Store
 	{
 		const bool reverse = ((dir & i) == 0); // asc/desc order
-		const bool swap = reverse ? (a >= b) : (a < b);
+		const bool swap = reverse ? !KeyLess(a, b) : KeyLess(a, b);
 		if (swap)
 		{
 			// Store
-			output.Store(i * 4, b);
-			output.Store((i + inc) * 4, a);
+			StoreKey(i, b);
+			StoreKey(i + inc, a);
+		}
+	}
+}
+
+#if defined(PACKED_KEY_BITS)
+// The comparators of one unit always touch exactly two whole words, so no other thread writes them in the same pass.
+// For inc >= KEYS_PER_WORD the unit compares word0[k] with word1[k], otherwise it sorts within 2 * KEYS_PER_WORD consecutive keys.
+void BitonicSortPacked(uint unit, uint inc, uint dir)
+{
+	const uint mask = (inc - 1);
+	const uint firstIndex = unit * KEYS_PER_WORD;
+	const uint first = (firstIndex * 2) - (mask & firstIndex);
+	const uint word0 = first / KEYS_PER_WORD;
+	const uint word1 = (inc >= KEYS_PER_WORD) ? (first + inc) / KEYS_PER_WORD : word0 + 1;
+
+	// Load
+	const uint a = output.Load(word0 * 4);
+	const uint b = output.Load(word1 * 4);
+	uint keys[KEYS_PER_WORD * 2];
+	[unroll]
+	for (uint s = 0; s < KEYS_PER_WORD; ++s)
+	{
+		keys[s] = ExtractKey(a, s);
+		keys[KEYS_PER_WORD + s] = ExtractKey(b, s);
+	}
+
+	// Sort
+	[unroll]
+	for (uint k = 0; k < KEYS_PER_WORD; ++k)
+	{
+		const uint index = firstIndex + k;
+		const uint i = (index * 2) - (mask & index);
+		const uint x = (inc >= KEYS_PER_WORD) ? k : i - first;
+		const uint y = (inc >= KEYS_PER_WORD) ? KEYS_PER_WORD + k : x + inc;
+		const uint keyX = keys[x];
+		const uint keyY = keys[y];
+		const bool reverse = ((dir & i) == 0); // asc/desc order
+		const bool swap = reverse ? !(keyX < keyY) : (keyX < keyY);
+		if (swap)
+		{
+			keys[x] = keyY;
+			keys[y] = keyX;
+		}
+	}
+
+	// Store
+	uint sortedA = 0;
+	uint sortedB = 0;
+	[unroll]
+	for (uint t = 0; t < KEYS_PER_WORD; ++t)
+	{
+		sortedA = InsertKey(sortedA, t, keys[t]);
+		sortedB = InsertKey(sortedB, t, keys[KEYS_PER_WORD + t]);
+	}
+	output.Store(word0 * 4, sortedA);
+	output.Store(word1 * 4, sortedB);
+}
+#endif
+
+// Each thread sorts ELEMENTS_PER_THREAD consecutive units.
+void BitonicSortThread(uint threadIndex, uint inc, uint dir)
+{
+	[unroll]
+	for (uint k = 0; k < ELEMENTS_PER_THREAD; ++k)
+	{
+		const uint index = threadIndex * ELEMENTS_PER_THREAD + k;
+		if (index < GetNumSortUnits())
+		{
+#if defined(PACKED_KEY_BITS)
+			BitonicSortPacked(index, inc, dir);
+#else
+			BitonicSort(index, inc, dir);
+#endif
 		}
 	}
 }
 
+bool IsOutOfSortRange(uint threadIndex)
+{
+	return threadIndex * ELEMENTS_PER_THREAD >= GetNumSortUnits();
+}
+
+uint GetSortDispatchGrid()
+{
+	return max(1, GetNumSortUnits() / (NUM_THREADS * ELEMENTS_PER_THREAD));
+}
+
 #if defined(WORK_GRAPH_LAUNCHED_MULTI_DISPATCH_GRID) && WORK_GRAPH_LAUNCHED_MULTI_DISPATCH_GRID
 #	define ENABLE_WORK_GRAPH_LAUNCHED_MULTI_DISPATCH_GRID 1
 #else
 #	define ENABLE_WORK_GRAPH_LAUNCHED_MULTI_DISPATCH_GRID 0
 #endif
 
+#if defined(WORK_GRAPH_RECURSIVE) && WORK_GRAPH_RECURSIVE
+#	define ENABLE_WORK_GRAPH_RECURSIVE 1
+#else
+#	define ENABLE_WORK_GRAPH_RECURSIVE 0
+#endif
+
+// Per-node counters of the instrumentation build, see WorkGraphStats.h for the layout and the expected values.
+#if defined(WORK_GRAPH_STATS) && WORK_GRAPH_STATS
+#	define ENABLE_WORK_GRAPH_STATS 1
+#else
+#	define ENABLE_WORK_GRAPH_STATS 0
+#endif
+
+#define NODE_LAUNCH 0
+#define NODE_BITONIC_SORT 1
+#define NODE_SPLIT 2
+#define NODE_LEAF_SORT 3
+#define NODE_MERGE 4
+
+#define NODE_STAT_RECORDS_IN 0
+#define NODE_STAT_RECORDS_OUT 1
+#define NODE_STAT_GROUPS 2
+#define NODE_STAT_THREADS 3
+#define NODE_STAT_EARLY_EXITS 4
+#define NODE_STAT_COUNT 5
+
+#if ENABLE_WORK_GRAPH_STATS
+RWByteAddressBuffer nodeStats : register(u3);
+
+// Summed over the active lanes, so one atomic per wave.
+void AddNodeStat(uint node, uint stat, uint value)
+{
+	const uint sum = WaveActiveSum(value);
+	if (WaveIsFirstLane() && sum > 0)
+	{
+		nodeStats.InterlockedAdd((node * NODE_STAT_COUNT + stat) * 4, sum);
+	}
+}
+#else
+void AddNodeStat(uint node, uint stat, uint value)
+{
+}
+#endif
+
+// Called by every thread of a broadcasting node before it may exit, the first group counts the input record.
+void CountNodeGroup(uint node, uint groupID, uint groupIndex, bool isEarlyExit)
+{
+	AddNodeStat(node, NODE_STAT_RECORDS_IN, (groupID == 0 && groupIndex == 0) ? 1 : 0);
+	AddNodeStat(node, NODE_STAT_GROUPS, (groupIndex == 0) ? 1 : 0);
+	AddNodeStat(node, NODE_STAT_THREADS, 1);
+	AddNodeStat(node, NODE_STAT_EARLY_EXITS, isEarlyExit ? 1 : 0);
+}
+
+// Called by every invocation of a thread launch node.
+void CountNodeThread(uint node)
+{
+	AddNodeStat(node, NODE_STAT_RECORDS_IN, 1);
+	AddNodeStat(node, NODE_STAT_THREADS, 1);
+}
+
+#if !ENABLE_WORK_GRAPH_RECURSIVE
 #if ENABLE_WORK_GRAPH_LAUNCHED_MULTI_DISPATCH_GRID
 struct LaunchRecord
 {
@@ -60,13 +323,15 @@ struct PassRecord
 [NodeLaunch("broadcasting")]
 #if ENABLE_WORK_GRAPH_LAUNCHED_MULTI_DISPATCH_GRID
 [NodeMaxDispatchGrid(65535, 1, 1)]
-[NumThreads(1024, 1, 1)]
+[NumThreads(NUM_THREADS, 1, 1)]
 #else
 [NodeDispatchGrid(1, 1, 1)]
 [NumThreads(1, 1, 1)]
 #endif
 void LaunchWorkGraphNode
 (
+	uint groupID : SV_GroupID,
+	uint groupIndex : SV_GroupIndex,
 #if ENABLE_WORK_GRAPH_LAUNCHED_MULTI_DISPATCH_GRID
 	uint dispatchThreadID : SV_DispatchThreadID,
 	DispatchNodeInputRecord<LaunchRecord> launchRecord,
@@ -75,13 +340,17 @@ void LaunchWorkGraphNode
 )
 {
 #if ENABLE_WORK_GRAPH_LAUNCHED_MULTI_DISPATCH_GRID
-	if (dispatchThreadID >= applicationConstantBuffer.numSortElements / 2)
+	CountNodeGroup(NODE_LAUNCH, groupID, groupIndex, IsOutOfSortRange(dispatchThreadID));
+	if (IsOutOfSortRange(dispatchThreadID))
 	{
 		return;
 	}
+#else
+	CountNodeGroup(NODE_LAUNCH, groupID, groupIndex, false);
 #endif
 
 	const uint log2n = log2(applicationConstantBuffer.numSortElements);
+	AddNodeStat(NODE_LAUNCH, NODE_STAT_RECORDS_OUT, log2n * (log2n + 1) / 2);
 	uint inc = 0;
 
 	// Main-block.
@@ -100,7 +369,7 @@ void LaunchWorkGraphNode
 
 			ThreadNodeOutputRecords<PassRecord> passRecord = BitonicSortNode.GetThreadNodeOutputRecords(1);
 #if !ENABLE_WORK_GRAPH_LAUNCHED_MULTI_DISPATCH_GRID
-			passRecord.Get().dispatchGrid = max(1, applicationConstantBuffer.numSortElements / 2 / 1024);
+			passRecord.Get().dispatchGrid = GetSortDispatchGrid();
 #else
 			passRecord.Get().index = dispatchThreadID;
 #endif
@@ -119,13 +388,15 @@ void LaunchWorkGraphNode
 #else
 [NodeLaunch("broadcasting")]
 [NodeMaxDispatchGrid(65535, 1, 1)]
-[NumThreads(1024, 1, 1)]
+[NumThreads(NUM_THREADS, 1, 1)]
 #endif
 void BitonicSortNode
 (
 #if ENABLE_WORK_GRAPH_LAUNCHED_MULTI_DISPATCH_GRID
 	ThreadNodeInputRecord<PassRecord> passRecord
 #else
+	uint groupID : SV_GroupID,
+	uint groupIndex : SV_GroupIndex,
 	uint dispatchThreadID : SV_DispatchThreadID,
 	DispatchNodeInputRecord<PassRecord> passRecord
 #endif
@@ -133,34 +404,616 @@ void BitonicSortNode
 {
 #if ENABLE_WORK_GRAPH_LAUNCHED_MULTI_DISPATCH_GRID
 	const uint index = passRecord.Get().index;
+	CountNodeThread(NODE_BITONIC_SORT);
 #else
 	const uint index = dispatchThreadID;
+	CountNodeGroup(NODE_BITONIC_SORT, groupID, groupIndex, IsOutOfSortRange(dispatchThreadID));
 #endif
 	const uint inc = passRecord.Get().inc;
 	const uint dir = passRecord.Get().dir;
 #if !ENABLE_WORK_GRAPH_LAUNCHED_MULTI_DISPATCH_GRID
-	if (dispatchThreadID >= applicationConstantBuffer.numSortElements / 2)
+	if (IsOutOfSortRange(dispatchThreadID))
 	{
 		return;
 	}
 #endif
-	BitonicSort(index, inc, dir);
+	BitonicSortThread(index, inc, dir);
 }
+#endif
 
 struct PassConstantBuffer
 {
 	uint inc;
 	uint dir;
-	uint2 dummy;
+	uint numDeletes;
+	uint numInserts;
 };
 ConstantBuffer<PassConstantBuffer> passConstantBuffer : register(b1);
 
-[numthreads(1024, 1, 1)]
+[numthreads(NUM_THREADS, 1, 1)]
 void CSMain(uint dispatchThreadID : SV_DispatchThreadID)
 {
-	if (dispatchThreadID >= applicationConstantBuffer.numSortElements / 2)
+	if (IsOutOfSortRange(dispatchThreadID))
 	{
 		return;
 	}
-	BitonicSort(dispatchThreadID, passConstantBuffer.inc, passConstantBuffer.dir);
+	BitonicSortThread(dispatchThreadID, passConstantBuffer.inc, passConstantBuffer.dir);
+}
+
+#if defined(SORTING_NETWORK_SIZE)
+// SortingNetwork() is prepended by the application from the C++ comparator table, see SortingNetwork::GenerateHLSL.
+[numthreads(1, 1, 1)]
+void SortingNetworkCSMain()
+{
+	uint v[SORTING_NETWORK_SIZE];
+	[unroll]
+	for (uint i = 0; i < SORTING_NETWORK_SIZE; ++i)
+	{
+		v[i] = output.Load(i * 4);
+	}
+	SortingNetwork(v);
+	[unroll]
+	for (uint j = 0; j < SORTING_NETWORK_SIZE; ++j)
+	{
+		output.Store(j * 4, v[j]);
+	}
+}
+#endif
+
+// Reverse sort strategy: the pre-pass found the keys before the padding in descending order.
+[numthreads(NUM_THREADS, 1, 1)]
+void ReverseCSMain(uint dispatchThreadID : SV_DispatchThreadID)
+{
+	const uint numValidElements = applicationConstantBuffer.numValidElements;
+	if (dispatchThreadID >= numValidElements / 2)
+	{
+		return;
+	}
+	const uint i = dispatchThreadID;
+	const uint j = numValidElements - 1 - dispatchThreadID;
+	const KeyBits a = LoadKey(i);
+	const KeyBits b = LoadKey(j);
+	StoreKey(i, b);
+	StoreKey(j, a);
+}
+
+// Incremental sort, see SortDelta. delta holds the sorted deletes followed by the sorted inserts.
+ByteAddressBuffer delta : register(t0);
+globallycoherent RWByteAddressBuffer scratch : register(u1);
+
+#if !defined(MERGE_ELEMENTS_PER_THREAD)
+#	define MERGE_ELEMENTS_PER_THREAD 8
+#endif
+
+// First delta index in [begin, end) whose key is not less than (or, for upperBound, greater than) the value.
+uint DeltaBound(uint begin, uint end, KeyBits value, bool upperBound)
+{
+	while (begin < end)
+	{
+		const uint mid = (begin + end) / 2;
+		const KeyBits key = LOAD_KEY(delta, mid);
+		if (upperBound ? !KeyLess(value, key) : KeyLess(key, value))
+		{
+			begin = mid + 1;
+		}
+		else
+		{
+			end = mid;
+		}
+	}
+	return begin;
+}
+
+uint LowerBound(uint end, KeyBits value)
+{
+	uint begin = 0;
+	while (begin < end)
+	{
+		const uint mid = (begin + end) / 2;
+		if (KeyLess(LoadKey(mid), value))
+		{
+			begin = mid + 1;
+		}
+		else
+		{
+			end = mid;
+		}
+	}
+	return begin;
+}
+
+// One thread per sorted key. The k-th delete of a key removes its k-th occurrence, so the destination of a kept key
+// is its index minus the deletes of smaller keys and of its own key, found by binary search without a scan.
+[numthreads(NUM_THREADS, 1, 1)]
+void DeltaRemoveCSMain(uint dispatchThreadID : SV_DispatchThreadID)
+{
+	const uint i = dispatchThreadID;
+	if (i >= applicationConstantBuffer.numSortElements)
+	{
+		return;
+	}
+	const uint numDeletes = passConstantBuffer.numDeletes;
+	const KeyBits key = LoadKey(i);
+	const uint deletesBefore = DeltaBound(0, numDeletes, key, false);
+	const uint numKeyDeletes = DeltaBound(deletesBefore, numDeletes, key, true) - deletesBefore;
+	const uint occurrence = i - LowerBound(i, key);
+	if (occurrence < numKeyDeletes)
+	{
+		return;
+	}
+	STORE_KEY(scratch, i - deletesBefore - numKeyDeletes, key);
+}
+
+// Matches MergePathSplit in MergePath.h. a is the scratch buffer, b the inserts.
+uint MergePathSplit(uint diagonal, uint numA, uint numB)
+{
+	uint low = (diagonal > numB) ? diagonal - numB : 0;
+	uint high = min(diagonal, numA);
+	while (low < high)
+	{
+		const uint mid = (low + high) / 2;
+		if (!KeyLess(LOAD_KEY(delta, passConstantBuffer.numDeletes + diagonal - 1 - mid), LOAD_KEY(scratch, mid)))
+		{
+			low = mid + 1;
+		}
+		else
+		{
+			high = mid;
+		}
+	}
+	return low;
+}
+
+// Each thread finds the start of its MERGE_ELEMENTS_PER_THREAD outputs on the merge path and merges them serially.
+[numthreads(NUM_THREADS, 1, 1)]
+void MergePathCSMain(uint dispatchThreadID : SV_DispatchThreadID)
+{
+	const uint numA = applicationConstantBuffer.numSortElements - passConstantBuffer.numDeletes;
+	const uint numB = passConstantBuffer.numInserts;
+	const uint begin = dispatchThreadID * MERGE_ELEMENTS_PER_THREAD;
+	const uint end = min(begin + MERGE_ELEMENTS_PER_THREAD, numA + numB);
+	if (begin >= end)
+	{
+		return;
+	}
+	uint a = MergePathSplit(begin, numA, numB);
+	uint b = begin - a;
+	for (uint k = begin; k < end; ++k)
+	{
+		bool takeA = (a < numA);
+		if (takeA && b < numB)
+		{
+			takeA = !KeyLess(LOAD_KEY(delta, passConstantBuffer.numDeletes + b), LOAD_KEY(scratch, a));
+		}
+		if (takeA)
+		{
+			StoreKey(k, LOAD_KEY(scratch, a));
+			++a;
+		}
+		else
+		{
+			StoreKey(k, LOAD_KEY(delta, passConstantBuffer.numDeletes + b));
+			++b;
+		}
+	}
+}
+
+// Run merge: delta holds the number of runs, the run starts and the number of keys. Each pass merges pairs of inputs
+// of passConstantBuffer.inc runs from the sort buffer into the scratch buffer, or back if passConstantBuffer.dir is set.
+uint RunStart(uint run)
+{
+	return delta.Load((1 + min(run, delta.Load(0))) * 4);
+}
+
+KeyBits LoadRunKey(bool fromScratch, uint index)
+{
+	if (fromScratch)
+	{
+		return LOAD_KEY(scratch, index);
+	}
+	return LOAD_KEY(output, index);
+}
+
+void StoreRunKey(bool toScratch, uint index, KeyBits key)
+{
+	if (toScratch)
+	{
+		STORE_KEY(scratch, index, key);
+	}
+	else
+	{
+		STORE_KEY(output, index, key);
+	}
+}
+
+// Matches MergePathSplit in MergePath.h. a is [first, middle), b is [middle, middle + numB).
+uint RunMergeSplit(bool fromScratch, uint first, uint middle, uint diagonal, uint numA, uint numB)
+{
+	uint low = (diagonal > numB) ? diagonal - numB : 0;
+	uint high = min(diagonal, numA);
+	while (low < high)
+	{
+		const uint mid = (low + high) / 2;
+		if (!KeyLess(LoadRunKey(fromScratch, middle + diagonal - 1 - mid), LoadRunKey(fromScratch, first + mid)))
+		{
+			low = mid + 1;
+		}
+		else
+		{
+			high = mid;
+		}
+	}
+	return low;
+}
+
+// Each thread merges MERGE_ELEMENTS_PER_THREAD outputs like MergePathCSMain, continuing into the next pair of inputs
+// when its outputs cross one.
+[numthreads(NUM_THREADS, 1, 1)]
+void RunMergeCSMain(uint dispatchThreadID : SV_DispatchThreadID)
+{
+	const uint numRuns = delta.Load(0);
+	const uint runsPerPair = passConstantBuffer.inc * 2;
+	const bool fromScratch = (passConstantBuffer.dir != 0);
+	uint k = dispatchThreadID * MERGE_ELEMENTS_PER_THREAD;
+	const uint end = min(k + MERGE_ELEMENTS_PER_THREAD, RunStart(numRuns));
+	while (k < end)
+	{
+		// The last pair starting at or before k.
+		uint pair = 0;
+		uint high = (numRuns + runsPerPair - 1) / runsPerPair;
+		while (high - pair > 1)
+		{
+			const uint mid = (pair + high) / 2;
+			if (RunStart(mid * runsPerPair) <= k)
+			{
+				pair = mid;
+			}
+			else
+			{
+				high = mid;
+			}
+		}
+		const uint first = RunStart(pair * runsPerPair);
+		const uint middle = RunStart(pair * runsPerPair + passConstantBuffer.inc);
+		const uint last = RunStart(pair * runsPerPair + runsPerPair);
+		const uint numA = middle - first;
+		const uint numB = last - middle;
+		uint a = RunMergeSplit(fromScratch, first, middle, k - first, numA, numB);
+		uint b = k - first - a;
+		const uint pairEnd = min(end, last);
+		for (; k < pairEnd; ++k)
+		{
+			bool takeA = (a < numA);
+			if (takeA && b < numB)
+			{
+				takeA = !KeyLess(LoadRunKey(fromScratch, middle + b), LoadRunKey(fromScratch, first + a));
+			}
+			if (takeA)
+			{
+				StoreRunKey(!fromScratch, k, LoadRunKey(fromScratch, first + a));
+				++a;
+			}
+			else
+			{
+				StoreRunKey(!fromScratch, k, LoadRunKey(fromScratch, middle + b));
+				++b;
+			}
+		}
+	}
+}
+
+#if ENABLE_WORK_GRAPH_RECURSIVE
+// Recursive topology, see WorkGraphSortModel. SplitNode halves its range down to leaves that fit into groupshared memory,
+// LeafSortNode sorts a leaf, and the last of two sibling ranges to finish launches the MergeNode of their parent.
+// Ranges are nodes of an implicit binary tree: the children of node i are 2i + 1 and 2i + 2.
+#if defined(PACKED_KEY_BITS)
+#	error The recursive topology does not support packed keys.
+#endif
+
+#define RECURSIVE_LEAF_SIZE (NUM_THREADS * 2)
+#define RECURSIVE_MAX_DEPTH 24
+
+// [0, numTreeNodes): finished children per node. [numTreeNodes, 2 * numTreeNodes): finished merge groups per node.
+// Every counter is reset by the thread that sees it complete, so they are zero again for the next dispatch.
+globallycoherent RWByteAddressBuffer counters : register(u2);
+
+struct SortRangeRecord
+{
+	uint begin;
+	uint count;
+	uint nodeIndex;
+};
+
+struct MergeRecord
+{
+	uint dispatchGrid : SV_DispatchGrid;
+	uint begin;
+	uint count;
+	uint nodeIndex;
+};
+
+uint GetNumTreeNodes()
+{
+	return max(1, applicationConstantBuffer.numSortElements / RECURSIVE_LEAF_SIZE) * 2;
+}
+
+uint GetTreeDepth(uint nodeIndex)
+{
+	return firstbithigh(nodeIndex + 1);
+}
+
+// Merges of depth d write to the buffer of depth d, so that the root ends in output. Leaves write to the buffer of their depth.
+bool IsScratchDepth(uint depth)
+{
+	return (depth & 1) != 0;
+}
+
+KeyBits LoadDepthKey(uint depth, uint index)
+{
+	if (IsScratchDepth(depth))
+	{
+		return LOAD_KEY(scratch, index);
+	}
+	return LoadKey(index);
+}
+
+void StoreDepthKey(uint depth, uint index, KeyBits key)
+{
+	if (IsScratchDepth(depth))
+	{
+		STORE_KEY(scratch, index, key);
+	}
+	else
+	{
+		StoreKey(index, key);
+	}
 }
+
+// Clamped to NodeMaxDispatchGrid of MergeNode, the threads of larger ranges stride over the grid.
+uint GetMergeDispatchGrid(uint count)
+{
+	return clamp(count / (NUM_THREADS * MERGE_ELEMENTS_PER_THREAD), 1, 65535);
+}
+
+// Called by one thread when the range of nodeIndex is complete. Returns true if its sibling is complete too, so the parent can be merged.
+bool CompleteChild(uint nodeIndex)
+{
+	if (nodeIndex == 0)
+	{
+		return false;
+	}
+	const uint parentIndex = (nodeIndex - 1) / 2;
+	uint finishedChildren = 0;
+	counters.InterlockedAdd(parentIndex * 4, 1, finishedChildren);
+	if (finishedChildren == 0)
+	{
+		return false;
+	}
+	counters.Store(parentIndex * 4, 0);
+	return true;
+}
+
+MergeRecord GetParentMergeRecord(uint begin, uint count, uint nodeIndex)
+{
+	// Left children have odd indices.
+	MergeRecord record;
+	record.count = count * 2;
+	record.begin = (nodeIndex & 1) ? begin : begin - count;
+	record.nodeIndex = (nodeIndex - 1) / 2;
+	record.dispatchGrid = GetMergeDispatchGrid(record.count);
+	return record;
+}
+
+[Shader("node")]
+[NodeLaunch("thread")]
+[NodeIsProgramEntry]
+[NodeMaxRecursionDepth(RECURSIVE_MAX_DEPTH)]
+void SplitNode
+(
+	ThreadNodeInputRecord<SortRangeRecord> rangeRecord,
+	[MaxRecords(2)] [NodeID("SplitNode")] NodeOutput<SortRangeRecord> splitOutput,
+	[MaxRecords(2)] [NodeID("LeafSortNode")] NodeOutput<SortRangeRecord> leafOutput
+)
+{
+	const SortRangeRecord range = rangeRecord.Get();
+	CountNodeThread(NODE_SPLIT);
+
+	// A range that already fits is a single leaf, otherwise both halves go to leaves or are split again.
+	const uint numChildren = (range.count <= RECURSIVE_LEAF_SIZE) ? 1 : 2;
+	AddNodeStat(NODE_SPLIT, NODE_STAT_RECORDS_OUT, numChildren);
+	const uint childCount = range.count / numChildren;
+	const bool isLeaf = (childCount <= RECURSIVE_LEAF_SIZE);
+	ThreadNodeOutputRecords<SortRangeRecord> splitRecords = splitOutput.GetThreadNodeOutputRecords(isLeaf ? 0 : numChildren);
+	ThreadNodeOutputRecords<SortRangeRecord> leafRecords = leafOutput.GetThreadNodeOutputRecords(isLeaf ? numChildren : 0);
+	for (uint c = 0; c < numChildren; ++c)
+	{
+		SortRangeRecord child;
+		child.begin = range.begin + c * childCount;
+		child.count = childCount;
+		child.nodeIndex = (numChildren == 1) ? range.nodeIndex : range.nodeIndex * 2 + 1 + c;
+		if (isLeaf)
+		{
+			leafRecords.Get(c) = child;
+		}
+		else
+		{
+			splitRecords.Get(c) = child;
+		}
+	}
+	splitRecords.OutputComplete();
+	leafRecords.OutputComplete();
+}
+
+groupshared KeyBits leafKeys[RECURSIVE_LEAF_SIZE];
+groupshared uint isLastArrival;
+
+[Shader("node")]
+[NodeLaunch("broadcasting")]
+[NodeDispatchGrid(1, 1, 1)]
+[NumThreads(NUM_THREADS, 1, 1)]
+void LeafSortNode
+(
+	uint groupIndex : SV_GroupIndex,
+	DispatchNodeInputRecord<SortRangeRecord> rangeRecord,
+	[MaxRecords(1)] [NodeID("MergeNode")] NodeOutput<MergeRecord> mergeOutput
+)
+{
+	const SortRangeRecord range = rangeRecord.Get();
+	const uint depth = GetTreeDepth(range.nodeIndex);
+	CountNodeGroup(NODE_LEAF_SORT, 0, groupIndex, false);
+
+	// Load
+	[unroll]
+	for (uint l = 0; l < 2; ++l)
+	{
+		const uint k = groupIndex + l * NUM_THREADS;
+		if (k < range.count)
+		{
+			leafKeys[k] = LoadKey(range.begin + k);
+		}
+	}
+	GroupMemoryBarrierWithGroupSync();
+
+	// Bitonic sort in groupshared memory, one comparator per thread and step.
+	for (uint size = 2; size <= range.count; size *= 2)
+	{
+		for (uint stride = size / 2; stride > 0; stride /= 2)
+		{
+			if (groupIndex < range.count / 2)
+			{
+				const uint i = groupIndex * 2 - (groupIndex & (stride - 1));
+				const uint j = i + stride;
+				const bool ascending = ((i & size) == 0);
+				const KeyBits a = leafKeys[i];
+				const KeyBits b = leafKeys[j];
+				if (KeyLess(b, a) == ascending)
+				{
+					leafKeys[i] = b;
+					leafKeys[j] = a;
+				}
+			}
+			GroupMemoryBarrierWithGroupSync();
+		}
+	}
+
+	// Store
+	[unroll]
+	for (uint s = 0; s < 2; ++s)
+	{
+		const uint k = groupIndex + s * NUM_THREADS;
+		if (k < range.count)
+		{
+			StoreDepthKey(depth, range.begin + k, leafKeys[k]);
+		}
+	}
+	Barrier(UAV_MEMORY, DEVICE_SCOPE | GROUP_SYNC);
+
+	if (groupIndex == 0)
+	{
+		isLastArrival = CompleteChild(range.nodeIndex) ? 1 : 0;
+	}
+	Barrier(GROUP_SHARED_MEMORY, GROUP_SCOPE | GROUP_SYNC);
+
+	GroupNodeOutputRecords<MergeRecord> mergeRecord = mergeOutput.GetGroupNodeOutputRecords(isLastArrival);
+	if (isLastArrival)
+	{
+		mergeRecord.Get() = GetParentMergeRecord(range.begin, range.count, range.nodeIndex);
+	}
+	mergeRecord.OutputComplete();
+	AddNodeStat(NODE_LEAF_SORT, NODE_STAT_RECORDS_OUT, (groupIndex == 0) ? isLastArrival : 0);
+}
+
+// Same as MergePathSplit in MergePath.h, over the two halves of a range in the buffer of depth.
+uint RangeMergePathSplit(uint depth, uint begin, uint half, uint diagonal)
+{
+	uint low = (diagonal > half) ? diagonal - half : 0;
+	uint high = min(diagonal, half);
+	while (low < high)
+	{
+		const uint mid = (low + high) / 2;
+		if (!KeyLess(LoadDepthKey(depth, begin + half + diagonal - 1 - mid), LoadDepthKey(depth, begin + mid)))
+		{
+			low = mid + 1;
+		}
+		else
+		{
+			high = mid;
+		}
+	}
+	return low;
+}
+
+[Shader("node")]
+[NodeLaunch("broadcasting")]
+[NodeMaxDispatchGrid(65535, 1, 1)]
+[NumThreads(NUM_THREADS, 1, 1)]
+[NodeMaxRecursionDepth(RECURSIVE_MAX_DEPTH)]
+void MergeNode
+(
+	uint groupID : SV_GroupID,
+	uint dispatchThreadID : SV_DispatchThreadID,
+	uint groupIndex : SV_GroupIndex,
+	DispatchNodeInputRecord<MergeRecord> mergeRecord,
+	[MaxRecords(1)] [NodeID("MergeNode")] NodeOutput<MergeRecord> mergeOutput
+)
+{
+	const MergeRecord range = mergeRecord.Get();
+	const uint depth = GetTreeDepth(range.nodeIndex);
+	const uint sourceDepth = depth + 1;
+	const uint half = range.count / 2;
+
+	// Each thread merges MERGE_ELEMENTS_PER_THREAD outputs from the buffer of the children into the buffer of this depth,
+	// and strides over the grid when the range has more outputs than the clamped grid has threads.
+	const uint gridStride = range.dispatchGrid * NUM_THREADS * MERGE_ELEMENTS_PER_THREAD;
+	const uint firstBegin = dispatchThreadID * MERGE_ELEMENTS_PER_THREAD;
+	CountNodeGroup(NODE_MERGE, groupID, groupIndex, firstBegin >= range.count);
+	for (uint begin = firstBegin; begin < range.count; begin += gridStride)
+	{
+		const uint end = min(begin + MERGE_ELEMENTS_PER_THREAD, range.count);
+		uint a = RangeMergePathSplit(sourceDepth, range.begin, half, begin);
+		uint b = begin - a;
+		for (uint k = begin; k < end; ++k)
+		{
+			bool takeA = (a < half);
+			if (takeA && b < half)
+			{
+				takeA = !KeyLess(LoadDepthKey(sourceDepth, range.begin + half + b), LoadDepthKey(sourceDepth, range.begin + a));
+			}
+			if (takeA)
+			{
+				StoreDepthKey(depth, range.begin + k, LoadDepthKey(sourceDepth, range.begin + a));
+				++a;
+			}
+			else
+			{
+				StoreDepthKey(depth, range.begin + k, LoadDepthKey(sourceDepth, range.begin + half + b));
+				++b;
+			}
+		}
+	}
+	Barrier(UAV_MEMORY, DEVICE_SCOPE | GROUP_SYNC);
+
+	// The last group of the merge completes the node.
+	if (groupIndex == 0)
+	{
+		const uint groupCounter = (GetNumTreeNodes() + range.nodeIndex) * 4;
+		uint finishedGroups = 0;
+		counters.InterlockedAdd(groupCounter, 1, finishedGroups);
+		isLastArrival = 0;
+		if (finishedGroups + 1 == range.dispatchGrid)
+		{
+			counters.Store(groupCounter, 0);
+			isLastArrival = CompleteChild(range.nodeIndex) ? 1 : 0;
+		}
+	}
+	Barrier(GROUP_SHARED_MEMORY, GROUP_SCOPE | GROUP_SYNC);
+
+	GroupNodeOutputRecords<MergeRecord> parentRecord = mergeOutput.GetGroupNodeOutputRecords(isLastArrival);
+	if (isLastArrival)
+	{
+		parentRecord.Get() = GetParentMergeRecord(range.begin, range.count, range.nodeIndex);
+	}
+	parentRecord.OutputComplete();
+	AddNodeStat(NODE_MERGE, NODE_STAT_RECORDS_OUT, (groupIndex == 0) ? isLastArrival : 0);
+}
+#endif
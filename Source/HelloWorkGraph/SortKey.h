@@ -0,0 +1,178 @@
+﻿#pragma once
+
+#include <algorithm>
+#include <bit>
+#include <cstdint>
+#include <cstring>
+#include <random>
+#include <string_view>
+#include <type_traits>
+
+namespace LearningWorkGraph
+{
+// Matches KEY_TYPE in Shader.shader.
+enum class SortKeyType : uint32_t
+{
+	UInt32 = 0,
+	Int32,
+	Float,
+	UInt64,
+	Int64,
+	Double,
+	Count
+};
+
+// Order-preserving bit transforms: comparing ToOrdered(bits) as unsigned integers gives the key order.
+template<typename Key>
+struct SortKeyTraits;
+
+template<>
+struct SortKeyTraits<uint32_t>
+{
+	using Bits = uint32_t;
+	static constexpr SortKeyType k_type = SortKeyType::UInt32;
+	static constexpr std::string_view k_name = "uint32";
+	static constexpr Bits ToOrdered(Bits bits) { return bits; }
+	static constexpr Bits FromOrdered(Bits ordered) { return ordered; }
+};
+
+template<>
+struct SortKeyTraits<int32_t>
+{
+	using Bits = uint32_t;
+	static constexpr SortKeyType k_type = SortKeyType::Int32;
+	static constexpr std::string_view k_name = "int32";
+	static constexpr Bits ToOrdered(Bits bits) { return bits ^ 0x80000000u; }
+	static constexpr Bits FromOrdered(Bits ordered) { return ordered ^ 0x80000000u; }
+};
+
+template<>
+struct SortKeyTraits<float>
+{
+	using Bits = uint32_t;
+	static constexpr SortKeyType k_type = SortKeyType::Float;
+	static constexpr std::string_view k_name = "float";
+	// Negative values have all bits flipped, positive values only the sign bit.
+	static constexpr Bits ToOrdered(Bits bits) { return bits ^ ((bits >> 31) ? 0xFFFFFFFFu : 0x80000000u); }
+	static constexpr Bits FromOrdered(Bits ordered) { return ordered ^ ((ordered >> 31) ? 0x80000000u : 0xFFFFFFFFu); }
+};
+
+template<>
+struct SortKeyTraits<uint64_t>
+{
+	using Bits = uint64_t;
+	static constexpr SortKeyType k_type = SortKeyType::UInt64;
+	static constexpr std::string_view k_name = "uint64";
+	static constexpr Bits ToOrdered(Bits bits) { return bits; }
+	static constexpr Bits FromOrdered(Bits ordered) { return ordered; }
+};
+
+template<>
+struct SortKeyTraits<int64_t>
+{
+	using Bits = uint64_t;
+	static constexpr SortKeyType k_type = SortKeyType::Int64;
+	static constexpr std::string_view k_name = "int64";
+	static constexpr Bits ToOrdered(Bits bits) { return bits ^ 0x8000000000000000ull; }
+	static constexpr Bits FromOrdered(Bits ordered) { return ordered ^ 0x8000000000000000ull; }
+};
+
+template<>
+struct SortKeyTraits<double>
+{
+	using Bits = uint64_t;
+	static constexpr SortKeyType k_type = SortKeyType::Double;
+	static constexpr std::string_view k_name = "double";
+	static constexpr Bits ToOrdered(Bits bits) { return bits ^ ((bits >> 63) ? 0xFFFFFFFFFFFFFFFFull : 0x8000000000000000ull); }
+	static constexpr Bits FromOrdered(Bits ordered) { return ordered ^ ((ordered >> 63) ? 0x8000000000000000ull : 0xFFFFFFFFFFFFFFFFull); }
+};
+
+template<typename Key>
+constexpr typename SortKeyTraits<Key>::Bits ToOrderedBits(Key key)
+{
+	return SortKeyTraits<Key>::ToOrdered(std::bit_cast<typename SortKeyTraits<Key>::Bits>(key));
+}
+
+template<typename Key>
+constexpr Key FromOrderedBits(typename SortKeyTraits<Key>::Bits ordered)
+{
+	return std::bit_cast<Key>(SortKeyTraits<Key>::FromOrdered(ordered));
+}
+
+// The key that sorts after every other key, used to pad the array to a power of two.
+template<typename Key>
+constexpr Key GetPaddingKey()
+{
+	return FromOrderedBits<Key>(~typename SortKeyTraits<Key>::Bits(0));
+}
+
+// Calls function(std::type_identity<Key>()) with the C++ type of the key type.
+template<typename Function>
+decltype(auto) VisitSortKeyType(SortKeyType type, Function&& function)
+{
+	switch (type)
+	{
+	case SortKeyType::Int32: return function(std::type_identity<int32_t>());
+	case SortKeyType::Float: return function(std::type_identity<float>());
+	case SortKeyType::UInt64: return function(std::type_identity<uint64_t>());
+	case SortKeyType::Int64: return function(std::type_identity<int64_t>());
+	case SortKeyType::Double: return function(std::type_identity<double>());
+	default: return function(std::type_identity<uint32_t>());
+	}
+}
+
+inline uint32_t GetSortKeySize(SortKeyType type)
+{
+	return VisitSortKeyType(type, []<typename Key>(std::type_identity<Key>) { return static_cast<uint32_t>(sizeof(Key)); });
+}
+
+inline std::string_view GetSortKeyName(SortKeyType type)
+{
+	return VisitSortKeyType(type, []<typename Key>(std::type_identity<Key>) { return SortKeyTraits<Key>::k_name; });
+}
+
+inline bool FindSortKeyType(std::string_view name, SortKeyType& type)
+{
+	for (uint32_t i = 0; i < static_cast<uint32_t>(SortKeyType::Count); ++i)
+	{
+		if (GetSortKeyName(static_cast<SortKeyType>(i)) == name)
+		{
+			type = static_cast<SortKeyType>(i);
+			return true;
+		}
+	}
+	return false;
+}
+
+// Keys with roughly numValues distinct values, centered on zero for signed types.
+template<typename Key>
+void GenerateSortKeys(std::mt19937& randomEngine, uint32_t numValues, Key* keys, size_t count)
+{
+	const auto range = (std::max)(numValues, 1u);
+	if constexpr (std::is_floating_point_v<Key>)
+	{
+		auto random = std::uniform_real_distribution<Key>(-static_cast<Key>(range) / 2, static_cast<Key>(range) / 2);
+		std::generate(keys, keys + count, [&] { return random(randomEngine); });
+	}
+	else
+	{
+		auto random = std::uniform_int_distribution<uint32_t>(0, range - 1);
+		const auto offset = std::is_signed_v<Key> ? static_cast<int64_t>(range / 2) : 0;
+		// 64-bit keys get random low words so that the comparison has to look past the high word.
+		const auto shift = (sizeof(Key) == 8) ? 32 : 0;
+		std::generate(keys, keys + count, [&]
+		{
+			const auto high = static_cast<int64_t>(random(randomEngine)) - offset;
+			const auto low = (sizeof(Key) == 8) ? static_cast<uint64_t>(randomEngine()) : 0;
+			return static_cast<Key>(static_cast<uint64_t>(high) << shift | low);
+		});
+	}
+}
+
+// CPU reference with the same ordering as the kernels.
+template<typename Key>
+void ReferenceSort(Key* keys, size_t count)
+{
+	std::sort(keys, keys + count, [](Key a, Key b) { return ToOrderedBits(a) < ToOrderedBits(b); });
+}
+}
\ No newline at end of file
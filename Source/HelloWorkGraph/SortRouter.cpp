@@ -0,0 +1,151 @@
+﻿#include "SortRouter.h"
+
+#include <algorithm>
+#include <charconv>
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+
+namespace LearningWorkGraph
+{
+namespace
+{
+template<typename T>
+bool ParseNumber(std::string_view text, T& value)
+{
+	const auto* end = text.data() + text.size();
+	const auto result = std::from_chars(text.data(), end, value);
+	return result.ec == std::errc() && result.ptr == end;
+}
+}
+
+void SortRouter::SetCost(std::string_view device, std::string_view engine, uint32_t numKeys, double time)
+{
+	auto found = std::find_if(m_entries.begin(), m_entries.end(), [&](const Entry& entry)
+	{
+		return entry.m_device == device && entry.m_engine == engine && entry.m_numKeys == numKeys;
+	});
+	if (found == m_entries.end())
+	{
+		m_entries.push_back({ std::string(device), std::string(engine), numKeys, time });
+		return;
+	}
+	found->m_time = time;
+}
+
+double SortRouter::Predict(std::string_view device, std::string_view engine, uint32_t numKeys) const
+{
+	auto points = std::vector<const Entry*>();
+	for (const auto& entry : m_entries)
+	{
+		if (entry.m_device == device && entry.m_engine == engine)
+		{
+			points.push_back(&entry);
+		}
+	}
+	if (points.empty())
+	{
+		return -1.0;
+	}
+	if (points.size() == 1)
+	{
+		return points[0]->m_time * numKeys / points[0]->m_numKeys;
+	}
+
+	// Segment containing numKeys, or the first or last segment outside of the measured sizes.
+	std::sort(points.begin(), points.end(), [](const Entry* a, const Entry* b) { return a->m_numKeys < b->m_numKeys; });
+	auto upper = std::upper_bound(points.begin() + 1, points.end() - 1, numKeys, [](uint32_t n, const Entry* entry) { return n < entry->m_numKeys; });
+	const auto* a = *(upper - 1);
+	const auto* b = *upper;
+	const auto x = std::log2(static_cast<double>((std::max)(numKeys, 1u)));
+	const auto xa = std::log2(static_cast<double>(a->m_numKeys));
+	const auto xb = std::log2(static_cast<double>(b->m_numKeys));
+	const auto ya = std::log2((std::max)(a->m_time, 1e-6));
+	const auto yb = std::log2((std::max)(b->m_time, 1e-6));
+	return std::exp2(ya + (yb - ya) * (x - xa) / (xb - xa));
+}
+
+std::optional<size_t> SortRouter::Route(std::string_view device, const std::vector<std::string_view>& engines, uint32_t numKeys) const
+{
+	auto best = std::optional<size_t>();
+	auto bestTime = 0.0;
+	for (size_t i = 0; i < engines.size(); ++i)
+	{
+		const auto time = Predict(device, engines[i], numKeys);
+		if (time >= 0.0 && (!best || time < bestTime))
+		{
+			best = i;
+			bestTime = time;
+		}
+	}
+	return best;
+}
+
+void SortRouter::Record(std::string_view engine, double predictedTime, double measuredTime)
+{
+	auto found = std::find_if(m_metrics.begin(), m_metrics.end(), [&](const Metrics& metrics) { return metrics.m_engine == engine; });
+	if (found == m_metrics.end())
+	{
+		found = m_metrics.insert(m_metrics.end(), Metrics());
+		found->m_engine = engine;
+	}
+	const auto relativeError = std::abs(predictedTime - measuredTime) / (std::max)(measuredTime, 1e-6);
+	++found->m_numRoutes;
+	found->m_sumRelativeError += relativeError;
+	found->m_maxRelativeError = (std::max)(found->m_maxRelativeError, relativeError);
+}
+
+void SortRouter::PrintMetrics() const
+{
+	for (const auto& metrics : m_metrics)
+	{
+		printf("Route: %s, %u requests, Mean Prediction Error: %.1f%%, Max Prediction Error: %.1f%%\n", metrics.m_engine.c_str(), metrics.m_numRoutes, metrics.GetMeanRelativeError() * 100.0, metrics.m_maxRelativeError * 100.0);
+	}
+}
+
+bool SortRouter::Load(std::string_view filePath)
+{
+	auto file = std::ifstream(std::string(filePath));
+	if (!file)
+	{
+		return false;
+	}
+	m_entries.clear();
+	auto line = std::string();
+	while (std::getline(file, line))
+	{
+		// device \t engine \t number of keys \t time
+		auto columns = std::vector<std::string>();
+		auto stream = std::istringstream(line);
+		auto column = std::string();
+		while (std::getline(stream, column, '\t'))
+		{
+			columns.push_back(column);
+		}
+		// A malformed line, e.g. cut short by an interrupted save, only loses that measurement.
+		auto numKeys = 0u;
+		auto time = 0.0;
+		if (columns.size() != 4 || !ParseNumber(columns[2], numKeys) || numKeys == 0 || !ParseNumber(columns[3], time) || !std::isfinite(time) || time < 0.0)
+		{
+			continue;
+		}
+		SetCost(columns[0], columns[1], numKeys, time);
+	}
+	return true;
+}
+
+bool SortRouter::Save(std::string_view filePath) const
+{
+	auto file = std::ofstream(std::string(filePath), std::ios::trunc);
+	if (!file)
+	{
+		return false;
+	}
+	for (const auto& entry : m_entries)
+	{
+		file << entry.m_device << '\t' << entry.m_engine << '\t' << entry.m_numKeys << '\t' << entry.m_time << '\n';
+	}
+	return static_cast<bool>(file);
+}
+}
\ No newline at end of file
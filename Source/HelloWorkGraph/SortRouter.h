@@ -0,0 +1,53 @@
+﻿#pragma once
+
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace LearningWorkGraph
+{
+// Cost model over measured wall times of one sort per (device, engine, size), including submission and readback.
+// Routes each request to the engine with the lowest predicted time and tracks how far the predictions were off.
+class SortRouter
+{
+public:
+	struct Metrics
+	{
+		std::string m_engine;
+		uint32_t m_numRoutes = 0;
+		double m_sumRelativeError = 0.0;
+		double m_maxRelativeError = 0.0;
+
+		double GetMeanRelativeError() const { return m_numRoutes > 0 ? m_sumRelativeError / m_numRoutes : 0.0; }
+	};
+
+	// Adds or replaces the measured time in milliseconds of one sort of numKeys.
+	void SetCost(std::string_view device, std::string_view engine, uint32_t numKeys, double time);
+	// Piecewise linear in log-log space between the measured sizes, extrapolated from the closest two.
+	// A single measurement scales linearly with the size. Returns a negative value without measurements.
+	double Predict(std::string_view device, std::string_view engine, uint32_t numKeys) const;
+	// Index of the engine with the lowest predicted time, engines without measurements are never chosen.
+	std::optional<size_t> Route(std::string_view device, const std::vector<std::string_view>& engines, uint32_t numKeys) const;
+
+	// Accounts one routed request with its predicted and measured time.
+	void Record(std::string_view engine, double predictedTime, double measuredTime);
+	const std::vector<Metrics>& GetMetrics() const { return m_metrics; }
+	void PrintMetrics() const;
+
+	bool Load(std::string_view filePath);
+	bool Save(std::string_view filePath) const;
+
+private:
+	struct Entry
+	{
+		std::string m_device;
+		std::string m_engine;
+		uint32_t m_numKeys;
+		double m_time;
+	};
+	std::vector<Entry> m_entries;
+	std::vector<Metrics> m_metrics;
+};
+}
\ No newline at end of file
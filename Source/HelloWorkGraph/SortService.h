@@ -0,0 +1,185 @@
+﻿#pragma once
+
+#include "Parallel.h"
+#include "SortKey.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <future>
+#include <thread>
+#include <vector>
+
+namespace LearningWorkGraph
+{
+// One job of a batch, sorted in place.
+template<typename Key>
+struct SortBatchItem
+{
+	Key* m_keys;
+	size_t m_count;
+};
+
+struct SortJobResult
+{
+	// Index of the batch the job was sorted in and the number of jobs of that batch.
+	uint32_t m_batchIndex = 0;
+	uint32_t m_batchSize = 0;
+};
+
+struct SortServiceOptions
+{
+	// How long the service keeps collecting jobs after the first one of a batch arrived.
+	std::chrono::microseconds m_batchWindow = std::chrono::microseconds(100);
+	// A batch is launched early once it has this many jobs or keys.
+	size_t m_maxBatchJobs = 64;
+	size_t m_maxBatchKeys = 1 << 22;
+};
+
+// Stand-in for a device on hosts without one: every batch pays submissionLatency once, like one submission and fence wait,
+// then the jobs are sorted in parallel with one range of jobs per worker.
+template<typename Key>
+class CpuSortBackend
+{
+public:
+	explicit CpuSortBackend(std::chrono::microseconds submissionLatency = {}) : m_submissionLatency(submissionLatency) {}
+
+	void SortBatch(const std::vector<SortBatchItem<Key>>& items)
+	{
+		if (m_submissionLatency.count() > 0)
+		{
+			std::this_thread::sleep_for(m_submissionLatency);
+		}
+		ParallelForRanges(items.size(), 1, [&](uint32_t, size_t begin, size_t end)
+		{
+			for (auto i = begin; i < end; ++i)
+			{
+				ReferenceSort(items[i].m_keys, items[i].m_count);
+			}
+		});
+	}
+
+private:
+	std::chrono::microseconds m_submissionLatency = {};
+};
+
+// Thread-safe sort service: any thread submits jobs and gets a future, one service thread coalesces the jobs that arrive within
+// the batch window into one Backend::SortBatch call. Submission is lock-free, jobs are pushed on an intrusive stack
+// that the service thread takes as a whole and reverses to the submission order.
+// The keys of a job must stay alive until its future is ready, and no job may be submitted once the destructor runs.
+template<typename Key, typename Backend>
+class SortService
+{
+public:
+	SortService(Backend& backend, const SortServiceOptions& options) : m_backend(backend), m_options(options), m_thread([this] { Run(); }) {}
+	~SortService()
+	{
+		Push(&m_stopJob);
+		m_thread.join();
+	}
+
+	std::future<SortJobResult> Submit(Key* keys, size_t count)
+	{
+		auto* job = new Job{ { keys, count }, {}, nullptr };
+		auto future = job->m_promise.get_future();
+		Push(job);
+		return future;
+	}
+
+	uint32_t GetNumBatches() const { return m_numBatches.load(std::memory_order_relaxed); }
+	uint64_t GetNumJobs() const { return m_numJobs.load(std::memory_order_relaxed); }
+
+private:
+	struct Job
+	{
+		SortBatchItem<Key> m_item;
+		std::promise<SortJobResult> m_promise;
+		Job* m_next;
+	};
+
+	void Push(Job* job)
+	{
+		auto* head = m_head.load(std::memory_order_relaxed);
+		do
+		{
+			job->m_next = head;
+		}
+		while (!m_head.compare_exchange_weak(head, job, std::memory_order_release, std::memory_order_relaxed));
+		// Only an empty queue can have the service thread waiting on it.
+		if (head == nullptr)
+		{
+			m_head.notify_one();
+		}
+	}
+
+	// Appends the jobs pushed so far in their submission order, returns false once the stop job came.
+	bool Take(std::vector<Job*>& jobs, size_t& numKeys)
+	{
+		auto* head = m_head.exchange(nullptr, std::memory_order_acquire);
+		const auto first = jobs.size();
+		auto isRunning = true;
+		for (; head != nullptr; head = head->m_next)
+		{
+			if (head == &m_stopJob)
+			{
+				isRunning = false;
+				continue;
+			}
+			jobs.push_back(head);
+			numKeys += head->m_item.m_count;
+		}
+		std::reverse(jobs.begin() + first, jobs.end());
+		return isRunning;
+	}
+
+	void Run()
+	{
+		auto jobs = std::vector<Job*>();
+		auto items = std::vector<SortBatchItem<Key>>();
+		for (auto isRunning = true; isRunning;)
+		{
+			m_head.wait(nullptr, std::memory_order_acquire);
+			auto numKeys = size_t(0);
+			isRunning = Take(jobs, numKeys);
+
+			// Collect more jobs until the window closes or the batch is full, yielding to the submitting threads.
+			const auto deadline = std::chrono::steady_clock::now() + m_options.m_batchWindow;
+			while (isRunning && jobs.size() < m_options.m_maxBatchJobs && numKeys < m_options.m_maxBatchKeys && std::chrono::steady_clock::now() < deadline)
+			{
+				std::this_thread::yield();
+				isRunning = Take(jobs, numKeys);
+			}
+			if (jobs.empty())
+			{
+				continue;
+			}
+
+			items.clear();
+			for (const auto* job : jobs)
+			{
+				items.push_back(job->m_item);
+			}
+			m_backend.SortBatch(items);
+
+			const auto result = SortJobResult{ m_numBatches.fetch_add(1, std::memory_order_relaxed), static_cast<uint32_t>(jobs.size()) };
+			m_numJobs.fetch_add(jobs.size(), std::memory_order_relaxed);
+			for (auto* job : jobs)
+			{
+				job->m_promise.set_value(result);
+				delete job;
+			}
+			jobs.clear();
+		}
+	}
+
+	Backend& m_backend;
+	SortServiceOptions m_options = {};
+	std::atomic<Job*> m_head = nullptr;
+	Job m_stopJob = {};
+	std::atomic<uint32_t> m_numBatches = 0;
+	std::atomic<uint64_t> m_numJobs = 0;
+	// Last, so that it starts after everything it uses.
+	std::thread m_thread;
+};
+}
\ No newline at end of file
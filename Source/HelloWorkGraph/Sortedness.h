@@ -0,0 +1,221 @@
+﻿#pragma once
+
+#include "Parallel.h"
+#include "SortKey.h"
+
+#include <algorithm>
+#include <random>
+#include <string_view>
+#include <vector>
+
+namespace LearningWorkGraph
+{
+// Input order used to exercise the adaptive pre-pass.
+enum class KeyDistribution : uint32_t
+{
+	Random = 0,
+	Sorted,
+	Reversed,
+	Runs,
+	NearlySorted,
+	Count
+};
+
+inline std::string_view GetKeyDistributionName(KeyDistribution distribution)
+{
+	constexpr std::string_view k_names[] = { "random", "sorted", "reversed", "runs", "nearly-sorted" };
+	return k_names[static_cast<uint32_t>(distribution)];
+}
+
+inline bool FindKeyDistribution(std::string_view name, KeyDistribution& distribution)
+{
+	for (uint32_t i = 0; i < static_cast<uint32_t>(KeyDistribution::Count); ++i)
+	{
+		if (GetKeyDistributionName(static_cast<KeyDistribution>(i)) == name)
+		{
+			distribution = static_cast<KeyDistribution>(i);
+			return true;
+		}
+	}
+	return false;
+}
+
+// Reorders random keys into the given distribution. Runs are 16 sorted chunks (appended logs),
+// nearly sorted swaps one key in a thousand with a random other key.
+template<typename Key>
+void ApplyKeyDistribution(KeyDistribution distribution, std::mt19937& randomEngine, Key* keys, size_t count)
+{
+	switch (distribution)
+	{
+	case KeyDistribution::Sorted:
+		ReferenceSort(keys, count);
+		break;
+	case KeyDistribution::Reversed:
+		ReferenceSort(keys, count);
+		std::reverse(keys, keys + count);
+		break;
+	case KeyDistribution::Runs:
+		for (size_t i = 0; i < 16; ++i)
+		{
+			ReferenceSort(keys + count * i / 16, count * (i + 1) / 16 - count * i / 16);
+		}
+		break;
+	case KeyDistribution::NearlySorted:
+		if (count > 0)
+		{
+			ReferenceSort(keys, count);
+			auto random = std::uniform_int_distribution<size_t>(0, count - 1);
+			for (size_t i = 0; i < count / 1000; ++i)
+			{
+				std::swap(keys[random(randomEngine)], keys[random(randomEngine)]);
+			}
+		}
+		break;
+	default:
+		break;
+	}
+}
+
+// Cheapest way to sort the input that the pre-pass found.
+enum class SortStrategy : uint32_t
+{
+	None = 0,
+	Reverse,
+	RunMerge,
+	FullSort,
+	Count
+};
+
+inline std::string_view GetSortStrategyName(SortStrategy strategy)
+{
+	constexpr std::string_view k_names[] = { "None", "Reverse", "RunMerge", "FullSort" };
+	return k_names[static_cast<uint32_t>(strategy)];
+}
+
+struct SortednessAnalysis
+{
+	SortStrategy m_strategy = SortStrategy::FullSort;
+	// Neighbours with a[i] > a[i + 1] and a[i] < a[i + 1]. Ascending runs = descents + 1.
+	size_t m_numDescents = 0;
+	size_t m_numAscents = 0;
+	// Descents per block, blocks of count / m_blockDescents.size() keys.
+	std::vector<size_t> m_blockDescents;
+
+	size_t GetNumRuns() const { return m_numDescents + 1; }
+};
+
+// Run-merge costs n * log2(runs), so it only pays off for long runs.
+constexpr size_t k_minAverageRunLength = 64;
+
+// Parallel pre-pass: each worker counts descents and ascents in its block, including the pair across the block end.
+template<typename Key>
+SortednessAnalysis AnalyzeSortedness(const Key* keys, size_t count)
+{
+	auto analysis = SortednessAnalysis();
+	auto blockAscents = std::vector<size_t>(GetNumWorkerThreads());
+	analysis.m_blockDescents.resize(GetNumWorkerThreads());
+	const auto numBlocks = ParallelForRanges(count, 1 << 16, [&](uint32_t blockIndex, size_t begin, size_t end)
+	{
+		size_t numDescents = 0;
+		size_t numAscents = 0;
+		for (size_t i = begin; i < (std::min)(end, count - 1); ++i)
+		{
+			const auto a = ToOrderedBits(keys[i]);
+			const auto b = ToOrderedBits(keys[i + 1]);
+			numDescents += (a > b);
+			numAscents += (a < b);
+		}
+		analysis.m_blockDescents[blockIndex] = numDescents;
+		blockAscents[blockIndex] = numAscents;
+	});
+	analysis.m_blockDescents.resize(numBlocks);
+	for (uint32_t i = 0; i < numBlocks; ++i)
+	{
+		analysis.m_numDescents += analysis.m_blockDescents[i];
+		analysis.m_numAscents += blockAscents[i];
+	}
+
+	if (analysis.m_numDescents == 0)
+	{
+		analysis.m_strategy = SortStrategy::None;
+	}
+	else if (analysis.m_numAscents == 0)
+	{
+		analysis.m_strategy = SortStrategy::Reverse;
+	}
+	else if (analysis.GetNumRuns() * k_minAverageRunLength <= count)
+	{
+		analysis.m_strategy = SortStrategy::RunMerge;
+	}
+	return analysis;
+}
+
+// Starts of the ascending runs followed by count.
+template<typename Key>
+std::vector<size_t> FindRunStarts(const Key* keys, size_t count)
+{
+	auto runStarts = std::vector<size_t>(1, 0);
+	for (size_t i = 1; i < count; ++i)
+	{
+		if (ToOrderedBits(keys[i]) < ToOrderedBits(keys[i - 1]))
+		{
+			runStarts.push_back(i);
+		}
+	}
+	runStarts.push_back(count);
+	return runStarts;
+}
+
+// Merges the ascending runs pairwise, the merges of one level run in parallel.
+template<typename Key>
+void MergeRuns(Key* keys, size_t count)
+{
+	auto less = [](Key a, Key b) { return ToOrderedBits(a) < ToOrderedBits(b); };
+	auto runStarts = FindRunStarts(keys, count);
+
+	while (runStarts.size() > 2)
+	{
+		const auto numRuns = runStarts.size() - 1;
+		ParallelForRanges(numRuns / 2, 1, [&](uint32_t, size_t begin, size_t end)
+		{
+			for (size_t pair = begin; pair < end; ++pair)
+			{
+				const auto first = runStarts[pair * 2];
+				const auto middle = runStarts[pair * 2 + 1];
+				const auto last = runStarts[pair * 2 + 2];
+				std::inplace_merge(keys + first, keys + middle, keys + last, less);
+			}
+		});
+		auto merged = std::vector<size_t>();
+		for (size_t i = 0; i < runStarts.size(); i += 2)
+		{
+			merged.push_back(runStarts[i]);
+		}
+		if (merged.back() != count)
+		{
+			merged.push_back(count);
+		}
+		runStarts = std::move(merged);
+	}
+}
+
+// CPU implementation of the strategies.
+template<typename Key>
+void SortWithStrategy(SortStrategy strategy, Key* keys, size_t count)
+{
+	switch (strategy)
+	{
+	case SortStrategy::None:
+		break;
+	case SortStrategy::Reverse:
+		std::reverse(keys, keys + count);
+		break;
+	case SortStrategy::RunMerge:
+		MergeRuns(keys, count);
+		break;
+	default:
+		ReferenceSort(keys, count);
+		break;
+	}
+}
+}
\ No newline at end of file
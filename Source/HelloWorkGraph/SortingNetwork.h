@@ -0,0 +1,255 @@
+﻿#pragma once
+
+#include <array>
+#include <algorithm>
+#include <bit>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <utility>
+
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64)
+#	include <immintrin.h>
+#endif
+
+namespace LearningWorkGraph
+{
+// Moves the smaller value to m_a and the larger value to m_b.
+struct Comparator
+{
+	uint8_t m_a;
+	uint8_t m_b;
+};
+
+enum class SortingNetworkKind
+{
+	Bitonic,
+	OddEvenMerge,
+	// Odd-even merge below 16 (optimal for 4 and 8), Green's network for 16 and odd-even merges of Green's networks above.
+	// 185 comparators for 32, the best known, and 531 for 64, where the best known network has 521.
+	GreenOddEvenMerge,
+	Count
+};
+
+namespace SortingNetworkDetail
+{
+template<typename Emit>
+constexpr void GenerateBitonic(uint32_t n, Emit&& emit)
+{
+	for (uint32_t k = 2; k <= n; k <<= 1)
+	{
+		for (uint32_t j = k >> 1; j > 0; j >>= 1)
+		{
+			for (uint32_t i = 0; i < n; ++i)
+			{
+				const uint32_t l = i ^ j;
+				if (l > i)
+				{
+					// Descending blocks are expressed by swapping the comparator ends.
+					((i & k) == 0) ? emit(i, l) : emit(l, i);
+				}
+			}
+		}
+	}
+}
+
+// https://en.wikipedia.org/wiki/Batcher_odd%E2%80%93even_mergesort
+// Merges sorted blocks of sortedSize elements, the full sort with sortedSize 1.
+template<typename Emit>
+constexpr void GenerateOddEvenMerge(uint32_t n, Emit&& emit, uint32_t sortedSize = 1)
+{
+	for (uint32_t p = sortedSize; p < n; p <<= 1)
+	{
+		for (uint32_t k = p; k >= 1; k >>= 1)
+		{
+			for (uint32_t j = k % p; j + k < n; j += 2 * k)
+			{
+				for (uint32_t i = 0; i < k && i < n - j - k; ++i)
+				{
+					if ((i + j) / (2 * p) == (i + j + k) / (2 * p))
+					{
+						emit(i + j, i + j + k);
+					}
+				}
+			}
+		}
+	}
+}
+
+inline constexpr Comparator k_green16[] =
+{
+	{ 0, 13 }, { 1, 12 }, { 2, 15 }, { 3, 14 }, { 4, 8 }, { 5, 6 }, { 7, 11 }, { 9, 10 },
+	{ 0, 5 }, { 1, 7 }, { 2, 9 }, { 3, 4 }, { 6, 13 }, { 8, 14 }, { 10, 15 }, { 11, 12 },
+	{ 0, 1 }, { 2, 3 }, { 4, 5 }, { 6, 8 }, { 7, 9 }, { 10, 11 }, { 12, 13 }, { 14, 15 },
+	{ 0, 2 }, { 1, 3 }, { 4, 10 }, { 5, 11 }, { 6, 7 }, { 8, 9 }, { 12, 14 }, { 13, 15 },
+	{ 1, 2 }, { 3, 12 }, { 4, 6 }, { 5, 7 }, { 8, 10 }, { 9, 11 }, { 13, 14 },
+	{ 1, 4 }, { 2, 6 }, { 5, 8 }, { 7, 10 }, { 9, 13 }, { 11, 14 },
+	{ 2, 4 }, { 3, 6 }, { 9, 12 }, { 11, 13 },
+	{ 3, 5 }, { 6, 8 }, { 7, 9 }, { 10, 12 },
+	{ 3, 4 }, { 5, 6 }, { 7, 8 }, { 9, 10 }, { 11, 12 },
+	{ 6, 7 }, { 8, 9 },
+};
+
+template<SortingNetworkKind Kind, typename Emit>
+constexpr void Generate(uint32_t n, Emit&& emit)
+{
+	if constexpr (Kind == SortingNetworkKind::Bitonic)
+	{
+		GenerateBitonic(n, emit);
+	}
+	else if constexpr (Kind == SortingNetworkKind::OddEvenMerge)
+	{
+		GenerateOddEvenMerge(n, emit);
+	}
+	else
+	{
+		if (n < 16)
+		{
+			GenerateOddEvenMerge(n, emit);
+			return;
+		}
+		for (uint32_t offset = 0; offset < n; offset += 16)
+		{
+			for (const auto& comparator : k_green16)
+			{
+				emit(offset + comparator.m_a, offset + comparator.m_b);
+			}
+		}
+		GenerateOddEvenMerge(n, emit, 16);
+	}
+}
+
+template<SortingNetworkKind Kind, uint32_t N>
+constexpr auto MakeComparators()
+{
+	constexpr size_t count = []
+	{
+		size_t count = 0;
+		Generate<Kind>(N, [&](uint32_t, uint32_t) { ++count; });
+		return count;
+	}();
+	auto comparators = std::array<Comparator, count>();
+	size_t index = 0;
+	Generate<Kind>(N, [&](uint32_t a, uint32_t b) { comparators[index++] = { static_cast<uint8_t>(a), static_cast<uint8_t>(b) }; });
+	return comparators;
+}
+
+template<typename T>
+inline T Min(T a, T b) { return (b < a) ? b : a; }
+template<typename T>
+inline T Max(T a, T b) { return (b < a) ? a : b; }
+
+// Vector overloads sort one independent array per lane (element i of every array lives in register i). They only exist in
+// translation units built with the instruction set, see SortingNetworkSimd.h. MSVC has no __SSE4_1__, the project defines
+// LWG_SORTING_NETWORK_SSE41 for SortingNetworkSse41.cpp instead.
+#if defined(__SSE4_1__) || defined(LWG_SORTING_NETWORK_SSE41)
+inline __m128i Min(__m128i a, __m128i b) { return _mm_min_epu32(a, b); }
+inline __m128i Max(__m128i a, __m128i b) { return _mm_max_epu32(a, b); }
+#endif
+#if defined(__AVX2__)
+inline __m256i Min(__m256i a, __m256i b) { return _mm256_min_epu32(a, b); }
+inline __m256i Max(__m256i a, __m256i b) { return _mm256_max_epu32(a, b); }
+#endif
+#if defined(__AVX512F__)
+inline __m512i Min(__m512i a, __m512i b) { return _mm512_min_epu32(a, b); }
+inline __m512i Max(__m512i a, __m512i b) { return _mm512_max_epu32(a, b); }
+#endif
+}
+
+// Sorting network for N elements with the comparator table generated at compile time.
+template<SortingNetworkKind Kind, uint32_t N>
+class SortingNetwork
+{
+	static_assert(std::has_single_bit(N) && N >= 2 && N <= 64);
+
+public:
+	static constexpr auto k_comparators = SortingNetworkDetail::MakeComparators<Kind, N>();
+	static constexpr uint32_t k_size = N;
+
+	// Fully unrolled: every comparator becomes one min/max pair. T is a scalar or one of the SIMD register types.
+	template<typename T>
+	static void Sort(T* values)
+	{
+		SortImpl(values, std::make_index_sequence<k_comparators.size()>());
+	}
+
+	// HLSL function "void <functionName>(inout uint v[N])" applying the same comparator table.
+	static std::string GenerateHLSL(std::string_view functionName)
+	{
+		auto source = std::string();
+		source += "void " + std::string(functionName) + "(inout uint v[" + std::to_string(N) + "])\n{\n";
+		for (const auto& comparator : k_comparators)
+		{
+			const auto a = "v[" + std::to_string(comparator.m_a) + "]";
+			const auto b = "v[" + std::to_string(comparator.m_b) + "]";
+			source += "\t{ const uint a = " + a + "; const uint b = " + b + "; " + a + " = min(a, b); " + b + " = max(a, b); }\n";
+		}
+		source += "}\n";
+		return source;
+	}
+
+private:
+	template<typename T, size_t... I>
+	static void SortImpl(T* values, std::index_sequence<I...>)
+	{
+		(CompareExchange<k_comparators[I].m_a, k_comparators[I].m_b>(values), ...);
+	}
+
+	template<uint32_t A, uint32_t B, typename T>
+	static void CompareExchange(T* values)
+	{
+		const T a = values[A];
+		const T b = values[B];
+		values[A] = SortingNetworkDetail::Min(a, b);
+		values[B] = SortingNetworkDetail::Max(a, b);
+	}
+};
+
+// Sizes with a network, the powers of two from 2 to 64.
+constexpr bool HasSortingNetwork(uint32_t numElements)
+{
+	return std::has_single_bit(numElements) && numElements >= 2 && numElements <= 64;
+}
+
+// Sort for a size only known at run time. Returns false if there is no network for numElements.
+template<SortingNetworkKind Kind, typename T>
+bool SortWithNetwork(T* values, uint32_t numElements)
+{
+	switch (numElements)
+	{
+	case 2: SortingNetwork<Kind, 2>::Sort(values); return true;
+	case 4: SortingNetwork<Kind, 4>::Sort(values); return true;
+	case 8: SortingNetwork<Kind, 8>::Sort(values); return true;
+	case 16: SortingNetwork<Kind, 16>::Sort(values); return true;
+	case 32: SortingNetwork<Kind, 32>::Sort(values); return true;
+	case 64: SortingNetwork<Kind, 64>::Sort(values); return true;
+	default: return false;
+	}
+}
+
+// GenerateHLSL for a size only known at run time. Returns an empty string if there is no network for numElements.
+template<SortingNetworkKind Kind>
+std::string GenerateSortingNetworkHLSL(uint32_t numElements, std::string_view functionName)
+{
+	switch (numElements)
+	{
+	case 2: return SortingNetwork<Kind, 2>::GenerateHLSL(functionName);
+	case 4: return SortingNetwork<Kind, 4>::GenerateHLSL(functionName);
+	case 8: return SortingNetwork<Kind, 8>::GenerateHLSL(functionName);
+	case 16: return SortingNetwork<Kind, 16>::GenerateHLSL(functionName);
+	case 32: return SortingNetwork<Kind, 32>::GenerateHLSL(functionName);
+	case 64: return SortingNetwork<Kind, 64>::GenerateHLSL(functionName);
+	default: return {};
+	}
+}
+
+// Sorts every consecutive block of N values, one network per block.
+template<SortingNetworkKind Kind, uint32_t N, typename T>
+void SortBlocksWithNetwork(T* values, size_t count)
+{
+	for (size_t i = 0; i + N <= count; i += N)
+	{
+		SortingNetwork<Kind, N>::Sort(values + i);
+	}
+}
+}
\ No newline at end of file
@@ -0,0 +1,13 @@
+﻿#include "SortingNetworkSimd.h"
+
+namespace LearningWorkGraph::SortingNetworkDetail
+{
+SortNetworkColumnsFunction GetSortNetworkColumnsAvx2([[maybe_unused]] uint32_t numElements)
+{
+#if defined(__AVX2__)
+	return GetSortNetworkColumnsOf<__m256i>(numElements);
+#else
+	return nullptr;
+#endif
+}
+}
\ No newline at end of file
@@ -0,0 +1,13 @@
+﻿#include "SortingNetworkSimd.h"
+
+namespace LearningWorkGraph::SortingNetworkDetail
+{
+SortNetworkColumnsFunction GetSortNetworkColumnsAvx512([[maybe_unused]] uint32_t numElements)
+{
+#if defined(__AVX512F__)
+	return GetSortNetworkColumnsOf<__m512i>(numElements);
+#else
+	return nullptr;
+#endif
+}
+}
\ No newline at end of file
@@ -0,0 +1,86 @@
+﻿#include "SortingNetworkSimd.h"
+
+#if defined(_MSC_VER) && defined(_M_X64)
+#	include <intrin.h>
+#endif
+
+namespace LearningWorkGraph
+{
+namespace
+{
+SimdLevel DetectSimdLevel()
+{
+#if defined(_MSC_VER) && defined(_M_X64)
+	int info[4] = {};
+	__cpuid(info, 0);
+	const auto maxLeaf = info[0];
+	__cpuid(info, 1);
+	const auto hasSse41 = (info[2] & (1 << 19)) != 0;
+	// The operating system has to save the AVX (bits 1, 2) and AVX-512 (bits 5 to 7) registers on a context switch.
+	const auto hasXsave = (info[2] & (1 << 27)) != 0;
+	const auto xcr0 = hasXsave ? _xgetbv(0) : 0;
+	auto hasAvx2 = false;
+	auto hasAvx512 = false;
+	if (maxLeaf >= 7)
+	{
+		__cpuidex(info, 7, 0);
+		hasAvx2 = ((xcr0 & 0x6) == 0x6) && (info[1] & (1 << 5)) != 0;
+		hasAvx512 = ((xcr0 & 0xe6) == 0xe6) && (info[1] & (1 << 16)) != 0;
+	}
+#elif (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+	__builtin_cpu_init();
+	const auto hasSse41 = __builtin_cpu_supports("sse4.1") != 0;
+	const auto hasAvx2 = __builtin_cpu_supports("avx2") != 0;
+	const auto hasAvx512 = __builtin_cpu_supports("avx512f") != 0;
+#else
+	const auto hasSse41 = false;
+	const auto hasAvx2 = false;
+	const auto hasAvx512 = false;
+#endif
+	return hasAvx512 ? SimdLevel::Avx512 : hasAvx2 ? SimdLevel::Avx2 : hasSse41 ? SimdLevel::Sse41 : SimdLevel::Scalar;
+}
+}
+
+const char* GetSimdLevelName(SimdLevel level)
+{
+	switch (level)
+	{
+	case SimdLevel::Sse41: return "SSE4.1";
+	case SimdLevel::Avx2: return "AVX2";
+	case SimdLevel::Avx512: return "AVX-512";
+	default: return "Scalar";
+	}
+}
+
+uint32_t GetSimdLanes(SimdLevel level)
+{
+	switch (level)
+	{
+	case SimdLevel::Sse41: return 4;
+	case SimdLevel::Avx2: return 8;
+	case SimdLevel::Avx512: return 16;
+	default: return 1;
+	}
+}
+
+SimdLevel GetSupportedSimdLevel()
+{
+	static const auto s_level = DetectSimdLevel();
+	return s_level;
+}
+
+SortNetworkColumnsFunction GetSortNetworkColumns(SimdLevel level, uint32_t numElements)
+{
+	if (level > GetSupportedSimdLevel())
+	{
+		return nullptr;
+	}
+	switch (level)
+	{
+	case SimdLevel::Sse41: return SortingNetworkDetail::GetSortNetworkColumnsSse41(numElements);
+	case SimdLevel::Avx2: return SortingNetworkDetail::GetSortNetworkColumnsAvx2(numElements);
+	case SimdLevel::Avx512: return SortingNetworkDetail::GetSortNetworkColumnsAvx512(numElements);
+	default: return nullptr;
+	}
+}
+}
\ No newline at end of file
@@ -0,0 +1,69 @@
+﻿#pragma once
+
+#include "SortingNetwork.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+namespace LearningWorkGraph
+{
+// Instruction sets of the SIMD sorting networks. Every level is compiled in its own translation unit with the instruction set
+// enabled (SortingNetworkSse41.cpp, SortingNetworkAvx2.cpp, SortingNetworkAvx512.cpp) and only called if the CPU supports it.
+enum class SimdLevel
+{
+	Scalar,
+	Sse41,
+	Avx2,
+	Avx512,
+	Count
+};
+
+const char* GetSimdLevelName(SimdLevel level);
+// 32-bit lanes of a register.
+uint32_t GetSimdLanes(SimdLevel level);
+// Highest level the CPU and the operating system support.
+SimdLevel GetSupportedSimdLevel();
+
+// Sorts every block of numElements * GetSimdLanes(level) values laid out as [element][lane], one array per lane.
+using SortNetworkColumnsFunction = void (*)(uint32_t* values, size_t count);
+// nullptr if the CPU doesn't support the level, the level isn't built for this platform or there is no network for numElements.
+SortNetworkColumnsFunction GetSortNetworkColumns(SimdLevel level, uint32_t numElements);
+
+namespace SortingNetworkDetail
+{
+// Defined by the translation unit of each level, nullptr if the level isn't built.
+SortNetworkColumnsFunction GetSortNetworkColumnsSse41(uint32_t numElements);
+SortNetworkColumnsFunction GetSortNetworkColumnsAvx2(uint32_t numElements);
+SortNetworkColumnsFunction GetSortNetworkColumnsAvx512(uint32_t numElements);
+
+// Only instantiated in the translation unit of the level of Register, so the compiler can't fold it into code without the instruction set.
+template<typename Register, uint32_t N>
+void SortNetworkColumns(uint32_t* values, size_t count)
+{
+	constexpr size_t k_blockSize = N * sizeof(Register) / sizeof(uint32_t);
+	Register registers[N];
+	for (size_t i = 0; i + k_blockSize <= count; i += k_blockSize)
+	{
+		std::memcpy(registers, values + i, sizeof(registers));
+		SortingNetwork<SortingNetworkKind::GreenOddEvenMerge, N>::Sort(registers);
+		std::memcpy(values + i, registers, sizeof(registers));
+	}
+}
+
+template<typename Register>
+SortNetworkColumnsFunction GetSortNetworkColumnsOf(uint32_t numElements)
+{
+	switch (numElements)
+	{
+	case 2: return SortNetworkColumns<Register, 2>;
+	case 4: return SortNetworkColumns<Register, 4>;
+	case 8: return SortNetworkColumns<Register, 8>;
+	case 16: return SortNetworkColumns<Register, 16>;
+	case 32: return SortNetworkColumns<Register, 32>;
+	case 64: return SortNetworkColumns<Register, 64>;
+	default: return nullptr;
+	}
+}
+}
+}
\ No newline at end of file
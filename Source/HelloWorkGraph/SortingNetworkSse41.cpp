@@ -0,0 +1,13 @@
+﻿#include "SortingNetworkSimd.h"
+
+namespace LearningWorkGraph::SortingNetworkDetail
+{
+SortNetworkColumnsFunction GetSortNetworkColumnsSse41([[maybe_unused]] uint32_t numElements)
+{
+#if defined(__SSE4_1__) || defined(LWG_SORTING_NETWORK_SSE41)
+	return GetSortNetworkColumnsOf<__m128i>(numElements);
+#else
+	return nullptr;
+#endif
+}
+}
\ No newline at end of file
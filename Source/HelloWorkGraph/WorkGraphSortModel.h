@@ -0,0 +1,184 @@
+﻿#pragma once
+
+#include "KernelTuner.h"
+#include "MergePath.h"
+#include "SortKey.h"
+
+#include <algorithm>
+#include <bit>
+#include <cstdint>
+#include <random>
+#include <vector>
+
+namespace LearningWorkGraph
+{
+// Record and group counts of one run of the recursive topology.
+struct WorkGraphSortStatistics
+{
+	uint32_t m_numSplitRecords = 0;
+	uint32_t m_numLeafRecords = 0;
+	uint32_t m_numMergeRecords = 0;
+	uint32_t m_numMergeGroups = 0;
+	// Merge records a group emitted before both children of the range had completed, always 0 if the counters are right.
+	uint32_t m_numEarlyMerges = 0;
+};
+
+// Host model of the recursive work graph topology in Shader.shader (WORK_GRAPH_RECURSIVE).
+// Runs the same records, buffers and arrival counters, but executes the pending thread records and thread groups in a random order,
+// so any order the GPU may pick is a possible order of the model. numSortElements must be a power of two.
+template<typename Key>
+class WorkGraphSortModel
+{
+public:
+	// maxDispatchGrid is NodeMaxDispatchGrid of MergeNode, smaller values make the merge threads stride over their range.
+	WorkGraphSortModel(uint32_t numThreads, uint32_t mergeElementsPerThread, uint32_t maxDispatchGrid = KernelVariant::k_maxDispatchGrid)
+		: m_numThreads(numThreads), m_mergeElementsPerThread(mergeElementsPerThread), m_maxDispatchGrid(maxDispatchGrid) {}
+
+	uint32_t GetLeafSize() const { return m_numThreads * 2; }
+	uint32_t GetNumTreeNodes(uint32_t numSortElements) const { return (std::max)(1u, numSortElements / GetLeafSize()) * 2; }
+	uint32_t GetMergeDispatchGrid(uint32_t count) const { return (std::clamp)(count / (m_numThreads * m_mergeElementsPerThread), 1u, m_maxDispatchGrid); }
+
+	// Sorts keys in place with scratch as the buffer of odd depths.
+	WorkGraphSortStatistics Run(Key* keys, uint32_t numSortElements, Key* scratch, uint32_t seed)
+	{
+		m_keys = keys;
+		m_scratch = scratch;
+		m_numSortElements = numSortElements;
+		m_counters.assign(GetNumTreeNodes(numSortElements) * 2, 0);
+		m_isCompleted.assign(GetNumTreeNodes(numSortElements), false);
+		m_statistics = {};
+		m_pending.clear();
+		m_pending.push_back({ WorkItem::Type::Split, { 0, numSortElements, 0 }, 0, 0 });
+
+		auto randomEngine = std::mt19937(seed);
+		while (!m_pending.empty())
+		{
+			const auto index = std::uniform_int_distribution<size_t>(0, m_pending.size() - 1)(randomEngine);
+			const auto item = m_pending[index];
+			m_pending[index] = m_pending.back();
+			m_pending.pop_back();
+			switch (item.m_type)
+			{
+			case WorkItem::Type::Split: ExecuteSplit(item.m_range); break;
+			case WorkItem::Type::Leaf: ExecuteLeaf(item.m_range); break;
+			case WorkItem::Type::Merge: ExecuteMergeGroup(item.m_range, item.m_dispatchGrid, item.m_groupIndex); break;
+			}
+		}
+		return m_statistics;
+	}
+
+private:
+	struct SortRange
+	{
+		uint32_t m_begin;
+		uint32_t m_count;
+		uint32_t m_nodeIndex;
+	};
+
+	struct WorkItem
+	{
+		enum class Type { Split, Leaf, Merge } m_type;
+		SortRange m_range;
+		uint32_t m_dispatchGrid;
+		uint32_t m_groupIndex;
+	};
+
+	static uint32_t GetTreeDepth(uint32_t nodeIndex) { return std::bit_width(nodeIndex + 1) - 1; }
+	Key* GetDepthBuffer(uint32_t depth) const { return (depth & 1) ? m_scratch : m_keys; }
+
+	void ExecuteSplit(const SortRange& range)
+	{
+		++m_statistics.m_numSplitRecords;
+		const auto numChildren = (range.m_count <= GetLeafSize()) ? 1u : 2u;
+		const auto childCount = range.m_count / numChildren;
+		const auto isLeaf = (childCount <= GetLeafSize());
+		for (uint32_t c = 0; c < numChildren; ++c)
+		{
+			const auto child = SortRange{ range.m_begin + c * childCount, childCount, (numChildren == 1) ? range.m_nodeIndex : range.m_nodeIndex * 2 + 1 + c };
+			m_pending.push_back({ isLeaf ? WorkItem::Type::Leaf : WorkItem::Type::Split, child, 0, 0 });
+		}
+	}
+
+	void ExecuteLeaf(const SortRange& range)
+	{
+		++m_statistics.m_numLeafRecords;
+		auto* destination = GetDepthBuffer(GetTreeDepth(range.m_nodeIndex)) + range.m_begin;
+		std::copy(m_keys + range.m_begin, m_keys + range.m_begin + range.m_count, destination);
+		ReferenceSort(destination, range.m_count);
+		m_isCompleted[range.m_nodeIndex] = true;
+		CompleteRange(range);
+	}
+
+	void ExecuteMergeGroup(const SortRange& range, uint32_t dispatchGrid, uint32_t groupIndex)
+	{
+		const auto depth = GetTreeDepth(range.m_nodeIndex);
+		const auto* source = GetDepthBuffer(depth + 1) + range.m_begin;
+		auto* destination = GetDepthBuffer(depth) + range.m_begin;
+		const auto half = range.m_count / 2;
+		auto less = [](Key a, Key b) { return ToOrderedBits(a) < ToOrderedBits(b); };
+
+		// Threads stride over the grid when the range has more outputs than the grid has threads.
+		const auto gridStride = dispatchGrid * m_numThreads * m_mergeElementsPerThread;
+		for (uint32_t thread = 0; thread < m_numThreads; ++thread)
+		{
+			for (auto begin = (groupIndex * m_numThreads + thread) * m_mergeElementsPerThread; begin < range.m_count; begin += gridStride)
+			{
+				const auto end = (std::min)(begin + m_mergeElementsPerThread, range.m_count);
+				const auto aBegin = MergePathSplit(source, half, source + half, half, begin, less);
+				const auto aEnd = MergePathSplit(source, half, source + half, half, end, less);
+				std::merge(source + aBegin, source + aEnd, source + half + (begin - aBegin), source + half + (end - aEnd), destination + begin, less);
+			}
+		}
+
+		auto& finishedGroups = m_counters[GetNumTreeNodes(m_numSortElements) + range.m_nodeIndex];
+		if (++finishedGroups < dispatchGrid)
+		{
+			return;
+		}
+		finishedGroups = 0;
+		m_isCompleted[range.m_nodeIndex] = true;
+		CompleteRange(range);
+	}
+
+	// Same as CompleteChild and GetParentMergeRecord in Shader.shader.
+	void CompleteRange(const SortRange& range)
+	{
+		if (range.m_nodeIndex == 0)
+		{
+			return;
+		}
+		const auto parentIndex = (range.m_nodeIndex - 1) / 2;
+		if (m_counters[parentIndex]++ == 0)
+		{
+			return;
+		}
+		m_counters[parentIndex] = 0;
+
+		const auto sibling = (range.m_nodeIndex & 1) ? range.m_nodeIndex + 1 : range.m_nodeIndex - 1;
+		if (!m_isCompleted[sibling])
+		{
+			++m_statistics.m_numEarlyMerges;
+		}
+
+		const auto parent = SortRange{ (range.m_nodeIndex & 1) ? range.m_begin : range.m_begin - range.m_count, range.m_count * 2, parentIndex };
+		const auto dispatchGrid = GetMergeDispatchGrid(parent.m_count);
+		++m_statistics.m_numMergeRecords;
+		m_statistics.m_numMergeGroups += dispatchGrid;
+		for (uint32_t group = 0; group < dispatchGrid; ++group)
+		{
+			m_pending.push_back({ WorkItem::Type::Merge, parent, dispatchGrid, group });
+		}
+	}
+
+	uint32_t m_numThreads = 1;
+	uint32_t m_mergeElementsPerThread = 1;
+	uint32_t m_maxDispatchGrid = KernelVariant::k_maxDispatchGrid;
+	Key* m_keys = nullptr;
+	Key* m_scratch = nullptr;
+	uint32_t m_numSortElements = 0;
+	std::vector<uint32_t> m_counters;
+	std::vector<WorkItem> m_pending;
+	std::vector<bool> m_isCompleted;
+	WorkGraphSortStatistics m_statistics = {};
+};
+}
\ No newline at end of file
@@ -0,0 +1,171 @@
+﻿#pragma once
+
+#include "KernelTuner.h"
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+
+namespace LearningWorkGraph
+{
+// Nodes of the sort work graphs in Shader.shader, in the order of NODE_LAUNCH to NODE_MERGE.
+enum class WorkGraphNode : uint32_t
+{
+	Launch = 0,
+	BitonicSort,
+	Split,
+	LeafSort,
+	Merge,
+	Count
+};
+
+// Counters of one node, the same layout as the NODE_STAT_ words the instrumentation build (WORK_GRAPH_STATS) adds up.
+// Thread launch nodes have no groups, every invocation is one record in and one thread.
+struct WorkGraphNodeStats
+{
+	uint32_t m_recordsIn = 0;
+	uint32_t m_recordsOut = 0;
+	uint32_t m_groups = 0;
+	uint32_t m_threads = 0;
+	// Threads that returned without work, past the sort range or the end of a merge.
+	uint32_t m_earlyExits = 0;
+
+	bool operator==(const WorkGraphNodeStats&) const = default;
+};
+static_assert(sizeof(WorkGraphNodeStats) == 5 * sizeof(uint32_t));
+
+using WorkGraphStats = std::array<WorkGraphNodeStats, static_cast<size_t>(WorkGraphNode::Count)>;
+
+inline const char* GetWorkGraphNodeName(WorkGraphNode node)
+{
+	static constexpr const char* k_names[] = { "LaunchWorkGraphNode", "BitonicSortNode", "SplitNode", "LeafSortNode", "MergeNode" };
+	static_assert(std::size(k_names) == static_cast<size_t>(WorkGraphNode::Count));
+	return k_names[static_cast<uint32_t>(node)];
+}
+
+inline std::string FormatWorkGraphStat(uint32_t value, uint32_t expected)
+{
+	char text[48] = {};
+	if (value == expected)
+	{
+		std::snprintf(text, sizeof(text), "%u", value);
+	}
+	else
+	{
+		std::snprintf(text, sizeof(text), "%u (expected %u)", value, expected);
+	}
+	return text;
+}
+
+// Walks the ranges of the recursive topology like SplitNode: every range that does not fit a leaf is halved,
+// and each range with two children is merged once both completed, the merge of the root emits nothing.
+inline void PredictRecursiveRange(WorkGraphStats& stats, uint32_t count, uint32_t numThreads, uint32_t leafSize, uint32_t mergeElementsPerThread)
+{
+	auto& split = stats[static_cast<size_t>(WorkGraphNode::Split)];
+	auto& leaf = stats[static_cast<size_t>(WorkGraphNode::LeafSort)];
+	auto& merge = stats[static_cast<size_t>(WorkGraphNode::Merge)];
+
+	++split.m_recordsIn;
+	++split.m_threads;
+	const auto numChildren = (count <= leafSize) ? 1u : 2u;
+	const auto childCount = count / numChildren;
+	split.m_recordsOut += numChildren;
+	for (uint32_t c = 0; c < numChildren; ++c)
+	{
+		if (childCount <= leafSize)
+		{
+			++leaf.m_recordsIn;
+			++leaf.m_groups;
+			leaf.m_threads += numThreads;
+		}
+		else
+		{
+			PredictRecursiveRange(stats, childCount, numThreads, leafSize, mergeElementsPerThread);
+		}
+	}
+	if (numChildren == 1)
+	{
+		return;
+	}
+
+	// The last of the two children to complete emits the merge, a leaf or the merge of the child range.
+	++((childCount <= leafSize) ? leaf : merge).m_recordsOut;
+	const auto dispatchGrid = (std::clamp)(count / (numThreads * mergeElementsPerThread), 1u, KernelVariant::k_maxDispatchGrid);
+	const auto numActiveThreads = (count + mergeElementsPerThread - 1) / mergeElementsPerThread;
+	++merge.m_recordsIn;
+	merge.m_groups += dispatchGrid;
+	merge.m_threads += dispatchGrid * numThreads;
+	merge.m_earlyExits += dispatchGrid * numThreads - (std::min)(dispatchGrid * numThreads, numActiveThreads);
+}
+
+// Counters one sort of numSortElements keys with the variant is expected to produce, from the structure of its work graph alone.
+// keysPerWord is the narrow key packing of the launcher topologies, mergeElementsPerThread and leafKeysPerThread
+// match MERGE_ELEMENTS_PER_THREAD and RECURSIVE_LEAF_SIZE of the recursive one. numSortElements must be a power of two.
+inline WorkGraphStats PredictWorkGraphStats(const KernelVariant& variant, uint32_t numSortElements, uint32_t keysPerWord, uint32_t mergeElementsPerThread, uint32_t leafKeysPerThread)
+{
+	auto stats = WorkGraphStats();
+	auto& launch = stats[static_cast<size_t>(WorkGraphNode::Launch)];
+	auto& bitonicSort = stats[static_cast<size_t>(WorkGraphNode::BitonicSort)];
+	const auto numThreads = variant.m_threadsPerGroup;
+
+	// One pass record per (inc, dir) of the bitonic sort, the same loop as LaunchWorkGraphNode.
+	const auto log2n = static_cast<uint32_t>(std::bit_width(numSortElements)) - 1;
+	const auto numPasses = log2n * (log2n + 1) / 2;
+	// Threads of a pass and the threads of those within the sort range, like IsOutOfSortRange.
+	const auto numSortUnits = numSortElements / 2 / keysPerWord;
+	const auto dispatchGrid = variant.GetDispatchGrid(numSortElements / keysPerWord);
+	const auto numDispatchThreads = dispatchGrid * numThreads;
+	const auto numActiveThreads = (std::min)(numDispatchThreads, (numSortUnits + variant.m_elementsPerThread - 1) / variant.m_elementsPerThread);
+
+	switch (variant.m_topology)
+	{
+	case KernelTopology::Launcher:
+		launch = { 1, numPasses, 1, 1, 0 };
+		bitonicSort = { numPasses, 0, numPasses * dispatchGrid, numPasses * numDispatchThreads, numPasses * (numDispatchThreads - numActiveThreads) };
+		break;
+	case KernelTopology::LauncherMultiDispatchGrid:
+		// Every thread in the sort range emits a thread record per pass.
+		launch = { 1, numActiveThreads * numPasses, dispatchGrid, numDispatchThreads, numDispatchThreads - numActiveThreads };
+		bitonicSort = { numActiveThreads * numPasses, 0, 0, numActiveThreads * numPasses, 0 };
+		break;
+	case KernelTopology::Recursive:
+		PredictRecursiveRange(stats, numSortElements, numThreads, numThreads * leafKeysPerThread, mergeElementsPerThread);
+		break;
+	default:
+		break;
+	}
+	return stats;
+}
+
+// One line per node that ran, each field followed by its expected value where they differ. Returns whether all matched.
+inline bool PrintWorkGraphStats(const WorkGraphStats& stats, const WorkGraphStats& expected)
+{
+	auto isMatched = true;
+	for (uint32_t node = 0; node < static_cast<uint32_t>(WorkGraphNode::Count); ++node)
+	{
+		const auto& actual = stats[node];
+		const auto& model = expected[node];
+		if (actual == WorkGraphNodeStats() && model == WorkGraphNodeStats())
+		{
+			continue;
+		}
+		printf
+		(
+			"  %-20s records in %s, records out %s, groups %s, threads %s, early exits %s (%.1f%%)%s\n",
+			GetWorkGraphNodeName(static_cast<WorkGraphNode>(node)),
+			FormatWorkGraphStat(actual.m_recordsIn, model.m_recordsIn).c_str(),
+			FormatWorkGraphStat(actual.m_recordsOut, model.m_recordsOut).c_str(),
+			FormatWorkGraphStat(actual.m_groups, model.m_groups).c_str(),
+			FormatWorkGraphStat(actual.m_threads, model.m_threads).c_str(),
+			FormatWorkGraphStat(actual.m_earlyExits, model.m_earlyExits).c_str(),
+			(actual.m_threads > 0) ? 100.0 * actual.m_earlyExits / actual.m_threads : 0.0,
+			(actual == model) ? "" : " MISMATCH"
+		);
+		isMatched &= (actual == model);
+	}
+	return isMatched;
+}
+}
\ No newline at end of file